@@ -1,4 +1,5 @@
 #include "Compression.hpp"
+#include "Trace.hpp"
 #include <zfp.h>
 #include <stdexcept>
 #include <cstring>
@@ -50,6 +51,8 @@ namespace Compression
       void * buffer,
       size_t & bufferSize )
    {
+      TRACE_SCOPE_ARGS( "Compression::EncodeZfp", "values", arrayDimension );
+
       // Allocate meta data for the array
       zfp_field * field = zfp_field_1d( array,
          zfp_type_double,
@@ -59,7 +62,7 @@ namespace Compression
       zfp_stream * zfp = zfp_stream_open( NULL );
 
       // Set accuracy tolerance
-      zfp_stream_set_accuracy( zfp, 1e-4 ) ;
+      zfp_stream_set_accuracy( zfp, ZFP_ACCURACY );
 
       // Associate bit stream with allocated buffer
       bitstream * stream = stream_open( buffer, bufferSize );
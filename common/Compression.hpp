@@ -7,6 +7,9 @@
 
 namespace Compression
 {
+   // Largest error EncodeZfp() leaves in any value
+   const double ZFP_ACCURACY = 1e-4;
+   
    void DecodeZfp( const uint8_t * compressedData,
       size_t dataSize,
       std::vector<double> & array );
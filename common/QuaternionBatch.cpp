@@ -0,0 +1,963 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include "QuaternionBatch.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+   #define HAVE_AVX2_KERNEL
+   #include <immintrin.h>
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+   #define HAVE_NEON_KERNEL
+   #include <arm_neon.h>
+#endif
+
+using namespace QuaternionBatch;
+
+namespace
+{
+   // Same thresholds as Eigen
+   const double SLERP_ONE = 1.0 - std::numeric_limits< double >::epsilon();
+   const double OPPOSITE_COSINE = -1.0 + 1e-12;
+
+   // Every kernel handles [begin, end) of its arrays, so the SIMD kernels can hand their leftovers to the scalar ones
+   struct KernelTable
+   {
+      void (*multiply)( const Quaternions &, const Quaternions &, const Quaternions &, size_t, size_t );
+      void (*conjugate)( const Quaternions &, const Quaternions &, size_t, size_t );
+      void (*normalize)( const Quaternions &, const Quaternions &, size_t, size_t );
+      void (*rotate)( const Quaternions &, const Vectors &, const Vectors &, size_t, size_t );
+      void (*slerp)( const Quaternions &, const Quaternions &, const double *, const Quaternions &, size_t, size_t );
+      void (*nlerp)( const Quaternions &, const Quaternions &, const double *, const Quaternions &, size_t, size_t );
+      void (*fromTwoVectors)( const Vectors &, const Vectors &, const Quaternions &, size_t, size_t );
+      void (*transformPoints)( const double *, const double *, double *, size_t, size_t );
+      void (*scalePoints)( const double *, const double *, double *, size_t, size_t );
+   };
+
+   // -------------------------------------------------
+   // Scalar reference, written the way Eigen computes each result
+   // -------------------------------------------------
+   void MultiplyScalar( const Quaternions & a,
+      const Quaternions & b,
+      const Quaternions & out,
+      size_t begin,
+      size_t end )
+   {
+      for ( size_t i = begin; i < end; ++i )
+      {
+         const double ax = a.x[ i ], ay = a.y[ i ], az = a.z[ i ], aw = a.w[ i ];
+         const double bx = b.x[ i ], by = b.y[ i ], bz = b.z[ i ], bw = b.w[ i ];
+         out.w[ i ] = aw * bw - ax * bx - ay * by - az * bz;
+         out.x[ i ] = aw * bx + ax * bw + ay * bz - az * by;
+         out.y[ i ] = aw * by + ay * bw + az * bx - ax * bz;
+         out.z[ i ] = aw * bz + az * bw + ax * by - ay * bx;
+      }
+   }
+   void ConjugateScalar( const Quaternions & q,
+      const Quaternions & out,
+      size_t begin,
+      size_t end )
+   {
+      for ( size_t i = begin; i < end; ++i )
+      {
+         out.x[ i ] = -q.x[ i ];
+         out.y[ i ] = -q.y[ i ];
+         out.z[ i ] = -q.z[ i ];
+         out.w[ i ] = q.w[ i ];
+      }
+   }
+   void NormalizeScalar( const Quaternions & q,
+      const Quaternions & out,
+      size_t begin,
+      size_t end )
+   {
+      for ( size_t i = begin; i < end; ++i )
+      {
+         const double x = q.x[ i ], y = q.y[ i ], z = q.z[ i ], w = q.w[ i ];
+         const double norm = std::sqrt( x * x + y * y + z * z + w * w );
+         const double divisor = norm > 0 ? norm : 1.0;
+         out.x[ i ] = x / divisor;
+         out.y[ i ] = y / divisor;
+         out.z[ i ] = z / divisor;
+         out.w[ i ] = w / divisor;
+      }
+   }
+   void RotateScalar( const Quaternions & q,
+      const Vectors & v,
+      const Vectors & out,
+      size_t begin,
+      size_t end )
+   {
+      for ( size_t i = begin; i < end; ++i )
+      {
+         const double qx = q.x[ i ], qy = q.y[ i ], qz = q.z[ i ], qw = q.w[ i ];
+         const double vx = v.x[ i ], vy = v.y[ i ], vz = v.z[ i ];
+
+         // v + 2w(q x v) + q x 2(q x v)
+         double uvx = qy * vz - qz * vy;
+         double uvy = qz * vx - qx * vz;
+         double uvz = qx * vy - qy * vx;
+         uvx += uvx;
+         uvy += uvy;
+         uvz += uvz;
+         out.x[ i ] = vx + qw * uvx + (qy * uvz - qz * uvy);
+         out.y[ i ] = vy + qw * uvy + (qz * uvx - qx * uvz);
+         out.z[ i ] = vz + qw * uvz + (qx * uvy - qy * uvx);
+      }
+   }
+
+   // Weights of the two rotations for SLERP, given their dot product @d
+   void SlerpScales( double d,
+      double t,
+      double & out_scale0,
+      double & out_scale1 )
+   {
+      const double absD = std::abs( d );
+      if ( absD >= SLERP_ONE )
+      {
+         out_scale0 = 1.0 - t;
+         out_scale1 = t;
+      }
+      else
+      {
+         const double theta = std::acos( absD );
+         const double sinTheta = std::sin( theta );
+         out_scale0 = std::sin( (1.0 - t) * theta ) / sinTheta;
+         out_scale1 = std::sin( t * theta ) / sinTheta;
+      }
+      if ( d < 0 )
+         out_scale1 = -out_scale1;
+   }
+   void SlerpScalar( const Quaternions & a,
+      const Quaternions & b,
+      const double * t,
+      const Quaternions & out,
+      size_t begin,
+      size_t end )
+   {
+      for ( size_t i = begin; i < end; ++i )
+      {
+         const double d = a.x[ i ] * b.x[ i ] + a.y[ i ] * b.y[ i ] + a.z[ i ] * b.z[ i ] + a.w[ i ] * b.w[ i ];
+         double scale0, scale1;
+         SlerpScales( d, t[ i ], scale0, scale1 );
+         out.x[ i ] = scale0 * a.x[ i ] + scale1 * b.x[ i ];
+         out.y[ i ] = scale0 * a.y[ i ] + scale1 * b.y[ i ];
+         out.z[ i ] = scale0 * a.z[ i ] + scale1 * b.z[ i ];
+         out.w[ i ] = scale0 * a.w[ i ] + scale1 * b.w[ i ];
+      }
+   }
+   void NlerpScalar( const Quaternions & a,
+      const Quaternions & b,
+      const double * t,
+      const Quaternions & out,
+      size_t begin,
+      size_t end )
+   {
+      for ( size_t i = begin; i < end; ++i )
+      {
+         const double d = a.x[ i ] * b.x[ i ] + a.y[ i ] * b.y[ i ] + a.z[ i ] * b.z[ i ] + a.w[ i ] * b.w[ i ];
+         const double scale0 = 1.0 - t[ i ];
+         const double scale1 = d < 0 ? -t[ i ] : t[ i ];
+         out.x[ i ] = scale0 * a.x[ i ] + scale1 * b.x[ i ];
+         out.y[ i ] = scale0 * a.y[ i ] + scale1 * b.y[ i ];
+         out.z[ i ] = scale0 * a.z[ i ] + scale1 * b.z[ i ];
+         out.w[ i ] = scale0 * a.w[ i ] + scale1 * b.w[ i ];
+      }
+      NormalizeScalar( out, out, begin, end );
+   }
+
+   // Opposite vectors have no smallest rotation; turn half way round any axis perpendicular to @v0
+   void FromOppositeVectors( double v0x,
+      double v0y,
+      double v0z,
+      double c,
+      const Quaternions & out,
+      size_t i )
+   {
+      double axisX, axisY, axisZ;
+      if ( std::abs( v0x ) < 0.9 )
+      {
+         // v0 x UnitX
+         axisX = 0;
+         axisY = v0z;
+         axisZ = -v0y;
+      }
+      else
+      {
+         // v0 x UnitY
+         axisX = -v0z;
+         axisY = 0;
+         axisZ = v0x;
+      }
+      const double axisNorm = std::sqrt( axisX * axisX + axisY * axisY + axisZ * axisZ );
+      c = std::max( c, -1.0 );
+      const double w2 = (1.0 + c) * 0.5;
+      const double sinHalfAngle = std::sqrt( 1.0 - w2 ) / axisNorm;
+      out.x[ i ] = axisX * sinHalfAngle;
+      out.y[ i ] = axisY * sinHalfAngle;
+      out.z[ i ] = axisZ * sinHalfAngle;
+      out.w[ i ] = std::sqrt( w2 );
+   }
+   void FromTwoVectorsScalar( const Vectors & a,
+      const Vectors & b,
+      const Quaternions & out,
+      size_t begin,
+      size_t end )
+   {
+      for ( size_t i = begin; i < end; ++i )
+      {
+         const double ax = a.x[ i ], ay = a.y[ i ], az = a.z[ i ];
+         const double bx = b.x[ i ], by = b.y[ i ], bz = b.z[ i ];
+         double aNorm = std::sqrt( ax * ax + ay * ay + az * az );
+         double bNorm = std::sqrt( bx * bx + by * by + bz * bz );
+         aNorm = aNorm > 0 ? aNorm : 1.0;
+         bNorm = bNorm > 0 ? bNorm : 1.0;
+         const double v0x = ax / aNorm, v0y = ay / aNorm, v0z = az / aNorm;
+         const double v1x = bx / bNorm, v1y = by / bNorm, v1z = bz / bNorm;
+         const double c = v1x * v0x + v1y * v0y + v1z * v0z;
+
+         if ( c < OPPOSITE_COSINE )
+         {
+            FromOppositeVectors( v0x, v0y, v0z, c, out, i );
+            continue;
+         }
+
+         const double s = std::sqrt( (1.0 + c) * 2.0 );
+         const double invS = 1.0 / s;
+         out.x[ i ] = (v0y * v1z - v0z * v1y) * invS;
+         out.y[ i ] = (v0z * v1x - v0x * v1z) * invS;
+         out.z[ i ] = (v0x * v1y - v0y * v1x) * invS;
+         out.w[ i ] = s * 0.5;
+      }
+   }
+
+   void TransformPointsScalar( const double * matrix,
+      const double * points,
+      double * out,
+      size_t begin,
+      size_t end )
+   {
+      const double * m = matrix;
+      for ( size_t i = begin; i < end; ++i )
+      {
+         const double x = points[ i * 3 ], y = points[ i * 3 + 1 ], z = points[ i * 3 + 2 ];
+         out[ i * 3 ] = m[ 0 ] * x + m[ 1 ] * y + m[ 2 ] * z + m[ 3 ];
+         out[ i * 3 + 1 ] = m[ 4 ] * x + m[ 5 ] * y + m[ 6 ] * z + m[ 7 ];
+         out[ i * 3 + 2 ] = m[ 8 ] * x + m[ 9 ] * y + m[ 10 ] * z + m[ 11 ];
+      }
+   }
+   void ScalePointsScalar( const double * scale,
+      const double * points,
+      double * out,
+      size_t begin,
+      size_t end )
+   {
+      for ( size_t i = begin; i < end; ++i )
+      {
+         out[ i * 3 ] = points[ i * 3 ] * scale[ 0 ];
+         out[ i * 3 + 1 ] = points[ i * 3 + 1 ] * scale[ 1 ];
+         out[ i * 3 + 2 ] = points[ i * 3 + 2 ] * scale[ 2 ];
+      }
+   }
+
+   const KernelTable SCALAR_KERNELS = {
+      MultiplyScalar,
+      ConjugateScalar,
+      NormalizeScalar,
+      RotateScalar,
+      SlerpScalar,
+      NlerpScalar,
+      FromTwoVectorsScalar,
+      TransformPointsScalar,
+      ScalePointsScalar
+   };
+
+#ifdef HAVE_AVX2_KERNEL
+   // -------------------------------------------------
+   // AVX2, 4 at a time. The same operations in the same order as the scalar kernels, and no fused multiply-adds,
+   // so results don't depend on which kernel ran. The upper halves of the registers are cleared before running any
+   // SSE code (the scalar kernels and the math library), which unoptimized builds don't do on their own and which
+   // otherwise slows that code down by an order of magnitude.
+   // -------------------------------------------------
+   #define AVX2_TARGET __attribute__(( target( "avx2" ) ))
+
+   AVX2_TARGET void MultiplyAvx2( const Quaternions & a,
+      const Quaternions & b,
+      const Quaternions & out,
+      size_t begin,
+      size_t end )
+   {
+      size_t i = begin;
+      for ( ; i + 4 <= end; i += 4 )
+      {
+         const __m256d ax = _mm256_loadu_pd( a.x + i ), ay = _mm256_loadu_pd( a.y + i );
+         const __m256d az = _mm256_loadu_pd( a.z + i ), aw = _mm256_loadu_pd( a.w + i );
+         const __m256d bx = _mm256_loadu_pd( b.x + i ), by = _mm256_loadu_pd( b.y + i );
+         const __m256d bz = _mm256_loadu_pd( b.z + i ), bw = _mm256_loadu_pd( b.w + i );
+         const __m256d w = _mm256_sub_pd( _mm256_sub_pd( _mm256_sub_pd( _mm256_mul_pd( aw, bw ), _mm256_mul_pd( ax, bx ) ), _mm256_mul_pd( ay, by ) ), _mm256_mul_pd( az, bz ) );
+         const __m256d x = _mm256_sub_pd( _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( aw, bx ), _mm256_mul_pd( ax, bw ) ), _mm256_mul_pd( ay, bz ) ), _mm256_mul_pd( az, by ) );
+         const __m256d y = _mm256_sub_pd( _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( aw, by ), _mm256_mul_pd( ay, bw ) ), _mm256_mul_pd( az, bx ) ), _mm256_mul_pd( ax, bz ) );
+         const __m256d z = _mm256_sub_pd( _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( aw, bz ), _mm256_mul_pd( az, bw ) ), _mm256_mul_pd( ax, by ) ), _mm256_mul_pd( ay, bx ) );
+         _mm256_storeu_pd( out.x + i, x );
+         _mm256_storeu_pd( out.y + i, y );
+         _mm256_storeu_pd( out.z + i, z );
+         _mm256_storeu_pd( out.w + i, w );
+      }
+      _mm256_zeroupper();
+      MultiplyScalar( a, b, out, i, end );
+   }
+   AVX2_TARGET void ConjugateAvx2( const Quaternions & q,
+      const Quaternions & out,
+      size_t begin,
+      size_t end )
+   {
+      const __m256d sign = _mm256_set1_pd( -0.0 );
+      size_t i = begin;
+      for ( ; i + 4 <= end; i += 4 )
+      {
+         _mm256_storeu_pd( out.x + i, _mm256_xor_pd( _mm256_loadu_pd( q.x + i ), sign ) );
+         _mm256_storeu_pd( out.y + i, _mm256_xor_pd( _mm256_loadu_pd( q.y + i ), sign ) );
+         _mm256_storeu_pd( out.z + i, _mm256_xor_pd( _mm256_loadu_pd( q.z + i ), sign ) );
+         _mm256_storeu_pd( out.w + i, _mm256_loadu_pd( q.w + i ) );
+      }
+      _mm256_zeroupper();
+      ConjugateScalar( q, out, i, end );
+   }
+
+   // @x / @divisor, or @x where the divisor is 0
+   AVX2_TARGET inline __m256d SafeDivideAvx2( __m256d x,
+      __m256d divisor )
+   {
+      const __m256d positive = _mm256_cmp_pd( divisor, _mm256_setzero_pd(), _CMP_GT_OQ );
+      return _mm256_div_pd( x, _mm256_blendv_pd( _mm256_set1_pd( 1.0 ), divisor, positive ) );
+   }
+   AVX2_TARGET inline __m256d Dot4Avx2( __m256d ax, __m256d ay, __m256d az, __m256d aw,
+      __m256d bx, __m256d by, __m256d bz, __m256d bw )
+   {
+      return _mm256_add_pd( _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( ax, bx ), _mm256_mul_pd( ay, by ) ), _mm256_mul_pd( az, bz ) ), _mm256_mul_pd( aw, bw ) );
+   }
+   AVX2_TARGET void NormalizeAvx2( const Quaternions & q,
+      const Quaternions & out,
+      size_t begin,
+      size_t end )
+   {
+      size_t i = begin;
+      for ( ; i + 4 <= end; i += 4 )
+      {
+         const __m256d x = _mm256_loadu_pd( q.x + i ), y = _mm256_loadu_pd( q.y + i );
+         const __m256d z = _mm256_loadu_pd( q.z + i ), w = _mm256_loadu_pd( q.w + i );
+         const __m256d norm = _mm256_sqrt_pd( Dot4Avx2( x, y, z, w, x, y, z, w ) );
+         _mm256_storeu_pd( out.x + i, SafeDivideAvx2( x, norm ) );
+         _mm256_storeu_pd( out.y + i, SafeDivideAvx2( y, norm ) );
+         _mm256_storeu_pd( out.z + i, SafeDivideAvx2( z, norm ) );
+         _mm256_storeu_pd( out.w + i, SafeDivideAvx2( w, norm ) );
+      }
+      _mm256_zeroupper();
+      NormalizeScalar( q, out, i, end );
+   }
+   AVX2_TARGET void RotateAvx2( const Quaternions & q,
+      const Vectors & v,
+      const Vectors & out,
+      size_t begin,
+      size_t end )
+   {
+      size_t i = begin;
+      for ( ; i + 4 <= end; i += 4 )
+      {
+         const __m256d qx = _mm256_loadu_pd( q.x + i ), qy = _mm256_loadu_pd( q.y + i );
+         const __m256d qz = _mm256_loadu_pd( q.z + i ), qw = _mm256_loadu_pd( q.w + i );
+         const __m256d vx = _mm256_loadu_pd( v.x + i ), vy = _mm256_loadu_pd( v.y + i ), vz = _mm256_loadu_pd( v.z + i );
+         __m256d uvx = _mm256_sub_pd( _mm256_mul_pd( qy, vz ), _mm256_mul_pd( qz, vy ) );
+         __m256d uvy = _mm256_sub_pd( _mm256_mul_pd( qz, vx ), _mm256_mul_pd( qx, vz ) );
+         __m256d uvz = _mm256_sub_pd( _mm256_mul_pd( qx, vy ), _mm256_mul_pd( qy, vx ) );
+         uvx = _mm256_add_pd( uvx, uvx );
+         uvy = _mm256_add_pd( uvy, uvy );
+         uvz = _mm256_add_pd( uvz, uvz );
+         const __m256d x = _mm256_add_pd( _mm256_add_pd( vx, _mm256_mul_pd( qw, uvx ) ), _mm256_sub_pd( _mm256_mul_pd( qy, uvz ), _mm256_mul_pd( qz, uvy ) ) );
+         const __m256d y = _mm256_add_pd( _mm256_add_pd( vy, _mm256_mul_pd( qw, uvy ) ), _mm256_sub_pd( _mm256_mul_pd( qz, uvx ), _mm256_mul_pd( qx, uvz ) ) );
+         const __m256d z = _mm256_add_pd( _mm256_add_pd( vz, _mm256_mul_pd( qw, uvz ) ), _mm256_sub_pd( _mm256_mul_pd( qx, uvy ), _mm256_mul_pd( qy, uvx ) ) );
+         _mm256_storeu_pd( out.x + i, x );
+         _mm256_storeu_pd( out.y + i, y );
+         _mm256_storeu_pd( out.z + i, z );
+      }
+      _mm256_zeroupper();
+      RotateScalar( q, v, out, i, end );
+   }
+
+   // out = scale0 * a + scale1 * b, for 4 quaternions
+   AVX2_TARGET inline void BlendAvx2( const Quaternions & a,
+      const Quaternions & b,
+      __m256d scale0,
+      __m256d scale1,
+      const Quaternions & out,
+      size_t i )
+   {
+      _mm256_storeu_pd( out.x + i, _mm256_add_pd( _mm256_mul_pd( scale0, _mm256_loadu_pd( a.x + i ) ), _mm256_mul_pd( scale1, _mm256_loadu_pd( b.x + i ) ) ) );
+      _mm256_storeu_pd( out.y + i, _mm256_add_pd( _mm256_mul_pd( scale0, _mm256_loadu_pd( a.y + i ) ), _mm256_mul_pd( scale1, _mm256_loadu_pd( b.y + i ) ) ) );
+      _mm256_storeu_pd( out.z + i, _mm256_add_pd( _mm256_mul_pd( scale0, _mm256_loadu_pd( a.z + i ) ), _mm256_mul_pd( scale1, _mm256_loadu_pd( b.z + i ) ) ) );
+      _mm256_storeu_pd( out.w + i, _mm256_add_pd( _mm256_mul_pd( scale0, _mm256_loadu_pd( a.w + i ) ), _mm256_mul_pd( scale1, _mm256_loadu_pd( b.w + i ) ) ) );
+   }
+   AVX2_TARGET inline __m256d DotAvx2( const Quaternions & a,
+      const Quaternions & b,
+      size_t i )
+   {
+      return Dot4Avx2( _mm256_loadu_pd( a.x + i ), _mm256_loadu_pd( a.y + i ), _mm256_loadu_pd( a.z + i ), _mm256_loadu_pd( a.w + i ),
+         _mm256_loadu_pd( b.x + i ), _mm256_loadu_pd( b.y + i ), _mm256_loadu_pd( b.z + i ), _mm256_loadu_pd( b.w + i ) );
+   }
+   // The SLERP weights for a block of dot products. Kept out of the AVX2 code, so calling into the math library
+   // doesn't switch between AVX and SSE for every lane.
+   __attribute__(( noinline )) void SlerpScalesBlock( const double * d,
+      const double * t,
+      double * out_scale0,
+      double * out_scale1,
+      size_t count )
+   {
+      for ( size_t i = 0; i < count; ++i )
+         SlerpScales( d[ i ], t[ i ], out_scale0[ i ], out_scale1[ i ] );
+   }
+   AVX2_TARGET void SlerpAvx2( const Quaternions & a,
+      const Quaternions & b,
+      const double * t,
+      const Quaternions & out,
+      size_t begin,
+      size_t end )
+   {
+      // There are no vector sines, so the weights are worked out one at a time, a block at a time
+      const size_t BLOCK_SIZE = 64;
+      alignas( 32 ) double d[ BLOCK_SIZE ], scale0[ BLOCK_SIZE ], scale1[ BLOCK_SIZE ];
+      size_t i = begin;
+      while ( i + 4 <= end )
+      {
+         const size_t blockSize = std::min( BLOCK_SIZE, (end - i) & ~size_t(3) );
+         for ( size_t j = 0; j < blockSize; j += 4 )
+            _mm256_store_pd( d + j, DotAvx2( a, b, i + j ) );
+         _mm256_zeroupper();
+         SlerpScalesBlock( d, t + i, scale0, scale1, blockSize );
+         for ( size_t j = 0; j < blockSize; j += 4 )
+            BlendAvx2( a, b, _mm256_load_pd( scale0 + j ), _mm256_load_pd( scale1 + j ), out, i + j );
+         i += blockSize;
+      }
+      _mm256_zeroupper();
+      SlerpScalar( a, b, t, out, i, end );
+   }
+   AVX2_TARGET void NlerpAvx2( const Quaternions & a,
+      const Quaternions & b,
+      const double * t,
+      const Quaternions & out,
+      size_t begin,
+      size_t end )
+   {
+      size_t i = begin;
+      for ( ; i + 4 <= end; i += 4 )
+      {
+         const __m256d ratio = _mm256_loadu_pd( t + i );
+         const __m256d negative = _mm256_cmp_pd( DotAvx2( a, b, i ), _mm256_setzero_pd(), _CMP_LT_OQ );
+         const __m256d scale0 = _mm256_sub_pd( _mm256_set1_pd( 1.0 ), ratio );
+         const __m256d scale1 = _mm256_xor_pd( ratio, _mm256_and_pd( negative, _mm256_set1_pd( -0.0 ) ) );
+         BlendAvx2( a, b, scale0, scale1, out, i );
+      }
+      _mm256_zeroupper();
+      NlerpScalar( a, b, t, out, i, end );
+      NormalizeAvx2( out, out, begin, i );
+   }
+   AVX2_TARGET void FromTwoVectorsAvx2( const Vectors & a,
+      const Vectors & b,
+      const Quaternions & out,
+      size_t begin,
+      size_t end )
+   {
+      size_t i = begin;
+      for ( ; i + 4 <= end; i += 4 )
+      {
+         const __m256d ax = _mm256_loadu_pd( a.x + i ), ay = _mm256_loadu_pd( a.y + i ), az = _mm256_loadu_pd( a.z + i );
+         const __m256d bx = _mm256_loadu_pd( b.x + i ), by = _mm256_loadu_pd( b.y + i ), bz = _mm256_loadu_pd( b.z + i );
+         const __m256d aNorm = _mm256_sqrt_pd( _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( ax, ax ), _mm256_mul_pd( ay, ay ) ), _mm256_mul_pd( az, az ) ) );
+         const __m256d bNorm = _mm256_sqrt_pd( _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( bx, bx ), _mm256_mul_pd( by, by ) ), _mm256_mul_pd( bz, bz ) ) );
+         const __m256d v0x = SafeDivideAvx2( ax, aNorm ), v0y = SafeDivideAvx2( ay, aNorm ), v0z = SafeDivideAvx2( az, aNorm );
+         const __m256d v1x = SafeDivideAvx2( bx, bNorm ), v1y = SafeDivideAvx2( by, bNorm ), v1z = SafeDivideAvx2( bz, bNorm );
+         const __m256d c = _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( v1x, v0x ), _mm256_mul_pd( v1y, v0y ) ), _mm256_mul_pd( v1z, v0z ) );
+
+         const __m256d s = _mm256_sqrt_pd( _mm256_mul_pd( _mm256_add_pd( _mm256_set1_pd( 1.0 ), c ), _mm256_set1_pd( 2.0 ) ) );
+         const __m256d invS = _mm256_div_pd( _mm256_set1_pd( 1.0 ), s );
+         _mm256_storeu_pd( out.x + i, _mm256_mul_pd( _mm256_sub_pd( _mm256_mul_pd( v0y, v1z ), _mm256_mul_pd( v0z, v1y ) ), invS ) );
+         _mm256_storeu_pd( out.y + i, _mm256_mul_pd( _mm256_sub_pd( _mm256_mul_pd( v0z, v1x ), _mm256_mul_pd( v0x, v1z ) ), invS ) );
+         _mm256_storeu_pd( out.z + i, _mm256_mul_pd( _mm256_sub_pd( _mm256_mul_pd( v0x, v1y ), _mm256_mul_pd( v0y, v1x ) ), invS ) );
+         _mm256_storeu_pd( out.w + i, _mm256_mul_pd( s, _mm256_set1_pd( 0.5 ) ) );
+
+         // Opposite vectors are rare, and redone one at a time
+         if ( _mm256_movemask_pd( _mm256_cmp_pd( c, _mm256_set1_pd( OPPOSITE_COSINE ), _CMP_LT_OQ ) ) )
+         {
+            _mm256_zeroupper();
+            FromTwoVectorsScalar( a, b, out, i, i + 4 );
+         }
+      }
+      _mm256_zeroupper();
+      FromTwoVectorsScalar( a, b, out, i, end );
+   }
+
+   // Points are packed {x, y, z}, so 4 of them fill 3 registers: { x0 y0 z0 x1 } { y1 z1 x2 y2 } { z2 x3 y3 z3 }.
+   // These shuffle them to and from one register per component.
+   AVX2_TARGET inline void DeinterleaveAvx2( const double * points,
+      __m256d & out_x,
+      __m256d & out_y,
+      __m256d & out_z )
+   {
+      const __m256d r0 = _mm256_loadu_pd( points ), r1 = _mm256_loadu_pd( points + 4 ), r2 = _mm256_loadu_pd( points + 8 );
+      out_x = _mm256_permute4x64_pd( _mm256_blend_pd( _mm256_blend_pd( r0, r1, 0x4 ), r2, 0x2 ), 0x6C ); // { x0 x3 x2 x1 }
+      out_y = _mm256_permute4x64_pd( _mm256_blend_pd( _mm256_blend_pd( r0, r1, 0x9 ), r2, 0x4 ), 0xB1 ); // { y1 y0 y3 y2 }
+      out_z = _mm256_permute4x64_pd( _mm256_blend_pd( _mm256_blend_pd( r0, r1, 0x2 ), r2, 0x9 ), 0xC6 ); // { z2 z1 z0 z3 }
+   }
+   AVX2_TARGET inline void InterleaveAvx2( __m256d x,
+      __m256d y,
+      __m256d z,
+      double * out )
+   {
+      // Each of the shuffles above is its own inverse
+      x = _mm256_permute4x64_pd( x, 0x6C );
+      y = _mm256_permute4x64_pd( y, 0xB1 );
+      z = _mm256_permute4x64_pd( z, 0xC6 );
+      _mm256_storeu_pd( out, _mm256_blend_pd( _mm256_blend_pd( x, y, 0x2 ), z, 0x4 ) );
+      _mm256_storeu_pd( out + 4, _mm256_blend_pd( _mm256_blend_pd( x, y, 0x9 ), z, 0x2 ) );
+      _mm256_storeu_pd( out + 8, _mm256_blend_pd( _mm256_blend_pd( x, y, 0x4 ), z, 0x9 ) );
+   }
+   AVX2_TARGET void TransformPointsAvx2( const double * matrix,
+      const double * points,
+      double * out,
+      size_t begin,
+      size_t end )
+   {
+      __m256d m[ 12 ];
+      for ( int j = 0; j < 12; ++j )
+         m[ j ] = _mm256_set1_pd( matrix[ j ] );
+      size_t i = begin;
+      for ( ; i + 4 <= end; i += 4 )
+      {
+         __m256d x, y, z;
+         DeinterleaveAvx2( points + i * 3, x, y, z );
+         const __m256d tx = _mm256_add_pd( _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( m[ 0 ], x ), _mm256_mul_pd( m[ 1 ], y ) ), _mm256_mul_pd( m[ 2 ], z ) ), m[ 3 ] );
+         const __m256d ty = _mm256_add_pd( _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( m[ 4 ], x ), _mm256_mul_pd( m[ 5 ], y ) ), _mm256_mul_pd( m[ 6 ], z ) ), m[ 7 ] );
+         const __m256d tz = _mm256_add_pd( _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( m[ 8 ], x ), _mm256_mul_pd( m[ 9 ], y ) ), _mm256_mul_pd( m[ 10 ], z ) ), m[ 11 ] );
+         InterleaveAvx2( tx, ty, tz, out + i * 3 );
+      }
+      _mm256_zeroupper();
+      TransformPointsScalar( matrix, points, out, i, end );
+   }
+   AVX2_TARGET void ScalePointsAvx2( const double * scale,
+      const double * points,
+      double * out,
+      size_t begin,
+      size_t end )
+   {
+      // The scales repeat every 3 values, so line them up with the 3 registers that hold 4 points
+      const __m256d s0 = _mm256_setr_pd( scale[ 0 ], scale[ 1 ], scale[ 2 ], scale[ 0 ] );
+      const __m256d s1 = _mm256_setr_pd( scale[ 1 ], scale[ 2 ], scale[ 0 ], scale[ 1 ] );
+      const __m256d s2 = _mm256_setr_pd( scale[ 2 ], scale[ 0 ], scale[ 1 ], scale[ 2 ] );
+      size_t i = begin;
+      for ( ; i + 4 <= end; i += 4 )
+      {
+         const double * p = points + i * 3;
+         double * o = out + i * 3;
+         _mm256_storeu_pd( o, _mm256_mul_pd( _mm256_loadu_pd( p ), s0 ) );
+         _mm256_storeu_pd( o + 4, _mm256_mul_pd( _mm256_loadu_pd( p + 4 ), s1 ) );
+         _mm256_storeu_pd( o + 8, _mm256_mul_pd( _mm256_loadu_pd( p + 8 ), s2 ) );
+      }
+      _mm256_zeroupper();
+      ScalePointsScalar( scale, points, out, i, end );
+   }
+
+   const KernelTable AVX2_KERNELS = {
+      MultiplyAvx2,
+      ConjugateAvx2,
+      NormalizeAvx2,
+      RotateAvx2,
+      SlerpAvx2,
+      NlerpAvx2,
+      FromTwoVectorsAvx2,
+      TransformPointsAvx2,
+      ScalePointsAvx2
+   };
+#endif
+
+#ifdef HAVE_NEON_KERNEL
+   // -------------------------------------------------
+   // NEON, 2 at a time
+   // -------------------------------------------------
+   void MultiplyNeon( const Quaternions & a,
+      const Quaternions & b,
+      const Quaternions & out,
+      size_t begin,
+      size_t end )
+   {
+      size_t i = begin;
+      for ( ; i + 2 <= end; i += 2 )
+      {
+         const float64x2_t ax = vld1q_f64( a.x + i ), ay = vld1q_f64( a.y + i ), az = vld1q_f64( a.z + i ), aw = vld1q_f64( a.w + i );
+         const float64x2_t bx = vld1q_f64( b.x + i ), by = vld1q_f64( b.y + i ), bz = vld1q_f64( b.z + i ), bw = vld1q_f64( b.w + i );
+         const float64x2_t w = vsubq_f64( vsubq_f64( vsubq_f64( vmulq_f64( aw, bw ), vmulq_f64( ax, bx ) ), vmulq_f64( ay, by ) ), vmulq_f64( az, bz ) );
+         const float64x2_t x = vsubq_f64( vaddq_f64( vaddq_f64( vmulq_f64( aw, bx ), vmulq_f64( ax, bw ) ), vmulq_f64( ay, bz ) ), vmulq_f64( az, by ) );
+         const float64x2_t y = vsubq_f64( vaddq_f64( vaddq_f64( vmulq_f64( aw, by ), vmulq_f64( ay, bw ) ), vmulq_f64( az, bx ) ), vmulq_f64( ax, bz ) );
+         const float64x2_t z = vsubq_f64( vaddq_f64( vaddq_f64( vmulq_f64( aw, bz ), vmulq_f64( az, bw ) ), vmulq_f64( ax, by ) ), vmulq_f64( ay, bx ) );
+         vst1q_f64( out.x + i, x );
+         vst1q_f64( out.y + i, y );
+         vst1q_f64( out.z + i, z );
+         vst1q_f64( out.w + i, w );
+      }
+      MultiplyScalar( a, b, out, i, end );
+   }
+   void ConjugateNeon( const Quaternions & q,
+      const Quaternions & out,
+      size_t begin,
+      size_t end )
+   {
+      size_t i = begin;
+      for ( ; i + 2 <= end; i += 2 )
+      {
+         vst1q_f64( out.x + i, vnegq_f64( vld1q_f64( q.x + i ) ) );
+         vst1q_f64( out.y + i, vnegq_f64( vld1q_f64( q.y + i ) ) );
+         vst1q_f64( out.z + i, vnegq_f64( vld1q_f64( q.z + i ) ) );
+         vst1q_f64( out.w + i, vld1q_f64( q.w + i ) );
+      }
+      ConjugateScalar( q, out, i, end );
+   }
+   inline float64x2_t SafeDivideNeon( float64x2_t x,
+      float64x2_t divisor )
+   {
+      const uint64x2_t positive = vcgtq_f64( divisor, vdupq_n_f64( 0.0 ) );
+      return vdivq_f64( x, vbslq_f64( positive, divisor, vdupq_n_f64( 1.0 ) ) );
+   }
+   void NormalizeNeon( const Quaternions & q,
+      const Quaternions & out,
+      size_t begin,
+      size_t end )
+   {
+      size_t i = begin;
+      for ( ; i + 2 <= end; i += 2 )
+      {
+         const float64x2_t x = vld1q_f64( q.x + i ), y = vld1q_f64( q.y + i ), z = vld1q_f64( q.z + i ), w = vld1q_f64( q.w + i );
+         const float64x2_t norm = vsqrtq_f64( vaddq_f64( vaddq_f64( vaddq_f64( vmulq_f64( x, x ), vmulq_f64( y, y ) ), vmulq_f64( z, z ) ), vmulq_f64( w, w ) ) );
+         vst1q_f64( out.x + i, SafeDivideNeon( x, norm ) );
+         vst1q_f64( out.y + i, SafeDivideNeon( y, norm ) );
+         vst1q_f64( out.z + i, SafeDivideNeon( z, norm ) );
+         vst1q_f64( out.w + i, SafeDivideNeon( w, norm ) );
+      }
+      NormalizeScalar( q, out, i, end );
+   }
+   void RotateNeon( const Quaternions & q,
+      const Vectors & v,
+      const Vectors & out,
+      size_t begin,
+      size_t end )
+   {
+      size_t i = begin;
+      for ( ; i + 2 <= end; i += 2 )
+      {
+         const float64x2_t qx = vld1q_f64( q.x + i ), qy = vld1q_f64( q.y + i ), qz = vld1q_f64( q.z + i ), qw = vld1q_f64( q.w + i );
+         const float64x2_t vx = vld1q_f64( v.x + i ), vy = vld1q_f64( v.y + i ), vz = vld1q_f64( v.z + i );
+         float64x2_t uvx = vsubq_f64( vmulq_f64( qy, vz ), vmulq_f64( qz, vy ) );
+         float64x2_t uvy = vsubq_f64( vmulq_f64( qz, vx ), vmulq_f64( qx, vz ) );
+         float64x2_t uvz = vsubq_f64( vmulq_f64( qx, vy ), vmulq_f64( qy, vx ) );
+         uvx = vaddq_f64( uvx, uvx );
+         uvy = vaddq_f64( uvy, uvy );
+         uvz = vaddq_f64( uvz, uvz );
+         vst1q_f64( out.x + i, vaddq_f64( vaddq_f64( vx, vmulq_f64( qw, uvx ) ), vsubq_f64( vmulq_f64( qy, uvz ), vmulq_f64( qz, uvy ) ) ) );
+         vst1q_f64( out.y + i, vaddq_f64( vaddq_f64( vy, vmulq_f64( qw, uvy ) ), vsubq_f64( vmulq_f64( qz, uvx ), vmulq_f64( qx, uvz ) ) ) );
+         vst1q_f64( out.z + i, vaddq_f64( vaddq_f64( vz, vmulq_f64( qw, uvz ) ), vsubq_f64( vmulq_f64( qx, uvy ), vmulq_f64( qy, uvx ) ) ) );
+      }
+      RotateScalar( q, v, out, i, end );
+   }
+   void BlendNeon( const Quaternions & a,
+      const Quaternions & b,
+      float64x2_t scale0,
+      float64x2_t scale1,
+      const Quaternions & out,
+      size_t i )
+   {
+      vst1q_f64( out.x + i, vaddq_f64( vmulq_f64( scale0, vld1q_f64( a.x + i ) ), vmulq_f64( scale1, vld1q_f64( b.x + i ) ) ) );
+      vst1q_f64( out.y + i, vaddq_f64( vmulq_f64( scale0, vld1q_f64( a.y + i ) ), vmulq_f64( scale1, vld1q_f64( b.y + i ) ) ) );
+      vst1q_f64( out.z + i, vaddq_f64( vmulq_f64( scale0, vld1q_f64( a.z + i ) ), vmulq_f64( scale1, vld1q_f64( b.z + i ) ) ) );
+      vst1q_f64( out.w + i, vaddq_f64( vmulq_f64( scale0, vld1q_f64( a.w + i ) ), vmulq_f64( scale1, vld1q_f64( b.w + i ) ) ) );
+   }
+   float64x2_t DotNeon( const Quaternions & a,
+      const Quaternions & b,
+      size_t i )
+   {
+      return vaddq_f64( vaddq_f64( vaddq_f64( vmulq_f64( vld1q_f64( a.x + i ), vld1q_f64( b.x + i ) ), vmulq_f64( vld1q_f64( a.y + i ), vld1q_f64( b.y + i ) ) ),
+         vmulq_f64( vld1q_f64( a.z + i ), vld1q_f64( b.z + i ) ) ), vmulq_f64( vld1q_f64( a.w + i ), vld1q_f64( b.w + i ) ) );
+   }
+   void SlerpNeon( const Quaternions & a,
+      const Quaternions & b,
+      const double * t,
+      const Quaternions & out,
+      size_t begin,
+      size_t end )
+   {
+      size_t i = begin;
+      for ( ; i + 2 <= end; i += 2 )
+      {
+         double d[ 2 ], scale0[ 2 ], scale1[ 2 ];
+         vst1q_f64( d, DotNeon( a, b, i ) );
+         for ( int lane = 0; lane < 2; ++lane )
+            SlerpScales( d[ lane ], t[ i + lane ], scale0[ lane ], scale1[ lane ] );
+         BlendNeon( a, b, vld1q_f64( scale0 ), vld1q_f64( scale1 ), out, i );
+      }
+      SlerpScalar( a, b, t, out, i, end );
+   }
+   void NlerpNeon( const Quaternions & a,
+      const Quaternions & b,
+      const double * t,
+      const Quaternions & out,
+      size_t begin,
+      size_t end )
+   {
+      size_t i = begin;
+      for ( ; i + 2 <= end; i += 2 )
+      {
+         const float64x2_t ratio = vld1q_f64( t + i );
+         const uint64x2_t negative = vcltq_f64( DotNeon( a, b, i ), vdupq_n_f64( 0.0 ) );
+         const float64x2_t scale0 = vsubq_f64( vdupq_n_f64( 1.0 ), ratio );
+         const float64x2_t scale1 = vbslq_f64( negative, vnegq_f64( ratio ), ratio );
+         BlendNeon( a, b, scale0, scale1, out, i );
+      }
+      NlerpScalar( a, b, t, out, i, end );
+      NormalizeNeon( out, out, begin, i );
+   }
+   void FromTwoVectorsNeon( const Vectors & a,
+      const Vectors & b,
+      const Quaternions & out,
+      size_t begin,
+      size_t end )
+   {
+      size_t i = begin;
+      for ( ; i + 2 <= end; i += 2 )
+      {
+         const float64x2_t ax = vld1q_f64( a.x + i ), ay = vld1q_f64( a.y + i ), az = vld1q_f64( a.z + i );
+         const float64x2_t bx = vld1q_f64( b.x + i ), by = vld1q_f64( b.y + i ), bz = vld1q_f64( b.z + i );
+         const float64x2_t aNorm = vsqrtq_f64( vaddq_f64( vaddq_f64( vmulq_f64( ax, ax ), vmulq_f64( ay, ay ) ), vmulq_f64( az, az ) ) );
+         const float64x2_t bNorm = vsqrtq_f64( vaddq_f64( vaddq_f64( vmulq_f64( bx, bx ), vmulq_f64( by, by ) ), vmulq_f64( bz, bz ) ) );
+         const float64x2_t v0x = SafeDivideNeon( ax, aNorm ), v0y = SafeDivideNeon( ay, aNorm ), v0z = SafeDivideNeon( az, aNorm );
+         const float64x2_t v1x = SafeDivideNeon( bx, bNorm ), v1y = SafeDivideNeon( by, bNorm ), v1z = SafeDivideNeon( bz, bNorm );
+         const float64x2_t c = vaddq_f64( vaddq_f64( vmulq_f64( v1x, v0x ), vmulq_f64( v1y, v0y ) ), vmulq_f64( v1z, v0z ) );
+
+         const float64x2_t s = vsqrtq_f64( vmulq_f64( vaddq_f64( vdupq_n_f64( 1.0 ), c ), vdupq_n_f64( 2.0 ) ) );
+         const float64x2_t invS = vdivq_f64( vdupq_n_f64( 1.0 ), s );
+         vst1q_f64( out.x + i, vmulq_f64( vsubq_f64( vmulq_f64( v0y, v1z ), vmulq_f64( v0z, v1y ) ), invS ) );
+         vst1q_f64( out.y + i, vmulq_f64( vsubq_f64( vmulq_f64( v0z, v1x ), vmulq_f64( v0x, v1z ) ), invS ) );
+         vst1q_f64( out.z + i, vmulq_f64( vsubq_f64( vmulq_f64( v0x, v1y ), vmulq_f64( v0y, v1x ) ), invS ) );
+         vst1q_f64( out.w + i, vmulq_f64( s, vdupq_n_f64( 0.5 ) ) );
+
+         const uint64x2_t opposite = vcltq_f64( c, vdupq_n_f64( OPPOSITE_COSINE ) );
+         if ( vgetq_lane_u64( opposite, 0 ) | vgetq_lane_u64( opposite, 1 ) )
+            FromTwoVectorsScalar( a, b, out, i, i + 2 );
+      }
+      FromTwoVectorsScalar( a, b, out, i, end );
+   }
+
+   void TransformPointsNeon( const double * matrix,
+      const double * points,
+      double * out,
+      size_t begin,
+      size_t end )
+   {
+      float64x2_t m[ 12 ];
+      for ( int j = 0; j < 12; ++j )
+         m[ j ] = vdupq_n_f64( matrix[ j ] );
+      size_t i = begin;
+      for ( ; i + 2 <= end; i += 2 )
+      {
+         // Loads and stores packed {x, y, z} points as one register per component
+         const float64x2x3_t p = vld3q_f64( points + i * 3 );
+         float64x2x3_t t;
+         t.val[ 0 ] = vaddq_f64( vaddq_f64( vaddq_f64( vmulq_f64( m[ 0 ], p.val[ 0 ] ), vmulq_f64( m[ 1 ], p.val[ 1 ] ) ), vmulq_f64( m[ 2 ], p.val[ 2 ] ) ), m[ 3 ] );
+         t.val[ 1 ] = vaddq_f64( vaddq_f64( vaddq_f64( vmulq_f64( m[ 4 ], p.val[ 0 ] ), vmulq_f64( m[ 5 ], p.val[ 1 ] ) ), vmulq_f64( m[ 6 ], p.val[ 2 ] ) ), m[ 7 ] );
+         t.val[ 2 ] = vaddq_f64( vaddq_f64( vaddq_f64( vmulq_f64( m[ 8 ], p.val[ 0 ] ), vmulq_f64( m[ 9 ], p.val[ 1 ] ) ), vmulq_f64( m[ 10 ], p.val[ 2 ] ) ), m[ 11 ] );
+         vst3q_f64( out + i * 3, t );
+      }
+      TransformPointsScalar( matrix, points, out, i, end );
+   }
+   void ScalePointsNeon( const double * scale,
+      const double * points,
+      double * out,
+      size_t begin,
+      size_t end )
+   {
+      const float64x2_t sx = vdupq_n_f64( scale[ 0 ] ), sy = vdupq_n_f64( scale[ 1 ] ), sz = vdupq_n_f64( scale[ 2 ] );
+      size_t i = begin;
+      for ( ; i + 2 <= end; i += 2 )
+      {
+         float64x2x3_t p = vld3q_f64( points + i * 3 );
+         p.val[ 0 ] = vmulq_f64( p.val[ 0 ], sx );
+         p.val[ 1 ] = vmulq_f64( p.val[ 1 ], sy );
+         p.val[ 2 ] = vmulq_f64( p.val[ 2 ], sz );
+         vst3q_f64( out + i * 3, p );
+      }
+      ScalePointsScalar( scale, points, out, i, end );
+   }
+
+   const KernelTable NEON_KERNELS = {
+      MultiplyNeon,
+      ConjugateNeon,
+      NormalizeNeon,
+      RotateNeon,
+      SlerpNeon,
+      NlerpNeon,
+      FromTwoVectorsNeon,
+      TransformPointsNeon,
+      ScalePointsNeon
+   };
+#endif
+
+   const KernelTable & Table( KERNEL kernel )
+   {
+      switch ( kernel )
+      {
+#ifdef HAVE_AVX2_KERNEL
+         case KERNEL_AVX2: return AVX2_KERNELS;
+#endif
+#ifdef HAVE_NEON_KERNEL
+         case KERNEL_NEON: return NEON_KERNELS;
+#endif
+         default: return SCALAR_KERNELS;
+      }
+   }
+   KERNEL FastestKernel()
+   {
+      if ( IsSupported( KERNEL_AVX2 ) )
+         return KERNEL_AVX2;
+      if ( IsSupported( KERNEL_NEON ) )
+         return KERNEL_NEON;
+      return KERNEL_SCALAR;
+   }
+   std::atomic< KERNEL > & SelectedKernel()
+   {
+      static std::atomic< KERNEL > kernel{ FastestKernel() };
+      return kernel;
+   }
+   const KernelTable & Kernels()
+   {
+      return Table( SelectedKernel().load( std::memory_order_relaxed ) );
+   }
+}
+
+bool QuaternionBatch::IsSupported( KERNEL kernel )
+{
+   switch ( kernel )
+   {
+      case KERNEL_SCALAR:
+         return true;
+      case KERNEL_AVX2:
+#ifdef HAVE_AVX2_KERNEL
+         return __builtin_cpu_supports( "avx2" );
+#else
+         return false;
+#endif
+      case KERNEL_NEON:
+#ifdef HAVE_NEON_KERNEL
+         return true;
+#else
+         return false;
+#endif
+      default:
+         return false;
+   }
+}
+QuaternionBatch::KERNEL QuaternionBatch::Kernel()
+{
+   return SelectedKernel().load();
+}
+void QuaternionBatch::Kernel( KERNEL kernel )
+{
+   if ( !IsSupported( kernel ) )
+      throw std::runtime_error( "The " + KernelName( kernel ) + " quaternion kernel isn't supported here" );
+   SelectedKernel().store( kernel );
+}
+std::string QuaternionBatch::KernelName( KERNEL kernel )
+{
+   switch ( kernel )
+   {
+      case KERNEL_SCALAR: return "scalar";
+      case KERNEL_AVX2: return "avx2";
+      case KERNEL_NEON: return "neon";
+      default: return "unknown";
+   }
+}
+
+void QuaternionBatch::Multiply( const Quaternions & a,
+   const Quaternions & b,
+   const Quaternions & out,
+   size_t count )
+{
+   Kernels().multiply( a, b, out, 0, count );
+}
+void QuaternionBatch::Conjugate( const Quaternions & q,
+   const Quaternions & out,
+   size_t count )
+{
+   Kernels().conjugate( q, out, 0, count );
+}
+void QuaternionBatch::Normalize( const Quaternions & q,
+   const Quaternions & out,
+   size_t count )
+{
+   Kernels().normalize( q, out, 0, count );
+}
+void QuaternionBatch::Rotate( const Quaternions & q,
+   const Vectors & v,
+   const Vectors & out,
+   size_t count )
+{
+   Kernels().rotate( q, v, out, 0, count );
+}
+void QuaternionBatch::Slerp( const Quaternions & a,
+   const Quaternions & b,
+   const double * t,
+   const Quaternions & out,
+   size_t count )
+{
+   Kernels().slerp( a, b, t, out, 0, count );
+}
+void QuaternionBatch::Nlerp( const Quaternions & a,
+   const Quaternions & b,
+   const double * t,
+   const Quaternions & out,
+   size_t count )
+{
+   Kernels().nlerp( a, b, t, out, 0, count );
+}
+void QuaternionBatch::FromTwoVectors( const Vectors & a,
+   const Vectors & b,
+   const Quaternions & out,
+   size_t count )
+{
+   Kernels().fromTwoVectors( a, b, out, 0, count );
+}
+void QuaternionBatch::TransformPoints( const std::array< double, 12 > & matrix,
+   const double * points,
+   double * out,
+   size_t count )
+{
+   Kernels().transformPoints( matrix.data(), points, out, 0, count );
+}
+void QuaternionBatch::ScalePoints( const std::array< double, 3 > & scale,
+   const double * points,
+   double * out,
+   size_t count )
+{
+   Kernels().scalePoints( scale.data(), points, out, 0, count );
+}
+
+void QuaternionBatch::QuaternionBuffer::Resize( size_t size )
+{
+   _size = size;
+   _values.resize( size * 4 );
+   double * values = _values.data();
+   _view = { values, values + size, values + size * 2, values + size * 3 };
+}
+void QuaternionBatch::VectorBuffer::Resize( size_t size )
+{
+   _size = size;
+   _values.resize( size * 3 );
+   double * values = _values.data();
+   _view = { values, values + size, values + size * 2 };
+}
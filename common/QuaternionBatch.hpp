@@ -0,0 +1,161 @@
+#ifndef QuaternionBatch_hpp
+#define QuaternionBatch_hpp
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Quaternion math over many quaternions at once, for code that handles a whole block of joints or frames.
+// Quaternions and vectors are stored as a "structure of arrays": one contiguous array per component, so each
+// operation runs down the arrays a SIMD register at a time. AVX2 is used when the CPU has it (checked at run time)
+// and NEON on 64-bit ARM; otherwise, and for whatever doesn't fill a register, the scalar kernel is used.
+//
+// Every function matches its Eigen::Quaterniond counterpart to within rounding. Outputs may be the same arrays as
+// inputs. Raw quaternions are {x, y, z, w}, the same as Joint::quaternion.
+namespace QuaternionBatch
+{
+   // Views of @count quaternions or vectors, one array per component
+   struct Quaternions
+   {
+      double * x;
+      double * y;
+      double * z;
+      double * w;
+   };
+   struct Vectors
+   {
+      double * x;
+      double * y;
+      double * z;
+   };
+
+   enum KERNEL
+   {
+      KERNEL_SCALAR,
+      KERNEL_AVX2,
+      KERNEL_NEON
+   };
+   // The kernel in use: the fastest this CPU supports, unless another was selected
+   KERNEL Kernel();
+   // Select a kernel, e.g. the scalar reference to compare against. Throws if this CPU doesn't support it.
+   void Kernel( KERNEL kernel );
+   bool IsSupported( KERNEL kernel );
+   std::string KernelName( KERNEL kernel );
+
+   // @out = @a * @b
+   void Multiply( const Quaternions & a,
+      const Quaternions & b,
+      const Quaternions & out,
+      size_t count );
+   // @out = @q.conjugate()
+   void Conjugate( const Quaternions & q,
+      const Quaternions & out,
+      size_t count );
+   // @out = @q.normalized(); zero quaternions are left as they are
+   void Normalize( const Quaternions & q,
+      const Quaternions & out,
+      size_t count );
+   // @out = @q._transformVector( @v ), which assumes @q is normalized
+   void Rotate( const Quaternions & q,
+      const Vectors & v,
+      const Vectors & out,
+      size_t count );
+   // @out = @a.slerp( @t, @b ), the shortest way round
+   void Slerp( const Quaternions & a,
+      const Quaternions & b,
+      const double * t,
+      const Quaternions & out,
+      size_t count );
+   // Normalized linear interpolation, the shortest way round. Cheaper than SLERP and close to it for nearby
+   // rotations, but its speed isn't constant.
+   void Nlerp( const Quaternions & a,
+      const Quaternions & b,
+      const double * t,
+      const Quaternions & out,
+      size_t count );
+   // @out = Eigen::Quaterniond::FromTwoVectors( @a, @b ), the smallest rotation taking @a to @b.
+   // For opposite vectors, any axis perpendicular to them is used, which may not be the one Eigen picks.
+   void FromTwoVectors( const Vectors & a,
+      const Vectors & b,
+      const Quaternions & out,
+      size_t count );
+
+   // Points packed {x, y, z, x, y, z, ...}, as they're read from input, rather than one array per component.
+   // @out = @matrix * @points, for the top 3 rows of a row-major 4x4 affine @matrix
+   void TransformPoints( const std::array< double, 12 > & matrix,
+      const double * points,
+      double * out,
+      size_t count );
+   // @out = @points scaled by @scale, per component. The same as TransformPoints() with a diagonal matrix, except that
+   // each value only depends on its own component (so one infinite or NaN component doesn't spread to the others).
+   void ScalePoints( const std::array< double, 3 > & scale,
+      const double * points,
+      double * out,
+      size_t count );
+
+   // Storage for a batch of quaternions, with accessors for moving raw quaternions in and out
+   class QuaternionBuffer
+   {
+   public:
+      QuaternionBuffer( size_t size = 0 ) { Resize( size ); }
+
+      // Contents are unspecified after a resize
+      void Resize( size_t size );
+      size_t Size() const { return _size; }
+
+      const Quaternions & View() const { return _view; }
+      void Set( size_t i,
+         const std::array< double, 4 > & raw );
+      std::array< double, 4 > Get( size_t i ) const;
+
+   private:
+      std::vector< double > _values;
+      size_t _size = 0;
+      Quaternions _view = {};
+   };
+   class VectorBuffer
+   {
+   public:
+      VectorBuffer( size_t size = 0 ) { Resize( size ); }
+
+      void Resize( size_t size );
+      size_t Size() const { return _size; }
+
+      const Vectors & View() const { return _view; }
+      void Set( size_t i,
+         const std::array< double, 3 > & raw );
+      std::array< double, 3 > Get( size_t i ) const;
+
+   private:
+      std::vector< double > _values;
+      size_t _size = 0;
+      Vectors _view = {};
+   };
+}
+
+inline void QuaternionBatch::QuaternionBuffer::Set( size_t i,
+   const std::array< double, 4 > & raw )
+{
+   _view.x[ i ] = raw[ 0 ];
+   _view.y[ i ] = raw[ 1 ];
+   _view.z[ i ] = raw[ 2 ];
+   _view.w[ i ] = raw[ 3 ];
+}
+inline std::array< double, 4 > QuaternionBatch::QuaternionBuffer::Get( size_t i ) const
+{
+   return { _view.x[ i ], _view.y[ i ], _view.z[ i ], _view.w[ i ] };
+}
+inline void QuaternionBatch::VectorBuffer::Set( size_t i,
+   const std::array< double, 3 > & raw )
+{
+   _view.x[ i ] = raw[ 0 ];
+   _view.y[ i ] = raw[ 1 ];
+   _view.z[ i ] = raw[ 2 ];
+}
+inline std::array< double, 3 > QuaternionBatch::VectorBuffer::Get( size_t i ) const
+{
+   return { _view.x[ i ], _view.y[ i ], _view.z[ i ] };
+}
+
+#endif
@@ -1,10 +1,12 @@
 #ifndef Rig_hpp
 #define Rig_hpp
 
+#include <cstddef>
 #include <array>
+#include <stdexcept>
+#include <string>
 #include <unordered_map>
 #include <vector>
-#include <mutex>
 
 // Global strings
 #define PELVIS_STRING    "pelvis"
@@ -62,7 +64,7 @@ typedef std::array< double, 3 > JointOffset;
 struct Rig
 {
    Rig(){}
-   ~Rig(){}
+   ~Rig() = default;
    
    static const size_t MAX_NUM_JOINTS = 20;
    enum JOINT_TYPE
@@ -257,7 +259,7 @@ struct Rig
       }
    }
    constexpr const Joint & GetJoint( JOINT_TYPE type ) const { return const_cast< Rig * >(this)->GetJoint( type ); }
-   constexpr JointOffset GetJointOffset( JOINT_OFFSET_TYPE type )
+   constexpr JointOffset & GetJointOffset( JOINT_OFFSET_TYPE type )
    {
       switch ( type )
       {
@@ -265,10 +267,10 @@ struct Rig
          case PELVIS_TO_LHIP:         return lHip.offset;
          case BASE_NECK_TO_RSHOULDER: return rShoulder.offset;
          case BASE_NECK_TO_LSHOULDER: return lShoulder.offset;
-         default:                     return { 0, 0, 0 };
+         default:                     throw std::out_of_range( "Unknown joint offset type" );
       }
    }
-   constexpr const JointOffset GetJointOffset( JOINT_OFFSET_TYPE type ) const { return const_cast< Rig * >(this)->GetJointOffset( type ); }
+   constexpr const JointOffset & GetJointOffset( JOINT_OFFSET_TYPE type ) const { return const_cast< Rig * >(this)->GetJointOffset( type ); }
    
    // Returns:
    // first:  parent's joint type
@@ -300,118 +302,116 @@ struct Rig
          default:        return std::make_pair( JOINT_TYPE_UNKNOWN, true );
       }
    }
-   // This creates a default armature, or rest (bind) pose, that is needed in order to make sense of rig data.
-   // This uses the Singleton pattern.
+   // This returns the default armature, or rest (bind) pose, that is needed in order to make sense of rig data.
+   // This uses the Singleton pattern; initialization of a function-local static is thread-safe,
+   // and the rig is never modified afterwards so callers should hold a const reference instead of copying it.
    // The values in the returned rig will provide:
    //  - Default rotations
    //  - Default joint (really bone) lengths
    //  - Default joint offsets
-   static Rig DefaultPoseHumanoid()
+   static const Rig & DefaultPoseHumanoid()
    {
-      static Rig instance;
-      static bool initialized = false;
-      if ( !initialized )
-      {
-         // Make this singleton thread-safe
-         static std::mutex m;
-         std::lock_guard< std::mutex > autoLock( m );
-         if ( initialized )
-            return instance;
-         initialized = true;
-         
-         // Lengths were determined by averaging American football players over a few hundred frames,
-         // then multiplying everything by 0.9 since an average person is smaller.
+      static const Rig instance = CreateDefaultPoseHumanoid();
+      return instance;
+   }
+   static constexpr auto RestPoseHumanoid = DefaultPoseHumanoid;
+   
+private:
+   static Rig CreateDefaultPoseHumanoid()
+   {
+      Rig instance;
+      
+      // Lengths were determined by averaging American football players over a few hundred frames,
+      // then multiplying everything by 0.9 since an average person is smaller.
 
-         //--------------- JOINTS --------------------
-         // Pelvis joint, the parent of all joints
-         instance.pelvis.quaternion = { 0, 0, 0, 1 };
-         instance.pelvis.length = 0.126220303905998;
+      //--------------- JOINTS --------------------
+      // Pelvis joint, the parent of all joints
+      instance.pelvis.quaternion = { 0, 0, 0, 1 };
+      instance.pelvis.length = 0.126220303905998;
 
-         // rHip rotated about the Z axis PI
-         instance.rHip.quaternion = { 0, 0, 1, 0 };
-         instance.rHip.length = 0.370963097762336;
+      // rHip rotated about the Z axis PI
+      instance.rHip.quaternion = { 0, 0, 1, 0 };
+      instance.rHip.length = 0.370963097762336;
 
-         // rKnee
-         instance.rKnee.quaternion = { 0, 0, 0, 1 };
-         instance.rKnee.length = 0.386561431929226;
+      // rKnee
+      instance.rKnee.quaternion = { 0, 0, 0, 1 };
+      instance.rKnee.length = 0.386561431929226;
 
-         // rAnkle rotated about the X axis PI*7/18
-         instance.rAnkle.quaternion = { 0.5735764, 0, 0, 0.819152 };
-         instance.rAnkle.length = 0.141880341123086;
+      // rAnkle rotated about the X axis PI*7/18
+      instance.rAnkle.quaternion = { 0.5735764, 0, 0, 0.819152 };
+      instance.rAnkle.length = 0.141880341123086;
 
-         // rToeBase rotated about the X axis PI/9
-         instance.rToeBase.quaternion = { 0.1736482, 0, 0, 0.9848078 };
-         instance.rToeBase.length = 0.04729344704103;
+      // rToeBase rotated about the X axis PI/9
+      instance.rToeBase.quaternion = { 0.1736482, 0, 0, 0.9848078 };
+      instance.rToeBase.length = 0.04729344704103;
 
-         // lHip
-         instance.lHip.quaternion = instance.rHip.quaternion;
-         instance.lHip.length = instance.rHip.length;
+      // lHip
+      instance.lHip.quaternion = instance.rHip.quaternion;
+      instance.lHip.length = instance.rHip.length;
 
-         // lKnee
-         instance.lKnee.quaternion = instance.rKnee.quaternion;
-         instance.lKnee.length = instance.rKnee.length;
+      // lKnee
+      instance.lKnee.quaternion = instance.rKnee.quaternion;
+      instance.lKnee.length = instance.rKnee.length;
 
-         // lAnkle
-         instance.lAnkle.quaternion = instance.rAnkle.quaternion;
-         instance.lAnkle.length = instance.rAnkle.length;
+      // lAnkle
+      instance.lAnkle.quaternion = instance.rAnkle.quaternion;
+      instance.lAnkle.length = instance.rAnkle.length;
 
-         // lToeBase
-         instance.lToeBase.quaternion = instance.rToeBase.quaternion;
-         instance.lToeBase.length = instance.rToeBase.length;
+      // lToeBase
+      instance.lToeBase.quaternion = instance.rToeBase.quaternion;
+      instance.lToeBase.length = instance.rToeBase.length;
 
-         // spine2
-         instance.spine2.quaternion = { 0, 0, 0, 1 };
-         instance.spine2.length = 0.122532125318093;
+      // spine2
+      instance.spine2.quaternion = { 0, 0, 0, 1 };
+      instance.spine2.length = 0.122532125318093;
 
-         // spine3
-         instance.spine3.quaternion = { 0, 0, 0, 1 };
-         instance.spine3.length = 0.126637363035725;
+      // spine3
+      instance.spine3.quaternion = { 0, 0, 0, 1 };
+      instance.spine3.length = 0.126637363035725;
 
-         // spine4
-         instance.spine4.quaternion = { 0, 0, 0, 1 };
-         instance.spine4.length = 0.122532125318093;
+      // spine4
+      instance.spine4.quaternion = { 0, 0, 0, 1 };
+      instance.spine4.length = 0.122532125318093;
 
-         // rShoulder rotated about the Z axis PI/2
-         instance.rShoulder.quaternion = { 0, 0, 0.7071068, 0.7071068 };
-         instance.rShoulder.length = 0.266648027895734;
+      // rShoulder rotated about the Z axis PI/2
+      instance.rShoulder.quaternion = { 0, 0, 0.7071068, 0.7071068 };
+      instance.rShoulder.length = 0.266648027895734;
 
-         // rElbow
-         instance.rElbow.quaternion = { 0, 0, 0, 1 };
-         instance.rElbow.length = 0.207658895203634;
+      // rElbow
+      instance.rElbow.quaternion = { 0, 0, 0, 1 };
+      instance.rElbow.length = 0.207658895203634;
 
-         // rWrist
-         instance.rWrist.quaternion = { 0, 0, 0, 1 };
-         instance.rWrist.length = 0.132146569675043;
+      // rWrist
+      instance.rWrist.quaternion = { 0, 0, 0, 1 };
+      instance.rWrist.length = 0.132146569675043;
 
-         // lShoulder rotated about the Z axis -PI/2
-         instance.lShoulder.quaternion = { 0, 0, -0.7071068, 0.7071068 };
-         instance.lShoulder.length = instance.rShoulder.length;
+      // lShoulder rotated about the Z axis -PI/2
+      instance.lShoulder.quaternion = { 0, 0, -0.7071068, 0.7071068 };
+      instance.lShoulder.length = instance.rShoulder.length;
 
-         // lElbow
-         instance.lElbow.quaternion = instance.rElbow.quaternion;
-         instance.lElbow.length = instance.rElbow.length;
+      // lElbow
+      instance.lElbow.quaternion = instance.rElbow.quaternion;
+      instance.lElbow.length = instance.rElbow.length;
 
-         // lWrist
-         instance.lWrist.quaternion = instance.rWrist.quaternion;
-         instance.lWrist.length = instance.rWrist.length;
+      // lWrist
+      instance.lWrist.quaternion = instance.rWrist.quaternion;
+      instance.lWrist.length = instance.rWrist.length;
 
-         // Base of neck (torso-ish)
-         instance.baseNeck.quaternion = { 0, 0, 0, 1 };
-         instance.baseNeck.length = 0.084940724767463;
+      // Base of neck (torso-ish)
+      instance.baseNeck.quaternion = { 0, 0, 0, 1 };
+      instance.baseNeck.length = 0.084940724767463;
 
-         // Base of head (not quite chin but close)
-         instance.baseHead.quaternion = { 0, 0, 0, 1 };
-         instance.baseHead.length = 0.204343368655985;
+      // Base of head (not quite chin but close)
+      instance.baseHead.quaternion = { 0, 0, 0, 1 };
+      instance.baseHead.length = 0.204343368655985;
 
-         //--------------- OFFSETS --------------------
-         instance.rHip.offset = { -0.096862528167303, 0, 0 };
-         instance.lHip.offset = {  0.096862528167303, 0, 0 };
-         instance.rShoulder.offset = { -0.169329877973758, 0, 0 };
-         instance.lShoulder.offset = {  0.169329877973758, 0, 0 };
-      }
+      //--------------- OFFSETS --------------------
+      instance.rHip.offset = { -0.096862528167303, 0, 0 };
+      instance.lHip.offset = {  0.096862528167303, 0, 0 };
+      instance.rShoulder.offset = { -0.169329877973758, 0, 0 };
+      instance.lShoulder.offset = {  0.169329877973758, 0, 0 };
       
       return instance;
    }
-   static constexpr auto RestPoseHumanoid = DefaultPoseHumanoid;
 };
 #endif 
@@ -0,0 +1,229 @@
+#include "RigFeed.hpp"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#if defined(_WIN32) || defined(__ANDROID__)
+   #define RIG_FEED_UNSUPPORTED
+#else
+   #include <fcntl.h>
+   #include <sys/mman.h>
+   #include <sys/stat.h>
+   #include <unistd.h>
+#endif
+
+// Slots are shared between processes, so the sequence must not need a lock
+#if ATOMIC_LLONG_LOCK_FREE != 2
+   #error "RigFeed requires lock-free 64-bit atomics"
+#endif
+
+namespace RigFeed
+{
+   static size_t FeedSize( uint32_t numSlots )
+   {
+      return sizeof( Header ) + numSlots * sizeof( Slot );
+   }
+   static std::runtime_error FeedError( const std::string & name, const std::string & what )
+   {
+      return std::runtime_error( "Live feed '" + name + "': " + what + (errno ? std::string( " (" ) + strerror( errno ) + ")" : std::string()) );
+   }
+
+#ifdef RIG_FEED_UNSUPPORTED
+   Publisher::Publisher( const std::string & name,
+      uint32_t )
+   {
+      throw std::runtime_error( "Live feed '" + name + "': not supported on this platform" );
+   }
+   Publisher::~Publisher() {}
+   void Publisher::Publish( const std::string &, int, const Rig & ) {}
+
+   Subscriber::Subscriber( const std::string & name )
+   {
+      throw std::runtime_error( "Live feed '" + name + "': not supported on this platform" );
+   }
+   Subscriber::~Subscriber() {}
+   bool Subscriber::Next( Frame &, uint64_t & ) { return false; }
+#else
+   Publisher::Publisher( const std::string & name,
+      uint32_t numSlots )
+      : _name( name )
+   {
+      if ( numSlots == 0 )
+         throw std::runtime_error( "Live feed '" + name + "': needs at least one slot" );
+
+      // Replace any feed left behind by a previous run
+      shm_unlink( name.c_str() );
+      errno = 0;
+      int fd = shm_open( name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644 );
+      if ( fd < 0 )
+         throw FeedError( name, "could not create" );
+
+      // New shared memory is zero-filled, so every slot starts with an even (unlocked) sequence
+      _size = FeedSize( numSlots );
+      if ( ftruncate( fd, (off_t)_size ) != 0 )
+      {
+         close( fd );
+         shm_unlink( name.c_str() );
+         throw FeedError( name, "could not resize" );
+      }
+      _memory = mmap( nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+      close( fd );
+      if ( _memory == MAP_FAILED )
+      {
+         _memory = nullptr;
+         shm_unlink( name.c_str() );
+         throw FeedError( name, "could not map" );
+      }
+
+      _header = static_cast< Header * >( _memory );
+      _slots = reinterpret_cast< Slot * >( static_cast< uint8_t * >( _memory ) + sizeof( Header ) );
+      _header->version = VERSION;
+      _header->numSlots = numSlots;
+      _header->slotSize = (uint32_t)sizeof( Slot );
+      _header->numPublished.store( 0, std::memory_order_relaxed );
+
+      // Subscribers check the magic number last
+      std::atomic_thread_fence( std::memory_order_release );
+      _header->magic = MAGIC;
+   }
+   Publisher::~Publisher()
+   {
+      if ( _memory )
+      {
+         munmap( _memory, _size );
+         shm_unlink( _name.c_str() );
+      }
+   }
+   void Publisher::Publish( const std::string & rigId,
+      int timestamp,
+      const Rig & rig )
+   {
+      const uint64_t index = _header->numPublished.load( std::memory_order_relaxed );
+      Slot & slot = _slots[ index % _header->numSlots ];
+
+      // Mark the slot as being written
+      const uint64_t sequence = slot.sequence.load( std::memory_order_relaxed );
+      slot.sequence.store( sequence + 1, std::memory_order_relaxed );
+      std::atomic_thread_fence( std::memory_order_release );
+
+      Frame & frame = slot.frame;
+      frame.index = index;
+      strncpy( frame.rigId, rigId.c_str(), MAX_RIG_ID_LENGTH - 1 );
+      frame.rigId[ MAX_RIG_ID_LENGTH - 1 ] = 0;
+      frame.timestamp = timestamp;
+      frame.numRotations = rig.numJointsUsed;
+      frame.numLengths = rig.numLengthsUsed;
+      frame.numOffsets = rig.numJointOffsetsUsed;
+      for ( size_t i = 0; i < Rig::LOCATION_DIMENSION; ++i )
+         frame.location[ i ] = rig.location[ i ];
+      for ( int i = 0; i < rig.numJointsUsed; ++i )
+      {
+         const Joint & joint = rig.GetJoint( Rig::JOINT_TYPE( i ) );
+         for ( int j = 0; j < 4; ++j )
+            frame.rotations[ i * 4 + j ] = joint.quaternion[ j ];
+      }
+      for ( int i = 0; i < rig.numLengthsUsed; ++i )
+         frame.lengths[ i ] = rig.GetJoint( Rig::JOINT_TYPE( i ) ).length;
+      for ( int i = 0; i < rig.numJointOffsetsUsed; ++i )
+      {
+         const JointOffset & offset = rig.GetJointOffset( Rig::JOINT_OFFSET_TYPE( i ) );
+         for ( int j = 0; j < 3; ++j )
+            frame.offsets[ i * 3 + j ] = offset[ j ];
+      }
+
+      // Unlock the slot, then make it visible
+      slot.sequence.store( sequence + 2, std::memory_order_release );
+      _header->numPublished.store( index + 1, std::memory_order_release );
+   }
+
+   Subscriber::Subscriber( const std::string & name )
+   {
+      errno = 0;
+      int fd = shm_open( name.c_str(), O_RDONLY, 0 );
+      if ( fd < 0 )
+         throw FeedError( name, "could not open, is the publisher running?" );
+
+      struct stat info;
+      if ( fstat( fd, &info ) != 0 || (size_t)info.st_size < sizeof( Header ) )
+      {
+         close( fd );
+         throw FeedError( name, "not a live feed" );
+      }
+      _size = (size_t)info.st_size;
+      _memory = mmap( nullptr, _size, PROT_READ, MAP_SHARED, fd, 0 );
+      close( fd );
+      if ( _memory == MAP_FAILED )
+      {
+         _memory = nullptr;
+         throw FeedError( name, "could not map" );
+      }
+
+      _header = static_cast< const Header * >( _memory );
+      _slots = reinterpret_cast< const Slot * >( static_cast< const uint8_t * >( _memory ) + sizeof( Header ) );
+      errno = 0;
+      if ( _header->magic != MAGIC ||
+         _header->version != VERSION ||
+         _header->slotSize != sizeof( Slot ) ||
+         _size < FeedSize( _header->numSlots ) )
+      {
+         munmap( _memory, _size );
+         _memory = nullptr;
+         throw FeedError( name, "not a live feed, or a different version" );
+      }
+      std::atomic_thread_fence( std::memory_order_acquire );
+
+      // Start live, with the next frame published
+      _nextIndex = _header->numPublished.load( std::memory_order_acquire );
+   }
+   Subscriber::~Subscriber()
+   {
+      if ( _memory )
+         munmap( _memory, _size );
+   }
+   bool Subscriber::Next( Frame & out_frame,
+      uint64_t & out_numDropped )
+   {
+      const uint64_t numSlots = _header->numSlots;
+      out_numDropped = 0;
+
+      for ( int attempt = 0; attempt < MAX_READ_ATTEMPTS; ++attempt )
+      {
+         const uint64_t numPublished = _header->numPublished.load( std::memory_order_acquire );
+         if ( _nextIndex >= numPublished )
+            return false;
+
+         // If we've fallen a whole ring behind, skip to the oldest frame still there.
+         // They're reported with the frame we return, which may not be this call's.
+         if ( numPublished - _nextIndex > numSlots )
+         {
+            _numDropped += numPublished - numSlots - _nextIndex;
+            _nextIndex = numPublished - numSlots;
+         }
+
+         // Copy the slot, and keep it only if the publisher didn't touch it meanwhile
+         const Slot & slot = _slots[ _nextIndex % numSlots ];
+         const uint64_t before = slot.sequence.load( std::memory_order_acquire );
+         if ( !(before & 1) )
+         {
+            memcpy( &out_frame, &slot.frame, sizeof( Frame ) );
+            std::atomic_thread_fence( std::memory_order_acquire );
+            if ( slot.sequence.load( std::memory_order_relaxed ) == before &&
+               out_frame.index == _nextIndex )
+            {
+               ++_nextIndex;
+               out_numDropped = _numDropped;
+               _numDropped = 0;
+               return true;
+            }
+         }
+
+         // The publisher is overwriting this slot, so it's about to be a ring ahead of us
+         std::this_thread::yield();
+      }
+
+      // Still being written, so treat it as not there yet
+      return false;
+   }
+#endif
+}
@@ -0,0 +1,100 @@
+#ifndef RigFeed_hpp
+#define RigFeed_hpp
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include "Rig.hpp"
+
+// A live feed of rig frames through shared memory, from one publisher (kp2rig) to any number of local subscribers (rig2c).
+// The feed is a ring of fixed-size slots. The publisher never waits for subscribers; a subscriber that falls more than a
+// ring behind skips ahead and loses frames. Each slot is guarded by a seqlock, so readers never block the publisher.
+// POSIX only; on other platforms opening a feed throws.
+namespace RigFeed
+{
+   const uint32_t MAGIC = 0x46474952; // "RIGF"
+   const uint32_t VERSION = 1;
+   const uint32_t DEFAULT_NUM_SLOTS = 1024;
+   const size_t MAX_RIG_ID_LENGTH = 64;
+   const int MAX_READ_ATTEMPTS = 1000;                   // Times Subscriber::Next() tries a slot being written
+
+   // One rig frame, laid out exactly as in shared memory
+   struct Frame
+   {
+      uint64_t index;                                    // Position in the feed, 0 for the first frame published
+      char rigId[ MAX_RIG_ID_LENGTH ];                   // Null-terminated, truncated if needed
+      int32_t timestamp;
+      int32_t numRotations;                              // Quaternions {x,y,z,w}
+      int32_t numLengths;
+      int32_t numOffsets;                                // Vectors {x,y,z}
+      double location[ Rig::LOCATION_DIMENSION ];
+      double rotations[ Rig::MAX_ROTATIONS_DIMENSION ];
+      double lengths[ Rig::MAX_LENGTHS_DIMENSION ];
+      double offsets[ Rig::MAX_OFFSETS_DIMENSION ];
+   };
+
+   struct Slot
+   {
+      std::atomic< uint64_t > sequence;                  // Odd while the publisher is writing
+      Frame frame;
+   };
+
+   struct Header
+   {
+      uint32_t magic;
+      uint32_t version;
+      uint32_t numSlots;
+      uint32_t slotSize;
+      std::atomic< uint64_t > numPublished;              // Index of the next frame to be published
+   };
+
+   // Creates the feed @name (e.g. "/kp2rig"), replacing any existing feed with that name.
+   // The feed is removed when the publisher is destroyed.
+   class Publisher
+   {
+   public:
+      Publisher( const std::string & name,
+         uint32_t numSlots = DEFAULT_NUM_SLOTS );
+      ~Publisher();
+      Publisher( const Publisher & ) = delete;
+      Publisher & operator=( const Publisher & ) = delete;
+
+      void Publish( const std::string & rigId,
+         int timestamp,
+         const Rig & rig );
+
+   private:
+      std::string _name;
+      void * _memory = nullptr;
+      size_t _size = 0;
+      Header * _header = nullptr;
+      Slot * _slots = nullptr;
+   };
+
+   // Opens an existing feed for reading. Subscribers start with the next frame published.
+   class Subscriber
+   {
+   public:
+      Subscriber( const std::string & name );
+      ~Subscriber();
+      Subscriber( const Subscriber & ) = delete;
+      Subscriber & operator=( const Subscriber & ) = delete;
+
+      // Copies the next frame to @out_frame, returning false if there isn't one yet.
+      // @out_numDropped is set to the number of frames skipped because this subscriber fell behind.
+      // A slot the publisher is writing is tried up to MAX_READ_ATTEMPTS times, after which this returns false as
+      // if there were no frame yet, and the next call tries again. So a publisher that died mid-write leaves its
+      // subscribers waiting for a frame rather than spinning forever.
+      bool Next( Frame & out_frame,
+         uint64_t & out_numDropped );
+
+   private:
+      void * _memory = nullptr;
+      size_t _size = 0;
+      const Header * _header = nullptr;
+      const Slot * _slots = nullptr;
+      uint64_t _nextIndex = 0;
+      uint64_t _numDropped = 0;                         // Skipped but not yet reported with a frame
+   };
+}
+#endif
@@ -0,0 +1,143 @@
+#include "SegmentFilename.hpp"
+#include <cctype>
+#include <cstdlib>
+
+namespace
+{
+   // An integer at @ref_position, moving past it. No signs or spaces other than a leading '-' if @allowNegative.
+   bool ParseInteger( const std::string & text,
+      size_t & ref_position,
+      bool allowNegative,
+      int & out_value )
+   {
+      size_t position = ref_position;
+      if ( allowNegative && position < text.size() && text[ position ] == '-' )
+         ++position;
+      if ( position >= text.size() || !isdigit( (unsigned char)text[ position ] ) )
+         return false;
+
+      char * end = nullptr;
+      out_value = (int)strtol( text.c_str() + ref_position, &end, 10 );
+      ref_position = end - text.c_str();
+      return true;
+   }
+
+   // Characters of a rig id that are written as they are; any other byte is '%' and two hex digits
+   bool IsPlain( char c )
+   {
+      return isalnum( (unsigned char)c ) || c == '-' || c == '_';
+   }
+   int HexDigit( char c )
+   {
+      if ( c >= '0' && c <= '9' )
+         return c - '0';
+      if ( c >= 'A' && c <= 'F' )
+         return c - 'A' + 10;
+      return -1;
+   }
+   std::string EncodeRigId( const std::string & id )
+   {
+      static const char HEX_DIGITS[] = "0123456789ABCDEF";
+      std::string encoded;
+      for ( char c : id )
+      {
+         if ( IsPlain( c ) )
+         {
+            encoded += c;
+         }
+         else
+         {
+            encoded += '%';
+            encoded += HEX_DIGITS[ (unsigned char)c >> 4 ];
+            encoded += HEX_DIGITS[ (unsigned char)c & 0xF ];
+         }
+      }
+      return encoded;
+   }
+   // Only accepts what EncodeRigId() writes, so each id has exactly one filename
+   bool DecodeRigId( const std::string & encoded,
+      std::string & out_id )
+   {
+      std::string id;
+      for ( size_t i = 0; i < encoded.size(); ++i )
+      {
+         if ( IsPlain( encoded[ i ] ) )
+         {
+            id += encoded[ i ];
+            continue;
+         }
+         if ( encoded[ i ] != '%' || i + 2 >= encoded.size() )
+            return false;
+         const int high = HexDigit( encoded[ i + 1 ] );
+         const int low = HexDigit( encoded[ i + 2 ] );
+         if ( high < 0 || low < 0 || IsPlain( (char)(high * 16 + low) ) )
+            return false;
+         id += (char)(high * 16 + low);
+         i += 2;
+      }
+      if ( id.empty() )
+         return false;
+      out_id = id;
+      return true;
+   }
+}
+
+bool SegmentFilename::Parse( const std::string & filename,
+   SegmentFilename & out_segment )
+{
+   const std::string prefix = "seg_";
+   const std::string suffix = ".json";
+   if ( filename.size() <= prefix.size() + suffix.size() ||
+      filename.compare( 0, prefix.size(), prefix ) != 0 ||
+      filename.compare( filename.size() - suffix.size(), suffix.size(), suffix ) != 0 )
+      return false;
+   const std::string name = filename.substr( 0, filename.size() - suffix.size() );
+
+   SegmentFilename segment;
+   size_t position = prefix.size();
+   if ( !ParseInteger( name, position, true, segment.startFrame ) )
+      return false;
+
+   const std::string patchPrefix = "_patch";
+   if ( name.compare( position, patchPrefix.size(), patchPrefix ) == 0 )
+   {
+      position += patchPrefix.size();
+      if ( !ParseInteger( name, position, false, segment.patch ) ||
+         segment.patch <= 0 )
+         return false;
+   }
+
+   // Then nothing, the manifest, or one rig
+   if ( position < name.size() )
+   {
+      const std::string part = name.substr( position );
+      const std::string rigPrefix = ".rig.";
+      if ( part == ".manifest" )
+      {
+         segment.contents = CONTENTS_MANIFEST;
+      }
+      else if ( part.compare( 0, rigPrefix.size(), rigPrefix ) == 0 &&
+         DecodeRigId( part.substr( rigPrefix.size() ), segment.rigId ) )
+      {
+         segment.contents = CONTENTS_RIG;
+      }
+      else
+      {
+         return false;
+      }
+   }
+
+   out_segment = segment;
+   return true;
+}
+std::string SegmentFilename::Filename() const
+{
+   std::string filename = "seg_" + std::to_string( startFrame );
+   if ( patch > 0 )
+      filename += "_patch" + std::to_string( patch );
+   if ( contents == CONTENTS_MANIFEST )
+      filename += ".manifest";
+   else if ( contents == CONTENTS_RIG )
+      filename += ".rig." + EncodeRigId( rigId );
+   return filename + ".json";
+}
@@ -0,0 +1,35 @@
+#ifndef SegmentFilename_hpp
+#define SegmentFilename_hpp
+
+#include <string>
+
+// The names kp2rig gives the files it writes when segmenting (see kp2rig --segsize), for everything that reads them back:
+//    seg_<startFrame>.json                  every character
+//    seg_<startFrame>.manifest.json         with --partition-by-rig, the rigs and the files holding them
+//    seg_<startFrame>.rig.<rigId>.json      with --partition-by-rig, one character. Bytes of the id other than letters,
+//                                           digits, '-' and '_' are written as '%' and two hex digits, so every id has
+//                                           a file of its own.
+// Patches (--late patch) are named the same with _patch<n> after the start frame, e.g. seg_<startFrame>_patch<n>.json.
+// Anything else in the directory, such as the temporary files segments are written to first, is not a segment file.
+struct SegmentFilename
+{
+   enum CONTENTS
+   {
+      CONTENTS_ALL,        // Every character
+      CONTENTS_MANIFEST,   // Rigs naming the file holding their data, read instead of the files it names
+      CONTENTS_RIG         // One character, only read through its manifest
+   };
+
+   int startFrame = 0;
+   int patch = 0;          // n of a patch, 0 for the segment itself
+   CONTENTS contents = CONTENTS_ALL;
+   std::string rigId;      // For CONTENTS_RIG, the character's id
+
+   // Splits up @filename, without its directory. Returns false if it isn't one of the above.
+   static bool Parse( const std::string & filename,
+      SegmentFilename & out_segment );
+   // The filename, without a directory; Parse() gives back the same fields
+   std::string Filename() const;
+};
+
+#endif
@@ -0,0 +1,175 @@
+#include "Trace.hpp"
+
+#ifdef WITH_TRACING
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+   #include <process.h>
+   #define getpid _getpid
+#else
+   #include <unistd.h>
+#endif
+
+namespace
+{
+   struct Event
+   {
+      const char * name;
+      std::string args;
+      int64_t start;
+      int64_t duration;
+   };
+
+   // Each thread records to its own buffer, so threads only contend with Stop()
+   struct ThreadBuffer
+   {
+      int id;
+      std::string name;
+      std::mutex mutex;
+      std::vector< Event > events;
+   };
+
+   struct Tracer
+   {
+      std::atomic< bool > enabled{ false };
+      std::mutex mutex;
+      std::string filename;
+      std::chrono::steady_clock::time_point epoch;
+      std::vector< std::unique_ptr< ThreadBuffer > > threads;
+   };
+
+   Tracer & GetTracer()
+   {
+      static Tracer tracer;
+      return tracer;
+   }
+
+   thread_local ThreadBuffer * t_buffer = nullptr;
+
+   ThreadBuffer & GetThreadBuffer()
+   {
+      if ( !t_buffer )
+      {
+         Tracer & tracer = GetTracer();
+         std::lock_guard< std::mutex > lock( tracer.mutex );
+         tracer.threads.emplace_back( new ThreadBuffer() );
+         t_buffer = tracer.threads.back().get();
+         t_buffer->id = (int)tracer.threads.size();
+      }
+      return *t_buffer;
+   }
+
+   // Microseconds since Start()
+   int64_t Now()
+   {
+      return std::chrono::duration_cast< std::chrono::microseconds >( std::chrono::steady_clock::now() - GetTracer().epoch ).count();
+   }
+}
+
+namespace Trace
+{
+   bool Start( const std::string & filename )
+   {
+      Tracer & tracer = GetTracer();
+      {
+         std::lock_guard< std::mutex > lock( tracer.mutex );
+         tracer.filename = filename;
+         tracer.epoch = std::chrono::steady_clock::now();
+      }
+      tracer.enabled = true;
+      return true;
+   }
+   void Stop()
+   {
+      Tracer & tracer = GetTracer();
+      if ( !tracer.enabled.exchange( false ) )
+         return;
+
+      std::lock_guard< std::mutex > lock( tracer.mutex );
+      std::ofstream file( tracer.filename, std::ios::binary | std::ios::trunc );
+      const int pid = (int)getpid();
+      bool first = true;
+      auto separator = [ &first, &file ]
+      {
+         file << (first ? "\n" : ",\n");
+         first = false;
+      };
+
+      file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+      for ( auto & thread : tracer.threads )
+      {
+         std::lock_guard< std::mutex > threadLock( thread->mutex );
+         if ( thread->name.size() )
+         {
+            separator();
+            file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << thread->id << ",\"args\":{\"name\":";
+            AppendValue( file, thread->name );
+            file << "}}";
+         }
+         for ( auto & event : thread->events )
+         {
+            separator();
+            file << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << thread->id
+               << ",\"ts\":" << event.start << ",\"dur\":" << event.duration
+               << ",\"args\":{" << event.args << "}}";
+         }
+         thread->events.clear();
+      }
+      file << "\n]}\n";
+   }
+   bool IsEnabled()
+   {
+      return GetTracer().enabled.load( std::memory_order_relaxed );
+   }
+   void ThreadName( const std::string & name )
+   {
+      ThreadBuffer & buffer = GetThreadBuffer();
+      std::lock_guard< std::mutex > lock( buffer.mutex );
+      buffer.name = name;
+   }
+
+   Span::Span( const char * name,
+      std::string args )
+      : _name( name ),
+      _args( std::move( args ) ),
+      _start( IsEnabled() ? Now() : -1 )
+   {
+   }
+   Span::~Span()
+   {
+      if ( _start < 0 || !IsEnabled() )
+         return;
+
+      int64_t end = Now();
+      ThreadBuffer & buffer = GetThreadBuffer();
+      std::lock_guard< std::mutex > lock( buffer.mutex );
+      buffer.events.push_back( { _name, std::move( _args ), _start, end - _start } );
+   }
+}
+
+#else
+
+namespace Trace
+{
+   bool Start( const std::string & ) { return false; }
+   void Stop() {}
+   bool IsEnabled() { return false; }
+   void ThreadName( const std::string & ) {}
+
+   Span::Span( const char * name,
+      std::string args )
+      : _name( name ),
+      _args( std::move( args ) ),
+      _start( -1 )
+   {
+   }
+   Span::~Span() {}
+}
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef Trace_hpp
+#define Trace_hpp
+
+#include <cstdint>
+#include <string>
+#include <sstream>
+#include <type_traits>
+
+// Timeline tracing in the Chrome trace_event format; open the output in chrome://tracing or https://ui.perfetto.dev.
+// Spans are compiled out unless built with -DWITH_TRACING=YES, and cost one branch when built in but not started.
+namespace Trace
+{
+   // Starts recording spans from every thread. Returns false if tracing was not built in.
+   bool Start( const std::string & filename );
+
+   // Writes everything recorded to the file passed to Start() and stops recording
+   void Stop();
+
+   bool IsEnabled();
+
+   // Names the calling thread in the trace
+   void ThreadName( const std::string & name );
+
+   // Records the time between construction and destruction as one span on the calling thread.
+   // @name must outlive the trace, e.g. a string literal.
+   class Span
+   {
+   public:
+      Span( const char * name,
+         std::string args = std::string() );
+      ~Span();
+
+   private:
+      const char * _name;
+      std::string _args;
+      int64_t _start;
+   };
+
+   // Builds span annotations from key/value pairs, e.g. Args( "character", name, "frames", 30 )
+   inline void AppendValue( std::ostream & stream, const std::string & value )
+   {
+      stream << '"';
+      for ( char c : value )
+      {
+         if ( c == '"' || c == '\\' )
+            stream << '\\';
+         if ( (unsigned char)c >= 0x20 )
+            stream << c;
+      }
+      stream << '"';
+   }
+   inline void AppendValue( std::ostream & stream, const char * value ) { AppendValue( stream, std::string( value ) ); }
+   template< typename T, typename = typename std::enable_if< std::is_arithmetic< T >::value >::type >
+   inline void AppendValue( std::ostream & stream, T value ) { stream << value; }
+
+   inline void AppendArgs( std::ostream & ) {}
+   template< typename T, typename... Rest >
+   inline void AppendArgs( std::ostream & stream, const char * key, const T & value, const Rest &... rest )
+   {
+      stream << ",\"" << key << "\":";
+      AppendValue( stream, value );
+      AppendArgs( stream, rest... );
+   }
+   template< typename... KeyValues >
+   inline std::string Args( const KeyValues &... keyValues )
+   {
+      std::stringstream ss;
+      AppendArgs( ss, keyValues... );
+      std::string args = ss.str();
+      return args.empty() ? args : args.substr( 1 );
+   }
+}
+
+#define TRACE_CONCAT_INNER( a, b ) a##b
+#define TRACE_CONCAT( a, b ) TRACE_CONCAT_INNER( a, b )
+
+#ifdef WITH_TRACING
+   // Traces the rest of the enclosing scope
+   #define TRACE_SCOPE( name ) Trace::Span TRACE_CONCAT( traceSpan, __LINE__ )( name )
+
+   // Same, with annotations built by Trace::Args() only when tracing is running
+   #define TRACE_SCOPE_ARGS( name, ... ) Trace::Span TRACE_CONCAT( traceSpan, __LINE__ )( name, Trace::IsEnabled() ? Trace::Args( __VA_ARGS__ ) : std::string() )
+#else
+   #define TRACE_SCOPE( name )
+   #define TRACE_SCOPE_ARGS( name, ... )
+#endif
+
+#endif
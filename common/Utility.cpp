@@ -112,8 +112,12 @@ void Utility::LoadLib()
       "rig_getInfo",
       "rig_getRigInfo",
       "rig_read",
+      "rig_readRigs",
       "rig_startRead",
-      "rig_stopRead"
+      "rig_subscribe",
+      "rig_follow",
+      "rig_stopRead",
+      "rig_getReadStats"
    };
    for ( auto & functionName : functionNames )
    {
@@ -503,6 +507,83 @@ std::vector< Eigen::Vector3d > Utility::QuadraticBezierCurve( Eigen::Vector3d p0
 
    return returnValue;
 }
+void Utility::QuadraticBezierCurvePoints( const Eigen::Vector3d & p0,
+   const Eigen::Vector3d & p1,
+   const Eigen::Vector3d & p2,
+   Eigen::Vector3d * out_points,
+   size_t numPoints,
+   double ratio )
+{
+   // The curve is sampled at t = 0.01 * (i+1), same as the vector version
+   constexpr int NUM_SAMPLES = 100;
+   typedef std::array< std::array< double, 3 >, NUM_SAMPLES > Weights;
+   auto computeWeights = []( double r, Weights & weights )
+   {
+      for ( int i = 0; i < NUM_SAMPLES; ++i )
+      {
+         double t = 0.01 * (i+1);
+         double f[] = { (1.0-t) * (1.0-t),
+            r * 2.0*t*(1.0-t),
+            t * t };
+         double basis = f[0] + f[1] + f[2];
+         weights[i] = { f[0] / basis, f[1] / basis, f[2] / basis };
+      }
+   };
+   
+   // The weights only depend on the ratio, so compute the spine's once
+   static const Weights spineWeights = [&computeWeights]()
+   {
+      Weights weights;
+      computeWeights( SPINE_BEZIER_RATIO, weights );
+      return weights;
+   }();
+   Weights customWeights;
+   const Weights * weights = &spineWeights;
+   if ( ratio != SPINE_BEZIER_RATIO )
+   {
+      computeWeights( ratio, customWeights );
+      weights = &customWeights;
+   }
+   
+   // Build the arc length lookup table
+   double totalArcLength = 0.0;
+   double lengths[ NUM_SAMPLES ];
+   Eigen::Vector3d points[ NUM_SAMPLES ];
+   for ( int i = 0; i < NUM_SAMPLES; ++i )
+   {
+      const auto & w = (*weights)[i];
+      points[i] = w[0]*p0 + w[1]*p1 + w[2]*p2;
+      lengths[i] = (points[i] - (i == 0 ? p0 : points[i-1])).norm();
+      totalArcLength += lengths[i];
+   }
+   
+   // Walk the table, picking points evenly spaced along the curve
+   size_t numFound = 0;
+   double targetLength = totalArcLength / double(numPoints + 1);
+   double runningLength = 0.0;
+   for ( int i = 0; i < NUM_SAMPLES && numFound < numPoints; ++i )
+   {
+      runningLength += lengths[i];
+      if ( runningLength > targetLength )
+      {
+         // Pick the closest one
+         if ( i > 0 && (targetLength - (runningLength - lengths[i-1])) < (lengths[i] - targetLength) )
+         {
+            out_points[ numFound++ ] = points[i-1];
+            runningLength = targetLength - runningLength + lengths[i];
+         }
+         else
+         {
+            out_points[ numFound++ ] = points[i];
+            runningLength = runningLength - targetLength;
+         }
+      }
+   }
+   
+   // If rounding left us short, the remaining points are at the end of the curve
+   while ( numFound < numPoints )
+      out_points[ numFound++ ] = p2;
+}
 Eigen::Quaterniond Utility::Distance( Eigen::Quaterniond & a,
    Eigen::Quaterniond & b )
 {
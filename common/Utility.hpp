@@ -4,6 +4,7 @@
 #include <unordered_map>
 #include <string>
 #include <vector>
+#include <array>
 #include <chrono>
 #include <eigen3/Eigen/Geometry>
 #include "rig2c.h"
@@ -52,7 +53,24 @@ public:
    static Eigen::Quaterniond Distance( Eigen::Quaterniond & a,
       Eigen::Quaterniond & b );
    
+   // Same as above, but allocation-free: exactly N points are written to @ref_points.
+   // Weights for SPINE_BEZIER_RATIO are precomputed, other ratios are computed per call.
+   static constexpr double SPINE_BEZIER_RATIO = 0.3;
+   template< size_t N >
+   static void QuadraticBezierCurve( const Eigen::Vector3d & p0,
+      const Eigen::Vector3d & p1,
+      const Eigen::Vector3d & p2,
+      std::array< Eigen::Vector3d, N > & ref_points,
+      double ratio = SPINE_BEZIER_RATIO );
+   
 private:
+   static void QuadraticBezierCurvePoints( const Eigen::Vector3d & p0,
+      const Eigen::Vector3d & p1,
+      const Eigen::Vector3d & p2,
+      Eigen::Vector3d * out_points,
+      size_t numPoints,
+      double ratio );
+   
    // Internal helpers
 #ifndef _WIN32
    static int FileFilter ( const struct dirent * in_directoryEntry );
@@ -63,6 +81,16 @@ private:
    std::unordered_map< std::string, void * > _functions;
 };
 
+template< size_t N >
+inline void Utility::QuadraticBezierCurve( const Eigen::Vector3d & p0,
+   const Eigen::Vector3d & p1,
+   const Eigen::Vector3d & p2,
+   std::array< Eigen::Vector3d, N > & ref_points,
+   double ratio )
+{
+   QuadraticBezierCurvePoints( p0, p1, p2, ref_points.data(), N, ratio );
+}
+
 // Generic RAII object
 struct RAII
 {
@@ -0,0 +1,172 @@
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include "Bench.hpp"
+
+// This lives in its own translation unit so the replacement operators are never
+// inlined into code that also uses new-expressions.
+// Count every heap allocation so benchmarks can report allocations per iteration. Every replaceable
+// allocation function is replaced, so new[], nothrow and over-aligned allocations are counted too.
+static std::atomic< uint64_t > g_numAllocations( 0 );
+
+namespace
+{
+   void * Allocate( size_t size )
+   {
+      ++g_numAllocations;
+      return malloc( size ? size : 1 );
+   }
+   void * AllocateOrThrow( size_t size )
+   {
+      void * p = Allocate( size );
+      if ( !p )
+         throw std::bad_alloc();
+      return p;
+   }
+}
+
+void * operator new( size_t size )
+{
+   return AllocateOrThrow( size );
+}
+void * operator new[]( size_t size )
+{
+   return AllocateOrThrow( size );
+}
+void * operator new( size_t size,
+   const std::nothrow_t & ) noexcept
+{
+   return Allocate( size );
+}
+void * operator new[]( size_t size,
+   const std::nothrow_t & ) noexcept
+{
+   return Allocate( size );
+}
+void operator delete( void * p ) noexcept
+{
+   free( p );
+}
+void operator delete[]( void * p ) noexcept
+{
+   free( p );
+}
+void operator delete( void * p,
+   size_t ) noexcept
+{
+   free( p );
+}
+void operator delete[]( void * p,
+   size_t ) noexcept
+{
+   free( p );
+}
+void operator delete( void * p,
+   const std::nothrow_t & ) noexcept
+{
+   free( p );
+}
+void operator delete[]( void * p,
+   const std::nothrow_t & ) noexcept
+{
+   free( p );
+}
+
+#ifdef __cpp_aligned_new
+// Over-aligned types, when compiled as C++17 or later. These are only ever released by the aligned deletes below.
+namespace
+{
+   void * AllocateAligned( size_t size,
+      std::align_val_t alignment )
+   {
+      ++g_numAllocations;
+#ifdef _WIN32
+      return _aligned_malloc( size ? size : 1, (size_t)alignment );
+#else
+      void * p = nullptr;
+      if ( posix_memalign( &p, std::max( (size_t)alignment, sizeof( void * ) ), size ? size : 1 ) != 0 )
+         return nullptr;
+      return p;
+#endif
+   }
+   void * AllocateAlignedOrThrow( size_t size,
+      std::align_val_t alignment )
+   {
+      void * p = AllocateAligned( size, alignment );
+      if ( !p )
+         throw std::bad_alloc();
+      return p;
+   }
+   void FreeAligned( void * p )
+   {
+#ifdef _WIN32
+      _aligned_free( p );
+#else
+      free( p );
+#endif
+   }
+}
+
+void * operator new( size_t size,
+   std::align_val_t alignment )
+{
+   return AllocateAlignedOrThrow( size, alignment );
+}
+void * operator new[]( size_t size,
+   std::align_val_t alignment )
+{
+   return AllocateAlignedOrThrow( size, alignment );
+}
+void * operator new( size_t size,
+   std::align_val_t alignment,
+   const std::nothrow_t & ) noexcept
+{
+   return AllocateAligned( size, alignment );
+}
+void * operator new[]( size_t size,
+   std::align_val_t alignment,
+   const std::nothrow_t & ) noexcept
+{
+   return AllocateAligned( size, alignment );
+}
+void operator delete( void * p,
+   std::align_val_t ) noexcept
+{
+   FreeAligned( p );
+}
+void operator delete[]( void * p,
+   std::align_val_t ) noexcept
+{
+   FreeAligned( p );
+}
+void operator delete( void * p,
+   size_t,
+   std::align_val_t ) noexcept
+{
+   FreeAligned( p );
+}
+void operator delete[]( void * p,
+   size_t,
+   std::align_val_t ) noexcept
+{
+   FreeAligned( p );
+}
+void operator delete( void * p,
+   std::align_val_t,
+   const std::nothrow_t & ) noexcept
+{
+   FreeAligned( p );
+}
+void operator delete[]( void * p,
+   std::align_val_t,
+   const std::nothrow_t & ) noexcept
+{
+   FreeAligned( p );
+}
+#endif
+
+uint64_t NumAllocations()
+{
+   return g_numAllocations.load();
+}
@@ -0,0 +1,84 @@
+#ifndef Bench_hpp
+#define Bench_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <chrono>
+#include <string>
+
+// Number of heap allocations made by this process so far (see Allocations.cpp)
+uint64_t NumAllocations();
+
+// Times a single benchmark, and the allocations it made
+struct BenchTimer
+{
+   BenchTimer()
+      : _start( std::chrono::steady_clock::now() ),
+      _startAllocations( NumAllocations() ) {}
+   
+   double ElapsedSeconds() const
+   {
+      return std::chrono::duration< double >( std::chrono::steady_clock::now() - _start ).count();
+   }
+   uint64_t Allocations() const { return NumAllocations() - _startAllocations; }
+   
+   // Prints one result line: name, total time, time per iteration, allocations per iteration
+   void Print( const std::string & name, size_t iterations ) const
+   {
+      double seconds = ElapsedSeconds();
+      uint64_t allocations = Allocations();
+      printf( "%-32s %10.3f ms %10.1f ns/iter %8.2f allocs/iter\n",
+         name.c_str(),
+         seconds * 1e3,
+         seconds * 1e9 / double(iterations),
+         double(allocations) / double(iterations) );
+   }
+   
+   // Prints one result line for a pipeline stage: name, total time, frames/s, MB/s, allocations per frame.
+   // @numBytes is the amount of data the stage consumed, or 0 if it doesn't apply
+   void PrintThroughput( const std::string & name, size_t numFrames, size_t numBytes ) const
+   {
+      double seconds = ElapsedSeconds();
+      uint64_t allocations = Allocations();
+      if ( numBytes )
+         printf( "%-32s %10.3f ms %12.0f frames/s %10.2f MB/s %8.2f allocs/frame\n",
+            name.c_str(),
+            seconds * 1e3,
+            double(numFrames) / seconds,
+            double(numBytes) / seconds / 1e6,
+            double(allocations) / double(numFrames) );
+      else
+         printf( "%-32s %10.3f ms %12.0f frames/s %10s MB/s %8.2f allocs/frame\n",
+            name.c_str(),
+            seconds * 1e3,
+            double(numFrames) / seconds,
+            "-",
+            double(allocations) / double(numFrames) );
+   }
+   
+private:
+   std::chrono::steady_clock::time_point _start;
+   uint64_t _startAllocations;
+};
+
+// Options for the pipeline benchmark
+struct PipelineOptions
+{
+   std::string dataDirectory;
+   size_t playerScale = 1;
+   size_t durationScale = 1;
+   double unitMeterNorm = 0.1;
+   double fps = 30.0;
+   double maxGap = 0.5;
+   std::string smooth = "none";
+   std::string smoothDomain = "keypoints";
+   unsigned int threads = 1;
+};
+
+// Benchmarks
+void BenchSpine( size_t iterations );
+void BenchQuaternions( size_t iterations );
+void BenchPipeline( const PipelineOptions & options );
+
+#endif
@@ -0,0 +1,279 @@
+#include <climits>
+#include <vector>
+#include <map>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include "RigFileWriter.hpp"
+#include "Bench.hpp"
+#include "Utility.hpp"
+#include "Compression.hpp"
+#include "AnimatedRig.hpp"
+#include "PoseFactory.hpp"
+#include "RigPose.hpp"
+#include "KpImporterFactory.hpp"
+
+typedef std::vector< std::unique_ptr< Pose > > PoseList;
+
+// Keypoint types with a built-in pose class
+static const char * g_kpTypes[] = { "mpii", "mpii_20", "mpii_27", "mop_14", "mop_19", "solidObject" };
+
+static size_t FileSize( const std::string & filename )
+{
+   std::ifstream file( filename, std::ios::binary | std::ios::ate );
+   return file.good() ? (size_t)file.tellg() : 0;
+}
+
+// Stage: read every file in the data directory
+static PoseList Import( const PipelineOptions & options )
+{
+   std::string directory = options.dataDirectory;
+   std::vector< std::string > files = Utility::GetFiles( directory, "" );
+   if ( files.empty() )
+      throw std::runtime_error( "No input files found in '" + options.dataDirectory + "'" );
+   
+   size_t numBytes = 0;
+   for ( auto & file : files )
+      numBytes += FileSize( directory + "/" + file );
+   
+   PoseList poses;
+   BenchTimer timer;
+   for ( auto & file : files )
+   {
+      std::string filename = directory + "/" + file;
+      std::unique_ptr< KpImporter > importer = KpImporterFactory::Create( KpImporterFactory::DetermineType( filename ) );
+      importer->UnitMeterNorm( options.unitMeterNorm );
+      importer->Open( filename );
+      while ( !importer->IsParseComplete() )
+      {
+         std::unique_ptr< Pose > pose;
+         try
+         {
+            pose = importer->ReadOne();
+         }
+         catch ( std::runtime_error & )
+         {
+            break;
+         }
+         if ( pose )
+         {
+            pose->CoordinateSystem( { 1., 1., -1. } );
+            poses.push_back( std::move( pose ) );
+         }
+      }
+   }
+   timer.PrintThroughput( "KpCsvImporter::ReadOne", poses.size(), numBytes );
+   
+   return poses;
+}
+
+// Repeat the imported data: each player @playerScale times (shifted sideways so they don't overlap),
+// and the whole capture @durationScale times back-to-back
+static PoseList ScaleUp( const PoseList & poses,
+   size_t playerScale,
+   size_t durationScale )
+{
+   int minTimestamp = INT_MAX, maxTimestamp = INT_MIN;
+   for ( auto & pose : poses )
+   {
+      minTimestamp = std::min( minTimestamp, pose->Timestamp() );
+      maxTimestamp = std::max( maxTimestamp, pose->Timestamp() );
+   }
+   int duration = maxTimestamp - minTimestamp + 1;
+   
+   PoseList returnValue;
+   returnValue.reserve( poses.size() * playerScale * durationScale );
+   for ( size_t d = 0; d < durationScale; ++d )
+   {
+      for ( auto & pose : poses )
+      {
+         for ( size_t p = 0; p < playerScale; ++p )
+         {
+            std::unique_ptr< Pose > copy( pose->Clone() );
+            copy->Timestamp( pose->Timestamp() + (int)d * duration );
+            if ( p > 0 )
+            {
+               copy->Name( pose->Name() + "_" + std::to_string( p ) );
+               for ( auto & kp : copy->KeypointLayout() )
+                  copy->Keypoint( kp.first )[ 0 ] += 2.0 * p;
+            }
+            returnValue.push_back( std::move( copy ) );
+         }
+      }
+   }
+   
+   return returnValue;
+}
+
+// Stage: generate rigs for every keypoint type. The imported rigs are converted to each type,
+// then copied into fresh poses so the rigs are generated from keypoints.
+static void GenerateRigs( const PoseList & poses )
+{
+   std::vector< RigPose > rigPoses;
+   rigPoses.reserve( poses.size() );
+   for ( auto & pose : poses )
+   {
+      std::unique_ptr< Pose > copy( pose->Clone() );
+      rigPoses.push_back( copy->GenerateRig() );
+   }
+   
+   for ( auto kpType : g_kpTypes )
+   {
+      std::map< KEYPOINT_TYPE, int > layout;
+      try
+      {
+         layout = KpImporterFactory::GetKeypointMap( kpType );
+      }
+      catch ( std::runtime_error & e )
+      {
+         printf( "GenerateRig/%s skipped: %s\n", kpType, e.what() );
+         continue;
+      }
+      
+      PoseList typedPoses;
+      typedPoses.reserve( rigPoses.size() );
+      for ( auto & rigPose : rigPoses )
+      {
+         std::unique_ptr< Pose > converted = PoseFactory::FromRigPose( rigPose, kpType, layout );
+         std::unique_ptr< Pose > fresh = PoseFactory::Create( kpType, layout );
+         for ( auto & kp : layout )
+            fresh->Keypoint( converted->Keypoint( kp.first ), kp.first );
+         fresh->Timestamp( rigPose.Timestamp() );
+         typedPoses.push_back( std::move( fresh ) );
+      }
+      
+      size_t numFailed = 0;
+      BenchTimer timer;
+      for ( auto & pose : typedPoses )
+      {
+         try
+         {
+            pose->GenerateRig();
+         }
+         catch ( std::runtime_error & )
+         {
+            ++numFailed;
+         }
+      }
+      timer.PrintThroughput( std::string( "Pose::GenerateRig/" ) + kpType, typedPoses.size(), 0 );
+      if ( numFailed )
+         printf( "   %d of %d rigs failed\n", (int)numFailed, (int)typedPoses.size() );
+   }
+}
+
+// Stage: compress rig data the same way AnimatedRig::Write() does
+static void Compress( const PoseList & poses )
+{
+   std::vector< double > locations, lengths, rotations, offsets;
+   for ( auto & pose : poses )
+   {
+      std::unique_ptr< Pose > copy( pose->Clone() );
+      lengths.clear();
+      copy->GenerateRig().GetRig().ToArrays( locations, lengths, rotations, offsets );
+   }
+   
+   std::vector< uint8_t > compressed( rotations.size() * sizeof(double) );
+   size_t compressedSize = compressed.size();
+   {
+      BenchTimer timer;
+      Compression::EncodeZfp( rotations.data(), rotations.size(), compressed.data(), compressedSize );
+      timer.PrintThroughput( "Compression::EncodeZfp", poses.size(), rotations.size() * sizeof(double) );
+   }
+   {
+      std::vector< unsigned char > base64Data;
+      BenchTimer timer;
+      Compression::EncodeBase64( compressed.data(), compressedSize, base64Data );
+      timer.PrintThroughput( "Compression::EncodeBase64", poses.size(), compressedSize );
+   }
+}
+
+// Stages: everything Animation does for a segment, one rig at a time
+static void Animate( PoseList & poses,
+   const PipelineOptions & options )
+{
+   std::map< std::string, AnimatedRig > animatedRigs;
+   int startTimestamp = INT_MAX, endTimestamp = INT_MIN;
+   size_t numFrames = poses.size();
+   
+   {
+      BenchTimer timer;
+      for ( auto & pose : poses )
+      {
+         startTimestamp = std::min( startTimestamp, pose->Timestamp() );
+         endTimestamp = std::max( endTimestamp, pose->Timestamp() );
+         
+         auto it = animatedRigs.find( pose->Name() );
+         if ( it == animatedRigs.end() )
+         {
+            it = animatedRigs.emplace( std::make_pair( pose->Name(), AnimatedRig() ) ).first;
+            (*it).second.SolverThreads( options.threads );
+            (*it).second.SmoothDomain( SmoothFactory::SmoothDomain( options.smoothDomain ) );
+            (*it).second.SmoothType( SmoothFactory::SmoothType( options.smooth ) );
+         }
+         (*it).second.AddPose( pose );
+      }
+      timer.PrintThroughput( "AnimatedRig::AddPose", numFrames, 0 );
+   }
+   
+   {
+      BenchTimer timer;
+      for ( auto & animatedRig : animatedRigs )
+         animatedRig.second.FixMissingFrames( startTimestamp, endTimestamp, (int)((options.maxGap * options.fps) + 0.5) );
+      timer.PrintThroughput( "AnimatedRig::FixMissingFrames", numFrames, 0 );
+   }
+   
+   // Gap filling adds frames
+   numFrames = 0;
+   for ( auto & animatedRig : animatedRigs )
+      numFrames += animatedRig.second.GetFrames().size();
+   
+   {
+      SMOOTH_TYPE smoothType = SmoothFactory::SmoothType( options.smooth );
+      BenchTimer timer;
+      try
+      {
+         for ( auto & animatedRig : animatedRigs )
+         {
+            int rangeStart = startTimestamp, rangeEnd = endTimestamp;
+            animatedRig.second.SmoothFrames( smoothType, rangeStart, rangeEnd, true );
+         }
+         timer.PrintThroughput( "AnimatedRig::SmoothFrames/" + SmoothFactory::SmoothType( smoothType ) + "/" + options.smoothDomain, numFrames, 0 );
+      }
+      catch ( std::runtime_error & e )
+      {
+         printf( "AnimatedRig::SmoothFrames skipped: %s\n", e.what() );
+      }
+   }
+   
+   {
+      BenchTimer timer;
+      RigFileWriter file( startTimestamp, endTimestamp, options.fps );
+      for ( auto & animatedRig : animatedRigs )
+      {
+         file.BeginRig( animatedRig.first, animatedRig.second.Category(), animatedRig.first );
+         animatedRig.second.Write( file, startTimestamp, endTimestamp );
+         file.EndRig();
+      }
+      const size_t numBytes = file.Finish().size();
+      double seconds = timer.ElapsedSeconds();
+      timer.PrintThroughput( "AnimatedRig::Write", numFrames, 0 );
+      
+      printf( "   %.2f MB of json, %.2f MB/s\n", numBytes / 1e6, numBytes / seconds / 1e6 );
+   }
+}
+
+void BenchPipeline( const PipelineOptions & options )
+{
+   PoseList poses = Import( options );
+   PoseList scaled = ScaleUp( poses, options.playerScale, options.durationScale );
+   printf( "%d frames imported, %d frames after scaling (%dx players, %dx duration)\n",
+      (int)poses.size(),
+      (int)scaled.size(),
+      (int)options.playerScale,
+      (int)options.durationScale );
+   
+   GenerateRigs( scaled );
+   Compress( scaled );
+   Animate( scaled, options );
+}
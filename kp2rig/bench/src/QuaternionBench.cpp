@@ -0,0 +1,163 @@
+#include <vector>
+#include <array>
+#include <random>
+#include "Bench.hpp"
+#include "QuaternionBatch.hpp"
+#include "Utility.hpp"
+
+namespace
+{
+   // Enough quaternions to fill a rig's worth of joints over a few seconds of frames, and stay in cache
+   const size_t BATCH_SIZE = 1024;
+
+   void RandomRotations( std::mt19937 & ref_random,
+      QuaternionBatch::QuaternionBuffer & out_rotations )
+   {
+      std::uniform_real_distribution< double > distribution( -1.0, 1.0 );
+      for ( size_t i = 0; i < out_rotations.Size(); ++i )
+      {
+         Eigen::Quaterniond q( distribution( ref_random ), distribution( ref_random ), distribution( ref_random ), distribution( ref_random ) );
+         out_rotations.Set( i, Utility::QuaternionToRaw( q.normalized() ) );
+      }
+   }
+}
+
+void BenchQuaternions( size_t iterations )
+{
+   using namespace QuaternionBatch;
+
+   std::mt19937 random( 7 );
+   QuaternionBuffer a( BATCH_SIZE ), b( BATCH_SIZE ), out( BATCH_SIZE );
+   VectorBuffer v( BATCH_SIZE ), rotated( BATCH_SIZE );
+   std::vector< double > ratios( BATCH_SIZE );
+   std::vector< double > points( BATCH_SIZE * 3 );
+   const std::array< double, 12 > matrix = { 0.1, 0, 0, 1.5,  0, 0, -0.1, 2,  0, 0.1, 0, -0.5 };
+   RandomRotations( random, a );
+   RandomRotations( random, b );
+   std::uniform_real_distribution< double > distribution( 0.0, 1.0 );
+   for ( size_t i = 0; i < BATCH_SIZE; ++i )
+   {
+      ratios[ i ] = distribution( random );
+      v.Set( i, { distribution( random ), distribution( random ), distribution( random ) } );
+   }
+   for ( auto & value : points )
+      value = distribution( random );
+
+   // Every result line is per quaternion
+   const size_t numBatches = iterations / BATCH_SIZE + 1;
+   const size_t count = numBatches * BATCH_SIZE;
+   double sum = 0;
+
+   // Eigen, one quaternion at a time, as the reference
+   {
+      BenchTimer timer;
+      for ( size_t batch = 0; batch < numBatches; ++batch )
+      {
+         for ( size_t i = 0; i < BATCH_SIZE; ++i )
+            out.Set( i, Utility::QuaternionToRaw( Utility::RawToQuaternion( a.Get( i ) ) * Utility::RawToQuaternion( b.Get( i ) ) ) );
+         sum += out.View().w[ batch % BATCH_SIZE ];
+      }
+      timer.Print( "Quaternion multiply (eigen)", count );
+   }
+   {
+      BenchTimer timer;
+      for ( size_t batch = 0; batch < numBatches; ++batch )
+      {
+         for ( size_t i = 0; i < BATCH_SIZE; ++i )
+            out.Set( i, Utility::QuaternionToRaw( Utility::RawToQuaternion( a.Get( i ) ).slerp( ratios[ i ], Utility::RawToQuaternion( b.Get( i ) ) ) ) );
+         sum += out.View().w[ batch % BATCH_SIZE ];
+      }
+      timer.Print( "Quaternion slerp (eigen)", count );
+   }
+
+   // Each batched operation with each kernel this CPU has
+   const KERNEL previousKernel = Kernel();
+   for ( KERNEL kernel : { KERNEL_SCALAR, KERNEL_AVX2, KERNEL_NEON } )
+   {
+      if ( !IsSupported( kernel ) )
+         continue;
+      Kernel( kernel );
+      const std::string suffix = " (" + KernelName( kernel ) + ")";
+
+      {
+         BenchTimer timer;
+         for ( size_t batch = 0; batch < numBatches; ++batch )
+         {
+            Multiply( a.View(), b.View(), out.View(), BATCH_SIZE );
+            sum += out.View().w[ batch % BATCH_SIZE ];
+         }
+         timer.Print( "Quaternion multiply" + suffix, count );
+      }
+      {
+         BenchTimer timer;
+         for ( size_t batch = 0; batch < numBatches; ++batch )
+         {
+            Normalize( a.View(), out.View(), BATCH_SIZE );
+            sum += out.View().w[ batch % BATCH_SIZE ];
+         }
+         timer.Print( "Quaternion normalize" + suffix, count );
+      }
+      {
+         BenchTimer timer;
+         for ( size_t batch = 0; batch < numBatches; ++batch )
+         {
+            Rotate( a.View(), v.View(), rotated.View(), BATCH_SIZE );
+            sum += rotated.View().x[ batch % BATCH_SIZE ];
+         }
+         timer.Print( "Quaternion rotate" + suffix, count );
+      }
+      {
+         BenchTimer timer;
+         for ( size_t batch = 0; batch < numBatches; ++batch )
+         {
+            Slerp( a.View(), b.View(), ratios.data(), out.View(), BATCH_SIZE );
+            sum += out.View().w[ batch % BATCH_SIZE ];
+         }
+         timer.Print( "Quaternion slerp" + suffix, count );
+      }
+      {
+         BenchTimer timer;
+         for ( size_t batch = 0; batch < numBatches; ++batch )
+         {
+            Nlerp( a.View(), b.View(), ratios.data(), out.View(), BATCH_SIZE );
+            sum += out.View().w[ batch % BATCH_SIZE ];
+         }
+         timer.Print( "Quaternion nlerp" + suffix, count );
+      }
+      {
+         BenchTimer timer;
+         for ( size_t batch = 0; batch < numBatches; ++batch )
+         {
+            FromTwoVectors( v.View(), rotated.View(), out.View(), BATCH_SIZE );
+            sum += out.View().w[ batch % BATCH_SIZE ];
+         }
+         timer.Print( "Quaternion from vectors" + suffix, count );
+      }
+      
+      // Packed points, as ImportTransform uses them, read from the same input every batch
+      std::vector< double > transformed( BATCH_SIZE * 3 );
+      {
+         BenchTimer timer;
+         for ( size_t batch = 0; batch < numBatches; ++batch )
+         {
+            TransformPoints( matrix, points.data(), transformed.data(), BATCH_SIZE );
+            sum += transformed[ batch % BATCH_SIZE ];
+         }
+         timer.Print( "Point transform" + suffix, count );
+      }
+      {
+         BenchTimer timer;
+         for ( size_t batch = 0; batch < numBatches; ++batch )
+         {
+            ScalePoints( { 0.1, 0.1, -0.1 }, points.data(), transformed.data(), BATCH_SIZE );
+            sum += transformed[ batch % BATCH_SIZE ];
+         }
+         timer.Print( "Point scale" + suffix, count );
+      }
+   }
+   Kernel( previousKernel );
+
+   // Keep the optimizer honest
+   if ( sum != sum )
+      printf( "%f\n", sum );
+}
@@ -0,0 +1,84 @@
+#include <vector>
+#include <array>
+#include "Bench.hpp"
+#include "KpMpii_16.hpp"
+#include "KpToRigHelper.hpp"
+#include "Utility.hpp"
+
+// A single frame of mpii keypoints (meters), taken from the soccer demo
+static const double g_mpiiFrame[ 16 ][ 3 ] =
+{
+   { 1.5071394787257328, 0.13629840029294118, -5.221340364337587 },
+   { 1.480194010263482,  0.4341753173940828,  -5.490205643351371 },
+   { 1.329215865448965,  0.794184931802938,   -5.466869352301000 },
+   { 1.495394787257328,  0.812984002929411,   -5.361340364337587 },
+   { 1.600194010263482,  0.452175317394082,   -5.290205643351371 },
+   { 1.587139478725732,  0.091629840029294,   -5.121340364337587 },
+   { 1.412305326353146,  0.803584467366174,   -5.414104858319293 },
+   { 1.401305326353146,  1.343584467366174,   -5.394104858319293 },
+   { 1.411305326353146,  1.453584467366174,   -5.384104858319293 },
+   { 1.421305326353146,  1.653584467366174,   -5.374104858319293 },
+   { 1.150305326353146,  0.903584467366174,   -5.264104858319293 },
+   { 1.200305326353146,  1.083584467366174,   -5.334104858319293 },
+   { 1.251305326353146,  1.323584467366174,   -5.414104858319293 },
+   { 1.551305326353146,  1.333584467366174,   -5.374104858319293 },
+   { 1.611305326353146,  1.093584467366174,   -5.304104858319293 },
+   { 1.651305326353146,  0.883584467366174,   -5.234104858319293 }
+};
+
+void BenchSpine( size_t iterations )
+{
+   std::map< KEYPOINT_TYPE, int > layout =
+   {
+      { RIGHT_ANKLE, 0 }, { RIGHT_KNEE, 1 }, { RIGHT_HIP, 2 }, { LEFT_HIP, 3 },
+      { LEFT_KNEE, 4 }, { LEFT_ANKLE, 5 }, { PELVIS, 6 }, { BASE_NECK, 7 },
+      { BASE_HEAD, 8 }, { TOP_HEAD, 9 }, { RIGHT_WRIST, 10 }, { RIGHT_ELBOW, 11 },
+      { RIGHT_SHOULDER, 12 }, { LEFT_SHOULDER, 13 }, { LEFT_ELBOW, 14 }, { LEFT_WRIST, 15 }
+   };
+   KpMpii_16 pose( "mpii", layout );
+   for ( int i = 0; i < 16; ++i )
+      pose.Keypoint( { g_mpiiFrame[ i ][ 0 ], g_mpiiFrame[ i ][ 1 ], g_mpiiFrame[ i ][ 2 ] }, i );
+   
+   Eigen::Vector3d p0( 1.46, 0.81, -5.39 );
+   Eigen::Vector3d p1( 1.38, 1.10, -5.28 );
+   Eigen::Vector3d p2( 1.40, 1.34, -5.39 );
+   Eigen::Vector3d sum( 0, 0, 0 );
+   
+   // The curve on its own
+   {
+      BenchTimer timer;
+      for ( size_t i = 0; i < iterations; ++i )
+      {
+         p1[ 0 ] += 1e-9;
+         std::vector< Eigen::Vector3d > points = Utility::QuadraticBezierCurve( p0, p1, p2, 3, 0.3 );
+         sum += points[ 0 ];
+      }
+      timer.Print( "QuadraticBezierCurve (vector)", iterations );
+   }
+   {
+      BenchTimer timer;
+      std::array< Eigen::Vector3d, 3 > points;
+      for ( size_t i = 0; i < iterations; ++i )
+      {
+         p1[ 0 ] += 1e-9;
+         Utility::QuadraticBezierCurve( p0, p1, p2, points );
+         sum += points[ 0 ];
+      }
+      timer.Print( "QuadraticBezierCurve (array)", iterations );
+   }
+   
+   // The curve as used by the solver, along with the legs and arms
+   {
+      BenchTimer timer;
+      for ( size_t i = 0; i < iterations; ++i )
+      {
+         pose.Keypoint( { g_mpiiFrame[ 7 ][ 0 ] + 1e-9 * double(i & 1), g_mpiiFrame[ 7 ][ 1 ], g_mpiiFrame[ 7 ][ 2 ] }, 7 );
+         KpToRigHelper::HandleCore( pose );
+      }
+      timer.Print( "KpToRigHelper::HandleCore", iterations );
+   }
+   
+   // Keep the optimizer honest
+   if ( sum.norm() < 0 )
+      printf( "%f\n", sum.norm() );
+}
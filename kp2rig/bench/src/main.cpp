@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <stdexcept>
+#include "CLI11.hpp"
+#include "Bench.hpp"
+
+int main( int argc, char *argv[] )
+{
+   size_t iterations = 200000;
+   bool pipelineOnly = false;
+   PipelineOptions pipeline;
+   
+   // The soccer demo is unpacked into the build tree at build time
+   pipeline.dataDirectory = BENCH_DATA_DIR "/IntelStudios_SoccerDemo";
+   
+   CLI::App app{ "kp2rig benchmarks" };
+   app.add_option( "-i,--iterations", iterations, "Number of iterations for micro-benchmarks. Default is 200000\n" );
+   app.add_flag( "--pipeline-only", pipelineOnly, "Skip the micro-benchmarks\n" );
+   app.add_option( "-d,--data", pipeline.dataDirectory, "Directory of keypoint files for the pipeline benchmark. Default is the bundled soccer demo\n" );
+   app.add_option( "-p,--players", pipeline.playerScale, "Repeat every player this many times. Default is 1\n" );
+   app.add_option( "-m,--duration", pipeline.durationScale, "Repeat the whole capture this many times. Default is 1\n" );
+   app.add_option( "-u,--units", pipeline.unitMeterNorm, "Value used to convert input units to meters. Default is 0.1, for the soccer demo\n" );
+   app.add_option( "-s,--smooth", pipeline.smooth, "Smoothing type used by the SmoothFrames stage. Default is none\n" );
+   app.add_option( "--smooth-domain", pipeline.smoothDomain, "What the SmoothFrames stage filters {keypoints|rotations}. Default is keypoints\n" );
+   app.add_option( "--threads", pipeline.threads, "Number of threads used to generate rigs. Default is 1\n" );
+   CLI11_PARSE( app, argc, argv );
+   
+   if ( !pipelineOnly )
+   {
+      BenchSpine( iterations );
+      BenchQuaternions( iterations );
+   }
+   
+   try
+   {
+      BenchPipeline( pipeline );
+   }
+   catch ( std::runtime_error & e )
+   {
+      std::cerr << e.what() << std::endl;
+      return 1;
+   }
+   
+   return 0;
+}
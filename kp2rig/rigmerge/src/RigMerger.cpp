@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <json.hpp>
+#include "Compression.hpp"
+#include "RigFileWriter.hpp"
+#include "SegmentFilename.hpp"
+#include "Utility.hpp"
+#include "RigMerger.hpp"
+
+namespace
+{
+   nlohmann::json ReadRigFile( const std::string & filename )
+   {
+      std::ifstream file( filename, std::ios::binary );
+      if ( !file.good() )
+         throw std::runtime_error( "Could not open file '" + filename + "'" );
+
+      nlohmann::json json;
+      try
+      {
+         file >> json;
+      }
+      catch ( nlohmann::json::exception & e )
+      {
+         throw std::runtime_error( "Could not parse '" + filename + "': " + e.what() );
+      }
+      if ( json.find( "header" ) == json.end() ||
+         json.find( "rigs" ) == json.end() )
+         throw std::runtime_error( "Not a rig file '" + filename + "'" );
+      return json;
+   }
+
+   // The base64, zfp-compressed array @key of @rig, or nothing if there isn't one
+   std::vector< double > DecodeField( const nlohmann::json & rig,
+      const char * key )
+   {
+      std::vector< double > values;
+      auto it = rig.find( key );
+      if ( it == rig.end() )
+         return values;
+
+      const std::string & encoded = (*it).get_ref< const std::string & >();
+      std::vector< unsigned char > compressed;
+      size_t compressedSize = Compression::DecodeBase64( (const unsigned char *)encoded.data(),
+         encoded.size(),
+         compressed );
+      Compression::DecodeZfp( compressed.data(), compressedSize, values );
+      return values;
+   }
+
+   void EncodeField( RigFileWriter & ref_file,
+      const char * key,
+      std::vector< double > & ref_values )
+   {
+      // Room for incompressible data and the zfp header
+      std::vector< uint8_t > compressed( ref_values.size() * sizeof( double ) + 1024 );
+      size_t compressedSize = compressed.size();
+      Compression::EncodeZfp( ref_values.data(),
+         ref_values.size(),
+         compressed.data(),
+         compressedSize );
+
+      std::vector< unsigned char > base64;
+      size_t base64Size = Compression::EncodeBase64( compressed.data(),
+         compressedSize,
+         base64 );
+      ref_file.Field( key, base64.data(), base64Size );
+   }
+
+   int IntField( const nlohmann::json & rig,
+      const char * key,
+      int defaultValue )
+   {
+      auto it = rig.find( key );
+      return it == rig.end() ? defaultValue : (*it).get< int >();
+   }
+}
+
+void RigMerger::Add( const std::string & fileOrDirectory )
+{
+   std::string directory = Utility::ExpandTilde( fileOrDirectory );
+   if ( !Utility::IsDirectory( directory ) )
+   {
+      AddFile( directory );
+      return;
+   }
+
+   for ( auto & filename : Utility::GetFiles( directory, "" ) )
+   {
+      // Rather than leave frames out, refuse what can't be merged
+      SegmentFilename segment;
+      if ( !SegmentFilename::Parse( filename, segment ) )
+         continue;
+      if ( segment.patch )
+         throw std::runtime_error( "Can't merge patches of late frames '" + directory + "/" + filename + "'" );
+      if ( segment.contents != SegmentFilename::CONTENTS_ALL )
+         throw std::runtime_error( "Can't merge segments written with --partition-by-rig '" + directory + "/" + filename + "'" );
+      AddFile( directory + "/" + filename );
+   }
+}
+void RigMerger::AddFile( const std::string & filename )
+{
+   nlohmann::json json = ReadRigFile( filename );
+   const nlohmann::json & header = json[ "header" ];
+   _segments.push_back( { filename,
+      header[ "startFrame" ].get< int >(),
+      header[ "endFrame" ].get< int >(),
+      header[ "fps" ].get< double >() } );
+   _sorted = false;
+}
+const std::vector< RigMerger::Segment > & RigMerger::Segments( std::vector< std::pair< int, int > > & out_gaps )
+{
+   if ( !_sorted )
+   {
+      std::stable_sort( std::begin( _segments ), std::end( _segments ),
+         []( const Segment & lhs, const Segment & rhs ) { return lhs.startFrame < rhs.startFrame; } );
+      _sorted = true;
+   }
+
+   out_gaps.clear();
+   for ( size_t i = 1; i < _segments.size(); ++i )
+   {
+      const Segment & previous = _segments[ i - 1 ];
+      const Segment & segment = _segments[ i ];
+      if ( segment.fps != previous.fps )
+      {
+         std::stringstream ss;
+         ss << "'" << segment.filename << "' is " << segment.fps << " fps but '" << previous.filename << "' is " << previous.fps;
+         throw std::runtime_error( ss.str() );
+      }
+      if ( segment.startFrame <= previous.endFrame )
+      {
+         std::stringstream ss;
+         ss << "'" << segment.filename << "' (" << segment.startFrame << "-" << segment.endFrame << ") overlaps '"
+            << previous.filename << "' (" << previous.startFrame << "-" << previous.endFrame << ")";
+         throw std::runtime_error( ss.str() );
+      }
+      if ( segment.startFrame > previous.endFrame + 1 )
+         out_gaps.push_back( std::make_pair( previous.endFrame + 1, segment.startFrame - 1 ) );
+   }
+   return _segments;
+}
+std::string RigMerger::Merge()
+{
+   std::vector< std::pair< int, int > > gaps;
+   const std::vector< Segment > & segments = Segments( gaps );
+   if ( segments.empty() )
+      throw std::runtime_error( "Nothing to merge" );
+
+   // Stitch each rig together, one file at a time so only one is ever parsed
+   std::map< std::string, MergedRig > rigs;
+   for ( auto & segment : segments )
+   {
+      nlohmann::json json = ReadRigFile( segment.filename );
+      for ( auto & rig : json[ "rigs" ] )
+      {
+         const std::string id = rig[ "id" ].get< std::string >();
+         const int startFrame = IntField( rig, "startFrame", segment.startFrame );
+         const int endFrame = IntField( rig, "endFrame", segment.endFrame );
+         const int numFrames = endFrame - startFrame + 1;
+         if ( numFrames <= 0 )
+            continue;
+
+         const int numLengths = IntField( rig, "numLen", 0 );
+         const int numRotations = IntField( rig, "numRot", 0 );
+         const int numOffsets = IntField( rig, "numOff", 0 );
+         std::vector< double > positions = DecodeField( rig, "loc" );
+         std::vector< double > rotations = numRotations ? DecodeField( rig, "boneRot" ) : std::vector< double >();
+         std::vector< double > offsets = numOffsets ? DecodeField( rig, "boneOff" ) : std::vector< double >();
+         if ( positions.size() != (size_t)numFrames * 3 ||
+            rotations.size() != (size_t)(numFrames * numRotations * 4) ||
+            offsets.size() != (size_t)(numFrames * numOffsets * 3) )
+            throw std::runtime_error( "Rig '" + id + "' in '" + segment.filename + "' doesn't have a frame for every frame in its range" );
+
+         MergedRig & merged = rigs[ id ];
+         if ( merged.positions.empty() )
+         {
+            merged.type = rig[ "type" ].get< std::string >();
+            merged.name = rig[ "name" ].get< std::string >();
+            merged.startFrame = startFrame;
+            merged.numRotations = numRotations;
+            merged.numOffsets = numOffsets;
+         }
+         else
+         {
+            if ( numRotations != merged.numRotations ||
+               numOffsets != merged.numOffsets )
+               throw std::runtime_error( "Rig '" + id + "' changes shape in '" + segment.filename + "'" );
+            HoldLastFrame( merged, startFrame - merged.endFrame - 1 );
+         }
+
+         merged.positions.insert( std::end( merged.positions ), std::begin( positions ), std::end( positions ) );
+         merged.rotations.insert( std::end( merged.rotations ), std::begin( rotations ), std::end( rotations ) );
+         merged.offsets.insert( std::end( merged.offsets ), std::begin( offsets ), std::end( offsets ) );
+         merged.endFrame = endFrame;
+
+         // Bone lengths are only written for the last frame, so the latest are the ones to keep
+         if ( numLengths > 0 )
+         {
+            merged.numLengths = numLengths;
+            merged.lengths = DecodeField( rig, "boneLen" );
+         }
+      }
+   }
+
+   // Same layout kp2rig writes
+   const int startFrame = segments.front().startFrame;
+   const int endFrame = segments.back().endFrame;
+   RigFileWriter file( startFrame, endFrame, segments.front().fps );
+   for ( auto & rig : rigs )
+   {
+      MergedRig & merged = rig.second;
+      file.BeginRig( rig.first, merged.type, merged.name );
+      EncodeField( file, "loc", merged.positions );
+      if ( merged.lengths.size() )
+      {
+         EncodeField( file, "boneLen", merged.lengths );
+         file.Field( "numLen", merged.numLengths );
+      }
+      if ( merged.rotations.size() )
+      {
+         EncodeField( file, "boneRot", merged.rotations );
+         file.Field( "numRot", merged.numRotations );
+      }
+      if ( merged.offsets.size() )
+      {
+         EncodeField( file, "boneOff", merged.offsets );
+         file.Field( "numOff", merged.numOffsets );
+      }
+      if ( merged.startFrame > startFrame )
+         file.Field( "startFrame", merged.startFrame );
+      if ( merged.endFrame < endFrame )
+         file.Field( "endFrame", merged.endFrame );
+      file.EndRig();
+   }
+   return file.Finish();
+}
+void RigMerger::HoldLastFrame( MergedRig & ref_rig,
+   int numFrames )
+{
+   auto repeat = []( std::vector< double > & ref_values, size_t frameSize, int count )
+   {
+      if ( ref_values.size() < frameSize )
+         return;
+      const size_t last = ref_values.size() - frameSize;
+      for ( int i = 0; i < count; ++i )
+         for ( size_t j = 0; j < frameSize; ++j )
+            ref_values.push_back( ref_values[ last + j ] );
+   };
+   repeat( ref_rig.positions, 3, numFrames );
+   repeat( ref_rig.rotations, (size_t)ref_rig.numRotations * 4, numFrames );
+   repeat( ref_rig.offsets, (size_t)ref_rig.numOffsets * 3, numFrames );
+}
@@ -0,0 +1,60 @@
+#ifndef RigMerger_hpp
+#define RigMerger_hpp
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Stitches rig files that cover consecutive frame ranges, such as the outputs of kp2rig --range shards,
+// back into one capture. Files may be given in any order; they are sorted by their first frame.
+class RigMerger
+{
+public:
+   struct Segment
+   {
+      std::string filename;
+      int startFrame;
+      int endFrame;
+      double fps;
+   };
+
+   // Adds a rig file, or every segment (seg_<startFrame>.json) in a directory.
+   // Throws if a file can't be read or isn't a rig file, or if the directory has patches or partitioned segments
+   // (see SegmentFilename), which can't be merged.
+   void Add( const std::string & fileOrDirectory );
+
+   // The files added, sorted by first frame. Throws if any overlap or their frame rates differ.
+   // Gaps are allowed, and reported in @out_gaps as {first missing frame, last missing frame}.
+   const std::vector< Segment > & Segments( std::vector< std::pair< int, int > > & out_gaps );
+
+   // A single rig file holding every frame of every rig, in order. A rig missing for a while (between shards,
+   // or for a whole shard) holds its last frame until it's back, as kp2rig does for long gaps.
+   // The data is decompressed and compressed again, so each value can move by up to Compression::ZFP_ACCURACY from
+   // the shard's, and by up to twice that from what kp2rig solved. Use rigmerge --segments to keep the shards' values.
+   std::string Merge();
+
+private:
+   struct MergedRig
+   {
+      std::string type;
+      std::string name;
+      int startFrame = 0;
+      int endFrame = -1;
+      int numLengths = 0;
+      int numRotations = 0;
+      int numOffsets = 0;
+      std::vector< double > positions;
+      std::vector< double > lengths;
+      std::vector< double > rotations;
+      std::vector< double > offsets;
+   };
+
+   void AddFile( const std::string & filename );
+   static void HoldLastFrame( MergedRig & ref_rig,
+      int numFrames );
+
+   std::vector< Segment > _segments;
+   bool _sorted = true;
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include "CLI11.hpp"
+#include "Utility.hpp"
+#include "SegmentWriter.hpp"
+#include "RigMerger.hpp"
+
+int main( int argc, char *argv[] )
+{
+   std::vector< std::string > inputs;
+   std::string output;
+   bool segments = false;
+   std::string fsync = SegmentWriter::FsyncPolicy( SegmentWriter::FSYNC_FILE );
+
+   CLI::App app{ "Stitches kp2rig --range shards back into one capture" };
+   app.add_option( "inputs", inputs, "Rig files, or output directories of kp2rig --segsize runs, in any order\n" )->required();
+   app.add_option( "-o,--output", output, "Merged rig file. With --segments, the directory the segments are copied to\n" )->required();
+   app.add_flag( "--segments", segments, "Keep the segments as they are and copy them all into one directory, instead of merging them into a single file\n" );
+   app.add_option( "--fsync", fsync, "When written files are synced to disk: none, file, or full. Default is file\n" );
+   CLI11_PARSE( app, argc, argv );
+
+   try
+   {
+      RigMerger merger;
+      for ( auto & input : inputs )
+         merger.Add( input );
+
+      std::vector< std::pair< int, int > > gaps;
+      const std::vector< RigMerger::Segment > & files = merger.Segments( gaps );
+      if ( files.empty() )
+         throw std::runtime_error( "No rig files found" );
+      for ( auto & gap : gaps )
+         printf( "Warning: no frames %d-%d\n", gap.first, gap.second );
+
+      SegmentWriter writer;
+      writer.Fsync( SegmentWriter::FsyncPolicy( fsync ) );
+      if ( segments )
+      {
+         output = Utility::ExpandTilde( output );
+         if ( !Utility::IsDirectory( output ) )
+            throw std::runtime_error( "Output directory does not exist '" + output + "'" );
+
+         // Segments are named by their first frame, so shards can't collide once they've been checked for overlap.
+         // They're copied as-is, so nothing is compressed twice.
+         for ( auto & file : files )
+         {
+            std::ifstream in( file.filename, std::ios::binary );
+            std::string contents( ( std::istreambuf_iterator< char >( in ) ),
+               std::istreambuf_iterator< char >() );
+            writer.Write( output + "/seg_" + std::to_string( file.startFrame ) + ".json", std::move( contents ) );
+         }
+      }
+      else
+      {
+         writer.Write( Utility::ExpandTilde( output ), merger.Merge() );
+      }
+      writer.Wait();
+
+      if ( writer.Written().size() != ( segments ? files.size() : 1 ) )
+         return 1;
+      printf( "Wrote %zu frames from %zu files\n",
+         (size_t)(files.back().endFrame - files.front().startFrame + 1),
+         files.size() );
+   }
+   catch ( std::runtime_error & e )
+   {
+      std::cerr << e.what() << std::endl;
+      return 1;
+   }
+
+   return 0;
+}
@@ -1,16 +1,51 @@
 #define _USE_MATH_DEFINES
 #include <cmath>
+#include <algorithm>
+#include <iterator>
 #include "AnimatedRig.hpp"
 #include "Utility.hpp"
 #include "Compression.hpp"
+#include "QuaternionBatch.hpp"
 #include "PoseFactory.hpp"
 #include "RigPose.hpp"
+#include "RigSolver.hpp"
+#include "Metrics.hpp"
+#include "Smooth_oneEuro.hpp"
 
 // This defines the "window" size of our low-pass filter
 const int NUM_TAPS = 21;
 
+// Cutoff of causal filters when still, in cycles/frame; lower than the low-pass filter's because causal
+// filters raise it with speed
+const double CAUSAL_NORMALIZED_FREQUENCY = 1./30.;
+// How quickly the 1€ filter's cutoff rises with speed, in cycles/frame per unit/frame (meters or radians)
+const double CAUSAL_BETA = Smooth_oneEuro::DEFAULT_BETA;
+// Cutoff of the speed the 1€ filter's cutoff rises with, in cycles/frame
+const double CAUSAL_DERIVATIVE_FREQUENCY = CAUSAL_NORMALIZED_FREQUENCY;
+
+// The joints with more than 1 degree of freedom, whose roll is smoothed:
+//   - hip roll (where the knee points)
+//   - shoulder roll (where the elbow points)
+const std::array< Rig::JOINT_TYPE, 4 > JOINTS_WITH_ROLL =
+{ {
+   Rig::LHIP,
+   Rig::RHIP,
+   Rig::LSHOULDER,
+   Rig::RSHOULDER
+} };
+
+// A filter of @type for one value, with the causal filters' parameters if it's causal
+static std::unique_ptr< Smooth > CreateSmoother( SMOOTH_TYPE type,
+   double normalizedFrequency )
+{
+   auto filter = SmoothFactory::Create( type );
+   filter->Initialize( NUM_TAPS, normalizedFrequency );
+   if ( type == SMOOTH_TYPE_ONE_EURO )
+      static_cast< Smooth_oneEuro & >( *filter ).Parameters( CAUSAL_BETA, CAUSAL_DERIVATIVE_FREQUENCY );
+   return filter;
+}
+
 AnimatedRig::AnimatedRig()
-   : _rawBoneLengths( Rig::MAX_NUM_JOINTS + Rig::MAX_NUM_JOINT_OFFSETS, std::vector< double >() )
 {
 }
 
@@ -19,175 +54,296 @@ void AnimatedRig::AddPose( std::unique_ptr< Pose > & pose )
    // Set our type if not set
    if ( _category.empty() )
       _category = pose->Category();
+   
+   if ( _causalSmoothType != SMOOTH_TYPE_NONE &&
+      _smoothDomain == SMOOTH_DOMAIN_KEYPOINTS )
+   {
+      SmoothPose( *pose );
+   }
       
    auto it = _frames.emplace( std::make_pair( pose->Timestamp(), std::move( pose ) ) ).first;
 
    DetermineBoneLengths( it );
 }
-void AnimatedRig::DetermineBoneLengths( std::map< int, std::unique_ptr< Pose > >::iterator & poseIt )
+void AnimatedRig::SmoothPose( Pose & pose )
 {
-   // For the first MIN_NUM_FRAMES
-   constexpr int MIN_NUM_FRAMES = 5;
-   if ( _rawBoneLengths[ 0 ].size() < MIN_NUM_FRAMES )
-   {
-      // Generate a RigPose only so we can determine bone lengths
-      (*poseIt).second->GenerateRig();
-      
-      // Ensure the rig is good-to-go.
-      // Note this will only validate the first MIN_NUM_FRAMES for this rig IF successfull
-      if ( !(*poseIt).second->ValidateRig() )
-      {
-         std::stringstream ss;
-         ss << (*poseIt).second->Name() << ": Rig is invalid! This can be caused by bad math, or missing keys in kpDescriptor.json";
-         throw std::runtime_error( ss.str().c_str() );
-      }
+   // Poses back in time are left alone, the filters only move forward
+   if ( _frames.size() && pose.Timestamp() <= (*_frames.rbegin()).first )
+      return;
    
-      int boneIndex = 0;
-      const Rig & rig = (*poseIt).second->RigPose().GetRig();
-      
-      // Bone lengths
-      for ( int i = 0; i < rig.numJointsUsed; ++i )
-      {
-         const Joint & joint = rig.GetJoint( Rig::JOINT_TYPE(i) );
-         _rawBoneLengths[ boneIndex++ ].push_back( joint.length );
-      }
-      
-      // Offset lengths, calculated from vectors
-      for ( int i = 0; i < rig.numJointOffsetsUsed; ++i )
-      {
-         const JointOffset & jointOffset = rig.GetJointOffset( Rig::JOINT_OFFSET_TYPE(i) );
-         _rawBoneLengths[ boneIndex++ ].push_back( Utility::RawToVector( jointOffset ).norm() );
-      }
+   // Reused for every pose, so nothing is allocated once the first has been smoothed
+   std::vector< double > & data = _poseData;
+   data.clear();
+   pose.InputDataToArray( data );
+   
+   // One filter per value of XYZ data, each updated in constant time
+   for ( size_t i = 0; i < data.size(); ++i )
+   {
+      if ( i >= _jointSmoothers.size() )
+         _jointSmoothers.emplace_back( CreateSmoother( _causalSmoothType, CAUSAL_NORMALIZED_FREQUENCY ) );
+      _jointSmoothers[ i ]->AddSample( pose.Timestamp(), data[ i ] );
+      _jointSmoothers[ i ]->Apply( _smoothedSample );
+      if ( _smoothedSample.size() )
+         data[ i ] = _smoothedSample.back();
    }
    
-   // If we haven't calculated our final bone lengths
-   auto it = poseIt;
-   if ( _averagedBoneLengths.size() == 0 )
+   for ( size_t i = 0; i < data.size() / 3; ++i )
+      pose.Keypoint( { data[ i * 3 + 0 ], data[ i * 3 + 1 ], data[ i * 3 + 2 ] }, (int)i );
+}
+void AnimatedRig::BoneLengthFrames( size_t warmupFrames,
+   size_t freezeFrames )
+{
+   _boneLengths.WarmupFrames( warmupFrames );
+   _boneLengths.FreezeFrames( freezeFrames );
+}
+void AnimatedRig::DetermineBoneLengths( std::map< int, std::unique_ptr< Pose > >::iterator & poseIt )
+{
+   // Keypoints the low-pass filter will replace would only be solved again, so those frames are sampled in Write()
+   const bool keypointsReplaced = _smoothDomain == SMOOTH_DOMAIN_KEYPOINTS &&
+      _smoothType != SMOOTH_TYPE_NONE &&
+      _causalSmoothType == SMOOTH_TYPE_NONE;
+   
+   // Until we have enough samples for an estimate, sample every incoming frame.
+   // Afterwards frames are sampled in Write() when their rigs are generated as a block.
+   if ( !_boneLengths.IsWarm() && !keypointsReplaced )
    {
-      // If we have enough data to calculate our average bone lengths
-      if (  _rawBoneLengths[ 0 ].size() == MIN_NUM_FRAMES )
-      {
-         // For every bone
-         for ( auto rawBoneLength : _rawBoneLengths )
-         {
-            // Compute and set the average
-            auto sum = 0.0;
-            for ( auto val : rawBoneLength )
-               sum += val;
-            _averagedBoneLengths.push_back( sum / rawBoneLength.size() );
-         }
-         
-         // Update all existing poses
-         it = _frames.begin();
-      }
+      // Generate a RigPose so we can determine bone lengths; Write() reuses it
+      (*poseIt).second->GenerateRig();
+      SampleBoneLengths( *(*poseIt).second );
    }
 }
-void AnimatedRig::UpdateBoneLengths( std::unique_ptr< Pose > & pose )
+void AnimatedRig::ValidateRigs( const Pose * const * poses,
+   size_t numPoses ) const
 {
-   // If we have our average bone lengths
-   if ( _averagedBoneLengths.size() > 0 )
+   // Ensure the rigs are good-to-go.
+   // Note this will only validate the warm-up frames for this rig IF successfull.
+   // Smoothed rigs no longer match their keypoints, so rigs are validated as they're solved, before smoothing.
+   if ( _boneLengths.IsWarm() )
+      return;
+   for ( size_t i = 0; i < numPoses; ++i )
    {
-      int boneIndex = 0;
-      Rig & rig = pose->RigPose().GetRig();
-
-      // Bone lengths
-      for ( int i = 0; i < rig.numJointsUsed; ++i )
+      const Pose & pose = *poses[ i ];
+      if ( pose.State() == Pose::FRAME_STATE_SOLVED &&
+         !pose.ValidateRig() )
       {
-         Joint & joint = rig.GetJoint( Rig::JOINT_TYPE(i) );
-         joint.length = _averagedBoneLengths[ boneIndex++ ];
-      }
-
-      // Adjusted offsets (calculated from lengths)
-      for ( int i = 0; i < rig.numJointOffsetsUsed; ++i )
-      {
-         JointOffset jointOffset = rig.GetJointOffset( Rig::JOINT_OFFSET_TYPE(i) );
-         Eigen::Vector3d vec = Utility::RawToVector( jointOffset ).normalized();
-         jointOffset = Utility::VectorToRaw( vec * _averagedBoneLengths[ boneIndex++ ] );
+         std::stringstream ss;
+         ss << pose.Name() << ": Rig is invalid! This can be caused by bad math, or missing keys in kpDescriptor.json";
+         throw std::runtime_error( ss.str().c_str() );
       }
    }
 }
+void AnimatedRig::SampleBoneLengths( const Pose & pose )
+{
+   const Pose * poses[] = { &pose };
+   ValidateRigs( poses, 1 );
+   _boneLengths.AddSample( pose.RigPose().GetRig() );
+   _lastSampledTimestamp = std::max( _lastSampledTimestamp, pose.Timestamp() );
+}
+Rig AnimatedRig::PreviewRig( int timestamp )
+{
+   auto it = _frames.find( timestamp );
+   if ( it == _frames.end() )
+      throw std::runtime_error( "No frame to publish at this timestamp" );
+   
+   Rig rig = (*it).second->GenerateRig().GetRig();
+   _boneLengths.Apply( rig );
+   return rig;
+}
+size_t AnimatedRig::MemoryEstimate() const
+{
+   // Each frame is a map node holding a pose, and every pose carries its generated rig
+   const size_t frameSize = sizeof( std::pair< const int, std::unique_ptr< Pose > > ) + 4 * sizeof( void * ) + sizeof( RigPose );
+   return _frames.size() * frameSize +
+      _interpolatedPoses.capacity() * sizeof( RigPose ) +
+      _interpolationRatios.capacity() * sizeof( double );
+}
 void AnimatedRig::FixMissingFrames( int rangeStart,
    int rangeEnd,
    int missingFramesThreshold )
 {
-   int previousTimestamp = rangeStart - 1;
-   
-   auto it = _frames.begin();
-   while ( it != _frames.end() )
+   // A single pass over the range. Inserting into the map doesn't invalidate iterators,
+   // so the previous frame is kept as an iterator and new frames are inserted with a hint.
+   auto it = _frames.lower_bound( rangeStart );
+   auto previousIt = (it == _frames.begin()) ? _frames.end() : std::prev( it );
+   while ( it != _frames.end() && (*it).first <= rangeEnd )
    {
-      auto timestamp = (*it).first;
-      if ( timestamp >= rangeStart &&
-         timestamp <= rangeEnd )
+      // If we missed some frames. If we are missing a bunch at the beginning don't fix anything,
+      // this will be handled by the adjusted bounds
+      if ( previousIt != _frames.end() &&
+         (*it).first - (*previousIt).first > 1 )
       {
-         // See how many frames we are missing
-         int numMissingFrames = timestamp - previousTimestamp - 1;
+         int previousTimestamp = (*previousIt).first;
+         size_t numMissingFrames = (*it).first - previousTimestamp - 1;
          
-         // If we missed some frames
-         if ( numMissingFrames > 0 )
+         // Get the 2 rigs we will interpolate between, making sure to generate rigs
+         // This will be done on the quaternions, not the points
+         const RigPose & lhs = (*previousIt).second->GenerateRig();
+         
+         // Reuse our storage from previous gaps
+         if ( _interpolatedPoses.size() < numMissingFrames )
+            _interpolatedPoses.resize( numMissingFrames );
+         
+         // If we can fix this cleanly
+         if ( numMissingFrames <= (size_t)missingFramesThreshold )
          {
-            // If we are mising a bunch at the beginning
-            if ( previousTimestamp == rangeStart - 1 )
-            {
-               // Don't fix anything, this will be handled by the adjusted bounds               
-               ++it;
-               previousTimestamp = timestamp;
-               continue;
-            }
-            // Else if we can fix this cleanly
-            else if ( numMissingFrames <= missingFramesThreshold )
+            const RigPose & rhs = (*it).second->GenerateRig();
+            
+            // This defines how the lhs and rhs are weighted
+            _interpolationRatios.resize( numMissingFrames );
+            for ( size_t i = 0; i < numMissingFrames; ++i )
+               _interpolationRatios[ i ] = double(i + 1) / (double)(numMissingFrames + 1);
+            
+            lhs.Interpolate( rhs, _interpolationRatios.data(), numMissingFrames, _interpolatedPoses.data() );
+         }
+         // Else too many missing contiguous frames - enter damage control mode!
+         else
+         {
+            // Anything we do may make things worse, so just copy the same frame over and over
+            for ( size_t i = 0; i < numMissingFrames; ++i )
+               _interpolatedPoses[ i ] = lhs;
+         }
+         
+         // Make a pose for each interpolated rig and add it right before the current frame.
+         // Only the first pose goes through the factory, the rest are clones rebuilt from their own rig.
+         const Pose * firstFrame = nullptr;
+         for ( size_t i = 0; i < numMissingFrames; ++i )
+         {
+            RigPose & rigPose = _interpolatedPoses[ i ];
+            rigPose.Timestamp( previousTimestamp + 1 + (int)i );
+            
+            std::unique_ptr< Pose > interpolatedFrame;
+            if ( !firstFrame )
             {
-               // Get the 2 rigs we will interpolate betwen, making sure to generate rigs
-               // This will be done on the quaternions, not the points
-               RigPose & lhs = _frames[ previousTimestamp ]->GenerateRig();
-               const RigPose & rhs = (*it).second->GenerateRig();
-               std::string kpType = (*it).second->KpType();
-
-               // Interpolate frames here
-               for ( int i = 0; i < numMissingFrames; ++i )
-               {
-                  // This defines how the lhs and rhs are weighted
-                  double ratio = double(i + 1) / (double)(numMissingFrames + 1);
-
-                  // Interpolate, make a unique pointer, update the timestamp, add to our list.
-                  // Reset our iterator since we modified the list
-                  std::unique_ptr< RigPose > copy( new RigPose( lhs.Interpolate( rhs, ratio ) ) );
-                  copy->Timestamp( previousTimestamp + 1 + i );
-                  std::unique_ptr< Pose > interpolatedFrame = PoseFactory::FromRigPose( *copy, kpType, (*it).second->KeypointLayout() );
-                  
-                  _frames.emplace( std::make_pair( copy->Timestamp(), std::move( interpolatedFrame ) ) );
-               }
-
-               // Our original iterator is probably invalid, so re-point it here so we can continue iterating
-               it = _frames.find( timestamp );
+               interpolatedFrame = PoseFactory::FromRigPose( rigPose, (*it).second->KpType(), (*it).second->KeypointLayout() );
+               firstFrame = interpolatedFrame.get();
             }
-            // Else too many missing contiguous frames - enter damage control mode!
             else
             {
-               // Get the 2 rigs we will interpolate betwen, making sure to generate rigs
-               // This will be done on the quaternions, not the points
-               RigPose & lhs = _frames[ previousTimestamp ]->GenerateRig();
-               std::string kpType = (*it).second->KpType();
-               
-               // Anything we do may make things worse, so just copy the same frame over and over
-               for ( int i = 0; i < numMissingFrames; ++i )
-               {
-                  // Reset our iterator since we modified the list
-                  std::unique_ptr< RigPose > copy( new RigPose( lhs ) );
-                  copy->Timestamp( previousTimestamp + 1 + i );
-                  std::unique_ptr< Pose > interpolatedFrame = PoseFactory::FromRigPose( *copy, kpType, (*it).second->KeypointLayout() );
-                  _frames.emplace( std::make_pair( copy->Timestamp(), std::move( interpolatedFrame ) ) );
-               }
-               
-               // Our original iterator is probably invalid, so re-point it here so we can continue iterating
-               it = _frames.find( timestamp );
+               interpolatedFrame.reset( firstFrame->Clone() );
+               interpolatedFrame->FromRigPose( rigPose );
             }
+            
+            _frames.emplace_hint( it, rigPose.Timestamp(), std::move( interpolatedFrame ) );
          }
       }
       
+      previousIt = it;
       ++it;
-      previousTimestamp = timestamp;
    }
 }
+int AnimatedRig::PreRollFrames( SMOOTH_TYPE type,
+   size_t boneWarmupFrames )
+{
+   const bool smoothing = type != SMOOTH_TYPE_NONE && type != SMOOTH_TYPE_UNKNOWN;
+   return (smoothing ? NUM_TAPS : 0) + (int)boneWarmupFrames;
+}
+int AnimatedRig::SmoothDelayFrames( SMOOTH_TYPE type,
+   SMOOTH_DOMAIN domain )
+{
+   // Causal filters don't look ahead
+   if ( type == SMOOTH_TYPE_NONE ||
+      type == SMOOTH_TYPE_UNKNOWN ||
+      SmoothFactory::IsCausal( type ) )
+      return 0;
+   auto filter = SmoothFactory::Create( type );
+   if ( !filter )
+      return 0;
+   filter->Initialize( NUM_TAPS, 1./10. );
+   
+   // Keypoints, then the rolls of the rigs solved from them, are filtered one after the other
+   const int numFilters = domain == SMOOTH_DOMAIN_KEYPOINTS ? 2 : 1;
+   return numFilters * filter->GetSampleShift();
+}
+void AnimatedRig::Save( CheckpointWriter & ref_checkpoint ) const
+{
+   ref_checkpoint.Write( _category );
+   ref_checkpoint.Write( _lastSampledTimestamp );
+   ref_checkpoint.Write( _smoothedTimestamp );
+   _boneLengths.Save( ref_checkpoint );
+   
+   // Each pending frame as its input data, which is all a pose needs to generate its rig again
+   std::vector< double > data;
+   ref_checkpoint.Write( (uint64_t)_frames.size() );
+   for ( const auto & frame : _frames )
+   {
+      Pose & pose = *frame.second;
+      ref_checkpoint.Write( pose.KpType() );
+      ref_checkpoint.Write( (uint64_t)pose.KeypointLayout().size() );
+      for ( const auto & keypoint : pose.KeypointLayout() )
+      {
+         ref_checkpoint.Write( keypoint.first );
+         ref_checkpoint.Write( keypoint.second );
+      }
+      ref_checkpoint.Write( pose.Name() );
+      ref_checkpoint.Write( pose.Timestamp() );
+      ref_checkpoint.Write( pose.CoordinateSystem() );
+      data.clear();
+      pose.InputDataToArray( data );
+      ref_checkpoint.Write( data );
+   }
+   
+   ref_checkpoint.Write( (uint64_t)_jointSmoothers.size() );
+   for ( const auto & smoother : _jointSmoothers )
+      smoother->Save( ref_checkpoint );
+   ref_checkpoint.Write( (uint64_t)_boneRollSmoothers.size() );
+   for ( const auto & smoother : _boneRollSmoothers )
+      smoother->Save( ref_checkpoint );
+   ref_checkpoint.Write( _lastRotations );
+}
+void AnimatedRig::Restore( CheckpointReader & ref_checkpoint,
+   SMOOTH_TYPE smoothType )
+{
+   ref_checkpoint.Read( _category );
+   ref_checkpoint.Read( _lastSampledTimestamp );
+   ref_checkpoint.Read( _smoothedTimestamp );
+   _boneLengths.Restore( ref_checkpoint );
+   
+   _frames.clear();
+   std::vector< double > data;
+   const size_t numFrames = (size_t)ref_checkpoint.Read< uint64_t >();
+   for ( size_t i = 0; i < numFrames; ++i )
+   {
+      const std::string kpType = ref_checkpoint.Read< std::string >();
+      std::map< KEYPOINT_TYPE, int > layout;
+      const size_t layoutSize = (size_t)ref_checkpoint.Read< uint64_t >();
+      for ( size_t j = 0; j < layoutSize; ++j )
+      {
+         const KEYPOINT_TYPE type = ref_checkpoint.Read< KEYPOINT_TYPE >();
+         layout[ type ] = ref_checkpoint.Read< int >();
+      }
+      
+      std::unique_ptr< Pose > pose = PoseFactory::Create( kpType, layout );
+      pose->Name( ref_checkpoint.Read< std::string >() );
+      pose->Timestamp( ref_checkpoint.Read< int >() );
+      pose->CoordinateSystem( ref_checkpoint.Read< std::array< double, 3 > >() );
+      ref_checkpoint.Read( data );
+      if ( data.size() != pose->InputDataSize() )
+         throw std::runtime_error( "Checkpoint has the wrong number of keypoints for '" + kpType + "'" );
+      for ( size_t j = 0; j < data.size() / 3; ++j )
+         pose->Keypoint( { data[ j * 3 + 0 ], data[ j * 3 + 1 ], data[ j * 3 + 2 ] }, (int)j );
+      
+      const int timestamp = pose->Timestamp();
+      _frames.emplace( timestamp, std::move( pose ) );
+   }
+   
+   // Filters carry on from where they were saved
+   auto restoreSmoothers = [&]( std::vector< std::unique_ptr< Smooth > > & ref_smoothers, SMOOTH_TYPE type )
+   {
+      ref_smoothers.clear();
+      const size_t numSmoothers = (size_t)ref_checkpoint.Read< uint64_t >();
+      for ( size_t i = 0; i < numSmoothers; ++i )
+      {
+         auto filter = SmoothFactory::Create( type );
+         if ( !filter )
+            throw std::runtime_error( "Failed to instantiate " + SmoothFactory::SmoothType( type ) + " to restore a checkpoint" );
+         filter->Restore( ref_checkpoint );
+         ref_smoothers.emplace_back( std::move( filter ) );
+      }
+   };
+   restoreSmoothers( _jointSmoothers, _causalSmoothType != SMOOTH_TYPE_NONE ? _causalSmoothType : smoothType );
+   restoreSmoothers( _boneRollSmoothers, smoothType );
+   ref_checkpoint.Read( _lastRotations );
+}
 void AnimatedRig::SmoothFrames( SMOOTH_TYPE type,
    int & rangeStart,
    int & rangeEnd,
@@ -200,6 +356,20 @@ void AnimatedRig::SmoothFrames( SMOOTH_TYPE type,
       return;
    }
    
+   // Rotations are smoothed here whatever the type, in one pass after solving each frame once
+   if ( _smoothDomain == SMOOTH_DOMAIN_ROTATIONS )
+   {
+      SmoothAllRotations( type,
+         rangeStart,
+         rangeEnd,
+         flush );
+      return;
+   }
+   
+   // Causal types smoothed the keypoints as poses were added
+   if ( SmoothFactory::IsCausal( type ) )
+      return;
+   
    // Filter XYZ data first, ensuring new rigs are generated for each filtered frame
    SmoothAllKeypoints( type,
       rangeStart,
@@ -220,9 +390,6 @@ void AnimatedRig::SmoothAllKeypoints( SMOOTH_TYPE type,
    // Derived from data analysis, this is the smooth factor
    const double NORMALIZED_FREQUENCY = 1./10.;
 
-   int actualRangeStart = rangeEnd + 1;
-   int actualRangeEnd = rangeStart - 1;
-   
    // Sanity checks
    if ( !_frames.size() )
       return;
@@ -235,95 +402,81 @@ void AnimatedRig::SmoothAllKeypoints( SMOOTH_TYPE type,
    }
 
    // -------------------------------------------------
-   // ITERATION 1: Add original XYZ samples from every frame
+   // ITERATION 1: Add original XYZ samples from every frame not added yet, up to the end of the range and the frames
+   // after it needed to smooth the end of the range (everything, if flushing)
    // -------------------------------------------------
-   for ( const auto & frame : _frames )
+   const int lastTimestamp = flush ? INT_MAX : rangeEnd + SmoothDelayFrames( type, _smoothDomain );
+   int numAdded = 0;
+   for ( auto it = _frames.upper_bound( _smoothedTimestamp ); it != _frames.end() && (*it).first <= lastTimestamp; ++it )
    {
-      auto timestamp = frame.first;
-      if ( timestamp >= rangeStart &&
-         timestamp <= rangeEnd )
-      {
-         // Keep track of actual timestamps
-         if ( timestamp < actualRangeStart )
-            actualRangeStart = timestamp;
-         if ( timestamp > actualRangeEnd )
-            actualRangeEnd = timestamp;
-            
-         // Get the input XYZ data, serialized
-         std::vector< double > data;
-         frame.second->InputDataToArray( data );
+      auto timestamp = (*it).first;
+         
+      // Get the input XYZ data, serialized
+      std::vector< double > data;
+      (*it).second->InputDataToArray( data );
 
-         // For every value in the XYZ data
-         for ( size_t i = 0; i < data.size(); ++i )
+      // For every value in the XYZ data
+      for ( size_t i = 0; i < data.size(); ++i )
+      {
+         // Lazy initialization of an LPF object
+         if ( i >= _jointSmoothers.size() )
          {
-            // Lazy initialization of an LPF object
-            if ( i >= _jointSmoothers.size() )
+            auto filter = SmoothFactory::Create( type );
+            if ( !filter )
             {
-               auto filter = SmoothFactory::Create( type );
-               if ( !filter )
-               {
-                  return;
-               }
-               filter->Initialize( NUM_TAPS, NORMALIZED_FREQUENCY );
-               _jointSmoothers.emplace_back( std::move(filter) );
+               return;
             }
-            _jointSmoothers[ i ]->AddSample( timestamp, data[ i ] );
+            filter->Initialize( NUM_TAPS, NORMALIZED_FREQUENCY );
+            _jointSmoothers.emplace_back( std::move(filter) );
          }
+         _jointSmoothers[ i ]->AddSample( timestamp, data[ i ] );
       }
+      _smoothedTimestamp = timestamp;
+      ++numAdded;
    }
+   
+   // Nothing filtered, so no rolls to filter either
+   rangeEnd = rangeStart - 1;
+   if ( !_jointSmoothers.size() ||
+      (!numAdded && !flush) )
+      return;
 
-   if ( actualRangeEnd - actualRangeStart > 0 )
+   // -------------------------------------------------
+   // ITERATION 2: Filter XYZ samples
+   // -------------------------------------------------
+   std::vector< std::vector< double > > filteredValues( _jointSmoothers.size() );
+   for ( int i = 0; i < (int)_jointSmoothers.size(); ++i )
    {
-      // -------------------------------------------------
-      // ITERATION 2: Filter XYZ samples
-      // -------------------------------------------------
-      std::vector< std::vector< double > > filteredValues( _jointSmoothers.size() );
-      for ( int i = 0; i < (int)_jointSmoothers.size(); ++i )
-      {
-         // Apply our filter across all the values we grabbed.
-         // Notice rangeStart and actualNumValues will be set multiple times, which is okay since values remain constant
-         // across all joints.
-         rangeStart = _jointSmoothers[i]->Apply( filteredValues[i], flush );
-         rangeEnd = rangeStart + (int)filteredValues[i].size();
-      }
-
-      // -------------------------------------------------
-      // ITERATION 3: Create new poses from filtered values
-      // -------------------------------------------------
-      std::map< int, std::unique_ptr< Pose > > filteredFrames;
-      for ( int frameIndex = 0; frameIndex < (int)filteredValues.back().size(); ++frameIndex )
-      {
-         // Get the unfiltered rig
-         auto & unfilteredPose = _frames.at( actualRangeStart + frameIndex );
-         
-         // Create a new Pose with our adjusted timestamp and a copy of the original data.
-         Pose * filteredPose = unfilteredPose->Clone();
-         filteredPose->Timestamp( rangeStart + frameIndex );
+      // Apply our filter across all the values we grabbed.
+      // Notice rangeStart will be set multiple times, which is okay since it remains constant across all joints.
+      rangeStart = _jointSmoothers[i]->Apply( filteredValues[i], flush );
+   }
+   const size_t numFilteredFrames = filteredValues.back().size();
+   rangeEnd = rangeStart + (int)numFilteredFrames - 1;
 
-         // For every joint in the rig
-         for ( int i = 0; i < (int)filteredValues.size() / 3; ++i )
-         {
-            std::array< double, 3 > value =
-            {
-               filteredValues[ i * 3 + 0 ][ frameIndex ],
-               filteredValues[ i * 3 + 1 ][ frameIndex ],
-               filteredValues[ i * 3 + 2 ][ frameIndex ]
-            };
-            
-            // Set our filtered value on each rotation component
-            filteredPose->Keypoint( value, i );
-         }
-   
-         // Generate a rig since this filtered frame only has XYZ data
-         filteredPose->GenerateRig();
-         
-         // Add this rig frame to our filtered frames map
-         filteredFrames.emplace( std::make_pair( filteredPose->Timestamp(), std::move(filteredPose) ) );
-      }
-      
-      // Now replace our unfiltered frames with filtered frames
-      _frames = std::move( filteredFrames );
+   // -------------------------------------------------
+   // ITERATION 3: Replace the keypoints of the frames the filtered values are for
+   // -------------------------------------------------
+   // Each frame keeps its pose, with the filtered keypoints set on it, and the whole block is solved at once.
+   // Frames already written, or missing ones FixMissingFrames() fills in later, have no pose to take their values.
+   std::vector< Pose * > filteredBlock;
+   std::vector< std::vector< double > > filteredChannels( filteredValues.size() );
+   for ( int frameIndex = 0; frameIndex < (int)numFilteredFrames; ++frameIndex )
+   {
+      auto it = _frames.find( rangeStart + frameIndex );
+      if ( it == _frames.end() )
+         continue;
+      filteredBlock.push_back( (*it).second.get() );
+      for ( size_t i = 0; i < filteredValues.size(); ++i )
+         filteredChannels[ i ].push_back( filteredValues[ i ][ frameIndex ] );
    }
+   
+   // Set the filtered keypoints and generate rigs, since the filtered frames only have XYZ data
+   RigSolver::Solve( filteredBlock.data(),
+      filteredBlock.size(),
+      filteredChannels,
+      _solverThreads );
+   ValidateRigs( filteredBlock.data(), filteredBlock.size() );
 }
 void AnimatedRig::SmoothAllBoneRolls( SMOOTH_TYPE type,
    int rangeStart,
@@ -333,113 +486,258 @@ void AnimatedRig::SmoothAllBoneRolls( SMOOTH_TYPE type,
    // Derived from data analysis, this is the smooth factor
    const double NORMALIZED_FREQUENCY = 1./10.;
 
-   int actualRangeStart = rangeEnd + 1;
-   int actualRangeEnd = rangeStart - 1;
-   
    // Sanity check
    if ( !_frames.size() )
       return;
       
-   // We only care about joints with more than 1 degree of freedom:
-   //   - hip roll (where the knee points)
-   //   - shoulder roll (where the elbow points)
-   const std::vector< Rig::JOINT_TYPE > jointsWithRoll =
-   {
-      Rig::LHIP,
-      Rig::RHIP,
-      Rig::LSHOULDER,
-      Rig::RSHOULDER
-   };
+   // We only care about joints with more than 1 degree of freedom
+   const std::array< Rig::JOINT_TYPE, 4 > & jointsWithRoll = JOINTS_WITH_ROLL;
 
    // -------------------------------------------------
    // ITERATION 1: Add bone roll samples from every frame
    //
+   // The range is the frames whose keypoints were just filtered, so each frame is only added once
    // -------------------------------------------------
-   for ( const auto & frame : _frames )
+   int numAdded = 0;
+   for ( auto it = _frames.lower_bound( rangeStart ); it != _frames.end() && (*it).first <= rangeEnd; ++it )
    {
-      auto timestamp = frame.first;
-      if ( timestamp >= rangeStart &&
-         timestamp <= rangeEnd )
-      {
-         // Keep track of actual timestamps
-         if ( timestamp < actualRangeStart )
-            actualRangeStart = timestamp;
-         if ( timestamp > actualRangeEnd )
-            actualRangeEnd = timestamp;
+      auto timestamp = (*it).first;
             
-         // Get the rig for this pose
-         const Rig & rig = frame.second->RigPose().GetRig();
+      // Get the rig for this pose
+      const Rig & rig = (*it).second->RigPose().GetRig();
 
-         // For every roll value in the specified joints
-         for ( size_t i = 0; i < jointsWithRoll.size(); ++i )
+      // For every roll value in the specified joints
+      for ( size_t i = 0; i < jointsWithRoll.size(); ++i )
+      {
+         // Lazy initialization of an LPF object
+         if ( i >= _boneRollSmoothers.size() )
          {
-            // Lazy initialization of an LPF object
-            if ( i >= _boneRollSmoothers.size() )
-            {
-               auto filter = SmoothFactory::Create( type );
-               filter->Initialize( NUM_TAPS, NORMALIZED_FREQUENCY );
-               _boneRollSmoothers.emplace_back( std::move(filter) );
-            }
-            _boneRollSmoothers[ i ]->AddSample( timestamp, rig.GetJoint( jointsWithRoll[ i ] ).roll );
+            auto filter = SmoothFactory::Create( type );
+            filter->Initialize( NUM_TAPS, NORMALIZED_FREQUENCY );
+            _boneRollSmoothers.emplace_back( std::move(filter) );
          }
+         _boneRollSmoothers[ i ]->AddSample( timestamp, rig.GetJoint( jointsWithRoll[ i ] ).roll );
       }
+      ++numAdded;
+   }
+
+   if ( !_boneRollSmoothers.size() ||
+      (!numAdded && !flush) )
+      return;
+
+   // -------------------------------------------------
+   // ITERATION 2: Filter samples
+   // -------------------------------------------------
+   std::vector< std::vector< double > > filteredValues( _boneRollSmoothers.size() );
+   int firstTimestamp = rangeStart;
+   for ( int i = 0; i < (int)_boneRollSmoothers.size(); ++i )
+      firstTimestamp = _boneRollSmoothers[i]->Apply( filteredValues[i], flush );
+   
+   // The frames the filtered rolls are for, leaving out any already written
+   std::vector< Pose * > poses;
+   std::vector< size_t > indices;
+   for ( size_t frameIndex = 0; frameIndex < filteredValues.back().size(); ++frameIndex )
+   {
+      auto it = _frames.find( firstTimestamp + (int)frameIndex );
+      if ( it == _frames.end() )
+         continue;
+      poses.push_back( (*it).second.get() );
+      indices.push_back( frameIndex );
    }
 
-   if ( actualRangeEnd - actualRangeStart > 0 )
-   {
-      // Determine how much output space we need for filtered values, accounting for additional frames if flushing.
-      // Also account for time shift.
-      size_t expectedNumValues = actualRangeEnd - actualRangeStart + 1;
-      //size_t actualNumValues = 0;
-      rangeEnd -= _boneRollSmoothers[ 0 ]->GetSampleShift();
-      if ( flush )
+   // -------------------------------------------------
+   // ITERATION 3: Apply the filtered roll
+   //
+   // Done one joint at a time across every frame, as a batch of quaternions
+   // -------------------------------------------------
+   const size_t numFrames = poses.size();
+   QuaternionBatch::QuaternionBuffer rotations( numFrames ), rolls( numFrames );
+   for ( int i = 0; i < (int)filteredValues.size(); ++i )
+   {
+      // Get the original rotation, and un-apply the roll since it's baked into the original rotation
+      for ( size_t frameIndex = 0; frameIndex < numFrames; ++frameIndex )
       {
-         expectedNumValues += _jointSmoothers[ 0 ]->GetSampleShift();
-         rangeEnd += _boneRollSmoothers[ 0 ]->GetSampleShift();
+         const Joint & joint = poses[ frameIndex ]->RigPose().GetRig().GetJoint( jointsWithRoll[ i ] );
+         rotations.Set( frameIndex, joint.quaternion );
+         rolls.Set( frameIndex, Utility::QuaternionToRaw( Eigen::Quaterniond( Eigen::AngleAxisd( joint.roll, Eigen::Vector3d::UnitY() ).inverse() ) ) );
       }
-
-      // -------------------------------------------------
-      // ITERATION 2: Filter samples
-      // -------------------------------------------------
-      std::vector< std::vector< double > > filteredValues( _boneRollSmoothers.size() );
-      for ( int i = 0; i < (int)_boneRollSmoothers.size(); ++i )
+      QuaternionBatch::Multiply( rotations.View(), rolls.View(), rotations.View(), numFrames );
+      
+      // Now apply the filtered roll
+      for ( size_t frameIndex = 0; frameIndex < numFrames; ++frameIndex )
+         rolls.Set( frameIndex, Utility::QuaternionToRaw( Eigen::Quaterniond( Eigen::AngleAxisd( filteredValues[ i ][ indices[ frameIndex ] ], Eigen::Vector3d::UnitY() ) ) ) );
+      QuaternionBatch::Multiply( rotations.View(), rolls.View(), rotations.View(), numFrames );
+      
+      for ( size_t frameIndex = 0; frameIndex < numFrames; ++frameIndex )
       {
-         // Apply our filter across all the values we grabbed.
-         // Notice rangeStart and actualNumValues will be set multiple times, which is okay since values remain constant
-         // across all joints.
-         rangeStart = _boneRollSmoothers[i]->Apply( filteredValues[i], flush );
-         rangeEnd = rangeStart + (int)filteredValues[i].size();
+         Pose & pose = *poses[ frameIndex ];
+         Joint & joint = pose.RigPose().GetRig().GetJoint( jointsWithRoll[ i ] );
+         joint.roll = filteredValues[ i ][ indices[ frameIndex ] ];
+         joint.quaternion = rotations.Get( frameIndex );
+         pose.State( Pose::FRAME_STATE_SMOOTHED );
       }
+   }
+}
+void AnimatedRig::SmoothAllRotations( SMOOTH_TYPE type,
+   int & rangeStart,
+   int & rangeEnd,
+   bool flush )
+{
+   // Same smooth factors as for keypoints
+   const bool causal = SmoothFactory::IsCausal( type );
+   const double NORMALIZED_FREQUENCY = causal ? CAUSAL_NORMALIZED_FREQUENCY : 1./10.;
 
-      // -------------------------------------------------
-      // ITERATION 3: Apply the filtered roll
-      // -------------------------------------------------
-      for ( int frameIndex = 0; frameIndex < (int)filteredValues.back().size(); ++frameIndex )
+   // Sanity checks
+   if ( !_frames.size() )
+      return;
+   {
+      auto filter = SmoothFactory::Create( type );
+      if ( !filter )
       {
-         // Get the rig
-         auto & rig = _frames.at( actualRangeStart + frameIndex )->RigPose().GetRig();
-
-         // For every specific joint in the rig
-         for ( int i = 0; i < (int)filteredValues.size(); ++i )
+         throw std::runtime_error( "Failed to instantiate " + SmoothFactory::SmoothType( type ) + "; try --smooth=none" );
+      }
+   }
+   
+   // -------------------------------------------------
+   // ITERATION 1: Solve every frame not added yet, once, up to the end of the range and the frames after it needed
+   // to smooth the end of the range (everything, if flushing)
+   // -------------------------------------------------
+   const int lastTimestamp = flush ? INT_MAX : rangeEnd + SmoothDelayFrames( type, _smoothDomain );
+   std::vector< Pose * > block;
+   for ( auto it = _frames.upper_bound( _smoothedTimestamp ); it != _frames.end() && (*it).first <= lastTimestamp; ++it )
+      block.push_back( (*it).second.get() );
+   {
+      static Histogram & solveTime = Metrics::Instance().GetTimer( "kp2rig_solve_seconds" );
+      ScopedHistogramTimer timer( solveTime );
+      RigSolver::Solve( block.data(), block.size(), _solverThreads );
+   }
+   ValidateRigs( block.data(), block.size() );
+   
+   // -------------------------------------------------
+   // ITERATION 2: Add root location, joint rotation and roll samples from every frame
+   //
+   // A rotation and its negative are the same rotation, so each one is flipped to the side of the last,
+   // which keeps every quaternion component continuous to filter
+   // -------------------------------------------------
+   std::vector< double > samples;
+   for ( auto pose : block )
+   {
+      const int timestamp = pose->Timestamp();
+      _smoothedTimestamp = timestamp;
+      
+      const Rig & rig = pose->RigPose().GetRig();
+      samples.assign( rig.location.begin(), rig.location.end() );
+      if ( _lastRotations.empty() )
+      {
+         for ( int j = 0; j < rig.numJointsUsed; ++j )
+            _lastRotations.push_back( rig.GetJoint( Rig::JOINT_TYPE(j) ).quaternion );
+      }
+      for ( int j = 0; j < rig.numJointsUsed && j < (int)_lastRotations.size(); ++j )
+      {
+         std::array< double, 4 > rotation = rig.GetJoint( Rig::JOINT_TYPE(j) ).quaternion;
+         std::array< double, 4 > & lastRotation = _lastRotations[ j ];
+         const double d = rotation[ 0 ] * lastRotation[ 0 ] + rotation[ 1 ] * lastRotation[ 1 ] +
+            rotation[ 2 ] * lastRotation[ 2 ] + rotation[ 3 ] * lastRotation[ 3 ];
+         if ( d < 0 )
          {
-            // Get the joint
-            Joint & joint = rig.GetJoint( jointsWithRoll[ i ] );
-            
-            // Get the original rotation
-            Eigen::Quaterniond rotation( Utility::RawToQuaternion( joint.quaternion ) );
-            
-            // Un-apply the roll, since it's baked into the original rotation
-            rotation = rotation * Eigen::AngleAxisd( joint.roll, Eigen::Vector3d::UnitY() ).inverse();
-            
-            // Now apply the filtered roll
-            joint.roll = filteredValues[ i ][ frameIndex ];
-            rotation = rotation * Eigen::AngleAxisd( joint.roll, Eigen::Vector3d::UnitY() );
-            joint.quaternion = Utility::QuaternionToRaw( rotation );
+            for ( auto & value : rotation )
+               value = -value;
          }
+         lastRotation = rotation;
+         samples.insert( samples.end(), rotation.begin(), rotation.end() );
+      }
+      for ( auto jointType : JOINTS_WITH_ROLL )
+      {
+         if ( jointType < rig.numJointsUsed )
+            samples.push_back( rig.GetJoint( jointType ).roll );
+      }
+      
+      for ( size_t i = 0; i < samples.size(); ++i )
+      {
+         // Lazy initialization of a filter object
+         if ( i >= _jointSmoothers.size() )
+            _jointSmoothers.emplace_back( CreateSmoother( type, NORMALIZED_FREQUENCY ) );
+         _jointSmoothers[ i ]->AddSample( timestamp, samples[ i ] );
+      }
+   }
+   
+   // Causal filters have nothing left to hand back when flushing
+   rangeEnd = rangeStart - 1;
+   if ( !_jointSmoothers.size() ||
+      (block.empty() && (!flush || causal)) )
+      return;
+   
+   // -------------------------------------------------
+   // ITERATION 3: Filter samples
+   // -------------------------------------------------
+   std::vector< std::vector< double > > filteredValues( _jointSmoothers.size() );
+   for ( int i = 0; i < (int)_jointSmoothers.size(); ++i )
+      rangeStart = _jointSmoothers[i]->Apply( filteredValues[i], flush );
+   const size_t numFilteredValues = filteredValues.back().size();
+   rangeEnd = rangeStart + (int)numFilteredValues - 1;
+
+   // -------------------------------------------------
+   // ITERATION 4: Put the filtered values back in the rigs
+   // -------------------------------------------------
+   // As for keypoints, each frame the filtered values are for takes them, leaving out any already written.
+   // Frames restored from a checkpoint since they were added have to be solved again first.
+   std::vector< Pose * > filteredPoses;
+   std::vector< size_t > indices;
+   for ( size_t valueIndex = 0; valueIndex < numFilteredValues; ++valueIndex )
+   {
+      auto it = _frames.find( rangeStart + (int)valueIndex );
+      if ( it == _frames.end() )
+         continue;
+      filteredPoses.push_back( (*it).second.get() );
+      indices.push_back( valueIndex );
+   }
+   const size_t numFilteredFrames = filteredPoses.size();
+   RigSolver::Solve( filteredPoses.data(), numFilteredFrames, _solverThreads );
+   
+   std::vector< RigPose * > filteredBlock( numFilteredFrames );
+   for ( size_t frameIndex = 0; frameIndex < numFilteredFrames; ++frameIndex )
+   {
+      Pose & pose = *filteredPoses[ frameIndex ];
+      const size_t valueIndex = indices[ frameIndex ];
+      Rig & rig = pose.RigPose().GetRig();
+      rig.location = { filteredValues[ 0 ][ valueIndex ], filteredValues[ 1 ][ valueIndex ], filteredValues[ 2 ][ valueIndex ] };
+      size_t channel = 3 + 4 * _lastRotations.size();
+      for ( auto jointType : JOINTS_WITH_ROLL )
+      {
+         if ( jointType < rig.numJointsUsed )
+            rig.GetJoint( jointType ).roll = filteredValues[ channel++ ][ valueIndex ];
       }
+      
+      filteredBlock[ frameIndex ] = &pose.RigPose();
+      pose.State( Pose::FRAME_STATE_SMOOTHED );
    }
+   
+   // Filtered quaternions are no longer unit length, and are put back on the side the solver chose
+   QuaternionBatch::QuaternionBuffer rotations( numFilteredFrames );
+   for ( size_t j = 0; j < _lastRotations.size(); ++j )
+   {
+      const QuaternionBatch::Quaternions view = rotations.View();
+      for ( size_t frameIndex = 0; frameIndex < numFilteredFrames; ++frameIndex )
+      {
+         view.x[ frameIndex ] = filteredValues[ 3 + j * 4 + 0 ][ indices[ frameIndex ] ];
+         view.y[ frameIndex ] = filteredValues[ 3 + j * 4 + 1 ][ indices[ frameIndex ] ];
+         view.z[ frameIndex ] = filteredValues[ 3 + j * 4 + 2 ][ indices[ frameIndex ] ];
+         view.w[ frameIndex ] = filteredValues[ 3 + j * 4 + 3 ][ indices[ frameIndex ] ];
+      }
+      QuaternionBatch::Normalize( view, view, numFilteredFrames );
+      for ( size_t frameIndex = 0; frameIndex < numFilteredFrames; ++frameIndex )
+      {
+         std::array< double, 4 > & rotation = filteredBlock[ frameIndex ]->GetRig().GetJoint( Rig::JOINT_TYPE(j) ).quaternion;
+         const std::array< double, 4 > filtered = rotations.Get( frameIndex );
+         const double d = rotation[ 0 ] * filtered[ 0 ] + rotation[ 1 ] * filtered[ 1 ] +
+            rotation[ 2 ] * filtered[ 2 ] + rotation[ 3 ] * filtered[ 3 ];
+         for ( int i = 0; i < 4; ++i )
+            rotation[ i ] = d < 0 ? -filtered[ i ] : filtered[ i ];
+      }
+   }
+   RigPose::UpdateAbsRotations( filteredBlock.data(), numFilteredFrames );
 }
-int AnimatedRig::Write( nlohmann::json & json,
+int AnimatedRig::Write( RigFileWriter & ref_file,
    int startTimestamp,
    int endTimestamp )
 {
@@ -458,6 +756,36 @@ int AnimatedRig::Write( nlohmann::json & json,
    // Allocate a big buffer for the compressed data
    std::vector< uint8_t > buffer1( maxNumFrames * Rig::MAX_ROTATIONS_DIMENSION * sizeof(double) );
    
+   // Generate the final rigs we haven't already as a single block
+   std::vector< Pose * > block;
+   block.reserve( maxNumFrames );
+   for ( auto & frame : _frames )
+   {
+      if ( frame.first > endTimestamp )
+         break;
+      if ( frame.first >= startTimestamp )
+         block.push_back( frame.second.get() );
+   }
+   {
+      static Histogram & solveTime = Metrics::Instance().GetTimer( "kp2rig_solve_seconds" );
+      ScopedHistogramTimer timer( solveTime );
+      RigSolver::Solve( block.data(), block.size(), _solverThreads );
+   }
+   
+   // Feed frames we haven't seen yet to the bone length estimate, then apply it to the whole block
+   for ( auto pose : block )
+   {
+      if ( pose->Timestamp() > _lastSampledTimestamp )
+         SampleBoneLengths( *pose );
+   }
+   static Counter & framesWritten = Metrics::Instance().GetCounter( "kp2rig_frames_written_total" );
+   for ( auto pose : block )
+   {
+      _boneLengths.Apply( pose->RigPose().GetRig() );
+      pose->State( Pose::FRAME_STATE_FINAL );
+   }
+   framesWritten.Add( block.size() );
+   
    // For every frame in this animated character
    auto it = _frames.begin();
    while ( it != _frames.end() )
@@ -475,12 +803,6 @@ int AnimatedRig::Write( nlohmann::json & json,
          // we only need one set
          lengths.clear();
 
-         // Set average bone lengths
-         UpdateBoneLengths( pose );
-         
-         // Generate the final rig if we haven't already (expecting it to check internally)
-         pose->GenerateRig();
-         
          // Update internal values if needed
          if ( numJointRotationsPerFrame == 0 )
             numJointRotationsPerFrame = pose->RigPose().GetRig().numJointsUsed;
@@ -513,8 +835,13 @@ int AnimatedRig::Write( nlohmann::json & json,
    }
    
    std::vector< unsigned char > base64Data;
+   static Histogram & compressTime = Metrics::Instance().GetTimer( "kp2rig_compress_seconds" );
+   static Counter & uncompressedBytes = Metrics::Instance().GetCounter( "kp2rig_compress_input_bytes_total" );
+   static Counter & compressedBytes = Metrics::Instance().GetCounter( "kp2rig_compress_output_bytes_total" );
+   ScopedHistogramTimer timer( compressTime );
+   uncompressedBytes.Add( (locations.size() + lengths.size() + rotations.size() + offsets.size()) * sizeof(double) );
    
-   // Compress the position data, encode to base64, and set to json
+   // Compress the position data, encode to base64, and write it to the file
    if ( locations.size() )
    {
       size_t bufferSize = locations.size() * sizeof(double);
@@ -525,7 +852,8 @@ int AnimatedRig::Write( nlohmann::json & json,
       bufferSize = Compression::EncodeBase64( &buffer1[0],
          bufferSize,
          base64Data );
-      json["loc"] = std::string( reinterpret_cast< char * >(&base64Data[0]), bufferSize );
+      compressedBytes.Add( bufferSize );
+      ref_file.Field( "loc", &base64Data[0], bufferSize );
    }
 
    if ( lengths.size() )
@@ -539,8 +867,9 @@ int AnimatedRig::Write( nlohmann::json & json,
       bufferSize = Compression::EncodeBase64( &buffer1[0],
          bufferSize,
          base64Data );
-      json["boneLen"] = std::string( reinterpret_cast< char * >(&base64Data[0]), bufferSize );
-      json["numLen"] = lengths.size();
+      compressedBytes.Add( bufferSize );
+      ref_file.Field( "boneLen", &base64Data[0], bufferSize );
+      ref_file.Field( "numLen", (int)lengths.size() );
    }
 
    if ( rotations.size() )
@@ -554,8 +883,9 @@ int AnimatedRig::Write( nlohmann::json & json,
       bufferSize = Compression::EncodeBase64( &buffer1[0],
          bufferSize,
          base64Data );
-      json["boneRot"] = std::string( reinterpret_cast< char * >(&base64Data[0]), bufferSize );
-      json["numRot"] = numJointRotationsPerFrame;
+      compressedBytes.Add( bufferSize );
+      ref_file.Field( "boneRot", &base64Data[0], bufferSize );
+      ref_file.Field( "numRot", numJointRotationsPerFrame );
    }
 
    if ( offsets.size() )
@@ -569,8 +899,9 @@ int AnimatedRig::Write( nlohmann::json & json,
       bufferSize = Compression::EncodeBase64( &buffer1[0],
          bufferSize,
          base64Data );
-      json["boneOff"] = std::string( reinterpret_cast< char * >(&base64Data[0]), bufferSize );
-      json["numOff"] = numJointOffsetsPerFrame;
+      compressedBytes.Add( bufferSize );
+      ref_file.Field( "boneOff", &base64Data[0], bufferSize );
+      ref_file.Field( "numOff", numJointOffsetsPerFrame );
    }
    
    return lastTimestamp;
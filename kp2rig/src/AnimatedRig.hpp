@@ -3,9 +3,13 @@
 
 #include <stdio.h>
 #include <map>
+#include <climits>
 #include "Pose.hpp"
-#include <json.hpp>
+#include "RigPose.hpp"
+#include "BoneLengthEstimator.hpp"
 #include "SmoothFactory.hpp"
+#include "RigFileWriter.hpp"
+#include "Checkpoint.hpp"
 
 class AnimatedRig
 {
@@ -19,21 +23,73 @@ public:
       int rangeEnd,
       int missingFramesThreshold );
    std::string Category() const { return _category; }
+   
+   // A preview of the rig for the frame at @timestamp: solved from its keypoints as they are now, with the current bone
+   // length estimate. Only causal smoothing (one_euro) has been applied, so it can differ from the rig written later.
+   // Generates the frame's rig if it hasn't been already; with lpf_ipp on keypoints, that rig is solved again after smoothing.
+   Rig PreviewRig( int timestamp );
+   
+   // Rough number of bytes held by buffered frames and scratch buffers
+   size_t MemoryEstimate() const;
+   
+   // Number of threads used to generate rigs; 1 solves on the calling thread
+   unsigned int SolverThreads() const { return _solverThreads; }
+   void SolverThreads( unsigned int v ) { _solverThreads = v; }
+   
+   // Bone lengths are the running median over all frames written so far.
+   // No estimate is applied until @warmupFrames frames are seen, and it stops changing
+   // after @freezeFrames frames (0 to never freeze).
+   void BoneLengthFrames( size_t warmupFrames,
+      size_t freezeFrames );
+
+   // The type SmoothFrames() will be called with. Causal types (see SmoothFactory::IsCausal()) smooth the XYZ input
+   // data of each pose as it's added, before anything else sees it, and SmoothFrames() then does nothing for them.
+   // Other types replace the keypoints later, so frames aren't solved until they have been.
+   void SmoothType( SMOOTH_TYPE type )
+   {
+      _smoothType = type;
+      _causalSmoothType = SmoothFactory::IsCausal( type ) ? type : SMOOTH_TYPE_NONE;
+   }
+   
+   // With SMOOTH_DOMAIN_ROTATIONS, SmoothFrames() solves each frame once and filters its root location, joint
+   // rotations and rolls instead of its keypoints, for any smoothing type; keypoints are then left as they arrived.
+   // Set before adding poses.
+   void SmoothDomain( SMOOTH_DOMAIN v ) { _smoothDomain = v; }
 
-   // Smooth the XYZ input data (NOT the output rig).
+   // Frames to process before a range so that processing just that range starts from (nearly) the state of processing
+   // everything: the smoothing window plus the bone length warm-up. The low-pass filter only remembers its window, so
+   // it's exact; causal filters and the bone length median remember everything, so they're warmed up but not identical.
+   static int PreRollFrames( SMOOTH_TYPE type,
+      size_t boneWarmupFrames );
+   
+   // Frames after a range that SmoothFrames() reads ahead to smooth the end of the range: the delay of every
+   // non-causal filter a frame goes through. Until they've arrived, the end of the range is written unsmoothed.
+   static int SmoothDelayFrames( SMOOTH_TYPE type,
+      SMOOTH_DOMAIN domain );
+
+   // Smooth the XYZ input data (NOT the output rig), unless smoothing rotations (see SmoothDomain()).
    // This means you will need to re-generate rigs after calling this if you want filtered/smoothed data.
-   // Many implementations have inherent delays, so expect time shifts!
-   // Range is all inclusive, [rangeStart, rangeEnd].
-   // Range is updated with shifted timestamps on successful return.
+   // Range is all inclusive, [rangeStart, rangeEnd]. Frames are added to the filters once each, reading ahead of the
+   // range by SmoothDelayFrames() (or to the last frame, if flushing), and frames outside the range are kept.
+   // Range is updated to the frames the filters handed back on successful return.
    void SmoothFrames( SMOOTH_TYPE type,
       int & rangeStart,
       int & rangeEnd,
       bool flush = false );
 
-   int Write( nlohmann::json & json,
+   // Generate, compress and write the frames in [startTimestamp, endTimestamp] to the current rig of @ref_file,
+   // then drop them. Returns the last timestamp written.
+   int Write( RigFileWriter & ref_file,
       int startTimestamp,
       int endTimestamp );
    
+   // Save the frames not yet written, the filters and the bone length estimate, and restore them into a rig that
+   // has only been configured. Filters are restored as @smoothType (or as the causal type, for joints), which must
+   // be the type they were saved with. Generated rigs aren't saved; they're generated again when written.
+   void Save( CheckpointWriter & ref_checkpoint ) const;
+   void Restore( CheckpointReader & ref_checkpoint,
+      SMOOTH_TYPE smoothType );
+   
 private:
    void SmoothAllKeypoints( SMOOTH_TYPE type,
       int & rangeStart,
@@ -43,16 +99,33 @@ private:
       int rangeStart,
       int rangeEnd,
       bool flush = false );
+   void SmoothAllRotations( SMOOTH_TYPE type,
+      int & rangeStart,
+      int & rangeEnd,
+      bool flush = false );
    void DetermineBoneLengths( std::map< int, std::unique_ptr< Pose > >::iterator & poseIt );
-   void UpdateBoneLengths( std::unique_ptr< Pose > & pose );
+   void ValidateRigs( const Pose * const * poses,
+      size_t numPoses ) const;
+   void SampleBoneLengths( const Pose & pose );
+   void SmoothPose( Pose & pose );
 
    std::map< int, std::unique_ptr< Pose > > _frames;
-   std::vector< std::vector< double > > _rawBoneLengths;
-   std::vector< double > _averagedBoneLengths;
+   std::vector< RigPose > _interpolatedPoses;
+   std::vector< double > _interpolationRatios;
+   BoneLengthEstimator _boneLengths;
+   int _lastSampledTimestamp = INT_MIN;
+   int _smoothedTimestamp = INT_MIN;      // Frames up to this have been added to the non-causal filters
    std::vector< std::unique_ptr< Smooth > > _jointSmoothers;
    std::vector< std::unique_ptr< Smooth > > _boneRollSmoothers;
-   std::array< std::unique_ptr< Smooth >, 3 > _locationSmoothers;
+   SMOOTH_TYPE _smoothType = SMOOTH_TYPE_NONE;
+   SMOOTH_TYPE _causalSmoothType = SMOOTH_TYPE_NONE;
+   SMOOTH_DOMAIN _smoothDomain = SMOOTH_DOMAIN_KEYPOINTS;
+   // Last sample of each joint rotation, the hemisphere the next one is flipped into
+   std::vector< std::array< double, 4 > > _lastRotations;
+   std::vector< double > _poseData;         // SmoothPose()'s keypoints
+   std::vector< double > _smoothedSample;  // A filter's latest sample, in SmoothPose()
    std::string _category;
+   unsigned int _solverThreads = 1;
 };
 
 #endif
@@ -1,14 +1,37 @@
+#include <array>
 #include <chrono>
 #include <iostream>
 #include <fstream>
-#include <sstream>
 #include <limits.h>
 #include <functional>
+#include <algorithm>
+#include <unordered_map>
+#include <exception>
 #include "Animation.hpp"
+#include "Checkpoint.hpp"
 #include "RigPose.hpp"
+#include "SegmentFilename.hpp"
+#include "WorkerPool.hpp"
 #include "Utility.hpp"
+#include "Trace.hpp"
 #include "config.h"
 
+// Identifies checkpoints, and the layout of what follows
+static const std::array< char, 8 > CHECKPOINT_MAGIC = { { 'k', 'p', '2', 'r', 'i', 'g', 'c', 'p' } };
+static const uint32_t CHECKPOINT_VERSION = 3;
+
+Animation::LATE_POLICY Animation::LatePolicy( std::string policy )
+{
+   static std::unordered_map< std::string, LATE_POLICY > map = {
+      { "drop", LATE_DROP },
+      { "patch", LATE_PATCH }
+   };
+   
+   auto it = map.find( policy );
+   if ( it == map.end() )
+      throw std::runtime_error( "Unknown late frame policy '" + policy + "', expected drop or patch" );
+   return (*it).second;
+}
 Animation::Animation( double targetFps )
    : _fps( targetFps )
 {
@@ -29,11 +52,197 @@ void Animation::AddPose( std::string rigId,
 {
    std::lock_guard< std::mutex > lock( _mutex );
    
-   auto it = _animatedRigs.find( rigId );
-   if ( it == std::end( _animatedRigs ) )
-      it = _animatedRigs.emplace( std::make_pair( rigId, AnimatedRig() ) ).first;
+   // Ignore everything outside the range and its pre-roll
+   if ( _hasRange &&
+      (pose->Timestamp() < _rangeStart - AnimatedRig::PreRollFrames( _smoothType, _boneWarmupFrames ) ||
+      pose->Timestamp() > _rangeEnd) )
+      return;
+   
+   // Frames written before the checkpoint we resumed from are being replayed, they aren't late
+   if ( pose->Timestamp() < _resumedTimestamp )
+      return;
+   
+   auto it = _characterSlots.find( rigId );
+   Character & character = _characters[ it != std::end( _characterSlots ) ? (*it).second : AddCharacter( rigId ) ];
+   
+   const int timestamp = pose->Timestamp();
+   character.lastArrival = std::chrono::steady_clock::now();
+   if ( timestamp <= character.resumedTimestamp )
+      return;
+   character.newestTimestamp = std::max( character.newestTimestamp, timestamp );
+   
+   // If this frame's segment has already been written
+   if ( timestamp < _writtenTimestamp )
+   {
+      character.lateFrames->Add();
+      if ( _latePolicy == LATE_DROP )
+         return;
+   }
+   
+   character.rig.AddPose( pose );
    
-   (*it).second.AddPose( pose );
+   // Previews can't wait for smoothing, which would hold them back until their segment is written
+   if ( _feed )
+      _feed->Publish( rigId, timestamp, character.rig.PreviewRig( timestamp ) );
+}
+size_t Animation::AddCharacter( const std::string & rigId )
+{
+   size_t slot = _characters.size();
+   if ( _freeSlots.size() )
+   {
+      slot = _freeSlots.back();
+      _freeSlots.pop_back();
+   }
+   else
+   {
+      _characters.emplace_back();
+   }
+   
+   // Back before the caller took its retirement, which would otherwise drop what the caller keeps for it now
+   _retiredIds.erase( std::remove( std::begin( _retiredIds ), std::end( _retiredIds ), rigId ), std::end( _retiredIds ) );
+   
+   Character & character = _characters[ slot ];
+   character.id = rigId;
+   character.rig.SolverThreads( _solverThreads );
+   character.rig.BoneLengthFrames( _boneWarmupFrames, _boneFreezeFrames );
+   character.rig.SmoothDomain( _smoothDomain );
+   character.rig.SmoothType( _smoothType );
+   
+   std::string labels = Metrics::Label( "character", rigId );
+   character.frames = &Metrics::Instance().GetGauge( "kp2rig_rig_frames", labels );
+   character.bytes = &Metrics::Instance().GetGauge( "kp2rig_rig_bytes", labels );
+   character.lateFrames = &Metrics::Instance().GetCounter( "kp2rig_frames_late_total", labels );
+   
+   _characterSlots[ rigId ] = slot;
+   auto position = std::lower_bound( std::begin( _activeSlots ), std::end( _activeSlots ), rigId,
+      [this]( size_t lhs, const std::string & rhs ) { return _characters[ lhs ].id < rhs; } );
+   _activeSlots.insert( position, slot );
+   _activeCharacters.Set( (int64_t)_activeSlots.size() );
+   ++_numCharacters;
+   
+   return slot;
+}
+std::vector< std::string > Animation::TakeRetiredCharacters()
+{
+   std::lock_guard< std::mutex > lock( _mutex );
+   std::vector< std::string > retiredIds;
+   retiredIds.swap( _retiredIds );
+   return retiredIds;
+}
+void Animation::RetireIdleCharacters()
+{
+   if ( _retireAfter <= 0 )
+      return;
+   
+   const auto now = std::chrono::steady_clock::now();
+   const auto retireAfter = std::chrono::duration< double >( _retireAfter );
+   auto it = std::begin( _activeSlots );
+   while ( it != std::end( _activeSlots ) )
+   {
+      Character & character = _characters[ *it ];
+      
+      // Only once everything it sent has been written
+      if ( character.rig.GetFrames().size() ||
+         now - character.lastArrival <= retireAfter )
+      {
+         ++it;
+         continue;
+      }
+      
+      // Its metrics go with it, so the metrics of a long run don't grow with every character ever seen
+      const std::string labels = Metrics::Label( "character", character.id );
+      Metrics::Instance().Remove( "kp2rig_rig_frames", labels );
+      Metrics::Instance().Remove( "kp2rig_rig_bytes", labels );
+      Metrics::Instance().Remove( "kp2rig_frames_late_total", labels );
+      _retiredIds.push_back( character.id );
+      _characterSlots.erase( character.id );
+      _freeSlots.push_back( *it );
+      character = Character();
+      it = _activeSlots.erase( it );
+      _retiredCharacters.Add();
+   }
+   _activeCharacters.Set( (int64_t)_activeSlots.size() );
+}
+
+void Animation::WriteCheckpoint()
+{
+   TRACE_SCOPE( "Animation::WriteCheckpoint" );
+   
+   // Resuming would skip past a segment that isn't on disk, so the last checkpoint before it is kept instead.
+   // That's so whether the segment couldn't be processed or couldn't be written.
+   if ( _failedSegments || _writer.Failures() )
+      return;
+   
+   CheckpointWriter checkpoint;
+   checkpoint.Write( CHECKPOINT_MAGIC );
+   checkpoint.Write( CHECKPOINT_VERSION );
+   
+   // Resuming with other options would carry on with the wrong state
+   checkpoint.Write( _fps );
+   checkpoint.Write( _segmentDuration );
+   checkpoint.Write( (int32_t)_smoothType );
+   checkpoint.Write( (int32_t)_smoothDomain );
+   
+   checkpoint.Write( _segmentStartTimestamp );
+   checkpoint.Write( _writtenTimestamp );
+   checkpoint.Write( _numPatches );
+   checkpoint.Write( (uint64_t)_activeSlots.size() );
+   for ( size_t slot : _activeSlots )
+   {
+      const Character & character = _characters[ slot ];
+      checkpoint.Write( character.id );
+      checkpoint.Write( character.newestTimestamp );
+      character.rig.Save( checkpoint );
+   }
+   
+   // Queued after the segments it follows, so it never covers a segment that isn't on disk yet, or that failed
+   _writer.Write( Utility::ExpandTilde( _checkpointFilename ), checkpoint.Finish(), SegmentWriter::FILE_CHECKPOINT );
+}
+void Animation::Resume( const std::string & filename )
+{
+   CheckpointReader checkpoint = CheckpointReader::Load( Utility::ExpandTilde( filename ) );
+   if ( checkpoint.Read< std::array< char, 8 > >() != CHECKPOINT_MAGIC )
+      throw std::runtime_error( "Not a checkpoint '" + filename + "'" );
+   const uint32_t version = checkpoint.Read< uint32_t >();
+   if ( version != CHECKPOINT_VERSION )
+      throw std::runtime_error( "Checkpoint '" + filename + "' is version " + std::to_string( version ) +
+         ", expected " + std::to_string( CHECKPOINT_VERSION ) );
+   
+   const double fps = checkpoint.Read< double >();
+   const double segmentDuration = checkpoint.Read< double >();
+   const SMOOTH_TYPE smoothType = (SMOOTH_TYPE)checkpoint.Read< int32_t >();
+   const SMOOTH_DOMAIN smoothDomain = (SMOOTH_DOMAIN)checkpoint.Read< int32_t >();
+   if ( fps != _fps )
+      throw std::runtime_error( "Checkpoint '" + filename + "' is " + std::to_string( fps ) + " fps, not " + std::to_string( _fps ) );
+   if ( segmentDuration != _segmentDuration )
+      throw std::runtime_error( "Checkpoint '" + filename + "' has " + std::to_string( segmentDuration ) + " second segments, not " + std::to_string( _segmentDuration ) );
+   if ( smoothType != _smoothType )
+      throw std::runtime_error( "Checkpoint '" + filename + "' was smoothed with " + SmoothFactory::SmoothType( smoothType ) + ", not " + SmoothFactory::SmoothType( _smoothType ) );
+   if ( smoothDomain != _smoothDomain )
+      throw std::runtime_error( "Checkpoint '" + filename + "' smoothed " + SmoothFactory::SmoothDomain( smoothDomain ) + ", not " + SmoothFactory::SmoothDomain( _smoothDomain ) );
+   
+   std::lock_guard< std::mutex > lock( _mutex );
+   checkpoint.Read( _segmentStartTimestamp );
+   checkpoint.Read( _writtenTimestamp );
+   checkpoint.Read( _numPatches );
+   _resumedTimestamp = _writtenTimestamp;
+   
+   const size_t numCharacters = (size_t)checkpoint.Read< uint64_t >();
+   for ( size_t i = 0; i < numCharacters; ++i )
+   {
+      const std::string id = checkpoint.Read< std::string >();
+      if ( _characterSlots.count( id ) )
+         throw std::runtime_error( "Checkpoint '" + filename + "' has character '" + id + "' twice" );
+      
+      // Configured as usual, then given its saved state. Its frames count as just arrived.
+      Character & character = _characters[ AddCharacter( id ) ];
+      checkpoint.Read( character.newestTimestamp );
+      character.resumedTimestamp = character.newestTimestamp;
+      character.lastArrival = std::chrono::steady_clock::now();
+      character.rig.Restore( checkpoint, _smoothType );
+   }
+   if ( !checkpoint.AtEnd() )
+      throw std::runtime_error( "Checkpoint '" + filename + "' has unexpected data at its end" );
 }
 
 std::vector< std::pair< int, int >  > Animation::GetBounds( int & start,
@@ -45,12 +254,19 @@ std::vector< std::pair< int, int >  > Animation::GetBounds( int & start,
    
    std::lock_guard< std::mutex > autoLock( _mutex );
    
-   for ( auto & animatedRig : _animatedRigs )
+   int64_t pendingFrames = 0;
+   for ( size_t slot : _activeSlots )
    {
-      if ( animatedRig.second.GetFrames().size() )
+      // Track how much each character is holding on to
+      const Character & character = _characters[ slot ];
+      character.frames->Set( (int64_t)character.rig.GetFrames().size() );
+      character.bytes->Set( (int64_t)character.rig.MemoryEstimate() );
+      pendingFrames += (int64_t)character.rig.GetFrames().size();
+      
+      if ( character.rig.GetFrames().size() )
       {
-         int thisCharacterStart = (*animatedRig.second.GetFrames().begin()).second->Timestamp();
-         int thisCharacterEnd = (*animatedRig.second.GetFrames().rbegin()).second->Timestamp();
+         int thisCharacterStart = (*character.rig.GetFrames().begin()).second->Timestamp();
+         int thisCharacterEnd = (*character.rig.GetFrames().rbegin()).second->Timestamp();
          returnValue.push_back( std::make_pair( thisCharacterStart, thisCharacterEnd ) );
          
          // Keep track of overall min/max
@@ -58,18 +274,46 @@ std::vector< std::pair< int, int >  > Animation::GetBounds( int & start,
          if ( thisCharacterEnd > end ) end = thisCharacterEnd;
       }
    }
+   _pendingFrames.Set( pendingFrames );
    
    return returnValue;
 }
+int Animation::Watermark() const
+{
+   // The newest timestamp of every character that's still sending frames
+   const auto now = std::chrono::steady_clock::now();
+   const auto idleTimeout = std::chrono::duration< double >( _idleTimeout );
+   std::vector< int > newestTimestamps;
+   for ( size_t slot : _activeSlots )
+   {
+      const Character & character = _characters[ slot ];
+      if ( now - character.lastArrival <= idleTimeout )
+         newestTimestamps.push_back( character.newestTimestamp );
+   }
+   if ( newestTimestamps.empty() )
+      return INT_MIN;
+   
+   // The median follows the bulk of the characters, whatever the stragglers and runaways do
+   auto median = std::begin( newestTimestamps ) + (newestTimestamps.size() - 1) / 2;
+   std::nth_element( std::begin( newestTimestamps ), median, std::end( newestTimestamps ) );
+   return *median - (int)((_allowedLateness * _fps) + 0.5);
+}
 void Animation::WriteForever()
 {
+   Trace::ThreadName( "process and write" );
+   
    int min, max;
-   int segmentStartTimestamp = -1;
-   int segmentEndTimestamp;
 
    // Loop until told to stop OR until told to stop and all data is written
    while ( !_quit )
    {
+      // Take any flush request now; one made partway through this pass waits for the next
+      bool flush;
+      {
+         std::lock_guard< std::mutex > autoLock( _mutex );
+         flush = _flush;
+      }
+      
       // Get the bounds of all animated rigs
       std::vector< std::pair< int, int >  > bounds = GetBounds( min, max );
       
@@ -78,78 +322,91 @@ void Animation::WriteForever()
       {
          std::lock_guard< std::mutex > autoLock( _mutex );
          
-         // Calculate the min, max, and min/max averages
-         int minSum = 0, maxSum = 0;
-         for ( auto & bound : bounds )
-         {
-            if ( bound.first < min ) min = bound.first;
-            if ( bound.second > max ) max = bound.second;
-            
-            minSum += bound.first;
-            maxSum += bound.second;
-         }
-         double minAverage = minSum / (int)bounds.size();
-         double maxAverage = maxSum / (int)bounds.size();
-         
-         // Set our end timestamp to the end, we can move it later if needed
-         segmentEndTimestamp = max;
+         // Output starts at the earliest frame, or where we were told to
+         const int firstTimestamp = _hasRange ? _rangeStart : min;
       
-         // If we are streaming (using segments)
-         if ( _segmentDuration > 0 )
+         // If we are streaming (using segments). Without a live input, wait for the flush.
+         if ( _segmentDuration > 0 && (_live || flush) )
          {
-            // For streaming, force our segment timestamp ONLY the first time here;
-            // subsequent iterations MUST resume where the previous segment left off
-            if ( segmentStartTimestamp < 0 )
+            // For streaming, start at the first frame ONLY the first time here;
+            // subsequent segments MUST resume where the previous segment left off
+            if ( _segmentStartTimestamp < 0 )
             {
-               segmentStartTimestamp = min;
+               _segmentStartTimestamp = firstTimestamp;
             }
             
-            // If we have enough data to output a segment
-            int targetDiff = (int)(_fps * _segmentDuration) - 1;
-            if ( (max - min) >= targetDiff &&
-               ((maxAverage - minAverage) >= targetDiff || (max - min) >= (targetDiff * 3) / 2) )
+            const int segmentFrames = std::max( (int)(_fps * _segmentDuration), 1 );
+            const int watermark = _live ? Watermark() : INT_MIN;
+            if ( watermark != INT_MIN )
+               _watermarkGauge.Set( watermark );
+            
+            // Non-causal filters read ahead of a segment to smooth its end, so it also waits for those frames
+            const int readAhead = _live ? AnimatedRig::SmoothDelayFrames( _smoothType, _smoothDomain ) : 0;
+            
+            // Write every segment the watermark has passed, or everything we have if flushing
+            bool wroteSegment = false;
+            while ( true )
             {
-               // Adjust our end timestamp and mark for writing
-               segmentEndTimestamp = segmentStartTimestamp + targetDiff;
+               int segmentEndTimestamp = _segmentStartTimestamp + segmentFrames - 1;
                
-               _flush = true;
+               // Skip over segments nobody has frames for
+               if ( min > segmentEndTimestamp )
+               {
+                  _segmentStartTimestamp += ((min - _segmentStartTimestamp) / segmentFrames) * segmentFrames;
+                  continue;
+               }
+               
+               if ( watermark < segmentEndTimestamp + readAhead )
+               {
+                  if ( !flush || _segmentStartTimestamp > max )
+                     break;
+                  segmentEndTimestamp = std::min( segmentEndTimestamp, max );
+               }
+               
+               // Late frames go out with each segment, so there's at most one patch per segment
+               if ( _latePolicy == LATE_PATCH )
+                  WriteLateFrames();
+               
+               // Only the last segment flushes the filters, the others carry on into the next
+               PreRoll( min );
+               WriteSegment( _segmentStartTimestamp, segmentEndTimestamp, flush && segmentEndTimestamp >= max );
+               _segmentStartTimestamp = segmentEndTimestamp + 1;
+               wroteSegment = true;
             }
+            if ( flush && _latePolicy == LATE_PATCH )
+               WriteLateFrames();
+            
+            // One checkpoint for everything written this pass
+            if ( wroteSegment && _checkpointFilename.size() )
+               WriteCheckpoint();
          }
          // Else we are outputting to a monolithic file
-         else
+         else if ( _segmentDuration <= 0 && flush )
          {
-            // Force our segment timestamp every iteration.
-            // This addresses a case where the last file has the earliest timestamp,
-            // a case we don't (and can't) worry about while stremaing.
-            segmentStartTimestamp = min;
-         }
-         
-         // If we need to write
-         if ( _flush )
-         {
-            printf( "Processing and writing segment %d-->%d...", segmentStartTimestamp, segmentEndTimestamp );
-           
-            // Write this data, move the start timestamp to one passed the end
-            try
-            {
-               ProcessAndWrite( segmentStartTimestamp, segmentEndTimestamp, _flush );
-               printf( "DONE\n" );
-            }
-            catch ( std::runtime_error & e )
-            {
-               printf( "FAILED\n\t%s\n", e.what() );
-            }
-            segmentStartTimestamp = segmentEndTimestamp + 1;
+            // Always from the first frame. This addresses a case where the last file has the earliest
+            // timestamp, a case we don't (and can't) worry about while stremaing.
+            PreRoll( min );
+            if ( firstTimestamp <= max )
+               WriteSegment( firstTimestamp, max, flush );
          }
       }
+      
+      // Let go of characters that have gone away
+      {
+         std::lock_guard< std::mutex > autoLock( _mutex );
+         RetireIdleCharacters();
+      }
 
       // If we were asked to flush
-      if ( _flush )
+      if ( flush )
       {
          // When we get here the flush has been handled or didn't apply; either way it's been addressed.
          // Mark the flush as complete.
-         _flush = false;
-         _flushEvent.notify_one();
+         {
+            std::lock_guard< std::mutex > autoLock( _mutex );
+            _flush = false;
+         }
+         _flushEvent.notify_all();
       }
       
       // This thread will have mutex issues and poor performance if left
@@ -157,143 +414,227 @@ void Animation::WriteForever()
       std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
    }
 }
-void Animation::ProcessAndWrite( int startTimestamp,
-   int endTimestamp,
-   bool flush )
+void Animation::WriteLateFrames()
 {
-   RAII scopeGuard( [ flush, this ]
+   // Find the frames that arrived after their segment was written
+   int lateStart = INT_MAX, lateEnd = INT_MIN;
+   for ( size_t slot : _activeSlots )
    {
-      // If we flushed a file (whether or not it actually succeeded)
-      if ( flush )
+      auto & frames = _characters[ slot ].rig.GetFrames();
+      auto end = frames.lower_bound( _writtenTimestamp );
+      if ( end != frames.begin() )
       {
-         // Destroy this JSON file
-         this->_json.reset();
+         lateStart = std::min( lateStart, (*frames.begin()).first );
+         lateEnd = std::max( lateEnd, (*std::prev( end )).first );
       }
-   } );
+   }
+   
+   if ( lateStart <= lateEnd )
+      WriteSegment( lateStart, lateEnd, false, SEGMENT_PATCH );
+}
+void Animation::PreRoll( int firstTimestamp )
+{
+   // Frames before the range only bring filters and bone lengths up to speed, before anything is written
+   if ( _hasRange &&
+      _writtenTimestamp == INT_MIN &&
+      firstTimestamp < _rangeStart )
+      WriteSegment( firstTimestamp, _rangeStart - 1, false, SEGMENT_PRE_ROLL );
+}
+void Animation::WriteSegment( int startTimestamp,
+   int endTimestamp,
+   bool flush,
+   SEGMENT_TYPE type )
+{
+   static const char * names[] = { "segment", "patch", "pre-roll" };
+   printf( "Processing and writing %s %d-->%d...", names[ type ], startTimestamp, endTimestamp );
    
-   // If we have a json object and we are writing segments
-   if ( _json && _segmentDuration > 0 )
+   try
    {
-      // If we need to close this file and open a new one
-      if ( startTimestamp > (*_json)["header"]["endFrame"].get<int>() )
-      {
-         // Create the segment filename and add to our list
-         std::stringstream ss;
-         ss << _outputDirectory << "/" << "seg_" << (*_json)["header"]["startFrame"] << ".json";
-         _segmentFilenames.push_back( ss.str() );
-         
-         // Write this file to disk
-         std::ofstream fileStream( ss.str() );
-         fileStream << (*_json);
-         
-         // Destroy this json file
-         _json.reset();
-      }
+      static Histogram & segmentTime = Metrics::Instance().GetTimer( "kp2rig_segment_seconds" );
+      ScopedHistogramTimer timer( segmentTime );
+      ProcessAndWrite( startTimestamp, endTimestamp, flush, type );
+      printf( "DONE\n" );
+   }
+   catch ( std::runtime_error & e )
+   {
+      printf( "FAILED\n\t%s\n", e.what() );
+      ++_failedSegments;
    }
    
-   // If we don't have a json object
-   if ( !_json )
+   // Solves since the last segment, including frames solved as they arrived, over the frames written since.
+   // Pre-roll counts toward the first segment.
+   if ( type != SEGMENT_PRE_ROLL )
    {
-      // Create one
-      _json = std::unique_ptr< nlohmann::json >( new nlohmann::json() );
-      
-      // Write the header
-      //#define XSTR(s) STR(s)
-      //#define STR(s) #s
-      //(*_json)["version"] = XSTR(MY_VERSION);
-      (*_json)["version"] = MY_VERSION;
-      (*_json)["header"]["startFrame"] = startTimestamp;
-      (*_json)["header"]["endFrame"] = endTimestamp;
-      (*_json)["header"]["fps"] = _fps;
-      
-      // Start the frames array
-      (*_json)["rigs"] = {};
+      const uint64_t solves = _solves.Value();
+      const uint64_t framesWritten = _framesWritten.Value();
+      if ( framesWritten > _lastFramesWritten )
+         _solvesPerFrame.Record( (solves - _lastSolves) * 1000 / (framesWritten - _lastFramesWritten) );
+      _lastSolves = solves;
+      _lastFramesWritten = framesWritten;
    }
    
-   // For every rig
-   for ( auto & animatedRig : _animatedRigs )
+   // Anything for these frames from now on is late
+   if ( type != SEGMENT_PATCH )
+      _writtenTimestamp = std::max( _writtenTimestamp, endTimestamp + 1 );
+}
+void Animation::ProcessAndWrite( int startTimestamp,
+   int endTimestamp,
+   bool flush,
+   SEGMENT_TYPE type )
+{
+   TRACE_SCOPE_ARGS( "Animation::ProcessAndWrite", "start", startTimestamp, "end", endTimestamp, "flush", flush );
+   
+   // Every character with frames for this segment
+   std::vector< Character * > characters;
+   for ( size_t slot : _activeSlots )
    {
+      const AnimatedRig & animatedRig = _characters[ slot ].rig;
+      
       // Make sure we have some frames first
-      if ( animatedRig.second.GetFrames().size() == 0 )
+      if ( animatedRig.GetFrames().size() == 0 )
          continue;
-         
-      // Find this character in the json file
-      nlohmann::json * existingRig = nullptr;
-      for ( auto & rig : (*_json)["rigs"] )
+      
+      // Patches only hold the characters with late frames
+      if ( type == SEGMENT_PATCH &&
+         animatedRig.GetFrames().begin()->first > endTimestamp )
+         continue;
+      
+      characters.push_back( &_characters[ slot ] );
+   }
+   
+   // Name the segment
+   SegmentFilename segment;
+   segment.startFrame = startTimestamp;
+   if ( type == SEGMENT_PATCH )
+      segment.patch = ++_numPatches;
+   
+   if ( _partitionWorkers > 0 )
+   {
+      ProcessPartitioned( characters, startTimestamp, endTimestamp, flush, type, segment );
+      return;
+   }
+   
+   // The file is written as we go, starting with the header
+   RigFileWriter file( startTimestamp, endTimestamp, _fps );
+   for ( Character * character : characters )
+      ProcessCharacter( *character, startTimestamp, endTimestamp, flush, type, file );
+   
+   // Pre-roll has done its job by now
+   if ( type == SEGMENT_PRE_ROLL )
+      return;
+   
+   // Leave the disk to the writer thread
+   _writer.Write( Utility::ExpandTilde( _outputDirectory + "/" + segment.Filename() ), file.Finish() );
+}
+void Animation::ProcessPartitioned( const std::vector< Character * > & characters,
+   int startTimestamp,
+   int endTimestamp,
+   bool flush,
+   SEGMENT_TYPE type,
+   SegmentFilename segment )
+{
+   // Characters share nothing, so each worker takes every numWorkers'th character and writes it to its own file.
+   // The workers are the calling thread and those of the pool, which are kept between segments.
+   const size_t numWorkers = std::min( (size_t)_partitionWorkers, characters.size() );
+   std::vector< std::string > contents( characters.size() );
+   std::vector< std::exception_ptr > errors( characters.size() );
+   WorkerPool::Instance().Run( numWorkers, [&]( size_t worker )
+   {
+      for ( size_t i = worker; i < characters.size(); i += numWorkers )
       {
-         if ( rig["id"] == animatedRig.first )
+         try
+         {
+            RigFileWriter file( startTimestamp, endTimestamp, _fps );
+            ProcessCharacter( *characters[ i ], startTimestamp, endTimestamp, flush, type, file );
+            contents[ i ] = file.Finish();
+         }
+         catch ( ... )
          {
-            existingRig = &rig;
-            break;
+            errors[ i ] = std::current_exception();
          }
       }
-      
-      // If not found
-      if ( existingRig == nullptr )
+   } );
+   
+   if ( type != SEGMENT_PRE_ROLL )
+   {
+      // One file per character that made it, then the manifest: a rig file whose rigs name the file holding their
+      // data. The writer keeps the order, so by the time the manifest appears every file it names is in place.
+      RigFileWriter manifest( startTimestamp, endTimestamp, _fps );
+      segment.contents = SegmentFilename::CONTENTS_RIG;
+      for ( size_t i = 0; i < characters.size(); ++i )
       {
-         // Create a new character and add it to our json file
-         nlohmann::json rig;
-         rig["id"] = animatedRig.first;
-         rig["type"] = animatedRig.second.Category();
-         rig["name"] = animatedRig.first;
-         (*_json)["rigs"].push_back( rig );
-         existingRig = &(*_json)["rigs"].back();
+         if ( errors[ i ] )
+            continue;
+         const Character & character = *characters[ i ];
+         segment.rigId = character.id;
+         const std::string rigFilename = segment.Filename();
+         manifest.BeginRig( character.id,
+            character.rig.Category(),
+            character.id );
+         manifest.Field( "file", (const unsigned char *)rigFilename.data(), rigFilename.size() );
+         manifest.EndRig();
+         _writer.Write( Utility::ExpandTilde( _outputDirectory + "/" + rigFilename ), std::move( contents[ i ] ) );
       }
-
-      // "Fix" any missing frames
-      animatedRig.second.FixMissingFrames( startTimestamp,
-         endTimestamp,
-         (int)((_maxMissingFrameGap * _fps) + 0.5) );
-         
-      int firstTimestamp;
-      int lastTimestamp;
-      int actualStart = startTimestamp, actualEnd = endTimestamp;
+      segment.contents = SegmentFilename::CONTENTS_MANIFEST;
+      _writer.Write( Utility::ExpandTilde( _outputDirectory + "/" + segment.Filename() ), manifest.Finish() );
+   }
+   
+   // Report the first failure, the others were still written
+   for ( auto & error : errors )
+   {
+      if ( error )
+         std::rethrow_exception( error );
+   }
+}
+void Animation::ProcessCharacter( Character & ref_character,
+   int startTimestamp,
+   int endTimestamp,
+   bool flush,
+   SEGMENT_TYPE type,
+   RigFileWriter & ref_file ) const
+{
+   AnimatedRig & animatedRig = ref_character.rig;
+   const std::string & id = ref_character.id;
+   
+   // "Fix" any missing frames
+   animatedRig.FixMissingFrames( startTimestamp,
+      endTimestamp,
+      (int)((_maxMissingFrameGap * _fps) + 0.5) );
       
-      // Smooth noisy motion, if requested by the _smoothType
-      animatedRig.second.SmoothFrames( _smoothType,
+   int firstTimestamp;
+   int lastTimestamp;
+   int actualStart = startTimestamp, actualEnd = endTimestamp;
+   
+   // Smooth noisy motion, if requested by the _smoothType.
+   // Late frames are left alone, the filters have already moved on.
+   if ( type != SEGMENT_PATCH )
+   {
+      static Histogram & smoothTime = Metrics::Instance().GetTimer( "kp2rig_smooth_seconds" );
+      ScopedHistogramTimer timer( smoothTime );
+      TRACE_SCOPE_ARGS( "AnimatedRig::SmoothFrames", "character", id );
+      animatedRig.SmoothFrames( _smoothType,
          actualStart,
          actualEnd,
          flush );
-      
-      // Write this character's data
-      firstTimestamp = (*animatedRig.second.GetFrames().begin()).second->Timestamp();
-      lastTimestamp = animatedRig.second.Write( *existingRig,
-         startTimestamp,
-         endTimestamp );
-      
-      // Update the bounds for this character if they don't match the global bounds.
-      // Note this should happen AFTER frame interpolation and be able to account
-      // for frames from previous iterations
-      if ( firstTimestamp > startTimestamp )
-         (*existingRig)["startFrame"] = firstTimestamp;
-      if ( lastTimestamp < endTimestamp )
-         (*existingRig)["endFrame"] = lastTimestamp;
    }
    
-   // If we need to write this json object
-   if ( flush )
+   // Write this character's data
+   firstTimestamp = (*animatedRig.GetFrames().begin()).second->Timestamp();
+   ref_file.BeginRig( id,
+      animatedRig.Category(),
+      id );
    {
-      // Create the segment filename and add to our list now
-      std::stringstream ss;
-      ss << _outputDirectory << "/" << "seg_" << (*_json)["header"]["startFrame"] << ".json";
-      
-      std::string outputFilename = Utility::ExpandTilde( ss.str() );
-      
-      // Write this file to disk
-      std::ofstream fileStream( outputFilename );
-      if ( fileStream.good() )
-      {
-         fileStream << (*_json);
-         _segmentFilenames.push_back( ss.str() );
-      }
-      else
-      {
-         char buffer[512];
-         buffer[0] = 0;
-         auto dontCare = strerror_s( buffer, sizeof( buffer ), errno ); (void)dontCare;
-         ss.str( std::string() ); // Clear the string stream
-         ss << "Tried to write '" << "seg_" << (*_json)["header"]["startFrame"] << ".json' to '" << _outputDirectory << "': " << buffer;
-         throw std::runtime_error( ss.str() );
-      }
+      TRACE_SCOPE_ARGS( "AnimatedRig::Write", "character", id, "start", startTimestamp, "end", endTimestamp );
+      lastTimestamp = animatedRig.Write( ref_file,
+         startTimestamp,
+         endTimestamp );
    }
+   
+   // Write the bounds for this character if they don't match the global bounds.
+   // Note this should happen AFTER frame interpolation
+   if ( firstTimestamp > startTimestamp )
+      ref_file.Field( "startFrame", firstTimestamp );
+   if ( lastTimestamp < endTimestamp )
+      ref_file.Field( "endFrame", lastTimestamp );
+   ref_file.EndRig();
 }
@@ -2,16 +2,28 @@
 #define Animation_hpp
 
 #include <stdio.h>
+#include <chrono>
+#include <unordered_map>
 #include <vector>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
-#include <json.hpp>
 #include "AnimatedRig.hpp"
+#include "Metrics.hpp"
+#include "RigFeed.hpp"
+#include "SegmentFilename.hpp"
+#include "SegmentWriter.hpp"
 
 class Animation
 {
 public:
+   enum LATE_POLICY
+   {
+      LATE_DROP,     // Frames for segments already written are dropped
+      LATE_PATCH     // They're written to a patch segment, seg_<startFrame>_patch<n>.json
+   };
+   static LATE_POLICY LatePolicy( std::string policy );
+   
    Animation( double targetFps );
    ~Animation();
    
@@ -19,52 +31,182 @@ public:
    void SegmentDuration( double v ) { _segmentDuration = v; }
    void OutputDirectory( std::string v ) { _outputDirectory = v; }
    void Smooth( SMOOTH_TYPE v ) { _smoothType = v; }
+   void SmoothDomain( SMOOTH_DOMAIN v ) { _smoothDomain = v; }
    void MaxMissingFrameGap( double v ) { _maxMissingFrameGap = v; }
-   const std::vector< std::string > & SegmentFilenames() const;
+   void SolverThreads( unsigned int v ) { _solverThreads = v; }
+   void BoneLengthFrames( size_t warmupFrames, size_t freezeFrames ) { _boneWarmupFrames = warmupFrames; _boneFreezeFrames = freezeFrames; }
+   void Fsync( SegmentWriter::FSYNC_POLICY v ) { _writer.Fsync( v ); }
+   
+   // When segmenting, a segment is written once the watermark passes its end. The watermark is the median of each
+   // active character's newest timestamp, less @seconds of allowed lateness, so it follows the bulk of the characters
+   // and one that stalls or drops out can't hold segments back.
+   void AllowedLateness( double seconds ) { _allowedLateness = seconds; }
+   // Characters without a new frame for @seconds stop counting toward the watermark until they have one
+   void IdleTimeout( double seconds ) { _idleTimeout = seconds; }
+   // What to do with frames that arrive after their segment was written
+   void Late( LATE_POLICY v ) { _latePolicy = v; }
+   // Without a live input, characters arrive one after another rather than side by side, so segments
+   // are only written when flushed
+   void Live( bool v ) { _live = v; }
+   // Characters without a new frame for @seconds are retired once all their frames are written, releasing their
+   // buffers and filter state. One that comes back starts over as a new character. @seconds is wall-clock time
+   // since the last frame arrived, so it's meant for live input; when reading a file faster or slower than real
+   // time it has nothing to do with the frames' timestamps. 0, the default, keeps every character.
+   void RetireAfter( double seconds ) { _retireAfter = seconds; }
+   // Only output frames [@start, @end], for splitting a capture across processes. Frames just before @start are
+   // processed but not written (see AnimatedRig::PreRollFrames()), and segments start at @start, so with the same
+   // options the segments match those of a single run whose segments start there too. See rigmerge.
+   void Range( int start,
+      int end ) { _hasRange = true; _rangeStart = start; _rangeEnd = end; }
+   
+   // Write one rig file per character instead of one for everyone, seg_<startFrame>.rig.<id>.json, along with a manifest
+   // seg_<startFrame>.manifest.json mapping ids to files, so consumers can load just the characters they want.
+   // Characters are processed independently of each other, spread across @workers threads of the WorkerPool.
+   // 0 writes one file. See SegmentFilename for how ids are written in filenames.
+   void PartitionByRig( unsigned int workers ) { _partitionWorkers = workers; }
+   
+   // Save the state of every character to @filename after each segment is written, replacing the previous checkpoint
+   // once the segment is on disk. Once a segment fails to be processed or written, no more checkpoints are saved, so
+   // resuming from the last one writes that segment again. See Resume().
+   void Checkpoint( const std::string & filename ) { _checkpointFilename = filename; }
+   // Carry on from a checkpoint: restore every character and start writing at the segment after the last one the
+   // checkpoint covers. Frames it covers are dropped as they're read again, so the input can be replayed from any
+   // point before the checkpoint. Call before adding poses, with the options the checkpoint was written with.
+   // Throws if the checkpoint can't be read or doesn't match the options.
+   void Resume( const std::string & filename );
+   
+   // Publish a preview of every frame to the shared-memory feed @name as soon as it is added, for rig2c's rig_subscribe().
+   // See AnimatedRig::PreviewRig(): the frames written to segments are smoothed and solved again, so they can differ.
+   void PreviewFeed( const std::string & name ) { _feed.reset( new RigFeed::Publisher( name ) ); }
+   std::vector< std::string > SegmentFilenames() const;
    void FlushSegments();
    
    void AddPose( std::string rigId,
       std::unique_ptr< Pose > & pose );
-   const std::map< std::string, AnimatedRig > & GetAnimatedRigs() const;
+   // Every character seen, including retired ones
+   size_t NumCharacters() const { return _numCharacters; }
+   // Ids of the characters retired since the last call (see RetireAfter()), so callers can let go of what they keep
+   // for each one too. A character that has come back since it was retired isn't among them, so what the caller
+   // keeps for it is never dropped while it's active.
+   std::vector< std::string > TakeRetiredCharacters();
    
 private:
    std::vector< std::pair< int, int > > GetBounds( int & start,
       int & end );
+   size_t AddCharacter( const std::string & rigId );
+   void RetireIdleCharacters();
+   void WriteCheckpoint();
+   enum SEGMENT_TYPE
+   {
+      SEGMENT_NORMAL,
+      SEGMENT_PATCH,       // Late frames, for segments already written
+      SEGMENT_PRE_ROLL     // Frames before the range, processed but not written
+   };
+   
+   int Watermark() const;
    void WriteForever();
+   void WriteLateFrames();
+   void PreRoll( int firstTimestamp );
+   void WriteSegment( int startTimestamp,
+      int endTimestamp,
+      bool flush,
+      SEGMENT_TYPE type = SEGMENT_NORMAL );
    void ProcessAndWrite( int startTimestamp,
       int endTimestamp,
-      bool flush = false );
+      bool flush = false,
+      SEGMENT_TYPE type = SEGMENT_NORMAL );
+   struct Character;
+   void ProcessPartitioned( const std::vector< Character * > & characters,
+      int startTimestamp,
+      int endTimestamp,
+      bool flush,
+      SEGMENT_TYPE type,
+      SegmentFilename segment );
+   void ProcessCharacter( Character & ref_character,
+      int startTimestamp,
+      int endTimestamp,
+      bool flush,
+      SEGMENT_TYPE type,
+      RigFileWriter & ref_file ) const;
    
    double _segmentDuration;
-   std::map< std::string, AnimatedRig > _animatedRigs;
-   std::vector< std::string > _segmentFilenames;
+   SegmentWriter _writer;
    std::thread _thread;
    std::mutex _mutex;
    std::condition_variable _flushEvent;
    volatile bool _quit = false;
    double _fps;
-   std::unique_ptr< nlohmann::json > _json;
    std::string _outputDirectory;
    double _maxMissingFrameGap = 0.5;
-   volatile bool _flush = false;
+   bool _flush = false;
    SMOOTH_TYPE _smoothType = SMOOTH_TYPE_NONE;
+   SMOOTH_DOMAIN _smoothDomain = SMOOTH_DOMAIN_KEYPOINTS;
+   unsigned int _solverThreads = 1;
+   unsigned int _partitionWorkers = 0;
+   size_t _boneWarmupFrames = BoneLengthEstimator::DEFAULT_WARMUP_FRAMES;
+   size_t _boneFreezeFrames = 0;
+   double _allowedLateness = 1.0;
+   double _idleTimeout = 2.0;
+   LATE_POLICY _latePolicy = LATE_DROP;
+   bool _live = true;
+   int _segmentStartTimestamp = -1;
+   int _writtenTimestamp = INT_MIN;    // Frames before this have been written
+   bool _hasRange = false;
+   int _rangeStart = 0;
+   int _rangeEnd = 0;
+   int _numPatches = 0;
+   double _retireAfter = 0.0;
+   std::string _checkpointFilename;
+   int _resumedTimestamp = INT_MIN;    // Frames before this were written before the checkpoint we resumed from
+   size_t _failedSegments = 0;         // Segments that couldn't be processed; no checkpoint is written after one
+   
+   // Everything kept for one character. Characters stay in the same slot of _characters until they're retired,
+   // and a retired character's slot goes to the next new one.
+   struct Character
+   {
+      std::string id;
+      AnimatedRig rig;
+      int newestTimestamp = INT_MIN;
+      int resumedTimestamp = INT_MIN;  // Frames up to this were in the checkpoint we resumed from
+      std::chrono::steady_clock::time_point lastArrival;
+      Gauge * frames = nullptr;
+      Gauge * bytes = nullptr;
+      Counter * lateFrames = nullptr;
+   };
+   std::vector< Character > _characters;
+   std::vector< size_t > _freeSlots;
+   std::unordered_map< std::string, size_t > _characterSlots;
+   std::vector< size_t > _activeSlots;         // Sorted by id, so characters are always written in the same order
+   std::vector< std::string > _retiredIds;
+   size_t _numCharacters = 0;
+   std::unique_ptr< RigFeed::Publisher > _feed;
+   Gauge & _pendingFrames = Metrics::Instance().GetGauge( "kp2rig_pending_frames" );
+   Gauge & _watermarkGauge = Metrics::Instance().GetGauge( "kp2rig_watermark" );
+   Gauge & _activeCharacters = Metrics::Instance().GetGauge( "kp2rig_characters_active" );
+   Counter & _retiredCharacters = Metrics::Instance().GetCounter( "kp2rig_characters_retired_total" );
+   
+   // Rigs generated per frame written, for each segment; recorded in thousandths
+   Histogram & _solvesPerFrame = Metrics::Instance().GetHistogram( "kp2rig_solves_per_frame", "", 1e-3 );
+   Counter & _solves = Metrics::Instance().GetCounter( "kp2rig_solves_total" );
+   Counter & _framesWritten = Metrics::Instance().GetCounter( "kp2rig_frames_written_total" );
+   uint64_t _lastSolves = _solves.Value();
+   uint64_t _lastFramesWritten = _framesWritten.Value();
 };
 #endif /* Animation_hpp */
 
-inline const std::map< std::string, AnimatedRig > & Animation::GetAnimatedRigs() const
-{
-   return _animatedRigs;
-}
-inline const std::vector< std::string > & Animation::SegmentFilenames() const
+inline std::vector< std::string > Animation::SegmentFilenames() const
 {
-   return _segmentFilenames;
+   return _writer.Written();
 }
 inline void Animation::FlushSegments()
 {
-   // Mark for writing
-   _flush = true;
+   // Mark for writing, and wait for the flush to complete for safety
+   {
+      std::unique_lock< std::mutex > waitLock( _mutex );
+      _flush = true;
+      _flushEvent.wait( waitLock, [this]{ return !_flush; } );
+   }
    
-   // Wait for the flush to complete for safety
-   std::unique_lock< std::mutex > waitLock( _mutex );
-   _flushEvent.wait( waitLock );
+   // Including the files themselves
+   _writer.Wait();
 }
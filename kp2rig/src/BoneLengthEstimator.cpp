@@ -0,0 +1,177 @@
+#include <cmath>
+#include <algorithm>
+#include "Checkpoint.hpp"
+#include "BoneLengthEstimator.hpp"
+
+void P2Quantile::Add( double value )
+{
+   // The first 5 samples initialize the markers
+   if ( _count < 5 )
+   {
+      _heights[ _count++ ] = value;
+      if ( _count == 5 )
+      {
+         std::sort( _heights.begin(), _heights.end() );
+         for ( int i = 0; i < 5; ++i )
+            _positions[ i ] = i + 1;
+         _desiredPositions = { 1, 1 + 2 * _quantile, 1 + 4 * _quantile, 3 + 2 * _quantile, 5 };
+         _increments = { 0, _quantile / 2, _quantile, (1 + _quantile) / 2, 1 };
+      }
+      return;
+   }
+   ++_count;
+   
+   // 1 Find the cell containing this value, extending the extremes if needed
+   int k;
+   if ( value < _heights[ 0 ] )
+   {
+      _heights[ 0 ] = value;
+      k = 0;
+   }
+   else if ( value >= _heights[ 4 ] )
+   {
+      _heights[ 4 ] = value;
+      k = 3;
+   }
+   else
+   {
+      k = 0;
+      while ( value >= _heights[ k + 1 ] )
+         ++k;
+   }
+   
+   // 2 Shift the positions of markers above the cell
+   for ( int i = k + 1; i < 5; ++i )
+      _positions[ i ] += 1;
+   for ( int i = 0; i < 5; ++i )
+      _desiredPositions[ i ] += _increments[ i ];
+   
+   // 3 Adjust the middle markers if they drifted from their desired positions
+   for ( int i = 1; i < 4; ++i )
+   {
+      double d = _desiredPositions[ i ] - _positions[ i ];
+      if ( (d >= 1 && _positions[ i + 1 ] - _positions[ i ] > 1) ||
+         (d <= -1 && _positions[ i - 1 ] - _positions[ i ] < -1) )
+      {
+         int sign = d > 0 ? 1 : -1;
+         double height = Parabolic( i, sign );
+         if ( _heights[ i - 1 ] < height && height < _heights[ i + 1 ] )
+            _heights[ i ] = height;
+         else
+            _heights[ i ] = Linear( i, sign );
+         _positions[ i ] += sign;
+      }
+   }
+}
+double P2Quantile::Value() const
+{
+   if ( _count == 0 )
+      return 0.0;
+   
+   // Until the markers are initialized, use the exact quantile of what we have
+   if ( _count < 5 )
+   {
+      std::array< double, 5 > sorted = _heights;
+      std::sort( sorted.begin(), sorted.begin() + _count );
+      double index = _quantile * (_count - 1);
+      size_t lower = (size_t)index;
+      size_t upper = std::min( lower + 1, _count - 1 );
+      return sorted[ lower ] + (index - lower) * (sorted[ upper ] - sorted[ lower ]);
+   }
+   
+   return _heights[ 2 ];
+}
+double P2Quantile::Parabolic( int i, double d ) const
+{
+   return _heights[ i ] + d / (_positions[ i + 1 ] - _positions[ i - 1 ]) *
+      ((_positions[ i ] - _positions[ i - 1 ] + d) * (_heights[ i + 1 ] - _heights[ i ]) / (_positions[ i + 1 ] - _positions[ i ]) +
+      (_positions[ i + 1 ] - _positions[ i ] - d) * (_heights[ i ] - _heights[ i - 1 ]) / (_positions[ i ] - _positions[ i - 1 ]));
+}
+double P2Quantile::Linear( int i, int d ) const
+{
+   return _heights[ i ] + d * (_heights[ i + d ] - _heights[ i ]) / (_positions[ i + d ] - _positions[ i ]);
+}
+
+void P2Quantile::Save( CheckpointWriter & ref_checkpoint ) const
+{
+   ref_checkpoint.Write( _quantile );
+   ref_checkpoint.Write( (uint64_t)_count );
+   ref_checkpoint.Write( _heights );
+   ref_checkpoint.Write( _positions );
+   ref_checkpoint.Write( _desiredPositions );
+   ref_checkpoint.Write( _increments );
+}
+void P2Quantile::Restore( CheckpointReader & ref_checkpoint )
+{
+   ref_checkpoint.Read( _quantile );
+   _count = (size_t)ref_checkpoint.Read< uint64_t >();
+   ref_checkpoint.Read( _heights );
+   ref_checkpoint.Read( _positions );
+   ref_checkpoint.Read( _desiredPositions );
+   ref_checkpoint.Read( _increments );
+}
+
+BoneLengthEstimator::BoneLengthEstimator( size_t warmupFrames,
+   size_t freezeFrames )
+   : _warmupFrames( warmupFrames ),
+   _freezeFrames( freezeFrames )
+{
+}
+void BoneLengthEstimator::AddSample( const Rig & rig )
+{
+   if ( IsFrozen() )
+      return;
+   
+   int boneIndex = 0;
+   
+   // Bone lengths
+   for ( int i = 0; i < rig.numJointsUsed; ++i )
+      _bones[ boneIndex++ ].Add( rig.GetJoint( Rig::JOINT_TYPE(i) ).length );
+   
+   // Offset lengths
+   boneIndex = Rig::MAX_NUM_JOINTS;
+   for ( int i = 0; i < rig.numJointOffsetsUsed; ++i )
+   {
+      const JointOffset & offset = rig.GetJointOffset( Rig::JOINT_OFFSET_TYPE(i) );
+      _bones[ boneIndex++ ].Add( std::sqrt( offset[0]*offset[0] + offset[1]*offset[1] + offset[2]*offset[2] ) );
+   }
+   
+   ++_numSamples;
+}
+void BoneLengthEstimator::Apply( Rig & rig ) const
+{
+   if ( !IsWarm() )
+      return;
+   
+   int boneIndex = 0;
+   
+   // Bone lengths
+   for ( int i = 0; i < rig.numJointsUsed; ++i )
+      rig.GetJoint( Rig::JOINT_TYPE(i) ).length = _bones[ boneIndex++ ].Value();
+   
+   // Offsets keep their direction, only the length changes
+   boneIndex = Rig::MAX_NUM_JOINTS;
+   for ( int i = 0; i < rig.numJointOffsetsUsed; ++i )
+   {
+      JointOffset & offset = rig.GetJointOffset( Rig::JOINT_OFFSET_TYPE(i) );
+      double length = std::sqrt( offset[0]*offset[0] + offset[1]*offset[1] + offset[2]*offset[2] );
+      double estimate = _bones[ boneIndex++ ].Value();
+      if ( length > 0 )
+      {
+         for ( auto & value : offset )
+            value *= estimate / length;
+      }
+   }
+}
+void BoneLengthEstimator::Save( CheckpointWriter & ref_checkpoint ) const
+{
+   ref_checkpoint.Write( (uint64_t)_numSamples );
+   for ( auto & bone : _bones )
+      bone.Save( ref_checkpoint );
+}
+void BoneLengthEstimator::Restore( CheckpointReader & ref_checkpoint )
+{
+   _numSamples = (size_t)ref_checkpoint.Read< uint64_t >();
+   for ( auto & bone : _bones )
+      bone.Restore( ref_checkpoint );
+}
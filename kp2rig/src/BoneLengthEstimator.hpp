@@ -0,0 +1,76 @@
+#ifndef BoneLengthEstimator_hpp
+#define BoneLengthEstimator_hpp
+
+#include <array>
+#include "Rig.hpp"
+
+class CheckpointWriter;
+class CheckpointReader;
+
+// Streaming quantile estimate using the P-square algorithm (Jain and Chlamtac, 1985).
+// Each sample costs O(1) time and the state is a handful of doubles; samples are not stored.
+class P2Quantile
+{
+public:
+   P2Quantile( double quantile = 0.5 ) : _quantile( quantile ) {}
+   
+   void Add( double value );
+   double Value() const;
+   size_t Count() const { return _count; }
+   
+   void Save( CheckpointWriter & ref_checkpoint ) const;
+   void Restore( CheckpointReader & ref_checkpoint );
+   
+private:
+   double Parabolic( int i, double d ) const;
+   double Linear( int i, int d ) const;
+   
+   double _quantile;
+   size_t _count = 0;
+   std::array< double, 5 > _heights = {};
+   std::array< double, 5 > _positions = {};
+   std::array< double, 5 > _desiredPositions = {};
+   std::array< double, 5 > _increments = {};
+};
+
+// Estimates the bone lengths of a character from a stream of rigs, using the median of each bone length
+// (and of each joint offset length) so that noisy frames have little influence.
+// - No estimate is available until @warmupFrames rigs, and at least one, have been added.
+// - After @freezeFrames rigs the estimate stops changing; 0 means never freeze.
+class BoneLengthEstimator
+{
+public:
+   static const size_t NUM_BONES = Rig::MAX_NUM_JOINTS + Rig::MAX_NUM_JOINT_OFFSETS;
+   static const size_t DEFAULT_WARMUP_FRAMES = 5;
+   
+   BoneLengthEstimator( size_t warmupFrames = DEFAULT_WARMUP_FRAMES,
+      size_t freezeFrames = 0 );
+   
+   size_t WarmupFrames() const { return _warmupFrames; }
+   void WarmupFrames( size_t v ) { _warmupFrames = v; }
+   size_t FreezeFrames() const { return _freezeFrames; }
+   void FreezeFrames( size_t v ) { _freezeFrames = v; }
+   
+   size_t NumSamples() const { return _numSamples; }
+   bool IsWarm() const { return _numSamples > 0 && _numSamples >= _warmupFrames; }
+   bool IsFrozen() const { return _freezeFrames > 0 && _numSamples >= _freezeFrames; }
+   
+   // Add the bone and offset lengths of @rig; ignored once frozen
+   void AddSample( const Rig & rig );
+   
+   // Set the bone lengths of @rig to the current estimate, and scale its offsets to the
+   // estimated offset lengths. Does nothing until warm.
+   void Apply( Rig & rig ) const;
+   
+   // The estimate so far, without the warm-up and freeze settings
+   void Save( CheckpointWriter & ref_checkpoint ) const;
+   void Restore( CheckpointReader & ref_checkpoint );
+   
+private:
+   std::array< P2Quantile, NUM_BONES > _bones;
+   size_t _numSamples = 0;
+   size_t _warmupFrames;
+   size_t _freezeFrames;
+};
+
+#endif
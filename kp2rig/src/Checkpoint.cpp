@@ -0,0 +1,16 @@
+#include <fstream>
+#include <iterator>
+#include "Checkpoint.hpp"
+
+CheckpointReader CheckpointReader::Load( const std::string & filename )
+{
+   std::ifstream file( filename, std::ios::binary );
+   if ( !file.good() )
+      throw std::runtime_error( "Could not open checkpoint '" + filename + "'" );
+
+   std::string contents( ( std::istreambuf_iterator< char >( file ) ),
+      std::istreambuf_iterator< char >() );
+   if ( file.bad() )
+      throw std::runtime_error( "Could not read checkpoint '" + filename + "'" );
+   return CheckpointReader( std::move( contents ) );
+}
@@ -0,0 +1,107 @@
+#ifndef Checkpoint_hpp
+#define Checkpoint_hpp
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Binary checkpoints of pipeline state, so a long run can pick up where it left off (see Animation::Resume()).
+// Values are stored as their raw bytes in host byte order, so a checkpoint is only meant to be read back by the same
+// build on the same kind of machine. Each class saves and restores its own state, in the same order.
+class CheckpointWriter
+{
+public:
+   // Plain values: numbers, enums, and fixed-size arrays of them
+   template< typename T >
+   void Write( const T & value );
+   void Write( const std::string & value );
+   template< typename T >
+   void Write( const std::vector< T > & values );
+
+   // Everything written so far
+   std::string Finish() { return std::move( _contents ); }
+
+private:
+   std::string _contents;
+};
+
+// Reads what a CheckpointWriter wrote. Throws if the checkpoint ends early.
+class CheckpointReader
+{
+public:
+   CheckpointReader( std::string && contents ) : _contents( std::move( contents ) ) {}
+
+   // Reads the whole file @filename. Throws if it can't be read.
+   static CheckpointReader Load( const std::string & filename );
+
+   template< typename T >
+   void Read( T & out_value );
+   void Read( std::string & out_value );
+   template< typename T >
+   void Read( std::vector< T > & out_values );
+   template< typename T >
+   T Read() { T value; Read( value ); return value; }
+
+   bool AtEnd() const { return _offset == _contents.size(); }
+
+private:
+   const char * Take( size_t size );
+
+   std::string _contents;
+   size_t _offset = 0;
+};
+
+template< typename T >
+inline void CheckpointWriter::Write( const T & value )
+{
+   static_assert( std::is_trivially_copyable< T >::value, "Only plain values can be checkpointed directly" );
+   _contents.append( (const char *)&value, sizeof( T ) );
+}
+inline void CheckpointWriter::Write( const std::string & value )
+{
+   Write( (uint64_t)value.size() );
+   _contents.append( value );
+}
+template< typename T >
+inline void CheckpointWriter::Write( const std::vector< T > & values )
+{
+   static_assert( std::is_trivially_copyable< T >::value, "Only vectors of plain values can be checkpointed directly" );
+   Write( (uint64_t)values.size() );
+   _contents.append( (const char *)values.data(), values.size() * sizeof( T ) );
+}
+
+template< typename T >
+inline void CheckpointReader::Read( T & out_value )
+{
+   static_assert( std::is_trivially_copyable< T >::value, "Only plain values can be checkpointed directly" );
+   memcpy( &out_value, Take( sizeof( T ) ), sizeof( T ) );
+}
+inline void CheckpointReader::Read( std::string & out_value )
+{
+   const size_t size = (size_t)Read< uint64_t >();
+   out_value.assign( Take( size ), size );
+}
+template< typename T >
+inline void CheckpointReader::Read( std::vector< T > & out_values )
+{
+   static_assert( std::is_trivially_copyable< T >::value, "Only vectors of plain values can be checkpointed directly" );
+   const size_t size = (size_t)Read< uint64_t >();
+   if ( size > (_contents.size() - _offset) / sizeof( T ) )
+      throw std::runtime_error( "Checkpoint is truncated" );
+   out_values.resize( size );
+   if ( size )
+      memcpy( out_values.data(), Take( size * sizeof( T ) ), size * sizeof( T ) );
+}
+inline const char * CheckpointReader::Take( size_t size )
+{
+   if ( size > _contents.size() - _offset )
+      throw std::runtime_error( "Checkpoint is truncated" );
+   const char * data = _contents.data() + _offset;
+   _offset += size;
+   return data;
+}
+
+#endif
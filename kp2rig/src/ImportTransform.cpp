@@ -0,0 +1,202 @@
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+#include <json.hpp>
+#include "ImportTransform.hpp"
+#include "QuaternionBatch.hpp"
+
+void ImportTransform::Scale( double value )
+{
+   if ( !std::isfinite( value ) || value == 0 )
+      throw std::runtime_error( "Invalid units " + std::to_string( value ) + ", expected a non-zero number" );
+   _scale = value;
+   Update();
+}
+std::string ImportTransform::Axes() const
+{
+   std::string returnValue;
+   for ( size_t i = 0; i < 3; ++i )
+   {
+      if ( i )
+         returnValue += ",";
+      if ( _axisSigns[ i ] < 0 )
+         returnValue += "-";
+      returnValue += "xyz"[ _axes[ i ] ];
+   }
+   return returnValue;
+}
+void ImportTransform::Axes( const std::string & value )
+{
+   std::array< int, 3 > axes = {{ 0, 1, 2 }};
+   std::array< double, 3 > signs = {{ 1, 1, 1 }};
+   bool used[ 3 ] = { false, false, false };
+   size_t numAxes = 0;
+   size_t position = 0;
+   bool valid = true;
+   while ( position <= value.size() )
+   {
+      size_t end = value.find( ',', position );
+      if ( end == std::string::npos )
+         end = value.size();
+      std::string token = value.substr( position, end - position );
+      position = end + 1;
+
+      double sign = 1.0;
+      if ( token.size() == 2 && (token[ 0 ] == '-' || token[ 0 ] == '+') )
+      {
+         sign = token[ 0 ] == '-' ? -1.0 : 1.0;
+         token = token.substr( 1 );
+      }
+      const int axis = token == "x" ? 0 : token == "y" ? 1 : token == "z" ? 2 : -1;
+      if ( axis < 0 || used[ axis ] || numAxes == 3 )
+      {
+         valid = false;
+         break;
+      }
+      used[ axis ] = true;
+      axes[ numAxes ] = axis;
+      signs[ numAxes ] = sign;
+      ++numAxes;
+   }
+   if ( !valid || numAxes != 3 )
+      throw std::runtime_error( "Invalid axes '" + value + "', expected x, y, and z in any order and each optionally negated, e.g. \"x,z,-y\"" );
+
+   // An odd number of swaps and negations turns the capture inside out, so every left keypoint would end up on the
+   // right of the skeleton
+   double determinant = signs[ 0 ] * signs[ 1 ] * signs[ 2 ];
+   for ( int i = 0; i < 3; ++i )
+   {
+      for ( int j = i + 1; j < 3; ++j )
+      {
+         if ( axes[ i ] > axes[ j ] )
+            determinant = -determinant;
+      }
+   }
+   if ( determinant < 0 )
+      throw std::runtime_error( "Invalid axes '" + value + "', they mirror the input; for left-handed input use --left" );
+
+   _axes = axes;
+   _axisSigns = signs;
+   Update();
+}
+void ImportTransform::Calibration( const std::array< double, 16 > & value )
+{
+   for ( double element : value )
+   {
+      if ( !std::isfinite( element ) )
+         throw std::runtime_error( "Invalid calibration, every value must be a finite number" );
+   }
+   if ( value[ 12 ] != 0 || value[ 13 ] != 0 || value[ 14 ] != 0 || value[ 15 ] != 1 )
+      throw std::runtime_error( "Invalid calibration, the last row must be 0 0 0 1" );
+
+   // The rotation must be a rotation: scaling would change the bone lengths, and a reflection would swap the
+   // skeleton's left and right
+   for ( int i = 0; i < 3; ++i )
+   {
+      for ( int j = 0; j < 3; ++j )
+      {
+         const double dot = value[ i * 4 + 0 ] * value[ j * 4 + 0 ] + value[ i * 4 + 1 ] * value[ j * 4 + 1 ] +
+            value[ i * 4 + 2 ] * value[ j * 4 + 2 ];
+         if ( std::abs( dot - (i == j ? 1.0 : 0.0) ) > CALIBRATION_TOLERANCE )
+            throw std::runtime_error( "Invalid calibration, the top left 3x3 must be a rotation, without scaling or shearing" );
+      }
+   }
+   const double determinant =
+      value[ 0 ] * (value[ 5 ] * value[ 10 ] - value[ 6 ] * value[ 9 ]) -
+      value[ 1 ] * (value[ 4 ] * value[ 10 ] - value[ 6 ] * value[ 8 ]) +
+      value[ 2 ] * (value[ 4 ] * value[ 9 ] - value[ 5 ] * value[ 8 ]);
+   if ( determinant < 0 )
+      throw std::runtime_error( "Invalid calibration, it mirrors the input; for left-handed input use --left" );
+
+   _calibration = value;
+   Update();
+}
+void ImportTransform::CalibrationFile( const std::string & filename )
+{
+   std::ifstream file( filename );
+   if ( !file.good() )
+      throw std::runtime_error( "Could not open calibration file '" + filename + "'" );
+
+   std::array< double, 16 > calibration;
+   try
+   {
+      nlohmann::json json;
+      file >> json;
+      const nlohmann::json & rows = json.is_object() ? json.at( "transform" ) : json;
+
+      size_t numValues = 0;
+      auto addValue = [&]( const nlohmann::json & value )
+      {
+         if ( numValues == 16 )
+            throw std::runtime_error( "too many values" );
+         calibration[ numValues++ ] = value.get< double >();
+      };
+      for ( const auto & row : rows )
+      {
+         if ( row.is_array() )
+         {
+            if ( row.size() != 4 )
+               throw std::runtime_error( "every row must have 4 values" );
+            for ( const auto & value : row )
+               addValue( value );
+         }
+         else
+         {
+            addValue( row );
+         }
+      }
+      if ( numValues != 16 )
+         throw std::runtime_error( "expected a 4x4 matrix" );
+   }
+   catch ( std::exception & e )
+   {
+      throw std::runtime_error( "Could not read calibration file '" + filename + "': " + e.what() );
+   }
+   Calibration( calibration );
+}
+bool ImportTransform::IsIdentity() const
+{
+   return _isDiagonal && _diagonal[ 0 ] == 1 && _diagonal[ 1 ] == 1 && _diagonal[ 2 ] == 1;
+}
+void ImportTransform::Apply( double * ref_keypoints,
+   size_t numKeypoints ) const
+{
+   if ( IsIdentity() )
+      return;
+
+   // Units and flipped axes on their own are the common case, and are exactly the same as multiplying each value
+   if ( _isDiagonal )
+      QuaternionBatch::ScalePoints( _diagonal, ref_keypoints, ref_keypoints, numKeypoints );
+   else
+      QuaternionBatch::TransformPoints( _matrix, ref_keypoints, ref_keypoints, numKeypoints );
+}
+void ImportTransform::Update()
+{
+   // The scale and axes: row i takes input axis _axes[ i ]
+   double axes[ 3 ][ 3 ] = {};
+   for ( int i = 0; i < 3; ++i )
+      axes[ i ][ _axes[ i ] ] = _axisSigns[ i ] * _scale;
+
+   // Followed by the calibration
+   for ( int row = 0; row < 3; ++row )
+   {
+      for ( int column = 0; column < 3; ++column )
+      {
+         _matrix[ row * 4 + column ] = _calibration[ row * 4 + 0 ] * axes[ 0 ][ column ] +
+            _calibration[ row * 4 + 1 ] * axes[ 1 ][ column ] +
+            _calibration[ row * 4 + 2 ] * axes[ 2 ][ column ];
+      }
+      _matrix[ row * 4 + 3 ] = _calibration[ row * 4 + 3 ];
+   }
+
+   _isDiagonal = true;
+   for ( int row = 0; row < 3; ++row )
+   {
+      for ( int column = 0; column < 4; ++column )
+      {
+         if ( row != column && _matrix[ row * 4 + column ] != 0 )
+            _isDiagonal = false;
+      }
+      _diagonal[ row ] = _matrix[ row * 4 + row ];
+   }
+}
@@ -0,0 +1,60 @@
+#ifndef ImportTransform_hpp
+#define ImportTransform_hpp
+
+#include <array>
+#include <cstddef>
+#include <string>
+
+// Maps keypoints from the input's space to the rig's. Importers apply it to each frame's block of keypoints as soon
+// as the frame is read, before any Pose sees them. In order:
+//  Scale():       converts input units to meters
+//  Axes():        reorders and flips the axes, e.g. for z-up or left-handed input
+//  Calibration(): places the capture in the world, e.g. a venue calibration
+// These are combined into one matrix, so each frame is transformed in a single pass.
+class ImportTransform
+{
+public:
+   // How far the calibration's rotation may be from orthonormal, allowing for the digits a file was written with
+   static constexpr double CALIBRATION_TOLERANCE = 1e-6;
+
+   // "Normalization" value used to convert input units to meters; e.g. 0.1 for decimeters
+   double Scale() const { return _scale; }
+   void Scale( double value );
+
+   // Which input axis, with an optional sign, becomes each of x, y, and z; e.g. "x,z,-y" for z-up input.
+   // Throws if @value isn't a permutation of x, y, and z, or if it mirrors the input, which would swap the skeleton's
+   // left and right. Left-handed input is converted by Pose::CoordinateSystem() instead.
+   std::string Axes() const;
+   void Axes( const std::string & value );
+
+   // A row-major 4x4 affine transform in meters, applied after the scale and axes. Throws unless the last row is
+   // 0 0 0 1 and the top left 3x3 is a rotation to within CALIBRATION_TOLERANCE, orthonormal with a determinant of +1.
+   const std::array< double, 16 > & Calibration() const { return _calibration; }
+   void Calibration( const std::array< double, 16 > & value );
+
+   // Reads the calibration from a JSON file, either {"transform": [[...], [...], [...], [...]]} or the rows on their own.
+   // The rows may also be given as 16 values in row-major order.
+   void CalibrationFile( const std::string & filename );
+
+   // True if keypoints are left as they are
+   bool IsIdentity() const;
+
+   // Transforms @numKeypoints packed {x, y, z} keypoints in place
+   void Apply( double * ref_keypoints,
+      size_t numKeypoints ) const;
+
+private:
+   void Update();
+
+   double _scale = 1.0;
+   std::array< int, 3 > _axes = {{ 0, 1, 2 }};
+   std::array< double, 3 > _axisSigns = {{ 1, 1, 1 }};
+   std::array< double, 16 > _calibration = {{ 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 }};
+
+   // All of the above as the top 3 rows of one matrix, and its diagonal if that's all there is to it
+   std::array< double, 12 > _matrix = {{ 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0 }};
+   std::array< double, 3 > _diagonal = {{ 1, 1, 1 }};
+   bool _isDiagonal = true;
+};
+
+#endif
@@ -6,8 +6,9 @@
 
 KpCsvImporter::KpCsvImporter( const KpCsvImporter & rhs )
 {
-   // Only copy the kp layout
+   // Only copy the kp layout and transform
    _kpLayout = rhs._kpLayout;
+   _transform = rhs._transform;
 }
 void KpCsvImporter::Open( std::string filename )
 {
@@ -226,6 +227,7 @@ size_t KpCsvImporter::ParsePoseData( Pose * poseClass,
    bool endOfInput )
 {
    size_t offset = 0;
+   _frameData.resize( _currentPose->InputDataSize() );
    while ( _numParsedDoubles < _currentPose->InputDataSize() )
    {
       // Stop if we are out of data
@@ -281,7 +283,7 @@ size_t KpCsvImporter::ParsePoseData( Pose * poseClass,
                double doubleValue = 0.0;
                try
                {
-                  doubleValue = std::stod( stringValue ) * _unitMeterNorm;
+                  doubleValue = std::stod( stringValue );
                }
                catch ( std::invalid_argument & e )
                {
@@ -290,15 +292,8 @@ size_t KpCsvImporter::ParsePoseData( Pose * poseClass,
                   throw std::runtime_error( ss.str() );
                }
                
-               // We need 3 doubles to make a single XYZ value, update the single component here.
-               // Also post-increment our running total
-               int valueIndex = (int)_numParsedDoubles / 3;
-               int componentIndex = (int)_numParsedDoubles % 3;
-               _currentValue[ componentIndex ] = doubleValue;
-               
-               // Update the pose when we have all doubles for this value
-               if ( componentIndex == 2 )
-                  poseClass->Keypoint( _currentValue, valueIndex );
+               // The pose is updated once the whole frame is here
+               _frameData[ _numParsedDoubles ] = doubleValue;
                
                // Move to the end
                offset = size_t(endOfData - data) + 1;
@@ -314,6 +309,10 @@ size_t KpCsvImporter::ParsePoseData( Pose * poseClass,
    
    if ( _numParsedDoubles == _currentPose->InputDataSize() )
    {
+      // Transform the frame's keypoints in one go, then set them
+      _transform.Apply( _frameData.data(), _frameData.size() / 3 );
+      for ( size_t i = 0; i < _frameData.size() / 3; ++i )
+         poseClass->Keypoint( { _frameData[ i * 3 ], _frameData[ i * 3 + 1 ], _frameData[ i * 3 + 2 ] }, (int)i );
       _parseState = HEADER;
    }
    
@@ -24,8 +24,10 @@ public:
    virtual void KeypointLayout( std::map< KEYPOINT_TYPE, int > value ) { _kpLayout = value; }
    virtual const std::map< KEYPOINT_TYPE, int > & KeypointLayout() const { return _kpLayout; }
    virtual IMPORT_TYPE ParserType() const { return IMPORT_TYPE_CSV; }
-   virtual double UnitMeterNorm() const { return _unitMeterNorm; }
-   virtual void UnitMeterNorm(double v) { _unitMeterNorm = v; }
+   virtual double UnitMeterNorm() const { return _transform.Scale(); }
+   virtual void UnitMeterNorm(double v) { _transform.Scale( v ); }
+   virtual const ImportTransform & Transform() const { return _transform; }
+   virtual void Transform( const ImportTransform & value ) { _transform = value; }
    
    virtual KpImporter * Clone() const { return new KpCsvImporter( *this ); }
 
@@ -58,8 +60,8 @@ private:
    
    std::vector< uint8_t > _bufferedParseData;
    std::map< KEYPOINT_TYPE, int > _kpLayout;
-   std::array< double, 3 > _currentValue;
+   std::vector< double > _frameData;
    std::ifstream _ifstream;
-   double _unitMeterNorm = 1.0;
+   ImportTransform _transform;
 };
 #endif
@@ -1,3 +1,4 @@
+#include <cerrno>
 #include <cstring>
 #include <sstream>
 #include <thread>
@@ -5,47 +6,214 @@
 #include "PoseFactory.hpp"
 #include "KpCsvStreamImporter.hpp"
 
+#ifdef _WIN32
+#else
+   #include <fcntl.h>
+   #include <poll.h>
+   #include <unistd.h>
+   #include <sys/socket.h>
+   #include <sys/stat.h>
+   #include <sys/un.h>
+#endif
+
+const int KpCsvStreamImporter::POLL_MILLISECONDS;
+
+namespace
+{
+   // Small reads keep latency low; whatever is left stays in the input until the next read
+   const size_t READ_SIZE = 1 << 16;
+
+   std::runtime_error OpenError( const std::string & what,
+      const std::string & filename )
+   {
+      std::stringstream ss;
+      ss << what << " '" << filename << "'";
+      if ( errno )
+         ss << " (" << strerror( errno ) << ")";
+      return std::runtime_error( ss.str() );
+   }
+}
+
+KpCsvStreamImporter::~KpCsvStreamImporter()
+{
+   Close();
+}
 void KpCsvStreamImporter::Open( std::string filename )
 {
-   (void)filename;
+   std::unique_ptr< Source > source( new Source() );
+   source->name = filename.size() && filename != "-" ? filename : "STDIN";
+   source->Transform( Transform() );
+
+   // STDIN is shared with our parent, so leave it blocking; it's only read once poll() says it's readable
+   if ( filename.empty() || filename == "-" )
+   {
+      source->fd = 0;
+      _sources.push_back( std::move( source ) );
+      return;
+   }
+
+#ifdef _WIN32
+   throw std::runtime_error( "Cannot stream from '" + filename + "': only STDIN is supported on this platform" );
+#else
+   errno = 0;
+   struct stat info;
+   if ( stat( filename.c_str(), &info ) != 0 )
+      throw OpenError( "Could not open", filename );
+
+   if ( S_ISSOCK( info.st_mode ) )
+   {
+      sockaddr_un address;
+      memset( &address, 0, sizeof( address ) );
+      address.sun_family = AF_UNIX;
+      if ( filename.size() >= sizeof( address.sun_path ) )
+         throw std::runtime_error( "Socket path too long '" + filename + "'" );
+      strncpy( address.sun_path, filename.c_str(), sizeof( address.sun_path ) - 1 );
+
+      source->fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+      if ( source->fd < 0 ||
+         connect( source->fd, (const sockaddr *)&address, sizeof( address ) ) != 0 )
+      {
+         std::runtime_error error = OpenError( "Could not connect to", filename );
+         if ( source->fd >= 0 )
+            close( source->fd );
+         throw error;
+      }
+      fcntl( source->fd, F_SETFL, fcntl( source->fd, F_GETFL ) | O_NONBLOCK );
+   }
+   else
+   {
+      // Without O_NONBLOCK, opening a FIFO waits for its writer
+      source->fd = open( filename.c_str(), O_RDONLY | O_NONBLOCK );
+      if ( source->fd < 0 )
+         throw OpenError( "Could not open", filename );
+   }
+   _sources.push_back( std::move( source ) );
+#endif
 }
 std::unique_ptr< Pose > KpCsvStreamImporter::ReadOne()
 {
-   bool endOfFile = false; // Always false for this stream
-   
    if ( IsParseComplete() )
       throw std::runtime_error( "Cannot read: Parse already complete" );
-   
-   // If we haven't any data from a previous read
-   if ( !_readBuffer.size() )
-   {
-      const int BUFFER_SIZE = 1 << 19; // ~512KB
-      _readBuffer.resize( BUFFER_SIZE );
-      
-      std::cin.read( (char *)&_readBuffer[0], BUFFER_SIZE );
 
-      // If nothing was read from stdin
-      if ( std::cin.gcount() == 0 )
-      {
-         // Clear everything, respect the CPU
-         _readBuffer.clear();
-         std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
-      }
-      else
+   // Hand out anything already complete before waiting for more
+   std::unique_ptr< Pose > pose = ParseAny();
+   if ( pose )
+      return pose;
+
+   ReadAvailable();
+   return ParseAny();
+}
+void KpCsvStreamImporter::Close()
+{
+   for ( auto & source : _sources )
+      source->End();
+   _sources.clear();
+}
+bool KpCsvStreamImporter::IsParseComplete() const
+{
+   for ( auto & source : _sources )
+   {
+      if ( !source->ended || source->HasData() )
+         return false;
+   }
+   return true;
+}
+std::unique_ptr< Pose > KpCsvStreamImporter::ParseAny()
+{
+   // Take turns, so one busy input can't starve the others
+   for ( size_t i = 0; i < _sources.size(); ++i )
+   {
+      const size_t index = (_nextSource + i) % _sources.size();
+      std::unique_ptr< Pose > pose = _sources[ index ]->Parse();
+      if ( pose )
       {
-         // Resize to the exact size read in
-         _readBuffer.resize( std::cin.gcount() );
+         _nextSource = index + 1;
+         return pose;
       }
    }
-   
-   size_t bytesRead = (size_t)_readBuffer.size();
-   uint8_t * data = &_readBuffer[0];
-
-   // If we have data
-   size_t offset = 0;
-   std::string keypointType = "";
-   if ( bytesRead )
+   return nullptr;
+}
+void KpCsvStreamImporter::ReadAvailable()
+{
+#ifdef _WIN32
+   for ( auto & source : _sources )
+   {
+      if ( !source->ended )
+         source->Fill();
+   }
+#else
+   std::vector< pollfd > fds;
+   std::vector< Source * > polled;
+   for ( auto & source : _sources )
+   {
+      if ( source->ended )
+         continue;
+      fds.push_back( { source->fd, POLLIN, 0 } );
+      polled.push_back( source.get() );
+   }
+   if ( fds.empty() )
+      return;
+
+   // Interrupted (by SIGINT, say) or timed out, either way the caller gets a chance to stop
+   if ( poll( &fds[0], (nfds_t)fds.size(), POLL_MILLISECONDS ) <= 0 )
+      return;
+
+   for ( size_t i = 0; i < fds.size(); ++i )
+   {
+      if ( fds[ i ].revents & POLLNVAL )
+         polled[ i ]->End();
+      else if ( fds[ i ].revents )
+         polled[ i ]->Fill();
+   }
+#endif
+}
+
+void KpCsvStreamImporter::Source::Fill()
+{
+   // Drop what's been parsed
+   if ( _readOffset )
+   {
+      _readBuffer.erase( std::begin(_readBuffer),
+         std::begin(_readBuffer) + _readOffset );
+      _readOffset = 0;
+   }
+
+   const size_t size = _readBuffer.size();
+   _readBuffer.resize( size + READ_SIZE );
+#ifdef _WIN32
+   std::cin.read( (char *)&_readBuffer[size], READ_SIZE );
+   _readBuffer.resize( size + (size_t)std::cin.gcount() );
+
+   // If nothing was read from stdin, respect the CPU
+   if ( std::cin.gcount() == 0 )
+      std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+#else
+   ssize_t bytesRead = read( fd, &_readBuffer[size], READ_SIZE );
+   _readBuffer.resize( size + (bytesRead > 0 ? (size_t)bytesRead : 0) );
+
+   if ( bytesRead == 0 )
+   {
+      End();
+   }
+   else if ( bytesRead < 0 &&
+      errno != EAGAIN &&
+      errno != EWOULDBLOCK &&
+      errno != EINTR )
    {
+      printf( "Stopped reading '%s'\n\t%s\n", name.c_str(), strerror( errno ) );
+      End();
+   }
+#endif
+}
+std::unique_ptr< Pose > KpCsvStreamImporter::Source::Parse()
+{
+   while ( HasData() )
+   {
+      uint8_t * data = &_readBuffer[ _readOffset ];
+      size_t bytesRead = _readBuffer.size() - _readOffset;
+      size_t offset = 0;
+      std::string keypointType = "";
+
       // If we don't have a current pose
       if ( _currentPose == nullptr )
       {
@@ -60,13 +228,13 @@ std::unique_ptr< Pose > KpCsvStreamImporter::ReadOne()
             // Create a pose using this information
             _currentPose = PoseFactory::Create( keypointType, kpLayout );
          }
-         // Else we need more data
+         // Else we need more data, which the parser has kept
          else
          {
-            _readBuffer.clear();
+            offset = bytesRead;
          }
       }
-      
+
       // If we have a current pose
       if ( _currentPose != nullptr )
       {
@@ -74,28 +242,32 @@ std::unique_ptr< Pose > KpCsvStreamImporter::ReadOne()
             offset += ParseHeader( _currentPose.get(),
                data,
                bytesRead );
-         
+
          if ( offset < bytesRead )
             offset += ParsePoseData( _currentPose.get(),
                data + offset,
                bytesRead - offset,
-               endOfFile );
-      }
-      
-      // Remove the parsed data, if any
-      if ( offset > 0 )
-      {
-         _readBuffer.erase( std::begin(_readBuffer),
-            std::begin(_readBuffer) + offset );
+               ended );
       }
+
+      _readOffset += offset;
+
+      if ( _currentPose != nullptr &&
+         _numParsedDoubles == _currentPose->InputDataSize() )
+         return std::move( _currentPose );
+
+      if ( offset == 0 )
+         break;
    }
-   
-   if ( _currentPose != nullptr &&
-      _numParsedDoubles == _currentPose->InputDataSize() )
-      return std::move( _currentPose );
-   else
-      return nullptr;
+
+   return nullptr;
 }
-void KpCsvStreamImporter::Close()
+void KpCsvStreamImporter::Source::End()
 {
+   ended = true;
+#ifndef _WIN32
+   if ( fd > 0 )
+      close( fd );
+#endif
+   fd = -1;
 }
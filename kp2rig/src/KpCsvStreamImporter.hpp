@@ -1,21 +1,63 @@
 #ifndef KpCsvStreamImporter_hpp
 #define KpCsvStreamImporter_hpp
 
+#include <memory>
+#include <vector>
 #include "KpCsvImporter.hpp"
 
+// Reads keypoint CSV as it arrives, from STDIN or from any number of FIFOs and Unix sockets (one per tracker, say).
+// Inputs are read without blocking as data becomes available, and a pose is returned as soon as all of its values have
+// arrived, so ingest latency doesn't depend on how much data is buffered. Each input is parsed separately, so poses
+// from different inputs may be interleaved at any point.
 class KpCsvStreamImporter : public KpCsvImporter
 {
 public:
-//   KpCsvImporter(){}
-//   KpCsvImporter( const KpCsvImporter & rhs );
-   virtual ~KpCsvStreamImporter(){}
-   
+   KpCsvStreamImporter(){}
+   KpCsvStreamImporter( const KpCsvStreamImporter & rhs ) : KpCsvImporter( rhs ) {}
+   virtual ~KpCsvStreamImporter();
+
+   // Adds an input: "" or "-" for STDIN, otherwise the path of a FIFO, a Unix socket to connect to, or a file.
+   // Call once per input.
    virtual void Open( std::string filename );
+
+   // Returns the next complete pose from any input, waiting up to POLL_MILLISECONDS for more data if there isn't one.
+   // Returns nullptr if no pose is complete yet.
    virtual std::unique_ptr< Pose > ReadOne();
    virtual void Close();
-   
+
+   // True once every input has ended and everything read has been parsed
+   virtual bool IsParseComplete() const;
    virtual IMPORT_TYPE ParserType() const { return IMPORT_TYPE_CSV_STREAM; }
-   
+
    virtual KpImporter * Clone() const { return new KpCsvStreamImporter( *this ); }
+
+   // The longest ReadOne() waits for data, so callers can check whether they've been asked to stop
+   static const int POLL_MILLISECONDS = 100;
+
+private:
+   // One input and its parse state
+   class Source : public KpCsvImporter
+   {
+   public:
+      std::string name;
+      int fd = -1;
+      bool ended = false;
+
+      // Reads whatever is available, without blocking once the input is readable
+      void Fill();
+      // Parses buffered data until a pose is complete or the buffer is used up
+      std::unique_ptr< Pose > Parse();
+      bool HasData() const { return _readOffset < _readBuffer.size(); }
+      void End();
+
+   private:
+      size_t _readOffset = 0;
+   };
+
+   std::unique_ptr< Pose > ParseAny();
+   void ReadAvailable();
+
+   std::vector< std::unique_ptr< Source > > _sources;
+   size_t _nextSource = 0;
 };
 #endif
@@ -4,6 +4,7 @@
 #include "Utility.hpp"
 #include "Pose.hpp"
 #include "RigPose.hpp"
+#include "RestPose.hpp"
 
 bool KpHelper::ValidateSpine( const Pose & pose )
 {
@@ -86,10 +87,9 @@ bool KpHelper::ValidateLegs( const Pose & pose )
    constexpr double tolerance = 0.25;
    double distance;
    const Rig & rig = pose.RigPose().GetRig();
-   Eigen::Vector3d forwardVector( 0, 0, 1 );
    Eigen::Vector3d rigPelvis = Utility::RawToVector( rig.location );
    Eigen::Quaterniond pelvisQuaternion = Utility::RawToQuaternion( rig.pelvis.quaternion );
-   Eigen::Quaterniond hipAdjustmentRotation( Eigen::AngleAxisd( M_PI, forwardVector ) );
+   const Eigen::Quaterniond & hipAdjustmentRotation = RestPose::Humanoid().hipAdjustment;
    Eigen::Quaterniond q;
    Eigen::Vector3d boneVector;
 
@@ -154,7 +154,6 @@ bool KpHelper::ValidateArms( const Pose & pose )
    const double tolerance = 0.25;
    double distance;
    const Rig & rig = pose.RigPose().GetRig();
-   Eigen::Vector3d forwardVector( 0, 0, 1 );
 
    Eigen::Vector3d torsoLocation = Utility::RawToVector( rig.location );
    Eigen::Quaterniond q = Utility::RawToQuaternion( rig.pelvis.quaternion );
@@ -184,7 +183,7 @@ bool KpHelper::ValidateArms( const Pose & pose )
    
    // RIGHT ARM
    {
-      Eigen::Quaterniond rShoulderAdjustmentRotatation = spine4Quaternion * Eigen::AngleAxisd( M_PI / 2, forwardVector );
+      Eigen::Quaterniond rShoulderAdjustmentRotatation = spine4Quaternion * RestPose::Humanoid().rShoulderAdjustment;
       
       // rShoulder
       Eigen::Vector3d parentLocation = torsoLocation;
@@ -224,7 +223,7 @@ bool KpHelper::ValidateArms( const Pose & pose )
    
    // LEFT ARM
    {
-      Eigen::Quaterniond lShoulderAdjustmentRotatation = spine4Quaternion * Eigen::AngleAxisd( -M_PI / 2, forwardVector );
+      Eigen::Quaterniond lShoulderAdjustmentRotatation = spine4Quaternion * RestPose::Humanoid().lShoulderAdjustment;
       
       // lShoulder
       Eigen::Vector3d parentLocation = torsoLocation;
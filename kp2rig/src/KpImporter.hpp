@@ -3,6 +3,7 @@
 
 #include <map>
 #include "KpType.hpp"
+#include "ImportTransform.hpp"
 
 class Pose;
 
@@ -30,6 +31,10 @@ public:
    virtual double UnitMeterNorm() const = 0;
    virtual void UnitMeterNorm(double v) = 0;
    
+   // Applied to each frame's keypoints as it's read; UnitMeterNorm() is its scale
+   virtual const ImportTransform & Transform() const = 0;
+   virtual void Transform( const ImportTransform & value ) = 0;
+   
    // Prototype pattern
    virtual KpImporter * Clone() const = 0;
 };
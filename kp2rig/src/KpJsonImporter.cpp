@@ -107,21 +107,26 @@ std::unique_ptr< Pose > KpJsonImporter::ReadOne()
          returnValue->Name( name );
          returnValue->Timestamp( timestamp );
          
-         // Get the keypoints
+         // Get the keypoints, stopping if there are more than expected
          try
          {
+            const size_t numKeypoints = returnValue->InputDataSize() / 3;
+            _frameData.resize( numKeypoints * 3 );
             size_t valueIndex = 0;
             for ( auto & jsonKeypoint : jsonCharacter[ "skeleton" ] )
             {
-               std::array< double, 3 > keypointValue = { jsonKeypoint[0].get<double>() * _unitMeterNorm,
-                  jsonKeypoint[1].get<double>() * _unitMeterNorm,
-                  jsonKeypoint[2].get<double>() * _unitMeterNorm };
-               returnValue->Keypoint( keypointValue, (int)valueIndex++ );
-               
-               // Stop if there are more keypoints than expected
-               if ( valueIndex > kpLayout.size() )
+               if ( valueIndex == numKeypoints )
                   break;
+               _frameData[ valueIndex * 3 ] = jsonKeypoint[0].get<double>();
+               _frameData[ valueIndex * 3 + 1 ] = jsonKeypoint[1].get<double>();
+               _frameData[ valueIndex * 3 + 2 ] = jsonKeypoint[2].get<double>();
+               ++valueIndex;
             }
+            
+            // Transform them in one go, then set them
+            _transform.Apply( _frameData.data(), valueIndex );
+            for ( size_t i = 0; i < valueIndex; ++i )
+               returnValue->Keypoint( { _frameData[ i * 3 ], _frameData[ i * 3 + 1 ], _frameData[ i * 3 + 2 ] }, (int)i );
          }
          catch ( std::domain_error & )
          {
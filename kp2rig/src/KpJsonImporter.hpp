@@ -21,8 +21,10 @@ public:
    virtual void KeypointLayout( std::map< KEYPOINT_TYPE, int > value ) { _kpLayout = value; }
    virtual const std::map< KEYPOINT_TYPE, int > & KeypointLayout() const { return _kpLayout; }
    virtual IMPORT_TYPE ParserType() const { return IMPORT_TYPE_JSON; }
-   virtual double UnitMeterNorm() const { return _unitMeterNorm; }
-   virtual void UnitMeterNorm(double v) { _unitMeterNorm = v; }
+   virtual double UnitMeterNorm() const { return _transform.Scale(); }
+   virtual void UnitMeterNorm(double v) { _transform.Scale( v ); }
+   virtual const ImportTransform & Transform() const { return _transform; }
+   virtual void Transform( const ImportTransform & value ) { _transform = value; }
    
    virtual KpImporter * Clone() const { return new KpJsonImporter( *this ); }
 
@@ -36,6 +38,7 @@ private:
    nlohmann::json::iterator _currentPlayerIt;
    bool _parseComplete = false;
    std::map< KEYPOINT_TYPE, int > _kpLayout;
-   double _unitMeterNorm = 1.0;
+   std::vector< double > _frameData;
+   ImportTransform _transform;
 };
 #endif
@@ -40,13 +40,13 @@ public:
    virtual const std::array< double, 3 > & Keypoint( KEYPOINT_TYPE type ) const;
    virtual std::array< double, 3 > & Keypoint( KEYPOINT_TYPE type );
    virtual bool HasKeypoint( KEYPOINT_TYPE type ) const;
-   virtual class RigPose & GenerateRig();
    virtual void FromRigPose( const class RigPose & rigPose );
    virtual void InputDataToArray( std::vector< double > & serializedList );
    virtual size_t InputDataSize() const { return FRAME_DATA_SIZE; }
    virtual const class RigPose & RigPose() const;
    virtual class RigPose & RigPose();
    virtual std::string Category() const { return "humanoid"; }
+   virtual bool UsesHumanoidCore() const { return true; }
    virtual bool ValidateRig() const;
    virtual void CoordinateSystem( std::array< double, 3 > value );
    virtual const std::array< double, 3 > & CoordinateSystem() const;
@@ -56,10 +56,12 @@ protected:
    virtual void HandleFeet();
    
 private:
+   virtual void SolveRig();
+   virtual void SolveExtremities();
+   
    Mop_14 _keypoints;
    
    class RigPose _rigPose;
-   bool _rigCreated = false;
    const int FRAME_DATA_SIZE = sizeof( _keypoints ) / sizeof( double );
    std::array< double, 3 > _coordinateSystem;
 };
@@ -75,10 +77,12 @@ inline RigPose & KpMop_14::RigPose()
 inline void KpMop_14::Keypoint( std::array< double, 3 > value, int index )
 {
    *((std::array< double, 3 > *)&_keypoints + index) = value;
-   _rigCreated = false;
+   _state = FRAME_STATE_RAW;
 }
 inline std::array< double, 3 > & KpMop_14::Keypoint( KEYPOINT_TYPE type )
 {
+   // The caller may change it
+   _state = FRAME_STATE_RAW;
    return const_cast< std::array< double, 3 > &>(static_cast<const Pose &>(*this).Keypoint( type ) );
 }
 inline bool KpMop_14::HasKeypoint( KEYPOINT_TYPE type ) const
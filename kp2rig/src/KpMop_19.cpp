@@ -19,32 +19,24 @@ KpMop_19::KpMop_19( const KpMop_19 & rhs )
 {
    _keypoints = rhs._keypoints;
    _rigPose = rhs._rigPose;
-   _rigCreated = rhs._rigCreated;
    _coordinateSystem = rhs._coordinateSystem;
 }
-RigPose & KpMop_19::GenerateRig()
+void KpMop_19::SolveRig()
 {
-   if ( _rigCreated )
-      return _rigPose;
+   // Spine (including baseNeck and baseHead), legs and arms, the same way RigSolver solves a block of these
+   KpToRigHelper::HandleCore( *this );
    
+   SolveExtremities();
+}
+void KpMop_19::SolveExtremities()
+{
    _rigPose.Timestamp( Timestamp() );
    
-   // Spine, including baseNeck and baseHead
-   KpToRigHelper::HandleSpine( *this );
-   
-   // Legs (not feet)
-   KpToRigHelper::HandleLegs( *this );
-
-   // Arms (not hands)
-   KpToRigHelper::HandleArms( *this );
-   
    // Deal with hands and feet
    HandleHands();
    HandleFeet();
    
    _rigPose.KpType( KpType() );
-   _rigCreated = true;
-   return _rigPose;
 }
 void KpMop_19::FromRigPose( const class RigPose & rigPose )
 {
@@ -55,7 +47,7 @@ void KpMop_19::FromRigPose( const class RigPose & rigPose )
    RigToKpHelper::HandleArms( *this );
    
    _timestamp = rigPose.Timestamp();
-   _rigCreated = true;
+   _state = FRAME_STATE_SOLVED;
 }
 void KpMop_19::InputDataToArray( std::vector< double > & serializedList )
 {
@@ -76,6 +68,7 @@ bool KpMop_19::ValidateRig() const
 void KpMop_19::CoordinateSystem( std::array< double, 3 > value )
 {
    _coordinateSystem = value;
+   _state = FRAME_STATE_RAW;
    std::array< double, 3 > * keypointsByOffset = reinterpret_cast< std::array< double, 3 > * >( &_keypoints );
    
    for ( size_t i = 0; i < InputDataSize() / 3; ++i )
@@ -94,7 +87,7 @@ void KpMop_19::CoordinateSystem( std::array< double, 3 > value )
 void KpMop_19::HandleHands()
 {
    Rig & rig = _rigPose.GetRig();
-   Rig restPose = Rig::RestPoseHumanoid();
+   const Rig & restPose = Rig::RestPoseHumanoid();
    
    // Guess the hands, starting with the wrist
    rig.rWrist.length = (rig.rElbow.length / restPose.rElbow.length) * restPose.rWrist.length;
@@ -107,7 +100,7 @@ void KpMop_19::HandleHands()
 void KpMop_19::HandleFeet()
 {
    Rig & rig = _rigPose.GetRig();
-   Rig restPose = Rig::RestPoseHumanoid();
+   const Rig & restPose = Rig::RestPoseHumanoid();
 
    // Guess the ankle
    rig.rAnkle.length = (rig.rKnee.length / restPose.rKnee.length) * restPose.rAnkle.length;
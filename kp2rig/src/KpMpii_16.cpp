@@ -19,32 +19,24 @@ KpMpii_16::KpMpii_16( const KpMpii_16 & rhs )
 {
    _keypoints = rhs._keypoints;
    _rigPose = rhs._rigPose;
-   _rigCreated = rhs._rigCreated;
    _coordinateSystem = rhs._coordinateSystem;
 }
-RigPose & KpMpii_16::GenerateRig()
+void KpMpii_16::SolveRig()
 {
-   if ( _rigCreated )
-      return _rigPose;
+   // Spine (including baseNeck and baseHead), legs and arms, the same way RigSolver solves a block of these
+   KpToRigHelper::HandleCore( *this );
    
+   SolveExtremities();
+}
+void KpMpii_16::SolveExtremities()
+{
    _rigPose.Timestamp( Timestamp() );
    
-   // Spine, including baseNeck and baseHead
-   KpToRigHelper::HandleSpine( *this );
-   
-   // Legs (not feet)
-   KpToRigHelper::HandleLegs( *this );
-
-   // Arms (not hands)
-   KpToRigHelper::HandleArms( *this );
-   
    // Deal with hands and feet
    HandleHands();
    HandleFeet();
    
    _rigPose.KpType( KpType() );
-   _rigCreated = true;
-   return _rigPose;
 }
 void KpMpii_16::FromRigPose( const class RigPose & rigPose )
 {
@@ -55,7 +47,7 @@ void KpMpii_16::FromRigPose( const class RigPose & rigPose )
    RigToKpHelper::HandleArms( *this );
    
    _timestamp = rigPose.Timestamp();
-   _rigCreated = true;
+   _state = FRAME_STATE_SOLVED;
 }
 void KpMpii_16::InputDataToArray( std::vector< double > & serializedList )
 {
@@ -83,6 +75,7 @@ bool KpMpii_16::ValidateRig() const
 void KpMpii_16::CoordinateSystem( std::array< double, 3 > value )
 {
    _coordinateSystem = value;
+   _state = FRAME_STATE_RAW;
    std::array< double, 3 > * keypointsByOffset = reinterpret_cast< std::array< double, 3 > * >( &_keypoints );
    
    for ( size_t i = 0; i < InputDataSize() / 3; ++i )
@@ -101,7 +94,7 @@ void KpMpii_16::CoordinateSystem( std::array< double, 3 > value )
 void KpMpii_16::HandleHands()
 {
    Rig & rig = _rigPose.GetRig();
-   Rig restPose = Rig::RestPoseHumanoid();
+   const Rig & restPose = Rig::RestPoseHumanoid();
    
    // Guess the hands, starting with the wrist
    rig.rWrist.length = (rig.rElbow.length / restPose.rElbow.length) * restPose.rWrist.length;
@@ -114,7 +107,7 @@ void KpMpii_16::HandleHands()
 void KpMpii_16::HandleFeet()
 {
    Rig & rig = _rigPose.GetRig();
-   Rig restPose = Rig::RestPoseHumanoid();
+   const Rig & restPose = Rig::RestPoseHumanoid();
   
    // Guess the ankle
    rig.rAnkle.length = (rig.rKnee.length / restPose.rKnee.length) * restPose.rAnkle.length;
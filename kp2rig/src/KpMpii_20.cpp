@@ -7,6 +7,7 @@
 #include "KpToRigHelper.hpp"
 #include "RigToKpHelper.hpp"
 #include "KpHelper.hpp"
+#include "RestPose.hpp"
 #include "Utility.hpp"
 
 KpMpii_20::KpMpii_20( std::string kpType,
@@ -19,39 +20,30 @@ KpMpii_20::KpMpii_20( const KpMpii_20 & rhs )
 {
    _keypoints = rhs._keypoints;
    _rigPose = rhs._rigPose;
-   _rigCreated = rhs._rigCreated;
    _coordinateSystem = rhs._coordinateSystem;
 }
-RigPose & KpMpii_20::GenerateRig()
+void KpMpii_20::SolveRig()
 {
-   if ( _rigCreated )
-      return _rigPose;
-      
-   _rigPose.Timestamp( Timestamp() );
-   
-   // Spine, including baseNeck and baseHead
-   KpToRigHelper::HandleSpine( *this );
+   // Spine (including baseNeck and baseHead), legs and arms, the same way RigSolver solves a block of these
+   KpToRigHelper::HandleCore( *this );
    
-   // Legs (not feet)
-   KpToRigHelper::HandleLegs( *this );
-
-   // Arms (not hands)
-   KpToRigHelper::HandleArms( *this );
+   SolveExtremities();
+}
+void KpMpii_20::SolveExtremities()
+{
+   _rigPose.Timestamp( Timestamp() );
    
    // Deal with hands and feet
    HandleHands();
    HandleFeet();
    
    _rigPose.KpType( KpType() );
-   _rigCreated = true;
-   return _rigPose;
 }
 void KpMpii_20::FromRigPose( const class RigPose & rigPose )
 {
    _rigPose = rigPose;
    Rig & rig = _rigPose.GetRig();
-   const Rig & restPose = Rig::RestPoseHumanoid();
-   const double ankleToeRatio = restPose.rAnkle.length / (restPose.rAnkle.length + restPose.rToeBase.length);
+   const double ankleToeRatio = RestPose::Humanoid().ankleToeRatio;
    
    RigToKpHelper::HandleSpine( *this );
    RigToKpHelper::HandleLegs( *this );
@@ -72,26 +64,20 @@ void KpMpii_20::FromRigPose( const class RigPose & rigPose )
    _keypoints.rightFootTip = Utility::VectorToRaw( childLocation );
    
    // Handle supplimentary joints
-   for ( auto jointPair : rigPose.SupplimentaryJoints )
+   for ( const SupplimentaryJoint & joint : rigPose.SupplimentaryJoints )
    {
-      // Get the keypoint type
-      auto keypointType = StrToKpType( jointPair.second.parentName );
-      
-      // Get the parent location
-      // I'm using both the keypoint and the rig to avoid walking the entire hiearchy
-      const Joint & parentJoint = rigPose.GetRig().GetJoint( jointPair.second.parentName );
-      Eigen::Vector3d boneVector = Utility::RawToQuaternion( parentJoint.quaternionAbs )._transformVector( Eigen::Vector3d::UnitY() ) * parentJoint.length;
-      auto parentLocation = Utility::RawToVector( Keypoint( keypointType ) ) + boneVector;
+      // Get the parent location, supplimentary joints attach to the head of their parent
+      auto parentLocation = Utility::RawToVector( Keypoint( joint.parentType ) );
       
       // Get the bone vector
-      boneVector = Utility::RawToQuaternion( jointPair.second.quaternionAbs )._transformVector( Eigen::Vector3d::UnitY() ) * jointPair.second.length;
+      Eigen::Vector3d boneVector = Utility::RawToQuaternion( joint.quaternionAbs )._transformVector( Eigen::Vector3d::UnitY() ) * joint.length;
 
       // Add the keypoint
-      Keypoint( Utility::VectorToRaw( parentLocation + boneVector ), keypointType );
+      Keypoint( Utility::VectorToRaw( parentLocation + boneVector ), joint.type );
    }
    
    _timestamp = rigPose.Timestamp();
-   _rigCreated = true;
+   _state = FRAME_STATE_SOLVED;
 }
 void KpMpii_20::InputDataToArray( std::vector< double > & serializedList )
 {
@@ -121,6 +107,7 @@ bool KpMpii_20::ValidateRig() const
 void KpMpii_20::CoordinateSystem( std::array< double, 3 > value )
 {
    _coordinateSystem = value;
+   _state = FRAME_STATE_RAW;
    std::array< double, 3 > * keypointsByOffset = reinterpret_cast< std::array< double, 3 > * >( &_keypoints );
    
    for ( size_t i = 0; i < InputDataSize() / 3; ++i )
@@ -142,7 +129,7 @@ void KpMpii_20::CoordinateSystem( std::array< double, 3 > value )
 void KpMpii_20::HandleHands()
 {
    Rig & rig = _rigPose.GetRig();
-   Rig restPose = Rig::RestPoseHumanoid();
+   const Rig & restPose = Rig::RestPoseHumanoid();
    
    // Guess the hands, starting with the wrist
    rig.rWrist.length = (rig.rElbow.length / restPose.rElbow.length) * restPose.rWrist.length;
@@ -162,7 +149,7 @@ void KpMpii_20::HandleFeet()
    //   * heel        * tip
    //-------------------------------------------------------------------
    Rig & rig = _rigPose.GetRig();
-   Rig restPose = Rig::RestPoseHumanoid();
+   const Rig & restPose = Rig::RestPoseHumanoid();
    
    Eigen::Vector3d rAnkle( _keypoints.rightAnkle[0], _keypoints.rightAnkle[1], _keypoints.rightAnkle[2] );
    Eigen::Vector3d lAnkle( _keypoints.leftAnkle[0], _keypoints.leftAnkle[1], _keypoints.leftAnkle[2] );
@@ -179,7 +166,7 @@ void KpMpii_20::HandleFeet()
    //  a) both feet are the same size
    //  b) the distance from the ankle to the ball of the foot is the same as from the heel to the ball of the foot
    // Armed with these somewhat sketchy assumptions, use the rest pose to determine the length ratio from ankle to ball/tip of the foot.
-   const double ballTipLengthRatio = restPose.rAnkle.length / (restPose.rAnkle.length + restPose.rToeBase.length);
+   const double ballTipLengthRatio = RestPose::Humanoid().ankleToeRatio;
 
    // Absolute rotations of ankles if bottom of foot is perpendicular to straight legs (like in our rest pose)
    Eigen::Quaterniond rAnkleRestPoseAdjustment = Utility::RawToQuaternion( rig.rKnee.quaternionAbs ) * Utility::RawToQuaternion( restPose.rAnkle.quaternion );
@@ -204,13 +191,12 @@ void KpMpii_20::HandleFeet()
    rig.lToeBase.quaternionAbs = Utility::QuaternionToRaw( Utility::RawToQuaternion( rig.lAnkle.quaternionAbs ) * Utility::RawToQuaternion( restPose.lToeBase.quaternion ) );
    
    // Heel is a supplimentary joint
-   _rigPose.SupplimentaryJoints[ "rightHeel" ] = SupplimentaryJoint( "rightHeel", "rightAnkle", KpToRigHelper::CreateJoint( rig.rAnkle, rHeel - rAnkle ) );
-   _rigPose.SupplimentaryJoints[ "leftHeel"  ] = SupplimentaryJoint( "leftHeel",  "leftAnkle",  KpToRigHelper::CreateJoint( rig.lAnkle, lHeel - lAnkle ) );
+   _rigPose.SupplimentaryJoints.Set( RIGHT_HEEL, RIGHT_ANKLE, KpToRigHelper::CreateJoint( rig.rAnkle, rHeel - rAnkle ) );
+   _rigPose.SupplimentaryJoints.Set( LEFT_HEEL,  LEFT_ANKLE,  KpToRigHelper::CreateJoint( rig.lAnkle, lHeel - lAnkle ) );
 }
 bool KpMpii_20::ValidateFeet() const
 {
    const Rig & rig = _rigPose.GetRig();
-   Rig restPose = Rig::RestPoseHumanoid();
    constexpr double tolerance = 0.25;
    
    // Get the absolute location of the ankles
@@ -218,13 +204,13 @@ bool KpMpii_20::ValidateFeet() const
    auto lAnkleLocation = RigToKpHelper::WorldCoordinates( rig, Rig::LANKLE );
 
    // Heel
-   auto joint = _rigPose.SupplimentaryJoints.at( "rightHeel" );
+   auto joint = _rigPose.SupplimentaryJoints.At( RIGHT_HEEL );
    Eigen::Quaterniond q = Utility::RawToQuaternion( joint.quaternionAbs );
    Eigen::Vector3d vec = q._transformVector( Eigen::Vector3d::UnitY() ) * joint.length;
    double distance = (Utility::RawToVector(rAnkleLocation) + vec - Utility::RawToVector(Keypoint(RIGHT_HEEL))).norm();
    if ( distance > tolerance )
       return false;
-   joint = _rigPose.SupplimentaryJoints.at( "leftHeel" );
+   joint = _rigPose.SupplimentaryJoints.At( LEFT_HEEL );
    q = Utility::RawToQuaternion( joint.quaternionAbs );
    vec = q._transformVector( Eigen::Vector3d::UnitY() ) * joint.length;
    distance = (Utility::RawToVector(lAnkleLocation) + vec - Utility::RawToVector(Keypoint(LEFT_HEEL))).norm();
@@ -7,6 +7,7 @@
 #include "KpToRigHelper.hpp"
 #include "RigToKpHelper.hpp"
 #include "KpHelper.hpp"
+#include "RestPose.hpp"
 
 // Helper functions
 Eigen::Vector3d GetTipOfFoot( const Eigen::Vector3d & bigToe,
@@ -23,32 +24,24 @@ KpMpii_27::KpMpii_27( const KpMpii_27 & rhs )
 {
    _keypoints = rhs._keypoints;
    _rigPose = rhs._rigPose;
-   _rigCreated = rhs._rigCreated;
    _coordinateSystem = rhs._coordinateSystem;
 }
-RigPose & KpMpii_27::GenerateRig()
+void KpMpii_27::SolveRig()
 {
-   if ( _rigCreated )
-      return _rigPose;
-      
-   _rigPose.Timestamp( Timestamp() );
+   // Spine (including baseNeck and baseHead), legs and arms, the same way RigSolver solves a block of these
+   KpToRigHelper::HandleCore( *this );
    
-   // Spine, including baseNeck and baseHead
-   KpToRigHelper::HandleSpine( *this );
-   
-   // Legs (not feet)
-   KpToRigHelper::HandleLegs( *this );
-
-   // Arms (not hands)
-   KpToRigHelper::HandleArms( *this );
+   SolveExtremities();
+}
+void KpMpii_27::SolveExtremities()
+{
+   _rigPose.Timestamp( Timestamp() );
    
    // Deal with hands and feet
    HandleHands();
    HandleFeet();
    
    _rigPose.KpType( KpType() );
-   _rigCreated = true;
-   return _rigPose;
 }
 void KpMpii_27::FromRigPose( const class RigPose & rigPose )
 {
@@ -59,12 +52,12 @@ void KpMpii_27::FromRigPose( const class RigPose & rigPose )
    RigToKpHelper::HandleArms( *this );
    
    // Handle supplimentary joints
-   for ( auto jointPair : rigPose.SupplimentaryJoints )
+   for ( const SupplimentaryJoint & joint : rigPose.SupplimentaryJoints )
    {
       // Get the parent location
       // I'm using both the keypoint and the rig to avoid walking the entire hiearchy
-      const Joint & parentJoint = rigPose.GetRig().GetJoint( jointPair.second.parentName );
-      auto parentLocation = Utility::RawToVector( Keypoint( StrToKpType( jointPair.second.parentName ) ) );
+      const Joint & parentJoint = rigPose.GetRig().GetJoint( joint.parent );
+      auto parentLocation = Utility::RawToVector( Keypoint( joint.parentType ) );
       
       // If attaching to the parent's tail
       if ( 0 ) // TODO: our supplimentary joints attach to the head of the parent joint, but if this changes we will need a real condition here
@@ -74,14 +67,14 @@ void KpMpii_27::FromRigPose( const class RigPose & rigPose )
       }
       
       // Get the bone vector
-      Eigen::Vector3d boneVector = Utility::RawToQuaternion( jointPair.second.quaternionAbs )._transformVector( Eigen::Vector3d::UnitY() ) * jointPair.second.length;
+      Eigen::Vector3d boneVector = Utility::RawToQuaternion( joint.quaternionAbs )._transformVector( Eigen::Vector3d::UnitY() ) * joint.length;
 
       // Add the keypoint
-      Keypoint( Utility::VectorToRaw( parentLocation + boneVector ), StrToKpType( jointPair.second.name ) );
+      Keypoint( Utility::VectorToRaw( parentLocation + boneVector ), joint.type );
    }
    
    _timestamp = rigPose.Timestamp();
-   _rigCreated = true;
+   _state = FRAME_STATE_SOLVED;
 }
 void KpMpii_27::InputDataToArray( std::vector< double > & serializedList )
 {
@@ -111,6 +104,7 @@ bool KpMpii_27::ValidateRig() const
 void KpMpii_27::CoordinateSystem( std::array< double, 3 > value )
 {
    _coordinateSystem = value;
+   _state = FRAME_STATE_RAW;
    std::array< double, 3 > * keypointsByOffset = reinterpret_cast< std::array< double, 3 > * >( &_keypoints );
    
    for ( size_t i = 0; i < InputDataSize() / 3; ++i )
@@ -135,7 +129,7 @@ void KpMpii_27::CoordinateSystem( std::array< double, 3 > value )
 void KpMpii_27::HandleHands()
 {
    Rig & rig = _rigPose.GetRig();
-   Rig restPose = Rig::RestPoseHumanoid();
+   const Rig & restPose = Rig::RestPoseHumanoid();
    
    // Guess the hands, starting with the wrist
    rig.rWrist.length = (rig.rElbow.length / restPose.rElbow.length) * restPose.rWrist.length;
@@ -148,7 +142,7 @@ void KpMpii_27::HandleHands()
 void KpMpii_27::HandleFeet()
 {
    Rig & rig = _rigPose.GetRig();
-   Rig restPose = Rig::RestPoseHumanoid();
+   const Rig & restPose = Rig::RestPoseHumanoid();
    
    Eigen::Vector3d forwardVector( 0, 0, 1 );
    Eigen::Vector3d rAnkle( _keypoints.rightAnkle[0], _keypoints.rightAnkle[1], _keypoints.rightAnkle[2] );
@@ -169,7 +163,7 @@ void KpMpii_27::HandleFeet()
    
    Eigen::Vector3d rAnkleToToe = rToe - rAnkle;
    Eigen::Vector3d lAnkleToToe = lToe - lAnkle;
-   const double ankleToeRatio = restPose.rAnkle.length / (restPose.rAnkle.length + restPose.rToeBase.length);
+   const double ankleToeRatio = RestPose::Humanoid().ankleToeRatio;
    
    // Rest poses
    Eigen::Quaterniond rAnkleRestPoseAdjustment = rKneeRotationAbs * Utility::RawToQuaternion( restPose.rAnkle.quaternion );
@@ -226,12 +220,12 @@ void KpMpii_27::HandleFeet()
    rig.lToeBase.quaternionAbs = Utility::QuaternionToRaw( Utility::RawToQuaternion( rig.lAnkle.quaternionAbs ) * Utility::RawToQuaternion( restPose.lToeBase.quaternion ) );
    
    // Heel, big toe, and small toe are supplimentary joints
-   _rigPose.SupplimentaryJoints[ "rightHeel"    ] = SupplimentaryJoint( "rightHeel",     "rightAnkle", KpToRigHelper::CreateJoint( rig.rAnkle, rHeel - rAnkle ) );
-   _rigPose.SupplimentaryJoints[ "rightBigToe"  ] = SupplimentaryJoint( "rightBigToe",   "rightAnkle", KpToRigHelper::CreateJoint( rig.rAnkle, rBigToe - rAnkle ) );
-   _rigPose.SupplimentaryJoints[ "rightSmallToe"] = SupplimentaryJoint( "rightSmallToe", "rightAnkle", KpToRigHelper::CreateJoint( rig.rAnkle, rSmallToe - rAnkle ) );
-   _rigPose.SupplimentaryJoints[ "leftHeel"     ] = SupplimentaryJoint( "leftHeel",      "leftAnkle",  KpToRigHelper::CreateJoint( rig.lAnkle, lHeel - lAnkle ) );
-   _rigPose.SupplimentaryJoints[ "leftBigToe"   ] = SupplimentaryJoint( "leftBigToe",    "leftAnkle",  KpToRigHelper::CreateJoint( rig.lAnkle, lBigToe - lAnkle ) );
-   _rigPose.SupplimentaryJoints[ "leftSmallToe" ] = SupplimentaryJoint( "leftSmallToe",  "leftAnkle",  KpToRigHelper::CreateJoint( rig.lAnkle, lSmallToe - lAnkle ) );
+   _rigPose.SupplimentaryJoints.Set( RIGHT_HEEL,      RIGHT_ANKLE, KpToRigHelper::CreateJoint( rig.rAnkle, rHeel - rAnkle ) );
+   _rigPose.SupplimentaryJoints.Set( RIGHT_BIG_TOE,   RIGHT_ANKLE, KpToRigHelper::CreateJoint( rig.rAnkle, rBigToe - rAnkle ) );
+   _rigPose.SupplimentaryJoints.Set( RIGHT_SMALL_TOE, RIGHT_ANKLE, KpToRigHelper::CreateJoint( rig.rAnkle, rSmallToe - rAnkle ) );
+   _rigPose.SupplimentaryJoints.Set( LEFT_HEEL,       LEFT_ANKLE,  KpToRigHelper::CreateJoint( rig.lAnkle, lHeel - lAnkle ) );
+   _rigPose.SupplimentaryJoints.Set( LEFT_BIG_TOE,    LEFT_ANKLE,  KpToRigHelper::CreateJoint( rig.lAnkle, lBigToe - lAnkle ) );
+   _rigPose.SupplimentaryJoints.Set( LEFT_SMALL_TOE,  LEFT_ANKLE,  KpToRigHelper::CreateJoint( rig.lAnkle, lSmallToe - lAnkle ) );
 }
 Eigen::Vector3d GetTipOfFoot( const Eigen::Vector3d & bigToe,
    const Eigen::Vector3d & smallToe,
@@ -287,7 +281,6 @@ Eigen::Vector3d GetTipOfFoot( const Eigen::Vector3d & bigToe,
 bool KpMpii_27::ValidateFeet() const
 {
    const Rig & rig = _rigPose.GetRig();
-   Rig restPose = Rig::RestPoseHumanoid();
    constexpr double tolerance = 0.25;
    
    // Get the absolute location of the ankles
@@ -295,13 +288,13 @@ bool KpMpii_27::ValidateFeet() const
    auto lAnkleLocation = RigToKpHelper::WorldCoordinates( rig, Rig::LANKLE );
    
    // Heel
-   auto joint = _rigPose.SupplimentaryJoints.at( "rightHeel" );
+   auto joint = _rigPose.SupplimentaryJoints.At( RIGHT_HEEL );
    Eigen::Quaterniond q = Utility::RawToQuaternion( joint.quaternionAbs );
    Eigen::Vector3d vec = q._transformVector( Eigen::Vector3d::UnitY() ) * joint.length;
    double distance = (Utility::RawToVector(rAnkleLocation) + vec - Utility::RawToVector(Keypoint(RIGHT_HEEL))).norm();
    if ( distance > tolerance )
       return false;
-   joint = _rigPose.SupplimentaryJoints.at( "leftHeel" );
+   joint = _rigPose.SupplimentaryJoints.At( LEFT_HEEL );
    q = Utility::RawToQuaternion( joint.quaternionAbs );
    vec = q._transformVector( Eigen::Vector3d::UnitY() ) * joint.length;
    distance = (Utility::RawToVector(lAnkleLocation) + vec - Utility::RawToVector(Keypoint(LEFT_HEEL))).norm();
@@ -309,13 +302,13 @@ bool KpMpii_27::ValidateFeet() const
       return false;
 
    // Big toe
-   joint = _rigPose.SupplimentaryJoints.at( "rightBigToe" );
+   joint = _rigPose.SupplimentaryJoints.At( RIGHT_BIG_TOE );
    q = Utility::RawToQuaternion( joint.quaternionAbs );
    vec = q._transformVector( Eigen::Vector3d::UnitY() ) * joint.length;
    distance = (Utility::RawToVector(rAnkleLocation) + vec - Utility::RawToVector(Keypoint(RIGHT_BIG_TOE))).norm();
    if ( distance > tolerance )
       return false;
-   joint = _rigPose.SupplimentaryJoints.at( "leftBigToe" );
+   joint = _rigPose.SupplimentaryJoints.At( LEFT_BIG_TOE );
    q = Utility::RawToQuaternion( joint.quaternionAbs );
    vec = q._transformVector( Eigen::Vector3d::UnitY() ) * joint.length;
    distance = (Utility::RawToVector(lAnkleLocation) + vec - Utility::RawToVector(Keypoint(LEFT_BIG_TOE))).norm();
@@ -323,13 +316,13 @@ bool KpMpii_27::ValidateFeet() const
       return false;
       
    // Small toe
-   joint = _rigPose.SupplimentaryJoints.at( "rightSmallToe" );
+   joint = _rigPose.SupplimentaryJoints.At( RIGHT_SMALL_TOE );
    q = Utility::RawToQuaternion( joint.quaternionAbs );
    vec = q._transformVector( Eigen::Vector3d::UnitY() ) * joint.length;
    distance = (Utility::RawToVector(rAnkleLocation) + vec - Utility::RawToVector(Keypoint(RIGHT_SMALL_TOE))).norm();
    if ( distance > tolerance )
       return false;
-   joint = _rigPose.SupplimentaryJoints.at( "leftSmallToe" );
+   joint = _rigPose.SupplimentaryJoints.At( LEFT_SMALL_TOE );
    q = Utility::RawToQuaternion( joint.quaternionAbs );
    vec = q._transformVector( Eigen::Vector3d::UnitY() ) * joint.length;
    distance = (Utility::RawToVector(lAnkleLocation) + vec - Utility::RawToVector(Keypoint(LEFT_SMALL_TOE))).norm();
@@ -54,13 +54,13 @@ public:
    virtual const std::array< double, 3 > & Keypoint( KEYPOINT_TYPE type ) const;
    virtual std::array< double, 3 > & Keypoint( KEYPOINT_TYPE type );
    virtual bool HasKeypoint( KEYPOINT_TYPE type ) const;
-   virtual class RigPose & GenerateRig();
    virtual void FromRigPose( const class RigPose & rigPose );
    virtual void InputDataToArray( std::vector< double > & serializedList );
    virtual size_t InputDataSize() const { return FRAME_DATA_SIZE; }
    virtual const class RigPose & RigPose() const;
    virtual class RigPose & RigPose();
    virtual std::string Category() const { return "humanoid"; }
+   virtual bool UsesHumanoidCore() const { return true; }
    virtual bool ValidateRig() const;
    virtual void CoordinateSystem( std::array< double, 3 > value );
    virtual const std::array< double, 3 > & CoordinateSystem() const;
@@ -71,9 +71,11 @@ protected:
    virtual bool ValidateFeet() const;
    
 private:
+   virtual void SolveRig();
+   virtual void SolveExtremities();
+   
    Mpii_27 _keypoints;
    class RigPose _rigPose;
-   bool _rigCreated = false;
    const int FRAME_DATA_SIZE = sizeof( _keypoints ) / sizeof( double );
    std::array< double, 3 > _coordinateSystem;
 };
@@ -89,14 +91,14 @@ inline RigPose & KpMpii_27::RigPose()
 inline void KpMpii_27::Keypoint( std::array< double, 3 > value, int index )
 {
    *((std::array< double, 3 > *)&_keypoints + index) = value;
-   _rigCreated = false;
+   _state = FRAME_STATE_RAW;
 }
 inline void KpMpii_27::Keypoint( std::array< double, 3 > value, KEYPOINT_TYPE type )
 {
    try
    {
       *((std::array< double, 3 > *)&_keypoints + _kpLayout.at( type )) = value;
-      _rigCreated = false;
+      _state = FRAME_STATE_RAW;
    }
    catch ( std::out_of_range & )
    {
@@ -111,6 +113,8 @@ inline const std::array< double, 3 > & KpMpii_27::Keypoint( KEYPOINT_TYPE type )
 }
 inline std::array< double, 3 > & KpMpii_27::Keypoint( KEYPOINT_TYPE type )
 {
+   // The caller may change it
+   _state = FRAME_STATE_RAW;
    return const_cast< std::array< double, 3 > &>(static_cast<const Pose &>(*this).Keypoint( type ) );
 }
 inline bool KpMpii_27::HasKeypoint( KEYPOINT_TYPE type ) const
@@ -17,10 +17,9 @@ KpSolidObject::KpSolidObject( const KpSolidObject & rhs )
 {
    _location = rhs._location;
    _rigPose = rhs._rigPose;
-   _rigCreated = rhs._rigCreated;
    _coordinateSystem = rhs._coordinateSystem;
 }
-RigPose & KpSolidObject::GenerateRig()
+void KpSolidObject::SolveRig()
 {
    _rigPose.Timestamp( Timestamp() );
    Rig & rig = _rigPose.GetRig();
@@ -35,8 +34,6 @@ RigPose & KpSolidObject::GenerateRig()
    rig.numJointsUsed = 1;   
    
    _rigPose.KpType( KpType() );
-   _rigCreated = true;
-   return _rigPose;
 }
 void KpSolidObject::FromRigPose( const class RigPose & rigPose )
 {
@@ -46,7 +43,7 @@ void KpSolidObject::FromRigPose( const class RigPose & rigPose )
    _location = rig.location;
    
    _timestamp = rigPose.Timestamp();
-   _rigCreated = true;
+   _state = FRAME_STATE_SOLVED;
 }
 void KpSolidObject::InputDataToArray( std::vector< double > & serializedList )
 {
@@ -70,6 +67,7 @@ bool KpSolidObject::ValidateRig() const
 void KpSolidObject::CoordinateSystem( std::array< double, 3 > value )
 {
    _coordinateSystem = value;
+   _state = FRAME_STATE_RAW;
    
    // x
    _location[ 0 ] *= _coordinateSystem[ 0 ];
@@ -20,7 +20,6 @@ public:
    virtual const std::array< double, 3 > & Keypoint( KEYPOINT_TYPE type ) const;
    virtual std::array< double, 3 > & Keypoint( KEYPOINT_TYPE type );
    virtual bool HasKeypoint( KEYPOINT_TYPE type ) const;
-   virtual class RigPose & GenerateRig();
    virtual void FromRigPose( const class RigPose & rigPose );
    virtual void InputDataToArray( std::vector< double > & serializedList );
    virtual size_t InputDataSize() const { return FRAME_DATA_SIZE; }
@@ -32,9 +31,10 @@ public:
    virtual const std::array< double, 3 > & CoordinateSystem() const;
    
 private: 
+   virtual void SolveRig();
+   
    std::array< double, 3 > _location;
    class RigPose _rigPose;
-   bool _rigCreated = false;
    const int FRAME_DATA_SIZE = 3;
    std::array< double, 3 > _coordinateSystem;
 };
@@ -50,11 +50,13 @@ inline RigPose & KpSolidObject::RigPose()
 inline void KpSolidObject::Keypoint( std::array< double, 3 > value, int index )
 {
    _location = value;
+   _state = FRAME_STATE_RAW;
    (void)index; // Avoids a compiler warning
 }
 inline void KpSolidObject::Keypoint( std::array< double, 3 > value, KEYPOINT_TYPE type )
 {
    _location = value;
+   _state = FRAME_STATE_RAW;
    (void)type; // Avoids a compiler warning
 }
 inline const std::array< double, 3 > & KpSolidObject::Keypoint( KEYPOINT_TYPE type ) const
@@ -64,6 +66,8 @@ inline const std::array< double, 3 > & KpSolidObject::Keypoint( KEYPOINT_TYPE ty
 }
 inline std::array< double, 3 > & KpSolidObject::Keypoint( KEYPOINT_TYPE type )
 {
+   // The caller may change it
+   _state = FRAME_STATE_RAW;
    return const_cast< std::array< double, 3 > &>(static_cast<const Pose &>(*this).Keypoint( type ) );
 }
 inline bool KpSolidObject::HasKeypoint( KEYPOINT_TYPE type ) const
@@ -1,95 +1,280 @@
 #define _USE_MATH_DEFINES
 #include <cmath>
+#include <algorithm>
+#include <stdexcept>
 #include "KpToRigHelper.hpp"
 #include "Pose.hpp"
 #include "Utility.hpp"
 #include "RigPose.hpp"
+#include "RestPose.hpp"
+#include "QuaternionBatch.hpp"
 
-void KpToRigHelper::HandleSpine( Pose & pose )
+using QuaternionBatch::Quaternions;
+using QuaternionBatch::Vectors;
+using QuaternionBatch::QuaternionBuffer;
+using QuaternionBatch::VectorBuffer;
+
+namespace
 {
-   Rig & rig = pose.RigPose().GetRig();
-
-   Eigen::Quaterniond q1;
-   Eigen::Vector3d leftHip;
-   Eigen::Vector3d rightHip;
-   Eigen::Vector3d baseNeck;
-   Eigen::Vector3d baseHead;
-   Eigen::Vector3d topHead;
-   Eigen::Vector3d leftShoulder;
-   Eigen::Vector3d rightShoulder;
-   
-   if ( pose.HasKeypoint( LEFT_HIP ) )
+   // -------------------------------------------------
+   // Vector math down arrays, for the steps QuaternionBatch doesn't cover.
+   // Each matches its Eigen::Vector3d counterpart.
+   // -------------------------------------------------
+   void Subtract( const Vectors & a,
+      const Vectors & b,
+      const Vectors & out,
+      size_t count )
    {
-      auto & temp1 = pose.Keypoint( LEFT_HIP );
-      leftHip = { temp1[0], temp1[1], temp1[2] };
-      auto & temp2 = pose.Keypoint( RIGHT_HIP );
-      rightHip = { temp2[0], temp2[1], temp2[2] };
+      for ( size_t i = 0; i < count; ++i )
+      {
+         out.x[ i ] = a.x[ i ] - b.x[ i ];
+         out.y[ i ] = a.y[ i ] - b.y[ i ];
+         out.z[ i ] = a.z[ i ] - b.z[ i ];
+      }
    }
-   else
+   // @out = @a + @b * @scale
+   void AddScaled( const Vectors & a,
+      const Vectors & b,
+      double scale,
+      const Vectors & out,
+      size_t count )
    {
-      throw std::runtime_error( "Hip keypoints are required" );
+      for ( size_t i = 0; i < count; ++i )
+      {
+         out.x[ i ] = a.x[ i ] + b.x[ i ] * scale;
+         out.y[ i ] = a.y[ i ] + b.y[ i ] * scale;
+         out.z[ i ] = a.z[ i ] + b.z[ i ] * scale;
+      }
    }
-   
-   if ( pose.HasKeypoint( LEFT_SHOULDER ) )
+   void Cross( const Vectors & a,
+      const Vectors & b,
+      const Vectors & out,
+      size_t count )
    {
-      auto & temp1 = pose.Keypoint( LEFT_SHOULDER );
-      leftShoulder = { temp1[0], temp1[1], temp1[2] };
-      auto & temp2 = pose.Keypoint( RIGHT_SHOULDER );
-      rightShoulder = { temp2[0], temp2[1], temp2[2] };
+      for ( size_t i = 0; i < count; ++i )
+      {
+         const double ax = a.x[ i ], ay = a.y[ i ], az = a.z[ i ];
+         const double bx = b.x[ i ], by = b.y[ i ], bz = b.z[ i ];
+         out.x[ i ] = ay * bz - az * by;
+         out.y[ i ] = az * bx - ax * bz;
+         out.z[ i ] = ax * by - ay * bx;
+      }
    }
-   else
+   // Zero vectors are left as they are
+   void Normalize( const Vectors & v,
+      const Vectors & out,
+      size_t count )
    {
-      throw std::runtime_error( "Shoulder keypoints are required" );
+      for ( size_t i = 0; i < count; ++i )
+      {
+         const double squaredNorm = v.x[ i ] * v.x[ i ] + v.y[ i ] * v.y[ i ] + v.z[ i ] * v.z[ i ];
+         const double divisor = squaredNorm > 0 ? std::sqrt( squaredNorm ) : 1.0;
+         out.x[ i ] = v.x[ i ] / divisor;
+         out.y[ i ] = v.y[ i ] / divisor;
+         out.z[ i ] = v.z[ i ] / divisor;
+      }
    }
-   
-   if ( pose.HasKeypoint( BASE_NECK ) )
+   double Norm( const Vectors & v,
+      size_t i )
    {
-      auto & temp = pose.Keypoint( BASE_NECK );
-      baseNeck = { temp[0], temp[1], temp[2] };
+      return std::sqrt( v.x[ i ] * v.x[ i ] + v.y[ i ] * v.y[ i ] + v.z[ i ] * v.z[ i ] );
    }
-   else
+   void Fill( const Vectors & out,
+      const Eigen::Vector3d & value,
+      size_t count )
    {
-      // Use the shoulders to guess this
-      Eigen::Vector3d shoulderVector = leftShoulder - rightShoulder;
-      shoulderVector *= 0.5;
-      Eigen::Vector3d baseNeckLocation = rightShoulder + shoulderVector;
-      baseNeck = { baseNeckLocation[0], baseNeckLocation[1], baseNeckLocation[2] };
+      std::fill_n( out.x, count, value[ 0 ] );
+      std::fill_n( out.y, count, value[ 1 ] );
+      std::fill_n( out.z, count, value[ 2 ] );
+   }
+   void Fill( const Quaternions & out,
+      const Eigen::Quaterniond & value,
+      size_t count )
+   {
+      std::fill_n( out.x, count, value.x() );
+      std::fill_n( out.y, count, value.y() );
+      std::fill_n( out.z, count, value.z() );
+      std::fill_n( out.w, count, value.w() );
+   }
+   void Copy( const Quaternions & q,
+      const Quaternions & out,
+      size_t count )
+   {
+      std::copy_n( q.x, count, out.x );
+      std::copy_n( q.y, count, out.y );
+      std::copy_n( q.z, count, out.z );
+      std::copy_n( q.w, count, out.w );
+   }
+   std::array< double, 3 > GetVector( const Vectors & v,
+      size_t i )
+   {
+      return { v.x[ i ], v.y[ i ], v.z[ i ] };
+   }
+   std::array< double, 4 > GetQuaternion( const Quaternions & q,
+      size_t i )
+   {
+      return { q.x[ i ], q.y[ i ], q.z[ i ], q.w[ i ] };
+   }
+
+   // The roll angle of a roll quaternion, Eigen::AngleAxisd( q ).angle() * axis()[1]
+   double RollAngle( const Quaternions & q,
+      size_t i )
+   {
+      const double x = q.x[ i ], y = q.y[ i ], z = q.z[ i ], w = q.w[ i ];
+      const double norm = std::sqrt( x * x + y * y + z * z );
+      if ( norm == 0 )
+         return 0;
+      const double angle = 2 * std::atan2( norm, std::abs( w ) );
+      return angle * (w < 0 ? -y : y) / norm;
    }
-   
-   if ( pose.HasKeypoint( TOP_HEAD ) )
+
+   // The keypoints used by the spine, legs and arms
+   const KEYPOINT_TYPE CORE_KEYPOINTS[] =
+   {
+      RIGHT_ANKLE, RIGHT_KNEE, RIGHT_HIP, LEFT_HIP, LEFT_KNEE, LEFT_ANKLE,
+      BASE_NECK, BASE_HEAD, TOP_HEAD,
+      RIGHT_WRIST, RIGHT_ELBOW, RIGHT_SHOULDER, LEFT_SHOULDER, LEFT_ELBOW, LEFT_WRIST
+   };
+
+   // Everything the core is solved with. One per thread, kept between calls so it only grows.
+   struct CoreScratch
    {
-      auto & temp = pose.Keypoint( TOP_HEAD );
-      topHead = { temp[0], temp[1], temp[2] };
+      void Resize( size_t size )
+      {
+         for ( KEYPOINT_TYPE type : CORE_KEYPOINTS )
+            keypoints[ type ].Resize( size );
+         for ( auto & buffer : vectors )
+            buffer.Resize( size );
+         for ( auto & buffer : spinePoints )
+            buffer.Resize( size );
+         for ( auto & buffer : quaternions )
+            buffer.Resize( size );
+      }
+
+      std::array< VectorBuffer, KP_UNKNOWN > keypoints;
+      std::array< VectorBuffer, 3 > spinePoints;
+      std::array< VectorBuffer, 11 > vectors;
+      std::array< QuaternionBuffer, 7 > quaternions;
+   };
+
+   void RequireKeypoints( const Pose & pose,
+      KEYPOINT_TYPE left,
+      KEYPOINT_TYPE right,
+      const char * error )
+   {
+      if ( !pose.HasKeypoint( left ) || !pose.HasKeypoint( right ) )
+         throw std::runtime_error( error );
    }
-   else
+
+   // Solves one joint from its parent's absolute rotation and the vector along its bone: @out_rotation takes +Y to
+   // the bone in the parent's frame and @out_abs is parent * rotation. @out_abs may be @parent.
+   void SolveChild( const Quaternions & parent,
+      const Vectors & bone,
+      const Vectors & up,
+      const Quaternions & out_rotation,
+      const Quaternions & out_abs,
+      const Quaternions & tempQuaternions,
+      const Vectors & tempVectors,
+      size_t count )
    {
-      // TODO: Figure out how to use other info to estimate this
-      throw std::runtime_error( "Top of head keypoint is required (for now)" );
+      QuaternionBatch::Conjugate( parent, tempQuaternions, count );
+      QuaternionBatch::Rotate( tempQuaternions, bone, tempVectors, count );
+      QuaternionBatch::FromTwoVectors( up, tempVectors, out_rotation, count );
+      QuaternionBatch::Multiply( parent, out_rotation, out_abs, count );
    }
-   
-   if ( pose.HasKeypoint( BASE_HEAD ) )
+   void StoreJoint( Joint & ref_joint,
+      const Quaternions & rotation,
+      const Quaternions & rotationAbs,
+      const Vectors & bone,
+      size_t i )
    {
-      auto & temp = pose.Keypoint( BASE_HEAD );
-      baseHead = { temp[0], temp[1], temp[2] };
+      ref_joint.quaternion = GetQuaternion( rotation, i );
+      ref_joint.quaternionAbs = GetQuaternion( rotationAbs, i );
+      ref_joint.length = Norm( bone, i );
    }
-   else
+}
+
+void KpToRigHelper::HandleCore( Pose * const * poses,
+   size_t count )
+{
+   if ( !count )
+      return;
+   thread_local CoreScratch scratch;
+
+   const Pose & first = *poses[ 0 ];
+   RequireKeypoints( first, LEFT_HIP, RIGHT_HIP, "Hip keypoints are required" );
+   RequireKeypoints( first, LEFT_SHOULDER, RIGHT_SHOULDER, "Shoulder keypoints are required" );
+   RequireKeypoints( first, TOP_HEAD, TOP_HEAD, "Top of head keypoint is required (for now)" );
+   RequireKeypoints( first, LEFT_KNEE, RIGHT_KNEE, "Knee keypoints are required" );
+   RequireKeypoints( first, LEFT_ANKLE, RIGHT_ANKLE, "Ankle keypoints are required" );
+   RequireKeypoints( first, LEFT_ELBOW, RIGHT_ELBOW, "Elbow keypoints are required" );
+   RequireKeypoints( first, LEFT_WRIST, RIGHT_WRIST, "Wrist keypoints are required" );
+   const bool hasBaseNeck = first.HasKeypoint( BASE_NECK );
+   const bool hasBaseHead = first.HasKeypoint( BASE_HEAD );
+
+   // Gather the keypoints of every pose into one array per component
+   scratch.Resize( count );
+   for ( KEYPOINT_TYPE type : CORE_KEYPOINTS )
    {
-      // Assume the neck is straight and length is a 30/70 split between
-      // base of neck and top of head
-      Eigen::Vector3d neckVector = topHead - baseNeck;
-      neckVector *= 0.3;
-      Eigen::Vector3d baseHeadLocation = baseNeck + neckVector;
-      baseHead = { baseHeadLocation[0], baseHeadLocation[1], baseHeadLocation[2] };
+      if ( !first.HasKeypoint( type ) )
+         continue;
+      const Vectors & keypoint = scratch.keypoints[ type ].View();
+      for ( size_t i = 0; i < count; ++i )
+      {
+         const std::array< double, 3 > & value = static_cast< const Pose & >( *poses[ i ] ).Keypoint( type );
+         keypoint.x[ i ] = value[ 0 ];
+         keypoint.y[ i ] = value[ 1 ];
+         keypoint.z[ i ] = value[ 2 ];
+      }
+   }
+
+   auto kp = [&]( KEYPOINT_TYPE type ) -> const Vectors & { return scratch.keypoints[ type ].View(); };
+   const Vectors & rHip = kp( RIGHT_HIP ), & lHip = kp( LEFT_HIP );
+   const Vectors & rKnee = kp( RIGHT_KNEE ), & lKnee = kp( LEFT_KNEE );
+   const Vectors & rAnkle = kp( RIGHT_ANKLE ), & lAnkle = kp( LEFT_ANKLE );
+   const Vectors & rShoulder = kp( RIGHT_SHOULDER ), & lShoulder = kp( LEFT_SHOULDER );
+   const Vectors & rElbow = kp( RIGHT_ELBOW ), & lElbow = kp( LEFT_ELBOW );
+   const Vectors & rWrist = kp( RIGHT_WRIST ), & lWrist = kp( LEFT_WRIST );
+   const Vectors & baseNeck = kp( BASE_NECK ), & baseHead = kp( BASE_HEAD ), & topHead = kp( TOP_HEAD );
+
+   const Vectors & up = scratch.vectors[ 0 ].View();
+   const Vectors & forward = scratch.vectors[ 1 ].View();
+   const Vectors & hipsUnit = scratch.vectors[ 2 ].View();
+   const Vectors & pelvis = scratch.vectors[ 3 ].View();
+   const Vectors & bone = scratch.vectors[ 4 ].View();
+   const Vectors & childBone = scratch.vectors[ 5 ].View();
+   const Vectors & v1 = scratch.vectors[ 6 ].View();
+   const Vectors & v2 = scratch.vectors[ 7 ].View();
+   const Vectors & v3 = scratch.vectors[ 8 ].View();
+   const Vectors & v4 = scratch.vectors[ 9 ].View();
+   const Vectors & tempVectors = scratch.vectors[ 10 ].View();
+   const Quaternions & pelvisRotation = scratch.quaternions[ 0 ].View();
+   const Quaternions & spine4Abs = scratch.quaternions[ 1 ].View();
+   const Quaternions & parent = scratch.quaternions[ 2 ].View();
+   const Quaternions & rotation = scratch.quaternions[ 3 ].View();
+   const Quaternions & roll = scratch.quaternions[ 4 ].View();
+   const Quaternions & adjustment = scratch.quaternions[ 5 ].View();
+   const Quaternions & tempQuaternions = scratch.quaternions[ 6 ].View();
+   Fill( up, Eigen::Vector3d( 0, 1, 0 ), count );
+   Fill( forward, Eigen::Vector3d( 0, 0, 1 ), count );
+   auto rig = [&]( size_t i ) -> Rig & { return poses[ i ]->RigPose().GetRig(); };
+
+   // -------------------------------------------------
+   // Spine
+   // -------------------------------------------------
+   if ( !hasBaseNeck )
+   {
+      // Use the shoulders to guess this
+      Subtract( lShoulder, rShoulder, v1, count );
+      AddScaled( rShoulder, v1, 0.5, baseNeck, count );
+   }
+   if ( !hasBaseHead )
+   {
+      // Assume the neck is straight and length is a 30/70 split between base of neck and top of head
+      Subtract( topHead, baseNeck, v1, count );
+      AddScaled( baseNeck, v1, 0.3, baseHead, count );
    }
 
-   // Useful vectors
-   Eigen::Vector3d upVector( 0, 1, 0 );
-   Eigen::Vector3d forwardVector( 0, 0, 1 );
-   Eigen::Vector3d hipsVector = leftHip - rightHip;
-   Eigen::Vector3d shoulderVector = leftShoulder - rightShoulder;
-   Eigen::Vector3d torsoVector = baseHead - baseNeck;
-   Eigen::Vector3d neckVector = topHead - baseHead;
-   
    // Pelvis (or spine1):
    // The pelvis (same as spine1) is the parent of all joints, so it is important to get this correct!
    // The pelvis is the only joint with an absolute position
@@ -118,160 +303,93 @@ void KpToRigHelper::HandleSpine( Pose & pose )
    //     b calculate the roll quaternion of the pelvis/spine1
    //  6 Apply the final quaternion
    //  7 Scale the spine1/pelvis length. spine2-4 will complete the remaining distance.
-   
-   // 1)
-   Eigen::Vector3d pelvis( rightHip[0] + hipsVector[0]/2, rightHip[1] + hipsVector[1]/2, rightHip[2] + hipsVector[2]/2 );
-   
-   // 2
-   rig.location = { pelvis[0], pelvis[1], pelvis[2] };
-   
+
+   // 1, 2
+   Subtract( lHip, rHip, v1, count );
+   Normalize( v1, hipsUnit, count );
+   AddScaled( rHip, v1, 0.5, pelvis, count );
+   for ( size_t i = 0; i < count; ++i )
+      rig( i ).location = GetVector( pelvis, i );
+
    // 3a
-   Eigen::Vector3d downwardHeadVector = (baseNeck - topHead).normalized();
-   Eigen::Vector3d thoraxForwardVector = shoulderVector.normalized().cross( downwardHeadVector );
-   downwardHeadVector = thoraxForwardVector.normalized().cross( shoulderVector.normalized() );
-   
-   // 3b
-   downwardHeadVector *= ((baseNeck - pelvis).norm() / 2);
-   
-   // 3c
-   Eigen::Vector3d p0 = pelvis;
-   Eigen::Vector3d p1 = baseNeck + downwardHeadVector;
-   Eigen::Vector3d p2 = baseNeck;
-   
-   // 3d
-   std::vector< Eigen::Vector3d > interpolatedSpinePoints = Utility::QuadraticBezierCurve( p0,
-      p1,
-      p2,
-      3,
-      0.3 );
-      
-   // 3e
-   Eigen::Vector3d spine1UnitVector = (interpolatedSpinePoints[0] - pelvis).normalized();
-   
-   // 4
-   q1 = Eigen::Quaterniond::FromTwoVectors( upVector, spine1UnitVector );
-   
-   // 5a
-   Eigen::Vector3d pelvisForwardVector = hipsVector.normalized().cross( spine1UnitVector );
-   pelvisForwardVector = q1.inverse()._transformVector( pelvisForwardVector.normalized() );
-
-   // 5b
-   Eigen::Quaterniond pelvisRoll = Eigen::Quaterniond::FromTwoVectors( forwardVector, pelvisForwardVector );
-   
-   // 6
-   q1 = q1 * pelvisRoll;
-   rig.pelvis.quaternion = Utility::QuaternionToRaw( q1 );
-   rig.pelvis.quaternionAbs = rig.pelvis.quaternion;
-   
-   // 7
-   rig.pelvis.length = (interpolatedSpinePoints[0] - pelvis).norm();
-   
-   
-   // All subsequent rotations must be RELATIVE, so we need to invert the cumulative quaternion before
-   // finding the difference-of-vectors.
-        
-   // spine2
-   Eigen::Vector3d spine2UnitVector = (interpolatedSpinePoints[1] - interpolatedSpinePoints[0]).normalized();
-   rig.spine2.length = (interpolatedSpinePoints[1] - interpolatedSpinePoints[0]).norm();
-   Eigen::Quaterniond relativeRotation = Eigen::Quaterniond::FromTwoVectors( upVector, q1.inverse()._transformVector( spine2UnitVector ) );
-   rig.spine2.quaternion = Utility::QuaternionToRaw( relativeRotation );
-   rig.spine2.quaternionAbs = Utility::QuaternionToRaw( q1 * relativeRotation );
-   q1 = Utility::RawToQuaternion( rig.spine2.quaternionAbs );
-   
-   // spine3
-   Eigen::Vector3d spine3UnitVector = (interpolatedSpinePoints[2] - interpolatedSpinePoints[1]).normalized();
-   rig.spine3.length = (interpolatedSpinePoints[2] - interpolatedSpinePoints[1]).norm();
-   relativeRotation = Eigen::Quaterniond::FromTwoVectors( upVector, q1.inverse()._transformVector( spine3UnitVector ) );
-   rig.spine3.quaternion = Utility::QuaternionToRaw( relativeRotation );
-   rig.spine3.quaternionAbs = Utility::QuaternionToRaw( q1 * relativeRotation );
-   q1 = Utility::RawToQuaternion( rig.spine3.quaternionAbs );
-   
-   // spine4
-   Eigen::Vector3d spine4UnitVector = (baseNeck - interpolatedSpinePoints[2]).normalized();
-   rig.spine4.length = (baseNeck - interpolatedSpinePoints[2]).norm();
-   relativeRotation = Eigen::Quaterniond::FromTwoVectors( upVector, q1.inverse()._transformVector( spine4UnitVector ) );
-   rig.spine4.quaternion = Utility::QuaternionToRaw( relativeRotation );
-   rig.spine4.quaternionAbs = Utility::QuaternionToRaw( q1 * relativeRotation );
-   q1 = Utility::RawToQuaternion( rig.spine4.quaternionAbs );
-   
-   // Torso (which is really the bottom-baseHead joint)
-   rig.baseNeck.length = torsoVector.norm();
-   relativeRotation = Eigen::Quaterniond::FromTwoVectors( upVector, q1.inverse()._transformVector( torsoVector ) );
-   rig.baseNeck.quaternion = Utility::QuaternionToRaw( relativeRotation );
-   rig.baseNeck.quaternionAbs = Utility::QuaternionToRaw( q1 * relativeRotation );
-   q1 = Utility::RawToQuaternion( rig.baseNeck.quaternionAbs );
-   
-   // Neck
-   rig.baseHead.length = neckVector.norm();
-   relativeRotation = Eigen::Quaterniond::FromTwoVectors( upVector, q1.inverse()._transformVector( neckVector ) );
-   rig.baseHead.quaternion = Utility::QuaternionToRaw( relativeRotation );
-   rig.baseHead.quaternionAbs = Utility::QuaternionToRaw( q1 * relativeRotation );
-   q1 = Utility::RawToQuaternion( rig.baseHead.quaternionAbs );
-}
-void KpToRigHelper::HandleLegs( Pose & pose )
-{
-   Rig & rig = pose.RigPose().GetRig();
-
-   Eigen::Quaterniond pelvisQuaternion = Utility::RawToQuaternion( rig.pelvis.quaternion );
-   Eigen::Vector3d rHip;
-   Eigen::Vector3d rKnee;
-   Eigen::Vector3d rAnkle;
-   Eigen::Vector3d lHip;
-   Eigen::Vector3d lKnee;
-   Eigen::Vector3d lAnkle;
-   const double BEND_THRESHOLD = M_PI / 12;
-   
-   if ( pose.HasKeypoint( LEFT_HIP ) )
-   {
-      auto & temp1 = pose.Keypoint( LEFT_HIP );
-      lHip = { temp1[0], temp1[1], temp1[2] };
-      auto & temp2 = pose.Keypoint( RIGHT_HIP );
-      rHip = { temp2[0], temp2[1], temp2[2] };
-   }
-   else
-   {
-      throw std::runtime_error( "Hip keypoints are required" );
-   }
-   
-   if ( pose.HasKeypoint( LEFT_KNEE ) )
-   {
-      auto & temp1 = pose.Keypoint( LEFT_KNEE );
-      lKnee = { temp1[0], temp1[1], temp1[2] };
-      auto & temp2 = pose.Keypoint( RIGHT_KNEE );
-      rKnee = { temp2[0], temp2[1], temp2[2] };
-   }
-   else
+   Subtract( lShoulder, rShoulder, v1, count );
+   Normalize( v1, v1, count );
+   Subtract( baseNeck, topHead, v2, count );
+   Normalize( v2, v2, count );
+   Cross( v1, v2, v3, count );
+   Normalize( v3, v3, count );
+   Cross( v3, v1, v2, count );
+
+   // 3b, 3c, 3d
+   const Vectors * spinePoints[ 3 ] = { &scratch.spinePoints[ 0 ].View(), &scratch.spinePoints[ 1 ].View(), &scratch.spinePoints[ 2 ].View() };
+   std::array< Eigen::Vector3d, 3 > interpolatedSpinePoints;
+   for ( size_t i = 0; i < count; ++i )
    {
-      throw std::runtime_error( "Knee keypoints are required" );
+      const Eigen::Vector3d p0( pelvis.x[ i ], pelvis.y[ i ], pelvis.z[ i ] );
+      const Eigen::Vector3d p2( baseNeck.x[ i ], baseNeck.y[ i ], baseNeck.z[ i ] );
+      const Eigen::Vector3d p1 = p2 + Eigen::Vector3d( v2.x[ i ], v2.y[ i ], v2.z[ i ] ) * ((p2 - p0).norm() / 2);
+      Utility::QuadraticBezierCurve( p0,
+         p1,
+         p2,
+         interpolatedSpinePoints,
+         Utility::SPINE_BEZIER_RATIO );
+      for ( size_t j = 0; j < 3; ++j )
+      {
+         spinePoints[ j ]->x[ i ] = interpolatedSpinePoints[ j ][ 0 ];
+         spinePoints[ j ]->y[ i ] = interpolatedSpinePoints[ j ][ 1 ];
+         spinePoints[ j ]->z[ i ] = interpolatedSpinePoints[ j ][ 2 ];
+      }
    }
-   
-   if ( pose.HasKeypoint( LEFT_ANKLE ) )
+
+   // 3e, 4
+   Subtract( *spinePoints[ 0 ], pelvis, bone, count );
+   Normalize( bone, v1, count );
+   QuaternionBatch::FromTwoVectors( up, v1, pelvisRotation, count );
+
+   // 5a
+   Cross( hipsUnit, v1, v2, count );
+   Normalize( v2, v2, count );
+   QuaternionBatch::Conjugate( pelvisRotation, tempQuaternions, count );
+   QuaternionBatch::Rotate( tempQuaternions, v2, v2, count );
+
+   // 5b, 6, 7
+   QuaternionBatch::FromTwoVectors( forward, v2, roll, count );
+   QuaternionBatch::Multiply( pelvisRotation, roll, pelvisRotation, count );
+   for ( size_t i = 0; i < count; ++i )
+      StoreJoint( rig( i ).pelvis, pelvisRotation, pelvisRotation, bone, i );
+
+   // spine2, spine3 and spine4 along the curve, then the torso (which is really the bottom-baseHead joint) and neck.
+   // All subsequent rotations must be RELATIVE, so each is found in its parent's frame.
+   Copy( pelvisRotation, parent, count );
+   auto chain = [&]( const Vectors & from, const Vectors & to, bool normalize, Joint Rig::* joint )
    {
-      auto & temp1 = pose.Keypoint( LEFT_ANKLE );
-      lAnkle = { temp1[0], temp1[1], temp1[2] };
-      auto & temp2 = pose.Keypoint( RIGHT_ANKLE );
-      rAnkle = { temp2[0], temp2[1], temp2[2] };
-   }
-   else
+      Subtract( to, from, bone, count );
+      if ( normalize )
+         Normalize( bone, childBone, count );
+      SolveChild( parent, normalize ? childBone : bone, up, rotation, parent, tempQuaternions, tempVectors, count );
+      for ( size_t i = 0; i < count; ++i )
+         StoreJoint( rig( i ).*joint, rotation, parent, bone, i );
+   };
+   chain( *spinePoints[ 0 ], *spinePoints[ 1 ], true, &Rig::spine2 );
+   chain( *spinePoints[ 1 ], *spinePoints[ 2 ], true, &Rig::spine3 );
+   chain( *spinePoints[ 2 ], baseNeck, true, &Rig::spine4 );
+   Copy( parent, spine4Abs, count );
+   chain( baseNeck, baseHead, false, &Rig::baseNeck );
+   chain( baseHead, topHead, false, &Rig::baseHead );
+
+   // -------------------------------------------------
+   // Legs
+   // -------------------------------------------------
+   const double BEND_THRESHOLD = M_PI / 12;
+
+   // Hip offsets
+   Subtract( lHip, rHip, v1, count );
+   for ( size_t i = 0; i < count; ++i )
    {
-      throw std::runtime_error( "Ankle keypoints are required" );
+      rig( i ).rHip.offset = { -v1.x[ i ] / 2, -v1.y[ i ] / 2, -v1.z[ i ] / 2 };
+      rig( i ).lHip.offset = { v1.x[ i ] / 2, v1.y[ i ] / 2, v1.z[ i ] / 2 };
    }
-   
-   // Create some useful vectors
-   Eigen::Vector3d upVector( 0, 1, 0 );
-   Eigen::Vector3d forwardVector( 0, 0, 1 );
-   Eigen::Vector3d rHipVector = rKnee - rHip;
-   Eigen::Vector3d lHipVector = lKnee - lHip;
-   Eigen::Vector3d hipsVector = lHip - rHip;
-   Eigen::Vector3d rKneeVector = rAnkle - rKnee;
-   Eigen::Vector3d lKneeVector = lAnkle - lKnee;
-   
-   // Hip offsets
-   Eigen::Vector3d pelvisToRHipVector = -hipsVector / 2;
-   rig.rHip.offset = { pelvisToRHipVector[0], pelvisToRHipVector[1], pelvisToRHipVector[2] };
-   Eigen::Vector3d pelvisToLHipVector = hipsVector / 2;
-   rig.lHip.offset = { pelvisToLHipVector[0], pelvisToLHipVector[1], pelvisToLHipVector[2] };
-   
+
    // Hips:
    // We assume a T-pose so, unlike the spine, hips point down instead of up.
    // This means for zero rotation of the hips:
@@ -295,153 +413,83 @@ void KpToRigHelper::HandleLegs( Pose & pose )
    //       we know that we are projected on the XZ plane which allows us to simply multiply the angle with Y to get the direction.
    //  5 Apply the hip roll adjustment to the hip rotation, so that the knee points the correct way now
    //  6 Set the values for rotation and length
-   
+   //
+   // Knees are more-or-less straightforward, just remember to include the rest pose adjustment
+
    // 1
-   Eigen::Quaterniond restPoseAdjustmentRotatation = pelvisQuaternion * Eigen::AngleAxisd( M_PI, forwardVector );
-
-   // 2
-   Eigen::Quaterniond rHipRotation = Eigen::Quaterniond::FromTwoVectors( upVector, restPoseAdjustmentRotatation.inverse()._transformVector( rHipVector ) );
-   Eigen::Quaterniond lHipRotation = Eigen::Quaterniond::FromTwoVectors( upVector, restPoseAdjustmentRotatation.inverse()._transformVector( lHipVector ) );
-   
-   // 3
-   double rKneeBendAngle = std::acos( rHipVector.normalized().dot( rKneeVector.normalized() ) );
-   double lKneeBendAngle = std::acos( lHipVector.normalized().dot( lKneeVector.normalized() ) );
-   
-   // 4
-   Eigen::Quaterniond rHipRoll, lHipRoll;
-   Eigen::Vector3d rHipForwardVector, lHipForwardVector;
-   if ( rKneeBendAngle > BEND_THRESHOLD )
-   {
-      // 4a (right knee bent)
-      Eigen::Vector3d rHipAnkleUnitVector = (rAnkle - rHip).normalized();
-      rHipForwardVector = rHipVector.normalized().cross( rHipAnkleUnitVector ).cross( rHipVector.normalized() ).normalized();
-   }
-   else
-   {
-      // 4a (right knee straight)
-      rHipForwardVector = rHipVector.normalized().cross( -hipsVector.normalized() ).normalized();
-   }
-   
-   if ( lKneeBendAngle > BEND_THRESHOLD )
-   {
-      // 4a (left knee bent)
-      Eigen::Vector3d lHipAnkleUnitVector = (lAnkle - lHip).normalized();
-      lHipForwardVector = lHipVector.normalized().cross( lHipAnkleUnitVector ).cross( lHipVector.normalized() ).normalized();
-   }
-   else
-   {
-      // 4a (left knee straight)
-      lHipForwardVector = lHipVector.normalized().cross( -hipsVector.normalized() ).normalized();
-   }
-   
-   // 4b
-   rHipForwardVector = (restPoseAdjustmentRotatation * rHipRotation).inverse()._transformVector( -rHipForwardVector );
-   lHipForwardVector = (restPoseAdjustmentRotatation * lHipRotation).inverse()._transformVector( -lHipForwardVector );
-
-   // 4c
-   rHipRoll = Eigen::Quaterniond::FromTwoVectors( forwardVector, rHipForwardVector );
-   lHipRoll = Eigen::Quaterniond::FromTwoVectors( forwardVector, lHipForwardVector );
-   
-   // 4d
-   Eigen::AngleAxisd rHipRollAngle( rHipRoll );
-   rig.rHip.roll = rHipRollAngle.angle() * rHipRollAngle.axis()[1];
-   Eigen::AngleAxisd lHipRollAngle( lHipRoll );
-   rig.lHip.roll = lHipRollAngle.angle() * lHipRollAngle.axis()[1];
-
-   // 5
-   rHipRotation = rHipRotation * rHipRoll;
-   lHipRotation = lHipRotation * lHipRoll;
-   
-   // 6
-   rig.rHip.quaternion = Utility::QuaternionToRaw( rHipRotation );
-   rig.rHip.quaternionAbs = Utility::QuaternionToRaw( restPoseAdjustmentRotatation * rHipRotation );
-   rig.lHip.quaternion = Utility::QuaternionToRaw( lHipRotation );
-   rig.lHip.quaternionAbs = Utility::QuaternionToRaw( restPoseAdjustmentRotatation * lHipRotation );
-   rig.rHip.length = rHipVector.norm();
-   rig.lHip.length = lHipVector.norm();
-   
-   // Knees
-   // More-or-less straightforward, just remember to include the rest pose adjustment
-   Eigen::Quaterniond rKneeRotation = Eigen::Quaterniond::FromTwoVectors( upVector, (restPoseAdjustmentRotatation * rHipRotation).inverse()._transformVector( rKneeVector ) );
-   Eigen::Quaterniond lKneeRotation = Eigen::Quaterniond::FromTwoVectors( upVector, (restPoseAdjustmentRotatation * lHipRotation).inverse()._transformVector( lKneeVector ) );
-   rig.rKnee.quaternion = Utility::QuaternionToRaw( rKneeRotation );
-   rig.rKnee.quaternionAbs = Utility::QuaternionToRaw( (restPoseAdjustmentRotatation * rHipRotation) * rKneeRotation );
-   rig.lKnee.quaternion = Utility::QuaternionToRaw( lKneeRotation );
-   rig.lKnee.quaternionAbs = Utility::QuaternionToRaw( (restPoseAdjustmentRotatation * lHipRotation) * lKneeRotation );
-   rig.rKnee.length = rKneeVector.norm();
-   rig.lKnee.length = lKneeVector.norm();
-}
-void KpToRigHelper::HandleArms( Pose & pose )
-{
-   Rig & rig = pose.RigPose().GetRig();
-   
-   Eigen::Quaterniond spine4Quaternion = Utility::RawToQuaternion( rig.spine4.quaternionAbs );
-   Eigen::Vector3d baseNeck;
-   Eigen::Vector3d rShoulder;
-   Eigen::Vector3d rElbow;
-   Eigen::Vector3d rWrist;
-   Eigen::Vector3d lShoulder;
-   Eigen::Vector3d lElbow;
-   Eigen::Vector3d lWrist;
-   
-   if ( pose.HasKeypoint( BASE_NECK ) )
-   {
-      auto & temp = pose.Keypoint( BASE_NECK );
-      baseNeck = { temp[0], temp[1], temp[2] };
-   }
-   else
-   {
-      // TODO: Use shoulders and anything else we have to "guess" this
-   }
-   
-   if ( pose.HasKeypoint( LEFT_SHOULDER ) )
-   {
-      auto & temp1 = pose.Keypoint( LEFT_SHOULDER );
-      lShoulder = { temp1[0], temp1[1], temp1[2] };
-      auto & temp2 = pose.Keypoint( RIGHT_SHOULDER );
-      rShoulder = { temp2[0], temp2[1], temp2[2] };
-   }
-   else
-   {
-      throw std::runtime_error( "Shoulder keypoints are required" );
-   }
-   
-   if ( pose.HasKeypoint( LEFT_ELBOW ) )
-   {
-      auto & temp1 = pose.Keypoint( LEFT_ELBOW );
-      lElbow = { temp1[0], temp1[1], temp1[2] };
-      auto & temp2 = pose.Keypoint( RIGHT_ELBOW );
-      rElbow = { temp2[0], temp2[1], temp2[2] };
-   }
-   else
-   {
-      throw std::runtime_error( "Elbow keypoints are required" );
-   }
-   
-   if ( pose.HasKeypoint( LEFT_WRIST ) )
-   {
-      auto & temp1 = pose.Keypoint( LEFT_WRIST );
-      lWrist = { temp1[0], temp1[1], temp1[2] };
-      auto & temp2 = pose.Keypoint( RIGHT_WRIST );
-      rWrist = { temp2[0], temp2[1], temp2[2] };
-   }
-   else
+   Fill( adjustment, RestPose::Humanoid().hipAdjustment, count );
+   QuaternionBatch::Multiply( pelvisRotation, adjustment, adjustment, count );
+
+   auto leg = [&]( const Vectors & hip, const Vectors & knee, const Vectors & ankle, Joint Rig::* hipJoint, Joint Rig::* kneeJoint )
    {
-      throw std::runtime_error( "Wrist keypoints are required" );
-   }
-   
-   // Useful vectors
-   Eigen::Vector3d upVector( 0, 1, 0 );
-   Eigen::Vector3d forwardVector( 0, 0, 1 );
-   Eigen::Vector3d rShoulderVector = rElbow - rShoulder;
-   Eigen::Vector3d lShoulderVector = lElbow - lShoulder;
-   
-   // Shoulder offsets
-   Eigen::Vector3d baseNeckToRShoulder = rShoulder - baseNeck;
-   rig.rShoulder.offset = { baseNeckToRShoulder[0], baseNeckToRShoulder[1], baseNeckToRShoulder[2] };
-   Eigen::Vector3d baseNeckToLShoulder = lShoulder - baseNeck;
-   rig.lShoulder.offset = { baseNeckToLShoulder[0], baseNeckToLShoulder[1], baseNeckToLShoulder[2] };
-   
+      // 2
+      Subtract( knee, hip, bone, count );
+      QuaternionBatch::Conjugate( adjustment, tempQuaternions, count );
+      QuaternionBatch::Rotate( tempQuaternions, bone, tempVectors, count );
+      QuaternionBatch::FromTwoVectors( up, tempVectors, rotation, count );
+
+      // 3, 4a: the forward vector both ways, then pick by the bend of the knee
+      Normalize( bone, v1, count );
+      Subtract( ankle, knee, childBone, count );
+      Normalize( childBone, v2, count );
+      Subtract( ankle, hip, v3, count );
+      Normalize( v3, v3, count );
+      Cross( v1, v3, v4, count );
+      Cross( v4, v1, v3, count );
+      Normalize( v3, v3, count );
+      Cross( v1, hipsUnit, v4, count );
+      for ( size_t i = 0; i < count; ++i )
+      {
+         const double kneeBendAngle = std::acos( v1.x[ i ] * v2.x[ i ] + v1.y[ i ] * v2.y[ i ] + v1.z[ i ] * v2.z[ i ] );
+         if ( kneeBendAngle > BEND_THRESHOLD )
+         {
+            v4.x[ i ] = v3.x[ i ];
+            v4.y[ i ] = v3.y[ i ];
+            v4.z[ i ] = v3.z[ i ];
+         }
+         else
+         {
+            // Straight legs use the hip bone crossed with -hipsUnit
+            v4.x[ i ] = -v4.x[ i ];
+            v4.y[ i ] = -v4.y[ i ];
+            v4.z[ i ] = -v4.z[ i ];
+         }
+      }
+      Normalize( v4, v4, count );
+
+      // 4b
+      QuaternionBatch::Multiply( adjustment, rotation, parent, count );
+      QuaternionBatch::Conjugate( parent, tempQuaternions, count );
+      for ( size_t i = 0; i < count; ++i )
+      {
+         v4.x[ i ] = -v4.x[ i ];
+         v4.y[ i ] = -v4.y[ i ];
+         v4.z[ i ] = -v4.z[ i ];
+      }
+      QuaternionBatch::Rotate( tempQuaternions, v4, v4, count );
+
+      // 4c, 4d
+      QuaternionBatch::FromTwoVectors( forward, v4, roll, count );
+      for ( size_t i = 0; i < count; ++i )
+         (rig( i ).*hipJoint).roll = RollAngle( roll, i );
+
+      // 5, 6
+      QuaternionBatch::Multiply( rotation, roll, rotation, count );
+      QuaternionBatch::Multiply( adjustment, rotation, parent, count );
+      for ( size_t i = 0; i < count; ++i )
+         StoreJoint( rig( i ).*hipJoint, rotation, parent, bone, i );
+
+      // Knee
+      SolveChild( parent, childBone, up, rotation, parent, tempQuaternions, tempVectors, count );
+      for ( size_t i = 0; i < count; ++i )
+         StoreJoint( rig( i ).*kneeJoint, rotation, parent, childBone, i );
+   };
+   leg( rHip, rKnee, rAnkle, &Rig::rHip, &Rig::rKnee );
+   leg( lHip, lKnee, lAnkle, &Rig::lHip, &Rig::lKnee );
+
+   // -------------------------------------------------
+   // Arms
+   // -------------------------------------------------
    // Shoulders:
    // We assume a T-pose so, unlike the spine4, shoulders point out (left, right) instead of up.
    // This means for zero rotation of the shoulders:
@@ -459,60 +507,64 @@ void KpToRigHelper::HandleArms( Pose & pose )
    //    c) Calculate the roll as the rotation from the world forward vector to our current XZ vector
    //  4 Multiply steps 3*4 (in order)
    //  5 Set the values for rotation and length
-   
-   // 1
-   Eigen::Quaterniond rRestPoseAdjustmentRotatation = spine4Quaternion * Eigen::AngleAxisd(  M_PI / 2, forwardVector );
-   Eigen::Quaterniond lRestPoseAdjustmentRotatation = spine4Quaternion * Eigen::AngleAxisd( -M_PI / 2, forwardVector );
+   //
+   // Elbows are more-or-less straightforward, just remember to include the rest keypoints adjustment
+   auto arm = [&]( const Vectors & shoulder, const Vectors & elbow, const Vectors & wrist, const Eigen::Quaterniond & restPoseAdjustment,
+      Joint Rig::* shoulderJoint, Joint Rig::* elbowJoint )
+   {
+      // Shoulder offset from the base of the neck, which is the origin if there's no keypoint for it
+      for ( size_t i = 0; i < count; ++i )
+      {
+         (rig( i ).*shoulderJoint).offset = hasBaseNeck ?
+            std::array< double, 3 >{ { shoulder.x[ i ] - baseNeck.x[ i ], shoulder.y[ i ] - baseNeck.y[ i ], shoulder.z[ i ] - baseNeck.z[ i ] } } :
+            GetVector( shoulder, i );
+      }
 
-   // 2
-   Eigen::Quaterniond rShoulderRotation = Eigen::Quaterniond::FromTwoVectors( upVector, rRestPoseAdjustmentRotatation.inverse()._transformVector( rShoulderVector ) );
-   Eigen::Quaterniond lShoulderRotation = Eigen::Quaterniond::FromTwoVectors( upVector, lRestPoseAdjustmentRotatation.inverse()._transformVector( lShoulderVector ) );
+      // 1
+      Fill( adjustment, restPoseAdjustment, count );
+      QuaternionBatch::Multiply( spine4Abs, adjustment, adjustment, count );
 
-   // 3a
-   Eigen::Vector3d rShoulderWristUnitVector = (rWrist - rShoulder).normalized();
-   Eigen::Vector3d lShoulderWristUnitVector = (lWrist - lShoulder).normalized();
-   Eigen::Vector3d rShoulderForwardVector = rShoulderVector.normalized().cross( rShoulderWristUnitVector ).cross( rShoulderVector.normalized() ).normalized();
-   Eigen::Vector3d lShoulderForwardVector = lShoulderVector.normalized().cross( lShoulderWristUnitVector ).cross( lShoulderVector.normalized() ).normalized();
-
-   // 3b
-   rShoulderForwardVector = (rRestPoseAdjustmentRotatation * rShoulderRotation).inverse()._transformVector( rShoulderForwardVector );
-   lShoulderForwardVector = (lRestPoseAdjustmentRotatation * lShoulderRotation).inverse()._transformVector( lShoulderForwardVector );
-
-   // 3c
-   Eigen::Quaterniond rShoulderRoll = Eigen::Quaterniond::FromTwoVectors( forwardVector, rShoulderForwardVector );
-   Eigen::Quaterniond lShoulderRoll = Eigen::Quaterniond::FromTwoVectors( forwardVector, lShoulderForwardVector );
-
-   // 4
-   rShoulderRotation = rShoulderRotation * rShoulderRoll;
-   lShoulderRotation = lShoulderRotation * lShoulderRoll;
-
-   // 5
-   rig.rShoulder.quaternion = Utility::QuaternionToRaw( rShoulderRotation );
-   rig.rShoulder.quaternionAbs = Utility::QuaternionToRaw( rRestPoseAdjustmentRotatation * rShoulderRotation );
-   rig.lShoulder.quaternion = Utility::QuaternionToRaw( lShoulderRotation );
-   rig.lShoulder.quaternionAbs = Utility::QuaternionToRaw( lRestPoseAdjustmentRotatation * lShoulderRotation );
-   rig.rShoulder.length = rShoulderVector.norm();
-   rig.lShoulder.length = lShoulderVector.norm();
-
-   // Elbows
-   // More-or-less straightforward, just remember to include the rest keypoints adjustment
-   Eigen::Vector3d rElbowVector = rWrist - rElbow;
-   Eigen::Vector3d lElbowVector = lWrist - lElbow;
-   Eigen::Quaterniond rElbowRotation = Eigen::Quaterniond::FromTwoVectors( upVector, (rRestPoseAdjustmentRotatation * rShoulderRotation).inverse()._transformVector( rElbowVector ) );
-   Eigen::Quaterniond lElbowRotation = Eigen::Quaterniond::FromTwoVectors( upVector, (lRestPoseAdjustmentRotatation * lShoulderRotation).inverse()._transformVector( lElbowVector ) );
-   rig.rElbow.quaternion = Utility::QuaternionToRaw( rElbowRotation );
-   rig.rElbow.quaternionAbs = Utility::QuaternionToRaw( (rRestPoseAdjustmentRotatation * rShoulderRotation) * rElbowRotation );
-   rig.lElbow.quaternion = Utility::QuaternionToRaw( lElbowRotation );
-   rig.lElbow.quaternionAbs = Utility::QuaternionToRaw( (lRestPoseAdjustmentRotatation * lShoulderRotation) * lElbowRotation );
-   rig.rElbow.length = rElbowVector.norm();
-   rig.lElbow.length = lElbowVector.norm();
+      // 2
+      Subtract( elbow, shoulder, bone, count );
+      QuaternionBatch::Conjugate( adjustment, tempQuaternions, count );
+      QuaternionBatch::Rotate( tempQuaternions, bone, tempVectors, count );
+      QuaternionBatch::FromTwoVectors( up, tempVectors, rotation, count );
+
+      // 3a
+      Normalize( bone, v1, count );
+      Subtract( wrist, shoulder, v2, count );
+      Normalize( v2, v2, count );
+      Cross( v1, v2, v3, count );
+      Cross( v3, v1, v3, count );
+      Normalize( v3, v3, count );
+
+      // 3b
+      QuaternionBatch::Multiply( adjustment, rotation, parent, count );
+      QuaternionBatch::Conjugate( parent, tempQuaternions, count );
+      QuaternionBatch::Rotate( tempQuaternions, v3, v3, count );
+
+      // 3c, 4, 5
+      QuaternionBatch::FromTwoVectors( forward, v3, roll, count );
+      QuaternionBatch::Multiply( rotation, roll, rotation, count );
+      QuaternionBatch::Multiply( adjustment, rotation, parent, count );
+      for ( size_t i = 0; i < count; ++i )
+         StoreJoint( rig( i ).*shoulderJoint, rotation, parent, bone, i );
+
+      // Elbow
+      Subtract( wrist, elbow, childBone, count );
+      SolveChild( parent, childBone, up, rotation, parent, tempQuaternions, tempVectors, count );
+      for ( size_t i = 0; i < count; ++i )
+         StoreJoint( rig( i ).*elbowJoint, rotation, parent, childBone, i );
+   };
+   arm( rShoulder, rElbow, rWrist, RestPose::Humanoid().rShoulderAdjustment, &Rig::rShoulder, &Rig::rElbow );
+   arm( lShoulder, lElbow, lWrist, RestPose::Humanoid().lShoulderAdjustment, &Rig::lShoulder, &Rig::lElbow );
 }
 Joint KpToRigHelper::CreateJoint( const Joint & parentJoint,
    Eigen::Vector3d boneVector )
 {
    Joint returnValue;
    Eigen::Quaterniond parentRotationAbs = Utility::RawToQuaternion( parentJoint.quaternionAbs );
-   
+
    Eigen::Quaterniond quat = Eigen::Quaterniond::FromTwoVectors( Eigen::Vector3d::UnitY(), parentRotationAbs.inverse()._transformVector( boneVector ) );
    returnValue.length = boneVector.norm();
    returnValue.quaternion = Utility::QuaternionToRaw( quat );
@@ -9,12 +9,23 @@ class Pose;
 class KpToRigHelper
 {
 public:
-   static void HandleSpine( Pose & pose );
-   static void HandleLegs( Pose & pose );
-   static void HandleArms( Pose & pose );
-   
+   // Solves the spine (including baseNeck and baseHead), legs and arms of @count poses sharing one keypoint layout,
+   // but not their hands and feet. The keypoints are gathered into one array per component and each step runs down
+   // those arrays with QuaternionBatch, using scratch buffers kept per thread between calls, so once they have grown
+   // to the largest block nothing is allocated. Every pose is solved independently of the others.
+   // Throws if the layout doesn't have the keypoints needed.
+   static void HandleCore( Pose * const * poses,
+      size_t count );
+   static void HandleCore( Pose & pose );
+
    static Joint CreateJoint( const Joint & parentJoint,
       Eigen::Vector3d boneVector );
 };
 
+inline void KpToRigHelper::HandleCore( Pose & pose )
+{
+   Pose * poses[] = { &pose };
+   HandleCore( poses, 1 );
+}
+
 #endif
@@ -0,0 +1,356 @@
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <fstream>
+#include <stdexcept>
+#include <json.hpp>
+#include "Metrics.hpp"
+
+#ifndef _WIN32
+   #include <sys/resource.h>
+#endif
+
+void Gauge::Set( int64_t value )
+{
+   _value.store( value, std::memory_order_relaxed );
+
+   int64_t highWaterMark = _highWaterMark.load( std::memory_order_relaxed );
+   while ( value > highWaterMark &&
+      !_highWaterMark.compare_exchange_weak( highWaterMark, value, std::memory_order_relaxed ) );
+}
+
+Histogram::Histogram()
+{
+   for ( auto & bucket : _buckets )
+      bucket.store( 0, std::memory_order_relaxed );
+}
+void Histogram::Record( uint64_t value )
+{
+   _buckets[ BucketIndex( value ) ].fetch_add( 1, std::memory_order_relaxed );
+   _count.fetch_add( 1, std::memory_order_relaxed );
+   _sum.fetch_add( value, std::memory_order_relaxed );
+
+   uint64_t min = _min.load( std::memory_order_relaxed );
+   while ( value < min &&
+      !_min.compare_exchange_weak( min, value, std::memory_order_relaxed ) );
+   uint64_t max = _max.load( std::memory_order_relaxed );
+   while ( value > max &&
+      !_max.compare_exchange_weak( max, value, std::memory_order_relaxed ) );
+}
+uint64_t Histogram::Min() const
+{
+   return Count() ? _min.load( std::memory_order_relaxed ) : 0;
+}
+uint64_t Histogram::Quantile( double quantile ) const
+{
+   uint64_t count = Count();
+   if ( count == 0 )
+      return 0;
+
+   // Walk the buckets until we've seen enough values
+   uint64_t target = (uint64_t)std::ceil( std::max( 0.0, std::min( quantile, 1.0 ) ) * count );
+   if ( target == 0 )
+      target = 1;
+   uint64_t seen = 0;
+   for ( size_t i = 0; i < NUM_BUCKETS; ++i )
+   {
+      seen += _buckets[ i ].load( std::memory_order_relaxed );
+      if ( seen >= target )
+         return std::max( Min(), std::min( BucketValue( i ), Max() ) );
+   }
+
+   return Max();
+}
+size_t Histogram::BucketIndex( uint64_t value )
+{
+   // Small values get a bucket each
+   if ( value < 2 * SUB_BUCKET_COUNT )
+      return (size_t)value;
+
+   // Otherwise the top SUB_BUCKET_BITS+1 bits pick the bucket within this power of two
+   int msb = 63;
+   while ( !(value >> msb) )
+      --msb;
+   uint64_t mantissa = value >> (msb - SUB_BUCKET_BITS);
+   return (size_t)((msb - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT + (mantissa - SUB_BUCKET_COUNT));
+}
+uint64_t Histogram::BucketValue( size_t index )
+{
+   if ( index < 2 * SUB_BUCKET_COUNT )
+      return index;
+
+   // The middle of the bucket
+   int msb = (int)(index / SUB_BUCKET_COUNT) + SUB_BUCKET_BITS - 1;
+   uint64_t mantissa = SUB_BUCKET_COUNT + index % SUB_BUCKET_COUNT;
+   uint64_t width = 1ull << (msb - SUB_BUCKET_BITS);
+   return (mantissa << (msb - SUB_BUCKET_BITS)) + width / 2;
+}
+
+bool RateLimiter::Allow( size_t & out_numSuppressed )
+{
+   auto now = std::chrono::steady_clock::now();
+   if ( _any && now - _last < _interval )
+   {
+      ++_numSuppressed;
+      return false;
+   }
+
+   out_numSuppressed = _numSuppressed;
+   _numSuppressed = 0;
+   _last = now;
+   _any = true;
+   return true;
+}
+
+Metrics & Metrics::Instance()
+{
+   static Metrics instance;
+   return instance;
+}
+Metrics::~Metrics()
+{
+   StopPeriodicWrite();
+}
+Counter & Metrics::GetCounter( const std::string & name, const std::string & labels )
+{
+   std::lock_guard< std::mutex > lock( _mutex );
+   auto & counter = _counters[ Key( name, labels ) ];
+   if ( !counter )
+      counter.reset( new Counter() );
+   return *counter;
+}
+Gauge & Metrics::GetGauge( const std::string & name, const std::string & labels )
+{
+   std::lock_guard< std::mutex > lock( _mutex );
+   auto & gauge = _gauges[ Key( name, labels ) ];
+   if ( !gauge )
+      gauge.reset( new Gauge() );
+   return *gauge;
+}
+Histogram & Metrics::GetHistogram( const std::string & name, const std::string & labels, double scale )
+{
+   std::lock_guard< std::mutex > lock( _mutex );
+   auto & entry = _histograms[ Key( name, labels ) ];
+   if ( !entry.histogram )
+   {
+      entry.histogram.reset( new Histogram() );
+      entry.scale = scale;
+   }
+   return *entry.histogram;
+}
+
+// Process-wide memory high-water mark, in bytes
+static int64_t MaxResidentBytes()
+{
+#ifndef _WIN32
+   struct rusage usage;
+   if ( getrusage( RUSAGE_SELF, &usage ) == 0 )
+   {
+#ifdef __APPLE__
+      return (int64_t)usage.ru_maxrss;
+#else
+      return (int64_t)usage.ru_maxrss * 1024;
+#endif
+   }
+#endif
+   return 0;
+}
+
+static const double g_quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+std::string Metrics::ToJson() const
+{
+   Instance().GetGauge( "kp2rig_max_resident_bytes" ).Set( MaxResidentBytes() );
+
+   std::lock_guard< std::mutex > lock( _mutex );
+   nlohmann::json json;
+   json["timestamp"] = std::chrono::duration_cast< std::chrono::milliseconds >( std::chrono::system_clock::now().time_since_epoch() ).count();
+
+   for ( auto & counter : _counters )
+   {
+      nlohmann::json value;
+      value["name"] = counter.first.first;
+      value["labels"] = counter.first.second;
+      value["value"] = counter.second->Value();
+      json["counters"].push_back( value );
+   }
+   for ( auto & gauge : _gauges )
+   {
+      nlohmann::json value;
+      value["name"] = gauge.first.first;
+      value["labels"] = gauge.first.second;
+      value["value"] = gauge.second->Value();
+      value["max"] = gauge.second->HighWaterMark();
+      json["gauges"].push_back( value );
+   }
+   for ( auto & entry : _histograms )
+   {
+      const Histogram & histogram = *entry.second.histogram;
+      double scale = entry.second.scale;
+      nlohmann::json value;
+      value["name"] = entry.first.first;
+      value["labels"] = entry.first.second;
+      value["count"] = histogram.Count();
+      value["sum"] = histogram.Sum() * scale;
+      value["min"] = histogram.Min() * scale;
+      value["max"] = histogram.Max() * scale;
+      for ( auto quantile : g_quantiles )
+      {
+         std::stringstream ss;
+         ss << "p" << quantile * 100;
+         value[ ss.str() ] = histogram.Quantile( quantile ) * scale;
+      }
+      json["histograms"].push_back( value );
+   }
+
+   return json.dump( 2 );
+}
+void Metrics::Remove( const std::string & name,
+   const std::string & labels )
+{
+   std::lock_guard< std::mutex > lock( _mutex );
+   const Key key( name, labels );
+   _counters.erase( key );
+   _gauges.erase( key );
+   _histograms.erase( key );
+}
+std::string Metrics::Label( const std::string & name,
+   const std::string & value )
+{
+   std::string label = name + "=\"";
+   for ( char c : value )
+   {
+      switch ( c )
+      {
+         case '\\': label += "\\\\"; break;
+         case '"': label += "\\\""; break;
+         case '\n': label += "\\n"; break;
+         default: label += c; break;
+      }
+   }
+   return label + "\"";
+}
+std::string Metrics::ToPrometheus() const
+{
+   Instance().GetGauge( "kp2rig_max_resident_bytes" ).Set( MaxResidentBytes() );
+
+   // Joins a metric name with its labels, and optionally one more label
+   auto fullName = []( const std::string & name, const std::string & labels, const std::string & extraLabel = "" )
+   {
+      std::string allLabels = labels;
+      if ( !extraLabel.empty() )
+         allLabels += (allLabels.empty() ? "" : ",") + extraLabel;
+      return allLabels.empty() ? name : name + "{" + allLabels + "}";
+   };
+
+   std::lock_guard< std::mutex > lock( _mutex );
+   std::stringstream ss;
+   ss.precision( 9 );
+   std::string previousName;
+
+   for ( auto & counter : _counters )
+   {
+      if ( counter.first.first != previousName )
+         ss << "# TYPE " << counter.first.first << " counter\n";
+      previousName = counter.first.first;
+      ss << fullName( counter.first.first, counter.first.second ) << " " << counter.second->Value() << "\n";
+   }
+   // A family's samples have to be together, so the high-water marks follow all of a gauge's values as their own family
+   for ( auto first = _gauges.begin(); first != _gauges.end(); )
+   {
+      const std::string & name = (*first).first.first;
+      auto last = first;
+      while ( last != _gauges.end() && (*last).first.first == name )
+         ++last;
+      ss << "# TYPE " << name << " gauge\n";
+      for ( auto gauge = first; gauge != last; ++gauge )
+         ss << fullName( name, (*gauge).first.second ) << " " << (*gauge).second->Value() << "\n";
+      ss << "# TYPE " << name << "_max gauge\n";
+      for ( auto gauge = first; gauge != last; ++gauge )
+         ss << fullName( name + "_max", (*gauge).first.second ) << " " << (*gauge).second->HighWaterMark() << "\n";
+      first = last;
+   }
+   for ( auto & entry : _histograms )
+   {
+      const std::string & name = entry.first.first;
+      const std::string & labels = entry.first.second;
+      const Histogram & histogram = *entry.second.histogram;
+      double scale = entry.second.scale;
+      if ( name != previousName )
+         ss << "# TYPE " << name << " summary\n";
+      previousName = name;
+      for ( auto quantile : g_quantiles )
+      {
+         std::stringstream quantileValue;
+         quantileValue << quantile;
+         ss << fullName( name, labels, Label( "quantile", quantileValue.str() ) ) << " " << histogram.Quantile( quantile ) * scale << "\n";
+      }
+      ss << fullName( name + "_sum", labels ) << " " << histogram.Sum() * scale << "\n";
+      ss << fullName( name + "_count", labels ) << " " << histogram.Count() << "\n";
+   }
+
+   return ss.str();
+}
+void Metrics::Write( const std::string & filename ) const
+{
+   auto endsWith = [ &filename ]( const std::string & suffix )
+   {
+      return filename.size() >= suffix.size() &&
+         filename.compare( filename.size() - suffix.size(), suffix.size(), suffix ) == 0;
+   };
+   std::string text = (endsWith( ".prom" ) || endsWith( ".txt" )) ? ToPrometheus() : ToJson();
+
+   // Write next to the target then rename, so readers never see a partial file
+   std::string tempFilename = filename + ".tmp";
+   {
+      std::ofstream file( tempFilename, std::ios::binary | std::ios::trunc );
+      if ( !file.good() )
+         throw std::runtime_error( "Could not write metrics to '" + tempFilename + "'" );
+      file << text;
+   }
+#ifdef _WIN32
+   // rename() won't replace an existing file on Windows; elsewhere it replaces it atomically, so the file never goes missing
+   std::remove( filename.c_str() );
+#endif
+   if ( std::rename( tempFilename.c_str(), filename.c_str() ) != 0 )
+      throw std::runtime_error( "Could not write metrics to '" + filename + "'" );
+}
+void Metrics::StartPeriodicWrite( const std::string & filename, double intervalSeconds )
+{
+   StopPeriodicWrite();
+
+   _filename = filename;
+   _stopWriting = false;
+   _writeThread = std::thread( [ this, intervalSeconds ]
+   {
+      std::unique_lock< std::mutex > lock( _writeMutex );
+      while ( !_stopWriting )
+      {
+         if ( intervalSeconds > 0 )
+            _writeEvent.wait_for( lock, std::chrono::duration< double >( intervalSeconds ) );
+         else
+            _writeEvent.wait( lock );
+
+         try
+         {
+            Write( _filename );
+         }
+         catch ( std::runtime_error & e )
+         {
+            fprintf( stderr, "%s\n", e.what() );
+         }
+      }
+   });
+}
+void Metrics::StopPeriodicWrite()
+{
+   if ( !_writeThread.joinable() )
+      return;
+
+   {
+      std::lock_guard< std::mutex > lock( _writeMutex );
+      _stopWriting = true;
+   }
+   _writeEvent.notify_one();
+   _writeThread.join();
+}
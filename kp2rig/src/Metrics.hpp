@@ -0,0 +1,169 @@
+#ifndef Metrics_hpp
+#define Metrics_hpp
+
+#include <stdio.h>
+#include <atomic>
+#include <array>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+
+// A value that only goes up
+class Counter
+{
+public:
+   void Add( uint64_t value = 1 ) { _value.fetch_add( value, std::memory_order_relaxed ); }
+   uint64_t Value() const { return _value.load( std::memory_order_relaxed ); }
+
+private:
+   std::atomic< uint64_t > _value{ 0 };
+};
+
+// A value that goes up and down, remembering the highest value it has had
+class Gauge
+{
+public:
+   void Set( int64_t value );
+   void Add( int64_t value ) { Set( _value.fetch_add( value, std::memory_order_relaxed ) + value ); }
+   int64_t Value() const { return _value.load( std::memory_order_relaxed ); }
+   int64_t HighWaterMark() const { return _highWaterMark.load( std::memory_order_relaxed ); }
+
+private:
+   std::atomic< int64_t > _value{ 0 };
+   std::atomic< int64_t > _highWaterMark{ 0 };
+};
+
+// Distribution of values in log-linear buckets, like an HDR histogram: every power of two is split
+// into 2^SUB_BUCKET_BITS linear buckets, so any recorded value is off by at most ~6%.
+// Recording is lock-free and never allocates.
+class Histogram
+{
+public:
+   static const int SUB_BUCKET_BITS = 4;
+   static const int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+   static const int NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+   Histogram();
+
+   void Record( uint64_t value );
+   uint64_t Count() const { return _count.load( std::memory_order_relaxed ); }
+   uint64_t Sum() const { return _sum.load( std::memory_order_relaxed ); }
+   uint64_t Min() const;
+   uint64_t Max() const { return _max.load( std::memory_order_relaxed ); }
+
+   // @quantile is in the range [0,1]
+   uint64_t Quantile( double quantile ) const;
+
+private:
+   static size_t BucketIndex( uint64_t value );
+   static uint64_t BucketValue( size_t index );
+
+   std::array< std::atomic< uint64_t >, NUM_BUCKETS > _buckets;
+   std::atomic< uint64_t > _count{ 0 };
+   std::atomic< uint64_t > _sum{ 0 };
+   std::atomic< uint64_t > _min{ UINT64_MAX };
+   std::atomic< uint64_t > _max{ 0 };
+};
+
+// Records the time spent in scope, in nanoseconds
+class ScopedHistogramTimer
+{
+public:
+   ScopedHistogramTimer( Histogram & histogram )
+      : _histogram( histogram ),
+      _start( std::chrono::steady_clock::now() ) {}
+   ~ScopedHistogramTimer()
+   {
+      _histogram.Record( (uint64_t)std::chrono::duration_cast< std::chrono::nanoseconds >( std::chrono::steady_clock::now() - _start ).count() );
+   }
+
+private:
+   Histogram & _histogram;
+   std::chrono::steady_clock::time_point _start;
+};
+
+// Limits how often a message is printed. Messages that aren't printed are counted,
+// so the next one printed can say how many were skipped.
+class RateLimiter
+{
+public:
+   RateLimiter( double intervalSeconds = 1.0 )
+      : _interval( intervalSeconds ) {}
+
+   // Returns true if a message can be printed now, and sets @out_numSuppressed to the number
+   // of messages skipped since the last one printed
+   bool Allow( size_t & out_numSuppressed );
+
+private:
+   std::chrono::duration< double > _interval;
+   std::chrono::steady_clock::time_point _last;
+   bool _any = false;
+   size_t _numSuppressed = 0;
+};
+
+// Registry of all metrics in this process. Metrics are created on first use and live until exit, or until removed,
+// so references can be kept instead of looking them up every time.
+// Names follow Prometheus conventions; @labels is the text between the braces, e.g. "character=\"player_5\"" (see Label()).
+class Metrics
+{
+public:
+   static Metrics & Instance();
+
+   Counter & GetCounter( const std::string & name, const std::string & labels = "" );
+   Gauge & GetGauge( const std::string & name, const std::string & labels = "" );
+
+   // Values are exported multiplied by @scale, e.g. record nanoseconds with a scale of 1e-9 to export seconds
+   Histogram & GetHistogram( const std::string & name, const std::string & labels = "", double scale = 1.0 );
+
+   // Convenience for histograms of durations, recorded in nanoseconds and exported in seconds
+   Histogram & GetTimer( const std::string & name, const std::string & labels = "" ) { return GetHistogram( name, labels, 1e-9 ); }
+
+   // Removes the metric @name with @labels, whatever its type, so it's no longer exported. For metrics of something that
+   // has gone away, such as a retired character. References to it must not be used afterwards.
+   void Remove( const std::string & name, const std::string & labels );
+
+   // The label @name="@value", with @value escaped for the Prometheus text format
+   static std::string Label( const std::string & name, const std::string & value );
+
+   std::string ToJson() const;
+   std::string ToPrometheus() const;
+
+   // Writes all metrics to @filename, replacing it. Files ending in ".prom" or ".txt" are written in the
+   // Prometheus text format, anything else as JSON
+   void Write( const std::string & filename ) const;
+
+   // Writes all metrics every @intervalSeconds from a background thread, and once more when stopped.
+   // An interval of 0 only writes when stopped.
+   void StartPeriodicWrite( const std::string & filename, double intervalSeconds );
+   void StopPeriodicWrite();
+
+private:
+   Metrics() = default;
+   ~Metrics();
+   Metrics( const Metrics & ) = delete;
+   Metrics & operator=( const Metrics & ) = delete;
+
+   typedef std::pair< std::string, std::string > Key;
+   struct HistogramEntry
+   {
+      std::unique_ptr< Histogram > histogram;
+      double scale;
+   };
+
+   mutable std::mutex _mutex;
+   std::map< Key, std::unique_ptr< Counter > > _counters;
+   std::map< Key, std::unique_ptr< Gauge > > _gauges;
+   std::map< Key, HistogramEntry > _histograms;
+
+   std::thread _writeThread;
+   std::mutex _writeMutex;
+   std::condition_variable _writeEvent;
+   bool _stopWriting = false;
+   std::string _filename;
+};
+
+#endif
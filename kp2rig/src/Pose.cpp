@@ -0,0 +1,18 @@
+#include "Pose.hpp"
+#include "Metrics.hpp"
+
+Pose::RigPose_t & Pose::GenerateRig()
+{
+   if ( _state == FRAME_STATE_RAW )
+   {
+      SolveRig();
+      MarkSolved();
+   }
+   return RigPose();
+}
+void Pose::MarkSolved()
+{
+   static Counter & solves = Metrics::Instance().GetCounter( "kp2rig_solves_total" );
+   solves.Add();
+   _state = FRAME_STATE_SOLVED;
+}
@@ -17,16 +17,28 @@ template <typename T> class KpCommon;
 class Pose
 {
    friend class PoseFactory;
+   friend class RigSolver;
+   friend class AnimatedRig;
+   friend class PoseTestAccess;
    template <typename T> friend class KpCommon;
    typedef class RigPose RigPose_t;
    
 public:
-   // This generates a rigged pose from a Pose if not already created,
-   // then returns the result; otherwise a cached result is returned.
-   // This must interpolate joints as needed to conform to the standard rig structure defined in RigPose.hpp
-   // This is not expected to perform filtering or temporal clean-up.
-   // Assume output rig coordinate system is RIGHT-HANDED (Maya, Blender)
-   virtual RigPose_t & GenerateRig() = 0;
+   // Where a frame is on its way to being written. Only the pipeline (RigSolver and AnimatedRig) moves a frame
+   // forward. Setting its keypoints, getting a keypoint to change, or changing its coordinate system sends it back
+   // to FRAME_STATE_RAW, and its rig is solved again when next needed.
+   enum FRAME_STATE
+   {
+      FRAME_STATE_RAW,      // Keypoints only; any rig is out of date
+      FRAME_STATE_SOLVED,   // Rig generated from the current keypoints, or the keypoints from the rig (FromRigPose())
+      FRAME_STATE_SMOOTHED, // Rig filtered after solving (rolls or rotations), so it no longer matches the keypoints
+      FRAME_STATE_FINAL     // Bone lengths applied, ready to write
+   };
+   
+   // Generates a rigged pose from the keypoints if the frame is FRAME_STATE_RAW and returns it; otherwise the
+   // existing rig is returned as-is. Every solve is counted by the kp2rig_solves_total metric.
+   RigPose_t & GenerateRig();
+   FRAME_STATE State() const { return _state; }
    
    // There are situations where we need to go backwards: given a RigPose create
    // what the original Pose would look like
@@ -49,6 +61,10 @@ public:
    //  "solid_object"
    virtual std::string Category() const = 0;
    
+   // True for poses whose SolveRig() is KpToRigHelper::HandleCore() followed by SolveExtremities().
+   // RigSolver solves the spine, legs and arms of a whole block of these at once.
+   virtual bool UsesHumanoidCore() const { return false; }
+   
    // Useful for testing, this function verifies that the generated rig
    // is valid
    virtual bool ValidateRig() const = 0;
@@ -58,6 +74,7 @@ public:
    
    // Keypoint getter/setter
    // Keypoints can be set in the order they _appear_ or by KEYPOINT_TYPE, but they are only read by KEYPOINT_TYPE.
+   // The non-const getter is for changing a keypoint, and makes the frame FRAME_STATE_RAW; read through a const Pose.
    // Your implementation will need to use the KpImporter::KeypointLayout mapping in order to figure out which
    //   keypoint this is (this layout ultimately comes from the kpDescriptor.json file).
    // Keypoints accessed by keypoint are _not_ the same as the original index they were set by.
@@ -79,7 +96,8 @@ public:
       : _name( rhs._name ),
       _kpType( rhs._kpType ),
       _timestamp( rhs._timestamp ),
-      _kpLayout( rhs._kpLayout ) {}
+      _kpLayout( rhs._kpLayout ),
+      _state( rhs._state ) {}
    Pose( std::string kpType,
       const std::map< KEYPOINT_TYPE, int > & kpLayout )
       : _kpType( kpType ),
@@ -93,10 +111,25 @@ public:
    const std::map< KEYPOINT_TYPE, int > & KeypointLayout() const { return _kpLayout; }
 
 protected:
+   // Only called by GenerateRig(), once each time the keypoints change.
+   // This must interpolate joints as needed to conform to the standard rig structure defined in RigPose.hpp
+   // This is not expected to perform filtering or temporal clean-up.
+   // Assume output rig coordinate system is RIGHT-HANDED (Maya, Blender)
+   virtual void SolveRig() = 0;
+   
+   // Everything SolveRig() does after the spine, legs and arms, for poses that use the humanoid core
+   virtual void SolveExtremities() {}
+   
    std::string _name;
    std::string _kpType;
    int _timestamp = 0;
    std::map< KEYPOINT_TYPE, int > _kpLayout;
+   FRAME_STATE _state = FRAME_STATE_RAW;
+   
+private:
+   // Counts a solve and marks the rig as matching the keypoints
+   void MarkSolved();
+   void State( FRAME_STATE value ) { _state = value; }
 };
 
 #endif
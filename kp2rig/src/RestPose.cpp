@@ -0,0 +1,19 @@
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include "RestPose.hpp"
+
+const RestPose & RestPose::Humanoid()
+{
+   static const RestPose instance;
+   return instance;
+}
+RestPose::RestPose()
+   : rig( Rig::RestPoseHumanoid() ),
+   ankleToeRatio( rig.rAnkle.length / (rig.rAnkle.length + rig.rToeBase.length) ),
+   hipAdjustment( Eigen::AngleAxisd( M_PI, Eigen::Vector3d::UnitZ() ) ),
+   ankleAdjustment( Eigen::AngleAxisd( M_PI * 7.0/18.0, Eigen::Vector3d::UnitX() ) ),
+   toeBaseAdjustment( Eigen::AngleAxisd( M_PI / 9.0, Eigen::Vector3d::UnitX() ) ),
+   rShoulderAdjustment( Eigen::AngleAxisd(  M_PI / 2, Eigen::Vector3d::UnitZ() ) ),
+   lShoulderAdjustment( Eigen::AngleAxisd( -M_PI / 2, Eigen::Vector3d::UnitZ() ) )
+{
+}
@@ -0,0 +1,35 @@
+#ifndef RestPose_hpp
+#define RestPose_hpp
+
+#include "Utility.hpp"
+#include "Rig.hpp"
+
+// Values derived from Rig::RestPoseHumanoid() that the solvers need on every frame.
+// They are computed once, on first use, and are read-only afterwards so it is safe to
+// use them from any number of threads.
+class RestPose
+{
+public:
+   static const RestPose & Humanoid();
+   
+   RestPose( const RestPose & ) = delete;
+   RestPose & operator=( const RestPose & ) = delete;
+   
+   // The rest pose itself
+   const Rig & rig;
+   
+   // Ankle length as a ratio of the ankle-to-toe-tip length
+   double ankleToeRatio;
+   
+   // Rotations that move a child joint from its parent's orientation to the T-pose
+   Eigen::Quaterniond hipAdjustment;       // PI about Z
+   Eigen::Quaterniond ankleAdjustment;     // PI*7/18 about X
+   Eigen::Quaterniond toeBaseAdjustment;   // PI/9 about X
+   Eigen::Quaterniond rShoulderAdjustment; // PI/2 about Z
+   Eigen::Quaterniond lShoulderAdjustment; // -PI/2 about Z
+   
+private:
+   RestPose();
+};
+
+#endif
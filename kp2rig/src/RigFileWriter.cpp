@@ -0,0 +1,73 @@
+#include <stdexcept>
+#include <json.hpp>
+#include "RigFileWriter.hpp"
+#include "config.h"
+
+RigFileWriter::RigFileWriter( int startFrame,
+   int endFrame,
+   double fps )
+{
+   // Scalars go through nlohmann::json so they're formatted exactly as before
+   _buffer = "{\"version\":" + nlohmann::json( MY_VERSION ).dump() +
+      ",\"header\":{\"startFrame\":" + std::to_string( startFrame ) +
+      ",\"endFrame\":" + std::to_string( endFrame ) +
+      ",\"fps\":" + nlohmann::json( fps ).dump() +
+      "},\"rigs\":[";
+}
+void RigFileWriter::BeginRig( const std::string & id,
+   const std::string & type,
+   const std::string & name )
+{
+   if ( _inRig )
+      throw std::runtime_error( "Rig file: rig '" + id + "' started before the previous rig ended" );
+   if ( !_rigIds.insert( id ).second )
+      throw std::runtime_error( "Rig file: rig '" + id + "' written twice" );
+   
+   if ( _rigIds.size() > 1 )
+      _buffer += ',';
+   _buffer += "{\"id\":" + nlohmann::json( id ).dump() +
+      ",\"type\":" + nlohmann::json( type ).dump() +
+      ",\"name\":" + nlohmann::json( name ).dump();
+   _inRig = true;
+}
+void RigFileWriter::Field( const char * key,
+   int value )
+{
+   Key( key );
+   _buffer += std::to_string( value );
+}
+void RigFileWriter::Field( const char * key,
+   const unsigned char * base64,
+   size_t length )
+{
+   Key( key );
+   _buffer += '"';
+   _buffer.append( reinterpret_cast< const char * >( base64 ), length );
+   _buffer += '"';
+}
+void RigFileWriter::EndRig()
+{
+   _buffer += '}';
+   _inRig = false;
+}
+std::string RigFileWriter::Finish()
+{
+   if ( _inRig )
+      EndRig();
+   _buffer += "]}";
+   
+   std::string contents;
+   contents.swap( _buffer );
+   _rigIds.clear();
+   return contents;
+}
+void RigFileWriter::Key( const char * key )
+{
+   if ( !_inRig )
+      throw std::runtime_error( std::string( "Rig file: field '" ) + key + "' written outside a rig" );
+   
+   // Keys are our own identifiers, so they never need escaping
+   _buffer += ",\"";
+   _buffer += key;
+   _buffer += "\":";
+}
@@ -0,0 +1,45 @@
+#ifndef RigFileWriter_hpp
+#define RigFileWriter_hpp
+
+#include <string>
+#include <unordered_set>
+
+// Streams a rig file straight into a buffer, one rig at a time, instead of building a JSON document first.
+// Payloads (compressed, base64 arrays) are copied once, into the buffer, and nothing is re-serialized.
+// The output is the same rig file rig2c reads, though keys are in the order written rather than sorted.
+//
+// Usage: construct with the header, then for each rig BeginRig(), any Field()s, and EndRig(); then Finish().
+class RigFileWriter
+{
+public:
+   RigFileWriter( int startFrame,
+      int endFrame,
+      double fps );
+   
+   // Starts a new rig. Every rig in a file must have a different @id.
+   void BeginRig( const std::string & id,
+      const std::string & type,
+      const std::string & name );
+   void Field( const char * key,
+      int value );
+   
+   // @base64 is written as the string value, as-is
+   void Field( const char * key,
+      const unsigned char * base64,
+      size_t length );
+   void EndRig();
+   
+   size_t NumRigs() const { return _rigIds.size(); }
+   
+   // Closes the file and returns its contents; the writer is empty afterwards
+   std::string Finish();
+   
+private:
+   void Key( const char * key );
+   
+   std::string _buffer;
+   std::unordered_set< std::string > _rigIds;
+   bool _inRig = false;
+};
+
+#endif
@@ -1,174 +1,293 @@
 #define _USE_MATH_DEFINES
 #include <cmath>
+#include <cstring>
+#include <type_traits>
 #include "RigPose.hpp"
 #include "Utility.hpp"
+#include "RestPose.hpp"
+#include "QuaternionBatch.hpp"
+
+// Poses are cloned for every frame that's smoothed or filled in, so they must copy as plain memory
+static_assert( std::is_trivially_copyable< RigPose >::value, "RigPose must be trivially copyable" );
 
 RigPose::RigPose( int timestamp, const Rig & rig )
    :_timestamp( timestamp ),
    _rig( rig )
 {
 }
+void RigPose::KpType( std::string v )
+{
+   if ( v.size() > MAX_KP_TYPE_LENGTH )
+      throw std::runtime_error( "Keypoint type '" + v + "' is too long" );
+   _kpType = {};
+   std::memcpy( _kpType.data(), v.data(), v.size() );
+}
+namespace
+{
+   // The rig joint whose head is at keypoint @type
+   Rig::JOINT_TYPE JointAtKeypoint( KEYPOINT_TYPE type )
+   {
+      switch ( type )
+      {
+         case PELVIS:         return Rig::PELVIS;
+         case RIGHT_HIP:      return Rig::RHIP;
+         case RIGHT_KNEE:     return Rig::RKNEE;
+         case RIGHT_ANKLE:    return Rig::RANKLE;
+         case LEFT_HIP:       return Rig::LHIP;
+         case LEFT_KNEE:      return Rig::LKNEE;
+         case LEFT_ANKLE:     return Rig::LANKLE;
+         case RIGHT_SHOULDER: return Rig::RSHOULDER;
+         case RIGHT_ELBOW:    return Rig::RELBOW;
+         case RIGHT_WRIST:    return Rig::RWRIST;
+         case LEFT_SHOULDER:  return Rig::LSHOULDER;
+         case LEFT_ELBOW:     return Rig::LELBOW;
+         case LEFT_WRIST:     return Rig::LWRIST;
+         case BASE_NECK:      return Rig::BASENECK;
+         case BASE_HEAD:      return Rig::BASEHEAD;
+         default:             return Rig::JOINT_TYPE_UNKNOWN;
+      }
+   }
+}
+void SupplimentaryJointList::Set( KEYPOINT_TYPE type,
+   KEYPOINT_TYPE parentType,
+   const Joint & joint )
+{
+   if ( type < 0 || type >= KP_UNKNOWN )
+      throw std::runtime_error( "Supplimentary joints need a known keypoint type" );
+   const Rig::JOINT_TYPE parent = JointAtKeypoint( parentType );
+   if ( parent == Rig::JOINT_TYPE_UNKNOWN )
+      throw std::runtime_error( "Supplimentary joint '" + KpTypeToStr( type ) + "' can't attach to '" + KpTypeToStr( parentType ) + "', it isn't the head of a rig joint" );
+   
+   if ( !Has( type ) )
+   {
+      if ( _size == MAX_NUM_JOINTS )
+         throw std::runtime_error( "Too many supplimentary joints, at most " + std::to_string( MAX_NUM_JOINTS ) + " are supported" );
+      _slots[ type ] = (uint8_t)++_size;
+   }
+   
+   SupplimentaryJoint & supplimentaryJoint = _joints[ _slots[ type ] - 1 ];
+   static_cast< Joint & >( supplimentaryJoint ) = joint;
+   supplimentaryJoint.type = type;
+   supplimentaryJoint.parentType = parentType;
+   supplimentaryJoint.parent = parent;
+}
+namespace
+{
+   // Scratch space for the batches, reused between calls
+   struct BatchScratch
+   {
+      QuaternionBatch::QuaternionBuffer from;
+      QuaternionBatch::QuaternionBuffer to;
+      QuaternionBatch::QuaternionBuffer result;
+      std::vector< double > ratios;
+      std::vector< RigPose * > poses;
+   };
+   BatchScratch & Scratch()
+   {
+      thread_local BatchScratch scratch;
+      return scratch;
+   }
+
+   void Fill( QuaternionBatch::QuaternionBuffer & out_buffer,
+      const Eigen::Quaterniond & rotation )
+   {
+      const std::array< double, 4 > raw = Utility::QuaternionToRaw( rotation );
+      for ( size_t i = 0; i < out_buffer.Size(); ++i )
+         out_buffer.Set( i, raw );
+   }
+   
+   // Multiplies the running rotations @ref_rotations of every pose by the rotation of joint @type, and stores the
+   // result as that joint's absolute rotation
+   void ChainJoint( RigPose * const * poses,
+      Rig::JOINT_TYPE type,
+      QuaternionBatch::QuaternionBuffer & ref_rotations,
+      QuaternionBatch::QuaternionBuffer & ref_local )
+   {
+      const size_t numPoses = ref_rotations.Size();
+      for ( size_t i = 0; i < numPoses; ++i )
+         ref_local.Set( i, poses[ i ]->GetRig().GetJoint( type ).quaternion );
+      QuaternionBatch::Multiply( ref_rotations.View(), ref_local.View(), ref_rotations.View(), numPoses );
+      for ( size_t i = 0; i < numPoses; ++i )
+         poses[ i ]->GetRig().GetJoint( type ).quaternionAbs = ref_rotations.Get( i );
+   }
+   
+   // Starts a chain of joints at the absolute rotation of joint @parent, followed by the fixed rest pose @adjustment
+   void StartChain( RigPose * const * poses,
+      Rig::JOINT_TYPE parent,
+      const Eigen::Quaterniond & adjustment,
+      QuaternionBatch::QuaternionBuffer & out_rotations,
+      QuaternionBatch::QuaternionBuffer & ref_local )
+   {
+      const size_t numPoses = out_rotations.Size();
+      for ( size_t i = 0; i < numPoses; ++i )
+         out_rotations.Set( i, poses[ i ]->GetRig().GetJoint( parent ).quaternionAbs );
+      Fill( ref_local, adjustment );
+      QuaternionBatch::Multiply( out_rotations.View(), ref_local.View(), out_rotations.View(), numPoses );
+   }
+}
+
 RigPose RigPose::Interpolate( const RigPose & rhs, double ratio ) const
 {
-   // Start by copying this
-   RigPose returnValue( *this );
-      
+   RigPose returnValue;
+   Interpolate( rhs, &ratio, 1, &returnValue );
+   return returnValue;
+};
+void RigPose::Interpolate( const RigPose & rhs,
+   const double * ratios,
+   size_t numRatios,
+   RigPose * out_poses ) const
+{
+   // Start by copying this, bone lengths are the same and already copied
+   for ( size_t i = 0; i < numRatios; ++i )
+      out_poses[ i ] = *this;
+   
    // LERP the position
    Eigen::Vector3d position1 = Utility::RawToVector( this->_rig.location );
    Eigen::Vector3d position2 = Utility::RawToVector( rhs._rig.location );
    Eigen::Vector3d vec = position2 - position1;
-   vec *= ratio;
-   Eigen::Vector3d interpolatedPosition = position1 + vec;
-   returnValue.GetRig().location = Utility::VectorToRaw( interpolatedPosition );
-
-   // Bone lengths are the same and already copied
-
-   // SLERP all bone rotations in the final rig
-   for ( int i = 0; i < _rig.numJointsUsed; ++i )
+   for ( size_t i = 0; i < numRatios; ++i )
+      out_poses[ i ].GetRig().location = Utility::VectorToRaw( position1 + vec * ratios[ i ] );
+   
+   // SLERP all bone rotations in the final rig and all supplimentary joints as one batch,
+   // laid out joint by joint with an entry for every ratio
+   BatchScratch & scratch = Scratch();
+   const size_t numJoints = (size_t)_rig.numJointsUsed + SupplimentaryJoints.Size();
+   const size_t batchSize = numJoints * numRatios;
+   scratch.from.Resize( batchSize );
+   scratch.to.Resize( batchSize );
+   scratch.result.Resize( batchSize );
+   scratch.ratios.resize( batchSize );
+   
+   size_t index = 0;
+   auto addJoint = [&]( const Joint & joint1, const Joint & joint2 )
+   {
+      for ( size_t i = 0; i < numRatios; ++i, ++index )
+      {
+         scratch.from.Set( index, joint1.quaternion );
+         scratch.to.Set( index, joint2.quaternion );
+         scratch.ratios[ index ] = ratios[ i ];
+      }
+   };
+   for ( int j = 0; j < _rig.numJointsUsed; ++j )
+      addJoint( this->_rig.GetJoint( Rig::JOINT_TYPE(j) ), rhs._rig.GetJoint( Rig::JOINT_TYPE(j) ) );
+   for ( const SupplimentaryJoint & joint : SupplimentaryJoints )
+      addJoint( joint, rhs.SupplimentaryJoints.At( joint.type ) );
+   
+   QuaternionBatch::Slerp( scratch.from.View(), scratch.to.View(), scratch.ratios.data(), scratch.result.View(), batchSize );
+   
+   index = 0;
+   for ( int j = 0; j < _rig.numJointsUsed; ++j )
    {
-      Eigen::Quaterniond rotation1 = Utility::RawToQuaternion( this->_rig.GetJoint( Rig::JOINT_TYPE(i) ).quaternion );
-      Eigen::Quaterniond rotation2 = Utility::RawToQuaternion( rhs._rig.GetJoint( Rig::JOINT_TYPE(i) ).quaternion );
-      Eigen::Quaterniond interpolatedRotation = rotation1.slerp( ratio, rotation2 );
-      returnValue.GetRig().GetJoint( Rig::JOINT_TYPE(i) ).quaternion = Utility::QuaternionToRaw( interpolatedRotation );
+      for ( size_t i = 0; i < numRatios; ++i, ++index )
+         out_poses[ i ].GetRig().GetJoint( Rig::JOINT_TYPE(j) ).quaternion = scratch.result.Get( index );
    }
-
-   // SLERP all supplimentary joints
-   for ( auto & jointPair : SupplimentaryJoints )
+   for ( const SupplimentaryJoint & joint : SupplimentaryJoints )
    {
-      Eigen::Quaterniond rotation1 = Utility::RawToQuaternion( jointPair.second.quaternion );
-      Eigen::Quaterniond rotation2 = Utility::RawToQuaternion( rhs.SupplimentaryJoints.at( jointPair.first ).quaternion );
-      Eigen::Quaterniond interpolatedRotation = rotation1.slerp( ratio, rotation2 );
-      returnValue.SupplimentaryJoints.at( jointPair.first ).quaternion = Utility::QuaternionToRaw( interpolatedRotation );
+      for ( size_t i = 0; i < numRatios; ++i, ++index )
+         out_poses[ i ].SupplimentaryJoints.At( joint.type ).quaternion = scratch.result.Get( index );
    }
-
+   
    // LERP all bone offsets
-   for ( int i = 0; i < _rig.numJointOffsetsUsed; ++i )
+   for ( int j = 0; j < _rig.numJointOffsetsUsed; ++j )
    {
-      Eigen::Vector3d offset1 = Utility::RawToVector( this->_rig.GetJointOffset( Rig::JOINT_OFFSET_TYPE(i) ) );
-      Eigen::Vector3d offset2 = Utility::RawToVector( rhs._rig.GetJointOffset( Rig::JOINT_OFFSET_TYPE(i) ) );
+      const Rig::JOINT_OFFSET_TYPE type = Rig::JOINT_OFFSET_TYPE(j);
+      Eigen::Vector3d offset1 = Utility::RawToVector( this->_rig.GetJointOffset( type ) );
+      Eigen::Vector3d offset2 = Utility::RawToVector( rhs._rig.GetJointOffset( type ) );
       Eigen::Vector3d diffVector = offset2 - offset1;
-      diffVector *= ratio;
-      Eigen::Vector3d interpolatedOffset = offset1 + diffVector;
-      returnValue.GetRig().GetJointOffset( Rig::JOINT_OFFSET_TYPE(i) ) = Utility::VectorToRaw( interpolatedOffset );
+      for ( size_t i = 0; i < numRatios; ++i )
+         out_poses[ i ].GetRig().GetJointOffset( type ) = Utility::VectorToRaw( offset1 + diffVector * ratios[ i ] );
    }
    
    // Ensure our absolute rotations are set properly
-   returnValue.UpdateAbsRotations();
-   
-   return returnValue;
-};
-void RigPose::UpdateAbsRotations()
+   scratch.poses.resize( numRatios );
+   for ( size_t i = 0; i < numRatios; ++i )
+      scratch.poses[ i ] = &out_poses[ i ];
+   UpdateAbsRotations( scratch.poses.data(), numRatios );
+}
+void RigPose::UpdateAbsRotations( RigPose * const * poses,
+   size_t numPoses )
 {
-   Eigen::Vector3d upVector( 0, 1, 0 );
-   //Eigen::Vector3d downVector( 0, -1, 0 );
-   Eigen::Quaterniond pelvisQuaternion = Utility::RawToQuaternion( _rig.pelvis.quaternion );
-   Eigen::Quaterniond q;
+   // Each joint is done for every pose at once, walking down the hierarchy
+   BatchScratch & scratch = Scratch();
+   QuaternionBatch::QuaternionBuffer & q = scratch.from;
+   QuaternionBatch::QuaternionBuffer & local = scratch.to;
+   q.Resize( numPoses );
+   local.Resize( numPoses );
+   const RestPose & restPose = RestPose::Humanoid();
 
    // SPINE
    {
       // pelvis/spine1
-      q = pelvisQuaternion;
-      _rig.pelvis.quaternionAbs = Utility::QuaternionToRaw( q );
-      
-      // spine2
-      q = q * Utility::RawToQuaternion( _rig.spine2.quaternion );
-      _rig.spine2.quaternionAbs = Utility::QuaternionToRaw( q );
+      for ( size_t i = 0; i < numPoses; ++i )
+      {
+         Rig & rig = poses[ i ]->GetRig();
+         rig.pelvis.quaternionAbs = rig.pelvis.quaternion;
+         q.Set( i, rig.pelvis.quaternion );
+      }
       
-      // spine3
-      q = q * Utility::RawToQuaternion( _rig.spine3.quaternion );
-      _rig.spine3.quaternionAbs = Utility::QuaternionToRaw( q );
-
-      // spine4
-      q = q * Utility::RawToQuaternion( _rig.spine4.quaternion );
-      _rig.spine4.quaternionAbs = Utility::QuaternionToRaw( q );
-
-      // torso
-      q = q * Utility::RawToQuaternion( _rig.baseNeck.quaternion );
-      _rig.baseNeck.quaternionAbs = Utility::QuaternionToRaw( q );
-
-      // baseHead
-      q = q * Utility::RawToQuaternion( _rig.baseHead.quaternion );
-      _rig.baseHead.quaternionAbs = Utility::QuaternionToRaw( q );
+      ChainJoint( poses, Rig::SPINE2, q, local );
+      ChainJoint( poses, Rig::SPINE3, q, local );
+      ChainJoint( poses, Rig::SPINE4, q, local );
+      ChainJoint( poses, Rig::BASENECK, q, local );
+      ChainJoint( poses, Rig::BASEHEAD, q, local );
    }
    
    // LEGS
    {
-      Eigen::Quaterniond hipAdjustmentRotation( Eigen::AngleAxisd( M_PI, Eigen::Vector3d::UnitZ() ) );
-      Eigen::Quaterniond ankleAdjustementRotation( Eigen::AngleAxisd( M_PI * 7.0/18.0, Eigen::Vector3d::UnitX() ) );
-      Eigen::Quaterniond toeBaseAdjustementRotation( Eigen::AngleAxisd( M_PI / 9.0, Eigen::Vector3d::UnitX() ) );
-      
-      // rHip
-      q = (pelvisQuaternion * hipAdjustmentRotation) * Utility::RawToQuaternion( _rig.rHip.quaternion );
-      _rig.rHip.quaternionAbs = Utility::QuaternionToRaw( q );
-
-      // rKnee
-      q = q * Utility::RawToQuaternion( _rig.rKnee.quaternion );
-      _rig.rKnee.quaternionAbs = Utility::QuaternionToRaw( q );
-      
-      // rAnkle
-      q = (q * ankleAdjustementRotation) * Utility::RawToQuaternion( _rig.rAnkle.quaternion );
-      _rig.rAnkle.quaternionAbs = Utility::QuaternionToRaw( q );
+      // Right leg
+      StartChain( poses, Rig::PELVIS, restPose.hipAdjustment, q, local );
+      ChainJoint( poses, Rig::RHIP, q, local );
+      ChainJoint( poses, Rig::RKNEE, q, local );
+      Fill( local, restPose.ankleAdjustment );
+      QuaternionBatch::Multiply( q.View(), local.View(), q.View(), numPoses );
+      ChainJoint( poses, Rig::RANKLE, q, local );
+      Fill( local, restPose.toeBaseAdjustment );
+      QuaternionBatch::Multiply( q.View(), local.View(), q.View(), numPoses );
+      ChainJoint( poses, Rig::RTOEBASE, q, local );
       
-      // rToeBase
-      q = (q * toeBaseAdjustementRotation) * Utility::RawToQuaternion( _rig.rToeBase.quaternion );
-      _rig.rToeBase.quaternionAbs = Utility::QuaternionToRaw( q );
-      
-      // lHip
-      q = (pelvisQuaternion * hipAdjustmentRotation) * Utility::RawToQuaternion( _rig.lHip.quaternion );
-      _rig.lHip.quaternionAbs = Utility::QuaternionToRaw( q );
-
-      // lKnee
-      q = q * Utility::RawToQuaternion( _rig.lKnee.quaternion );
-      _rig.lKnee.quaternionAbs = Utility::QuaternionToRaw( q );
-      
-      // lAnkle
-      q = (q * ankleAdjustementRotation) * Utility::RawToQuaternion( _rig.lAnkle.quaternion );
-      _rig.lAnkle.quaternionAbs = Utility::QuaternionToRaw( q );
-      
-      // lToeBase
-      q = (q * toeBaseAdjustementRotation) * Utility::RawToQuaternion( _rig.lToeBase.quaternion );
-      _rig.lToeBase.quaternionAbs = Utility::QuaternionToRaw( q );
+      // Left leg
+      StartChain( poses, Rig::PELVIS, restPose.hipAdjustment, q, local );
+      ChainJoint( poses, Rig::LHIP, q, local );
+      ChainJoint( poses, Rig::LKNEE, q, local );
+      Fill( local, restPose.ankleAdjustment );
+      QuaternionBatch::Multiply( q.View(), local.View(), q.View(), numPoses );
+      ChainJoint( poses, Rig::LANKLE, q, local );
+      Fill( local, restPose.toeBaseAdjustment );
+      QuaternionBatch::Multiply( q.View(), local.View(), q.View(), numPoses );
+      ChainJoint( poses, Rig::LTOEBASE, q, local );
    }
    
    // ARMS
    {
-      Eigen::Quaterniond spine4Quaternion = Utility::RawToQuaternion( _rig.spine4.quaternionAbs );
-      Eigen::Quaterniond rShoulderAdjustmentRotatation( Eigen::AngleAxisd(  M_PI / 2, Eigen::Vector3d::UnitZ() ) );
-      Eigen::Quaterniond lShoulderAdjustmentRotatation( Eigen::AngleAxisd( -M_PI / 2, Eigen::Vector3d::UnitZ() ) );
-
-      // rShoulder
-      q = (spine4Quaternion * rShoulderAdjustmentRotatation) * Utility::RawToQuaternion( _rig.rShoulder.quaternion );
-      _rig.rShoulder.quaternionAbs = Utility::QuaternionToRaw( q );
-
-      // rElbow
-      q = q * Utility::RawToQuaternion( _rig.rElbow.quaternion );
-      _rig.rElbow.quaternionAbs = Utility::QuaternionToRaw( q );
-      
-      // rWrist
-      q = q * Utility::RawToQuaternion( _rig.rWrist.quaternion );
-      _rig.rWrist.quaternionAbs = Utility::QuaternionToRaw( q );
-      
-      // lShoulder
-      q = (spine4Quaternion * lShoulderAdjustmentRotatation) * Utility::RawToQuaternion( _rig.lShoulder.quaternion );
-      _rig.lShoulder.quaternionAbs = Utility::QuaternionToRaw( q );
-
-      // lElbow
-      q = q * Utility::RawToQuaternion( _rig.lElbow.quaternion );
-      _rig.lElbow.quaternionAbs = Utility::QuaternionToRaw( q );
+      // Right arm
+      StartChain( poses, Rig::SPINE4, restPose.rShoulderAdjustment, q, local );
+      ChainJoint( poses, Rig::RSHOULDER, q, local );
+      ChainJoint( poses, Rig::RELBOW, q, local );
+      ChainJoint( poses, Rig::RWRIST, q, local );
       
-      // lWrist
-      q = q * Utility::RawToQuaternion( _rig.lWrist.quaternion );
-      _rig.lWrist.quaternionAbs = Utility::QuaternionToRaw( q );
+      // Left arm
+      StartChain( poses, Rig::SPINE4, restPose.lShoulderAdjustment, q, local );
+      ChainJoint( poses, Rig::LSHOULDER, q, local );
+      ChainJoint( poses, Rig::LELBOW, q, local );
+      ChainJoint( poses, Rig::LWRIST, q, local );
    }
    
    // SUPPLIMENTARY
-   for ( auto & jointPair : SupplimentaryJoints )
+   if ( !numPoses )
+      return;
+   for ( const SupplimentaryJoint & firstJoint : poses[ 0 ]->SupplimentaryJoints )
    {
-      // Find the parent joint
-      // TODO: this assumes the parent is in the rig as a primary joint, not supplimentary
-      const Joint & parent = _rig.GetJoint( jointPair.second.parentName );
+      const KEYPOINT_TYPE type = firstJoint.type;
+      for ( size_t i = 0; i < numPoses; ++i )
+      {
+         const SupplimentaryJoint & joint = poses[ i ]->SupplimentaryJoints.At( type );
+         q.Set( i, poses[ i ]->GetRig().GetJoint( joint.parent ).quaternionAbs );
+         local.Set( i, joint.quaternion );
+      }
       
       // Update the absolute rotation
-      jointPair.second.quaternionAbs = Utility::QuaternionToRaw( Utility::RawToQuaternion( parent.quaternionAbs ) * Utility::RawToQuaternion( jointPair.second.quaternion ) );
+      QuaternionBatch::Multiply( q.View(), local.View(), q.View(), numPoses );
+      for ( size_t i = 0; i < numPoses; ++i )
+         poses[ i ]->SupplimentaryJoints.At( type ).quaternionAbs = q.Get( i );
    }
 }
@@ -3,22 +3,60 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <array>
 #include <memory>
 #include <string>
-#include <map>
+#include <stdexcept>
 #include "Rig.hpp"
+#include "KpType.hpp"
 
 // Supplimentary joints are keypoints of importance not included in the final rig.
+// Each one hangs off the head of a rig joint, resolved once when the joint is added.
 struct SupplimentaryJoint : public Joint
 {
-   SupplimentaryJoint() = default;
-   SupplimentaryJoint( std::string name,
-      std::string parentName,
-      const Joint & joint )
-      : Joint( joint ), name{ name }, parentName{ parentName } {}
-   SupplimentaryJoint( const SupplimentaryJoint & ) = default;
-   std::string name;
-   std::string parentName;
+   KEYPOINT_TYPE type = KP_UNKNOWN;
+   
+   // The keypoint at the head of the parent joint, and the parent joint itself
+   KEYPOINT_TYPE parentType = KP_UNKNOWN;
+   Rig::JOINT_TYPE parent = Rig::JOINT_TYPE_UNKNOWN;
+};
+
+// A small, fixed number of supplimentary joints stored in place and looked up by keypoint type,
+// so copying a pose is a plain copy. Joints stay in the order they were first added.
+class SupplimentaryJointList
+{
+public:
+   static const size_t MAX_NUM_JOINTS = 8;
+   
+   // Adds the joint for keypoint @type, or replaces it if already added.
+   // @parentType must be the head of a rig joint, and throws otherwise.
+   void Set( KEYPOINT_TYPE type,
+      KEYPOINT_TYPE parentType,
+      const Joint & joint );
+   
+   // Throws std::out_of_range if there is no joint for @type
+   SupplimentaryJoint & At( KEYPOINT_TYPE type )
+   {
+      if ( !Has( type ) )
+         throw std::out_of_range( "No supplimentary joint for keypoint '" + KpTypeToStr( type ) + "'" );
+      return _joints[ _slots[ type ] - 1 ];
+   }
+   const SupplimentaryJoint & At( KEYPOINT_TYPE type ) const { return const_cast< SupplimentaryJointList * >(this)->At( type ); }
+   bool Has( KEYPOINT_TYPE type ) const { return type >= 0 && type < KP_UNKNOWN && _slots[ type ] != 0; }
+   size_t Size() const { return _size; }
+   
+   SupplimentaryJoint * begin() { return _joints.data(); }
+   SupplimentaryJoint * end() { return _joints.data() + _size; }
+   const SupplimentaryJoint * begin() const { return _joints.data(); }
+   const SupplimentaryJoint * end() const { return _joints.data() + _size; }
+   
+private:
+   std::array< SupplimentaryJoint, MAX_NUM_JOINTS > _joints;
+   size_t _size = 0;
+   
+   // One more than the position of each keypoint type's joint, 0 if it has none
+   std::array< uint8_t, KP_UNKNOWN > _slots = {};
 };
 
 // Wrapper for a rig, has extra information not contained in the rig
@@ -31,8 +69,8 @@ public:
    RigPose( RigPose && ) = default;
    RigPose & operator=( const RigPose & ) = default;
 
-   std::string KpType() const { return _kpType; }
-   void KpType( std::string v ) { _kpType = v; }
+   std::string KpType() const { return _kpType.data(); }
+   void KpType( std::string v );
    int Timestamp() const { return _timestamp; }
    void Timestamp( int value ) { _timestamp = value; }
    
@@ -42,14 +80,25 @@ public:
    // @ratio is a value in the range [0,1], where @ratio == 0 is same as this, @ratio == 1 is same as rhs
    RigPose Interpolate( const RigPose & rhs, double ratio ) const;
    
+   // Same as above for a batch of ratios, written to @out_poses which must hold @numRatios poses.
+   // Rotations are interpolated for every joint and ratio in one QuaternionBatch call.
+   void Interpolate( const RigPose & rhs,
+      const double * ratios,
+      size_t numRatios,
+      RigPose * out_poses ) const;
+   
+   // Works out the absolute rotation of every joint from the relative rotations, for all of @poses at once
+   static void UpdateAbsRotations( RigPose * const * poses,
+      size_t numPoses );
+   
    // Supplimentary joints are keypoints of importance not included in the final rig.
-   std::map< std::string, SupplimentaryJoint > SupplimentaryJoints;
+   SupplimentaryJointList SupplimentaryJoints;
    
 protected:
-   void UpdateAbsRotations();
-   
    int _timestamp = -1;
-   std::string _kpType;
+   // Kept in place rather than as a std::string so RigPose stays trivially copyable
+   static const size_t MAX_KP_TYPE_LENGTH = 31;
+   std::array< char, MAX_KP_TYPE_LENGTH + 1 > _kpType = {};
    Rig _rig;
 };
 
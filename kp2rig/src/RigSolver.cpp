@@ -0,0 +1,106 @@
+#include <stdexcept>
+#include <algorithm>
+#include <typeinfo>
+#include "RigSolver.hpp"
+#include "KpToRigHelper.hpp"
+#include "WorkerPool.hpp"
+#include "Trace.hpp"
+
+// Splitting a block smaller than this isn't worth handing to another thread
+const size_t MIN_FRAMES_PER_THREAD = 16;
+
+void RigSolver::Solve( Pose * const * poses,
+   size_t numPoses,
+   unsigned int numThreads )
+{
+   SolveParallel( poses, numPoses, nullptr, numThreads );
+}
+void RigSolver::Solve( Pose * const * poses,
+   size_t numPoses,
+   const std::vector< std::vector< double > > & keypointChannels,
+   unsigned int numThreads )
+{
+   for ( const auto & channel : keypointChannels )
+   {
+      if ( channel.size() < numPoses )
+         throw std::runtime_error( "RigSolver: keypoint channel is smaller than the block of poses" );
+   }
+
+   SolveParallel( poses, numPoses, &keypointChannels, numThreads );
+}
+void RigSolver::SolveBlock( Pose * const * poses,
+   size_t begin,
+   size_t end,
+   const std::vector< std::vector< double > > * keypointChannels )
+{
+   TRACE_SCOPE_ARGS( "RigSolver::SolveBlock", "frames", end - begin );
+   thread_local std::vector< Pose * > rawPoses;
+
+   // If new keypoints were provided, set them; this also invalidates any existing rig
+   if ( keypointChannels )
+   {
+      const auto & channels = *keypointChannels;
+      for ( size_t frameIndex = begin; frameIndex < end; ++frameIndex )
+      {
+         for ( size_t i = 0; i < channels.size() / 3; ++i )
+         {
+            poses[ frameIndex ]->Keypoint( {
+               channels[ i * 3 + 0 ][ frameIndex ],
+               channels[ i * 3 + 1 ][ frameIndex ],
+               channels[ i * 3 + 2 ][ frameIndex ] },
+               (int)i );
+         }
+      }
+   }
+
+   // Only frames without a rig are solved. A block is one keypoint type, so if the first needs the humanoid core they all do.
+   rawPoses.clear();
+   for ( size_t frameIndex = begin; frameIndex < end; ++frameIndex )
+   {
+      if ( poses[ frameIndex ]->State() == Pose::FRAME_STATE_RAW )
+         rawPoses.push_back( poses[ frameIndex ] );
+   }
+   if ( rawPoses.empty() )
+      return;
+   const Pose & first = *rawPoses.front();
+   bool batched = first.UsesHumanoidCore();
+   for ( auto pose : rawPoses )
+      batched = batched && typeid( *pose ) == typeid( first );
+   if ( !batched )
+   {
+      for ( auto pose : rawPoses )
+         pose->GenerateRig();
+      return;
+   }
+
+   KpToRigHelper::HandleCore( rawPoses.data(), rawPoses.size() );
+
+   // Hands, feet and the rest are particular to each pose type
+   for ( auto pose : rawPoses )
+   {
+      pose->SolveExtremities();
+      pose->MarkSolved();
+   }
+}
+void RigSolver::SolveParallel( Pose * const * poses,
+   size_t numPoses,
+   const std::vector< std::vector< double > > * keypointChannels,
+   unsigned int numThreads )
+{
+   // Don't use more threads than we have work for
+   numThreads = (unsigned int)std::min( (size_t)std::max( numThreads, 1u ), numPoses / MIN_FRAMES_PER_THREAD );
+   if ( numThreads <= 1 )
+   {
+      SolveBlock( poses, 0, numPoses, keypointChannels );
+      return;
+   }
+
+   // Each part is a contiguous sub-block
+   const size_t framesPerThread = (numPoses + numThreads - 1) / numThreads;
+   WorkerPool::Instance().Run( numThreads, [=]( size_t part )
+   {
+      const size_t begin = std::min( part * framesPerThread, numPoses );
+      const size_t end = std::min( begin + framesPerThread, numPoses );
+      SolveBlock( poses, begin, end, keypointChannels );
+   } );
+}
@@ -0,0 +1,43 @@
+#ifndef RigSolver_hpp
+#define RigSolver_hpp
+
+#include <vector>
+#include "Pose.hpp"
+
+// Generates rigs for a contiguous block of frames belonging to one character, and therefore one keypoint type.
+//
+// Humanoid poses (see Pose::UsesHumanoidCore()) have their spine, legs and arms solved for the whole block at once
+// by KpToRigHelper::HandleCore(), the same code that solves them one pose at a time. Hands, feet and anything else
+// particular to a pose type are then finished one pose at a time. Other poses are solved one at a time with
+// Pose::GenerateRig().
+//
+// Every frame is solved independently of its neighbors, which lets a block be split across the threads of WorkerPool;
+// the only shared state used while solving is read-only (see RestPose).
+class RigSolver
+{
+public:
+   // Generate a rig for every pose in [poses, poses + numPoses).
+   // Poses with an existing rig are left as-is.
+   static void Solve( Pose * const * poses,
+      size_t numPoses,
+      unsigned int numThreads = 1 );
+
+   // Same as above, but first overwrite the keypoints of every pose.
+   // @keypointChannels is structure-of-arrays: channel (i * 3 + axis) holds the value of keypoint index i, for every frame in the block.
+   static void Solve( Pose * const * poses,
+      size_t numPoses,
+      const std::vector< std::vector< double > > & keypointChannels,
+      unsigned int numThreads = 1 );
+
+private:
+   static void SolveBlock( Pose * const * poses,
+      size_t begin,
+      size_t end,
+      const std::vector< std::vector< double > > * keypointChannels );
+   static void SolveParallel( Pose * const * poses,
+      size_t numPoses,
+      const std::vector< std::vector< double > > * keypointChannels,
+      unsigned int numThreads );
+};
+
+#endif
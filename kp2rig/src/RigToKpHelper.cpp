@@ -3,47 +3,96 @@
 #include "Pose.hpp"
 #include "RigPose.hpp"
 #include "Utility.hpp"
+#include "QuaternionBatch.hpp"
+
+namespace
+{
+   // Rotates each axis in @axes by the absolute rotation at the same index in @rotations
+   template< size_t N >
+   std::array< Eigen::Vector3d, N > BoneVectors( const std::array< const std::array< double, 4 > *, N > & rotations,
+      const std::array< Eigen::Vector3d, N > & axes )
+   {
+      std::array< double, N > qx, qy, qz, qw, vx, vy, vz;
+      for ( size_t i = 0; i < N; ++i )
+      {
+         qx[ i ] = (*rotations[ i ])[ 0 ];
+         qy[ i ] = (*rotations[ i ])[ 1 ];
+         qz[ i ] = (*rotations[ i ])[ 2 ];
+         qw[ i ] = (*rotations[ i ])[ 3 ];
+         vx[ i ] = axes[ i ].x();
+         vy[ i ] = axes[ i ].y();
+         vz[ i ] = axes[ i ].z();
+      }
+      
+      const QuaternionBatch::Vectors vectors = { vx.data(), vy.data(), vz.data() };
+      QuaternionBatch::Rotate( { qx.data(), qy.data(), qz.data(), qw.data() }, vectors, vectors, N );
+      
+      std::array< Eigen::Vector3d, N > returnValue;
+      for ( size_t i = 0; i < N; ++i )
+         returnValue[ i ] = Eigen::Vector3d( vx[ i ], vy[ i ], vz[ i ] );
+      return returnValue;
+   }
+}
 
 void RigToKpHelper::HandleSpine( Pose & pose )
 {
    Rig & rig = pose.RigPose().GetRig();
    
+   // Every bone's direction only depends on its absolute rotation, so they are all found in one batch
+   const std::array< Eigen::Vector3d, 6 > boneVectors = BoneVectors< 6 >(
+      {
+         &rig.pelvis.quaternionAbs,
+         &rig.spine2.quaternionAbs,
+         &rig.spine3.quaternionAbs,
+         &rig.spine4.quaternionAbs,
+         &rig.baseNeck.quaternionAbs,
+         &rig.baseHead.quaternionAbs
+      },
+      {
+         Eigen::Vector3d::UnitY(),
+         Eigen::Vector3d::UnitY(),
+         Eigen::Vector3d::UnitY(),
+         Eigen::Vector3d::UnitY(),
+         Eigen::Vector3d::UnitY(),
+         Eigen::Vector3d::UnitY()
+      } );
+   
    // pelvis
    pose.Keypoint( rig.location, PELVIS );
    
    // spine2
    Eigen::Vector3d parentLocation = Utility::RawToVector( rig.location );
    double boneLength = rig.pelvis.length;
-   Eigen::Vector3d boneVector = Utility::RawToQuaternion( rig.pelvis.quaternionAbs )._transformVector( Eigen::Vector3d::UnitY() );
+   Eigen::Vector3d boneVector = boneVectors[ 0 ];
    parentLocation = parentLocation + (boneVector*boneLength);
    
    // spine3
    boneLength = rig.spine2.length;
-   boneVector = Utility::RawToQuaternion( rig.spine2.quaternionAbs )._transformVector( Eigen::Vector3d::UnitY() );
+   boneVector = boneVectors[ 1 ];
    parentLocation = parentLocation + (boneVector*boneLength);
    
    // spine4
    boneLength = rig.spine3.length;
-   boneVector = Utility::RawToQuaternion( rig.spine3.quaternionAbs )._transformVector( Eigen::Vector3d::UnitY() );
+   boneVector = boneVectors[ 2 ];
    parentLocation = parentLocation + (boneVector*boneLength);
    
    // baseNeck
    boneLength = rig.spine4.length;
-   boneVector = Utility::RawToQuaternion( rig.spine4.quaternionAbs )._transformVector( Eigen::Vector3d::UnitY() );
+   boneVector = boneVectors[ 3 ];
    Eigen::Vector3d childLocation = parentLocation + (boneVector*boneLength);
    pose.Keypoint(Utility::VectorToRaw( childLocation ), BASE_NECK );
    parentLocation = childLocation;
    
    // baseHead
    boneLength = rig.baseNeck.length;
-   boneVector = Utility::RawToQuaternion( rig.baseNeck.quaternionAbs )._transformVector( Eigen::Vector3d::UnitY() );
+   boneVector = boneVectors[ 4 ];
    childLocation = parentLocation + (boneVector*boneLength);
    pose.Keypoint( Utility::VectorToRaw( childLocation ), BASE_HEAD );
    parentLocation = childLocation;
    
    // topHead
    boneLength = rig.baseHead.length;
-   boneVector = Utility::RawToQuaternion( rig.baseHead.quaternionAbs )._transformVector( Eigen::Vector3d::UnitY() );
+   boneVector = boneVectors[ 5 ];
    childLocation = parentLocation + (boneVector*boneLength);
    pose.Keypoint( Utility::VectorToRaw( childLocation ), TOP_HEAD );
 }
@@ -51,45 +100,64 @@ void RigToKpHelper::HandleLegs( Pose & pose )
 {
    Rig & rig = pose.RigPose().GetRig();
    
+   // Every bone's direction only depends on its absolute rotation, so they are all found in one batch
+   const std::array< Eigen::Vector3d, 6 > boneVectors = BoneVectors< 6 >(
+      {
+         &rig.pelvis.quaternionAbs,
+         &rig.lHip.quaternionAbs,
+         &rig.lKnee.quaternionAbs,
+         &rig.pelvis.quaternionAbs,
+         &rig.rHip.quaternionAbs,
+         &rig.rKnee.quaternionAbs
+      },
+      {
+         Eigen::Vector3d::UnitX(),
+         Eigen::Vector3d::UnitY(),
+         Eigen::Vector3d::UnitY(),
+         -Eigen::Vector3d::UnitX(),
+         Eigen::Vector3d::UnitY(),
+         Eigen::Vector3d::UnitY()
+      } );
+   
    // left hip
    Eigen::Vector3d parentLocation = Utility::RawToVector( rig.location );
    double boneLength = Utility::RawToVector( rig.lHip.offset ).norm();
-   Eigen::Vector3d boneVector = Utility::RawToQuaternion( rig.pelvis.quaternionAbs )._transformVector( Eigen::Vector3d::UnitX() );
+   Eigen::Vector3d boneVector = boneVectors[ 0 ];
    Eigen::Vector3d childLocation = parentLocation + (boneVector*boneLength);
    pose.Keypoint( Utility::VectorToRaw( childLocation ), LEFT_HIP );
    parentLocation = childLocation;
    
    // left knee
    boneLength = rig.lHip.length;
-   boneVector = Utility::RawToQuaternion( rig.lHip.quaternionAbs )._transformVector( Eigen::Vector3d::UnitY() );
+   boneVector = boneVectors[ 1 ];
    childLocation = parentLocation + (boneVector*boneLength);
    pose.Keypoint( Utility::VectorToRaw( childLocation ), LEFT_KNEE );
    parentLocation = childLocation;
    
    // left ankle
    boneLength = rig.lKnee.length;
-   boneVector = Utility::RawToQuaternion( rig.lKnee.quaternionAbs )._transformVector( Eigen::Vector3d::UnitY() );
+   boneVector = boneVectors[ 2 ];
    childLocation = parentLocation + (boneVector*boneLength);
    pose.Keypoint( Utility::VectorToRaw( childLocation ), LEFT_ANKLE );
    
    // right hip
    parentLocation = Utility::RawToVector(rig.location);
    boneLength = Utility::RawToVector( rig.rHip.offset ).norm();
-   boneVector = Utility::RawToQuaternion( rig.pelvis.quaternionAbs )._transformVector( -Eigen::Vector3d::UnitX() );
+   boneVector = boneVectors[ 3 ];
    childLocation = parentLocation + (boneVector*boneLength);
    pose.Keypoint( Utility::VectorToRaw( childLocation ), RIGHT_HIP );
    parentLocation = childLocation;
    
    // right knee
    boneLength = rig.rHip.length;
-   boneVector = Utility::RawToQuaternion( rig.rHip.quaternionAbs )._transformVector( Eigen::Vector3d::UnitY() );
+   boneVector = boneVectors[ 4 ];
    childLocation = parentLocation + (boneVector*boneLength);
    pose.Keypoint( Utility::VectorToRaw( childLocation ), RIGHT_KNEE );
    parentLocation = childLocation;
    
    // right ankle
    boneLength = rig.rKnee.length;
-   boneVector = Utility::RawToQuaternion( rig.rKnee.quaternionAbs )._transformVector( Eigen::Vector3d::UnitY() );
+   boneVector = boneVectors[ 5 ];
    childLocation = parentLocation + (boneVector*boneLength);
    pose.Keypoint( Utility::VectorToRaw( childLocation ), RIGHT_ANKLE );
 }
@@ -97,47 +165,66 @@ void RigToKpHelper::HandleArms( Pose & pose )
 {
    Rig & rig = pose.RigPose().GetRig();
    
+   // Every bone's direction only depends on its absolute rotation, so they are all found in one batch
+   const std::array< Eigen::Vector3d, 6 > boneVectors = BoneVectors< 6 >(
+      {
+         &rig.baseNeck.quaternionAbs,
+         &rig.lShoulder.quaternionAbs,
+         &rig.lElbow.quaternionAbs,
+         &rig.baseNeck.quaternionAbs,
+         &rig.rShoulder.quaternionAbs,
+         &rig.rElbow.quaternionAbs
+      },
+      {
+         Eigen::Vector3d::UnitX(),
+         Eigen::Vector3d::UnitY(),
+         Eigen::Vector3d::UnitY(),
+         -Eigen::Vector3d::UnitX(),
+         Eigen::Vector3d::UnitY(),
+         Eigen::Vector3d::UnitY()
+      } );
+   
    // This assumes baseNeck keypoint is already set!
 
    // left shoulder
    Eigen::Vector3d parentLocation = Utility::RawToVector( pose.Keypoint( BASE_NECK ) );
    double boneLength = Utility::RawToVector( rig.lShoulder.offset ).norm();
-   Eigen::Vector3d boneVector = Utility::RawToQuaternion( rig.baseNeck.quaternionAbs )._transformVector( Eigen::Vector3d::UnitX() );
+   Eigen::Vector3d boneVector = boneVectors[ 0 ];
    Eigen::Vector3d childLocation = parentLocation + (boneVector*boneLength);
    pose.Keypoint( Utility::VectorToRaw( childLocation ), LEFT_SHOULDER );
    parentLocation = childLocation;
    
    // left elbow
    boneLength = rig.lShoulder.length;
-   boneVector = Utility::RawToQuaternion( rig.lShoulder.quaternionAbs )._transformVector( Eigen::Vector3d::UnitY() );
+   boneVector = boneVectors[ 1 ];
    childLocation = parentLocation + (boneVector*boneLength);
    pose.Keypoint( Utility::VectorToRaw( childLocation ), LEFT_ELBOW );
    parentLocation = childLocation;
    
    // left wrist
    boneLength = rig.lElbow.length;
-   boneVector = Utility::RawToQuaternion( rig.lElbow.quaternionAbs )._transformVector( Eigen::Vector3d::UnitY() );
+   boneVector = boneVectors[ 2 ];
    childLocation = parentLocation + (boneVector*boneLength);
    pose.Keypoint( Utility::VectorToRaw( childLocation ), LEFT_WRIST );
    
    // right shoulder
    parentLocation = Utility::RawToVector( pose.Keypoint( BASE_NECK ) );
    boneLength = Utility::RawToVector( rig.rShoulder.offset ).norm();
-   boneVector = Utility::RawToQuaternion( rig.baseNeck.quaternionAbs )._transformVector( -Eigen::Vector3d::UnitX() );
+   boneVector = boneVectors[ 3 ];
    childLocation = parentLocation + (boneVector*boneLength);
    pose.Keypoint( Utility::VectorToRaw( childLocation ), RIGHT_SHOULDER );
    parentLocation = childLocation;
    
    // right elbow
    boneLength = rig.rShoulder.length;
-   boneVector = Utility::RawToQuaternion( rig.rShoulder.quaternionAbs )._transformVector( Eigen::Vector3d::UnitY() );
+   boneVector = boneVectors[ 4 ];
    childLocation = parentLocation + (boneVector*boneLength);
    pose.Keypoint( Utility::VectorToRaw( childLocation ), RIGHT_ELBOW );
    parentLocation = childLocation;
    
    // right wrist
    boneLength = rig.rElbow.length;
-   boneVector = Utility::RawToQuaternion( rig.rElbow.quaternionAbs )._transformVector( Eigen::Vector3d::UnitY() );
+   boneVector = boneVectors[ 5 ];
    childLocation = parentLocation + (boneVector*boneLength);
    pose.Keypoint( Utility::VectorToRaw( childLocation ), RIGHT_WRIST );
 }
@@ -145,7 +232,7 @@ std::array< double, 3 > RigToKpHelper::WorldCoordinates( const Rig & rig,
    Rig::JOINT_TYPE type )
 {
    // Get the rest pose
-   const Rig restPose = Rig::DefaultPoseHumanoid();
+   const Rig & restPose = Rig::RestPoseHumanoid();
    
    // Get the root location
    Eigen::Vector3d location = Utility::RawToVector( rig.location );
@@ -0,0 +1,233 @@
+#include <cerrno>
+#include <cstdio>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+#include "SegmentWriter.hpp"
+#include "Trace.hpp"
+
+#ifdef _WIN32
+   #include <io.h>
+   #include <windows.h>
+#else
+   #include <fcntl.h>
+   #include <unistd.h>
+#endif
+
+// Describes the failure of the most recent system call
+static std::runtime_error WriteError( const std::string & what,
+   const std::string & filename )
+{
+   return std::runtime_error( what + " '" + filename + "': " + std::system_category().message( errno ) );
+}
+
+SegmentWriter::FSYNC_POLICY SegmentWriter::FsyncPolicy( std::string policy )
+{
+   static std::unordered_map< std::string, FSYNC_POLICY > map = {
+      { "none", FSYNC_NONE },
+      { "file", FSYNC_FILE },
+      { "full", FSYNC_FULL }
+   };
+   
+   auto it = map.find( policy );
+   if ( it == map.end() )
+      throw std::runtime_error( "Unknown fsync policy '" + policy + "', expected none, file or full" );
+   return (*it).second;
+}
+std::string SegmentWriter::FsyncPolicy( FSYNC_POLICY policy )
+{
+   switch ( policy )
+   {
+      case FSYNC_NONE: return "none";
+      case FSYNC_FILE: return "file";
+      case FSYNC_FULL: return "full";
+      default: return "unknown";
+   }
+}
+
+SegmentWriter::SegmentWriter()
+{
+   _thread = std::thread( [this]{ this->WriteForever(); } );
+}
+SegmentWriter::~SegmentWriter()
+{
+   // Finish writing everything we have
+   {
+      std::lock_guard< std::mutex > lock( _mutex );
+      _quit = true;
+   }
+   _changed.notify_all();
+   _thread.join();
+}
+void SegmentWriter::Write( const std::string & filename,
+   std::string && contents,
+   FILE_TYPE type )
+{
+   std::unique_lock< std::mutex > lock( _mutex );
+   
+   // Don't let a stalled disk use up all our memory
+   _changed.wait( lock, [ this ]{ return _queue.empty() || _queuedBytes < MAX_QUEUED_BYTES; } );
+   
+   _queuedBytes += contents.size();
+   _queuedBytesGauge.Set( (int64_t)_queuedBytes );
+   _queue.push_back( { filename, std::move( contents ), type } );
+   _changed.notify_all();
+}
+void SegmentWriter::Wait()
+{
+   std::unique_lock< std::mutex > lock( _mutex );
+   _changed.wait( lock, [ this ]{ return _queue.empty() && !_busy; } );
+}
+std::vector< std::string > SegmentWriter::Written() const
+{
+   std::lock_guard< std::mutex > lock( _mutex );
+   return _written;
+}
+size_t SegmentWriter::Failures() const
+{
+   std::lock_guard< std::mutex > lock( _mutex );
+   return _numFailures;
+}
+void SegmentWriter::WriteForever()
+{
+   Trace::ThreadName( "segment writer" );
+   static Histogram & writeTime = Metrics::Instance().GetTimer( "kp2rig_segment_write_seconds" );
+   static Counter & writeBytes = Metrics::Instance().GetCounter( "kp2rig_segment_write_bytes_total" );
+   static Counter & writeErrors = Metrics::Instance().GetCounter( "kp2rig_segment_write_errors_total" );
+   
+   while ( true )
+   {
+      Job job;
+      bool skip = false;
+      {
+         std::unique_lock< std::mutex > lock( _mutex );
+         _changed.wait( lock, [ this ]{ return _quit || _queue.size(); } );
+         
+         // Only quit once everything is written
+         if ( _queue.empty() )
+            return;
+         job = std::move( _queue.front() );
+         _queue.pop_front();
+         _busy = true;
+         skip = job.type == FILE_CHECKPOINT && _numFailures;
+      }
+      
+      bool written = false;
+      if ( skip )
+      {
+         printf( "Skipping checkpoint '%s', a segment before it couldn't be written\n", job.filename.c_str() );
+      }
+      else
+      {
+         try
+         {
+            TRACE_SCOPE_ARGS( "SegmentWriter::WriteFile", "file", job.filename, "bytes", job.contents.size() );
+            ScopedHistogramTimer timer( writeTime );
+            WriteFile( job.filename, job.contents );
+            writeBytes.Add( job.contents.size() );
+            written = true;
+         }
+         catch ( std::runtime_error & e )
+         {
+            writeErrors.Add();
+            printf( "Writing segment FAILED\n\t%s\n", e.what() );
+         }
+      }
+      
+      {
+         std::lock_guard< std::mutex > lock( _mutex );
+         if ( written && job.type == FILE_SEGMENT )
+            _written.push_back( job.filename );
+         if ( !written && job.type == FILE_SEGMENT )
+            ++_numFailures;
+         _queuedBytes -= job.contents.size();
+         _queuedBytesGauge.Set( (int64_t)_queuedBytes );
+         _busy = false;
+      }
+      _changed.notify_all();
+   }
+}
+void SegmentWriter::WriteFile( const std::string & filename,
+   const std::string & contents ) const
+{
+   const std::string temporaryFilename = filename + ".tmp";
+   
+#ifdef _WIN32
+   FILE * file = fopen( temporaryFilename.c_str(), "wb" );
+   if ( !file )
+      throw WriteError( "Tried to write", temporaryFilename );
+   bool ok = fwrite( contents.data(), 1, contents.size(), file ) == contents.size() &&
+      fflush( file ) == 0;
+   if ( ok && _fsync != FSYNC_NONE )
+      ok = _commit( _fileno( file ) ) == 0;
+   fclose( file );
+   if ( !ok )
+   {
+      std::runtime_error error = WriteError( "Tried to write", temporaryFilename );
+      remove( temporaryFilename.c_str() );
+      throw error;
+   }
+   
+   // Windows renames can't replace files, this can
+   DWORD flags = MOVEFILE_REPLACE_EXISTING | (_fsync == FSYNC_FULL ? MOVEFILE_WRITE_THROUGH : 0);
+   if ( !MoveFileExA( temporaryFilename.c_str(), filename.c_str(), flags ) )
+   {
+      remove( temporaryFilename.c_str() );
+      throw std::runtime_error( "Tried to rename '" + temporaryFilename + "' to '" + filename + "'" );
+   }
+#else
+   int fd = open( temporaryFilename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+   if ( fd < 0 )
+      throw WriteError( "Tried to write", temporaryFilename );
+   
+   // One pass over the buffer; writes only come up short for signals or a full disk
+   const char * data = contents.data();
+   size_t remaining = contents.size();
+   bool ok = true;
+   while ( ok && remaining )
+   {
+      ssize_t count = write( fd, data, remaining );
+      if ( count < 0 && errno == EINTR )
+         continue;
+      ok = count > 0;
+      if ( ok )
+      {
+         data += count;
+         remaining -= (size_t)count;
+      }
+   }
+   if ( ok && _fsync != FSYNC_NONE )
+      ok = fsync( fd ) == 0;
+   if ( !ok )
+   {
+      std::runtime_error error = WriteError( "Tried to write", temporaryFilename );
+      close( fd );
+      unlink( temporaryFilename.c_str() );
+      throw error;
+   }
+   close( fd );
+   
+   if ( rename( temporaryFilename.c_str(), filename.c_str() ) != 0 )
+   {
+      std::runtime_error error = WriteError( "Tried to rename '" + temporaryFilename + "' to", filename );
+      unlink( temporaryFilename.c_str() );
+      throw error;
+   }
+   
+   // The rename is only durable once the directory is
+   if ( _fsync == FSYNC_FULL )
+   {
+      const size_t slash = filename.find_last_of( '/' );
+      const std::string directory = slash == std::string::npos ? "." : (slash == 0 ? "/" : filename.substr( 0, slash ));
+      int directoryFd = open( directory.c_str(), O_RDONLY | O_CLOEXEC );
+      if ( directoryFd < 0 || fsync( directoryFd ) != 0 )
+      {
+         std::runtime_error error = WriteError( "Tried to sync", directory );
+         if ( directoryFd >= 0 )
+            close( directoryFd );
+         throw error;
+      }
+      close( directoryFd );
+   }
+#endif
+}
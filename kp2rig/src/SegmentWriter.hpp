@@ -0,0 +1,84 @@
+#ifndef SegmentWriter_hpp
+#define SegmentWriter_hpp
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Metrics.hpp"
+
+// Writes serialized segment files on its own thread, so slow disks don't hold up processing.
+// Each file is written to "<filename>.tmp" in one sequential pass, synced according to the fsync policy,
+// then renamed over <filename>. Readers of <filename> therefore only ever see complete files,
+// and with FSYNC_FILE or FSYNC_FULL so does anyone reading after a crash.
+class SegmentWriter
+{
+public:
+   enum FSYNC_POLICY
+   {
+      FSYNC_NONE,    // Leave it to the OS
+      FSYNC_FILE,    // Sync the file before renaming it
+      FSYNC_FULL     // Also sync the directory after renaming, so the rename itself survives a crash
+   };
+   static FSYNC_POLICY FsyncPolicy( std::string policy );
+   static std::string FsyncPolicy( FSYNC_POLICY policy );
+   
+   // Writes block while this many bytes are already waiting to be written
+   static const size_t MAX_QUEUED_BYTES = 256 * 1024 * 1024;
+   
+   SegmentWriter();
+   ~SegmentWriter();
+   SegmentWriter( const SegmentWriter & ) = delete;
+   SegmentWriter & operator=( const SegmentWriter & ) = delete;
+   
+   void Fsync( FSYNC_POLICY v ) { _fsync = v; }
+   
+   enum FILE_TYPE
+   {
+      FILE_SEGMENT,     // Listed in Written()
+      FILE_CHECKPOINT   // Left out of Written(), and skipped once any segment has failed
+   };
+   
+   // Queue @contents to be written to @filename. Failures are printed when they happen, and counted.
+   // A checkpoint covers every segment queued before it, so it's only written while none of them has failed.
+   void Write( const std::string & filename,
+      std::string && contents,
+      FILE_TYPE type = FILE_SEGMENT );
+   
+   // Blocks until everything queued so far is written
+   void Wait();
+   
+   // Files written successfully, in the order they were written
+   std::vector< std::string > Written() const;
+   // Segments that couldn't be written so far
+   size_t Failures() const;
+   
+private:
+   struct Job
+   {
+      std::string filename;
+      std::string contents;
+      FILE_TYPE type;
+   };
+   
+   void WriteForever();
+   void WriteFile( const std::string & filename,
+      const std::string & contents ) const;
+   
+   std::thread _thread;
+   mutable std::mutex _mutex;
+   std::condition_variable _changed;
+   std::deque< Job > _queue;
+   size_t _queuedBytes = 0;
+   bool _busy = false;
+   bool _quit = false;
+   std::atomic< FSYNC_POLICY > _fsync{ FSYNC_FILE };
+   std::vector< std::string > _written;
+   size_t _numFailures = 0;
+   Gauge & _queuedBytesGauge = Metrics::Instance().GetGauge( "kp2rig_segment_write_queue_bytes" );
+};
+
+#endif
@@ -4,6 +4,9 @@
 #include <stdio.h>
 #include <vector>
 
+class CheckpointWriter;
+class CheckpointReader;
+
 // Interface for smoothing noisy data in a floating-point array. Each sample in the array
 // is assumed to be temporally contiguous.
 //
@@ -56,5 +59,10 @@ public:
    // @return the timestamp of the first sample, shifted as necessary
    virtual int Apply( std::vector< double > & ref_smoothedSamples,
       bool flush = false ) = 0;
+   
+   // Save everything needed to carry on filtering where this filter left off, and restore it into a
+   // filter that hasn't been initialized. See @Checkpoint.hpp.
+   virtual void Save( CheckpointWriter & ref_checkpoint ) const = 0;
+   virtual void Restore( CheckpointReader & ref_checkpoint ) = 0;
 };
 #endif
@@ -1,15 +1,18 @@
 #include <sstream>
+#include <stdexcept>
 #include <unordered_map>
 #include "SmoothFactory.hpp"
 
 // Include implemented smooth classes here
 #include "Smooth_lpfIpp.hpp"
+#include "Smooth_oneEuro.hpp"
 
 SMOOTH_TYPE SmoothFactory::SmoothType( std::string type )
 {
    static std::unordered_map< std::string, SMOOTH_TYPE > map = {
       { "none",      SMOOTH_TYPE_NONE },
-      { "lpf_ipp",   SMOOTH_TYPE_LPF_IPP }
+      { "lpf_ipp",   SMOOTH_TYPE_LPF_IPP },
+      { "one_euro",  SMOOTH_TYPE_ONE_EURO }
    };
 
    auto it = map.find( type );
@@ -22,7 +25,8 @@ std::string SmoothFactory::SmoothType( SMOOTH_TYPE type )
 {
    static std::unordered_map< SMOOTH_TYPE, std::string > map = {
       { SMOOTH_TYPE_NONE,       "none"      },
-      { SMOOTH_TYPE_LPF_IPP,    "lpf_ipp"   }
+      { SMOOTH_TYPE_LPF_IPP,    "lpf_ipp"   },
+      { SMOOTH_TYPE_ONE_EURO,   "one_euro"  }
    };
 
    auto it = map.find( type );
@@ -39,6 +43,27 @@ std::unique_ptr< Smooth > SmoothFactory::Create( SMOOTH_TYPE type )
 #ifdef HAVE_IPP
       case SMOOTH_TYPE_LPF_IPP: return std::unique_ptr< Smooth >( new Smooth_lpfIpp() );
 #endif
+      case SMOOTH_TYPE_ONE_EURO: return std::unique_ptr< Smooth >( new Smooth_oneEuro() );
       default: return std::unique_ptr< Smooth >( nullptr );
    }
 }
+SMOOTH_DOMAIN SmoothFactory::SmoothDomain( std::string domain )
+{
+   static std::unordered_map< std::string, SMOOTH_DOMAIN > map = {
+      { "keypoints",   SMOOTH_DOMAIN_KEYPOINTS },
+      { "rotations",   SMOOTH_DOMAIN_ROTATIONS }
+   };
+
+   auto it = map.find( domain );
+   if ( it == map.end() )
+      throw std::runtime_error( "Unknown smoothing domain '" + domain + "', expected keypoints or rotations" );
+   return (*it).second;
+}
+std::string SmoothFactory::SmoothDomain( SMOOTH_DOMAIN domain )
+{
+   return domain == SMOOTH_DOMAIN_ROTATIONS ? "rotations" : "keypoints";
+}
+bool SmoothFactory::IsCausal( SMOOTH_TYPE type )
+{
+   return type == SMOOTH_TYPE_ONE_EURO;
+}
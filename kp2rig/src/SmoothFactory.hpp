@@ -11,11 +11,19 @@ enum SMOOTH_TYPE
 {
    SMOOTH_TYPE_NONE,
    SMOOTH_TYPE_LPF_IPP,   
+   SMOOTH_TYPE_ONE_EURO,
    // New smooth types go here
    
    SMOOTH_TYPE_UNKNOWN
 };
 
+// What gets filtered
+enum SMOOTH_DOMAIN
+{
+   SMOOTH_DOMAIN_KEYPOINTS,   // The input keypoints, then rigs are solved from the filtered keypoints
+   SMOOTH_DOMAIN_ROTATIONS    // The root location, joint rotations and rolls of rigs solved from the input keypoints
+};
+
 // Factory for filtering motion.
 // See @Smooth.hpp for more information.
 class SmoothFactory
@@ -24,6 +32,13 @@ public:
    static SMOOTH_TYPE SmoothType( std::string type );
    static std::string SmoothType( SMOOTH_TYPE type );
    static std::unique_ptr< Smooth > Create( SMOOTH_TYPE type );
+   
+   // Throws for an unknown domain
+   static SMOOTH_DOMAIN SmoothDomain( std::string domain );
+   static std::string SmoothDomain( SMOOTH_DOMAIN domain );
+   
+   // Causal types filter each sample as it's added, without delay, so they can smooth poses as they arrive
+   static bool IsCausal( SMOOTH_TYPE type );
 };
 
 #endif
@@ -5,6 +5,7 @@
 #include <limits.h>
 #include <cstring>
 #include <ipp.h>
+#include "Checkpoint.hpp"
 #include "Smooth_lpfIpp.hpp"
 
 #define check_sts(st) if((st) != ippStsNoErr) { char s[ 100 ]; snprintf( s, 100, "IPP error: %d", (int)st ); throw std::runtime_error(s); }
@@ -18,6 +19,7 @@ Smooth_lpfIpp::Smooth_lpfIpp( Smooth_lpfIpp && move )
    _ippInternalBuffer1 = move._ippInternalBuffer1;
    _ippInternalBuffer2 = move._ippInternalBuffer2;
    _numTaps = move._numTaps;
+   _normalizedFrequency = move._normalizedFrequency;
    _minNumSamples = move._minNumSamples;
    
    // Reset these on the old object
@@ -36,6 +38,7 @@ void Smooth_lpfIpp::Initialize( int numTaps,
    // Initialize our number of taps (windows size)
    // Let's stick with odd numbers only because math is easier
    _numTaps = (numTaps % 2 == 0) ? numTaps + 1 : numTaps;
+   _normalizedFrequency = normalizedFrequency;
    
    // Set our minimum number of samples.
    _minNumSamples = 5;
@@ -122,98 +125,100 @@ void Smooth_lpfIpp::AddSamples( int firstSampleTimestamp,
 int Smooth_lpfIpp::Apply( std::vector< double > & ref_smoothedSamples,
    bool flush )
 {
-   size_t numSamples = _newSamples.size();
+   const size_t numNewSamples = _newSamples.size();
+   
+   // Flushing with nothing new still hands back the last few samples, held in the delay line
+   if ( !numNewSamples &&
+      (!flush || (int)_delayLine.size() < _minNumSamples) )
+   {
+      ref_smoothedSamples.clear();
+      return _firstSampleTimestamp;
+   }
    
    // If we don't have enough data
-   int totalNumSamples = int(_delayLine.size() + numSamples);
+   int totalNumSamples = int(_delayLine.size() + numNewSamples);
    if ( totalNumSamples < _minNumSamples )
    {
       // Just copy over
-      ref_smoothedSamples.resize( numSamples );
-      memcpy( &ref_smoothedSamples[0],
-         &_newSamples[0],
-         numSamples * sizeof( double) );
+      ref_smoothedSamples = _newSamples;
       
-      // Move our window, making sure to keep enough data for the next call.
-      // This uses the last few filtered samples and then the remaining unfiltered samples
+      // Move our window, making sure to keep enough data for the next call: these samples, after a pre-roll
+      // of the first one as below. The next call hands these samples back again, filtered this time.
       int returnValue = _firstSampleTimestamp;
-      _firstSampleTimestamp += int(numSamples);
-      _delayLine = _newSamples;
+      _firstSampleTimestamp += int(numNewSamples);
+      _delayLine.assign( _numTaps - 1, _newSamples[0] );
+      _delayLine.insert( std::end(_delayLine), std::begin(_newSamples), std::end(_newSamples) );
+      _delayLine.erase( std::begin(_delayLine), std::end(_delayLine) - (_numTaps - 1) );
       _newSamples.clear();
       return returnValue;
    }
    
    // Handle flushing frames by duplicating the last input value over and over,
    // creating a DC rolloff at the end
-   int numExtraFlushSamples = 0;
-   while ( flush &&
-      numExtraFlushSamples < GetSampleShift() )
-   {
-      _newSamples.push_back( _newSamples.back() );
-      ++numExtraFlushSamples;
-   }
-   numSamples += numExtraFlushSamples;
+   const double lastSample = numNewSamples ? _newSamples.back() : _delayLine.back();
+   if ( flush )
+      _newSamples.insert( std::end(_newSamples), GetSampleShift(), lastSample );
+   const size_t numSamples = _newSamples.size();
 
    // Return the first timestamp
    int returnValue = _firstSampleTimestamp - GetSampleShift();
    
    // If we don't have a delay line (first time)
-   double * filteredResult = nullptr;
-   if ( !_delayLine.size() )
+   const bool firstTime = !_delayLine.size();
+   if ( firstTime )
    {
       // We need to pre-roll to account for the shift caused by the filter.
       // We need at least (numTaps - 1) elements as defined by IPP:
       //    https://software.intel.com/en-us/ipp-dev-reference-firsr
       // Pre-roll with a DC value that is the same as the first sample
       _delayLine = std::vector< double >( _numTaps - 1, _newSamples[0] );
-      
-      // We will skip the first few results because they will be from this artificial delay line.
-      // So we need an intermediate output as well as the original timestamp back
-      filteredResult = new double[ numSamples ];
       returnValue = _firstSampleTimestamp;
    }
-   else
-   {
-      // Allocate memory for the filtered results and get a pointer to it
-      ref_smoothedSamples.resize( numSamples );
-      filteredResult = &ref_smoothedSamples[0];
-   }
    
    // Perform the filtering
+   ref_smoothedSamples.resize( numSamples );
    check_sts( ippsFIRSR_64f( &_newSamples[0],
-      filteredResult,
-      numSamples,
+      &ref_smoothedSamples[0],
+      (int)numSamples,
       (IppsFIRSpec_64f*)_internalFirStructureIPP,
       &_delayLine[0],
       NULL,
       _ippInternalBuffer2) )
       
-   // If this was the first time
-   if ( ref_smoothedSamples.size() == 0 ||
-      filteredResult != &ref_smoothedSamples[0] )
+   // If this was the first time, skip the first delayed output samples since they are from the initial delay line
+   if ( firstTime )
    {
-      // Adjust, allocate output, copy the data from our temp buffer.
-      // We need to skip the first delayed output samples since they are from the initial delay line.
-      numSamples -= GetSampleShift();
-      ref_smoothedSamples.resize( numSamples );
-      memcpy( &ref_smoothedSamples[0],
-         (filteredResult + GetSampleShift()),
-         numSamples * sizeof(double) );
-         
-      delete[] filteredResult;
-      filteredResult = &ref_smoothedSamples[0];
+      ref_smoothedSamples.erase( std::begin(ref_smoothedSamples),
+         std::begin(ref_smoothedSamples) + std::min( (size_t)GetSampleShift(), numSamples ) );
    }
       
-   // Move our window, making sure to keep enough data for the next call.
-   // This uses the last few filtered samples and then the remaining unfiltered samples
-   _firstSampleTimestamp += numSamples;
-   _delayLine.clear();
-   for ( int i = 0; i < GetSampleShift(); ++i )
-      _delayLine.push_back( filteredResult[ numSamples - GetSampleShift() + i ] );
-   _delayLine.insert( std::begin(_delayLine) + GetSampleShift(), std::begin(_newSamples) + (numSamples - GetSampleShift()), std::end(_newSamples) );
+   // Move our window: the delay line for the next call is the last (numTaps - 1) samples filtered, and the next
+   // sample added follows the last one added here (samples added to flush don't count)
+   _delayLine.insert( std::end(_delayLine), std::begin(_newSamples), std::end(_newSamples) );
+   _delayLine.erase( std::begin(_delayLine), std::end(_delayLine) - (_numTaps - 1) );
+   _firstSampleTimestamp += int(numNewSamples);
    _newSamples.clear();
 
    return returnValue;
 }
+void Smooth_lpfIpp::Save( CheckpointWriter & ref_checkpoint ) const
+{
+   // The taps are generated again from these on restore
+   ref_checkpoint.Write( _numTaps );
+   ref_checkpoint.Write( _normalizedFrequency );
+   ref_checkpoint.Write( _delayLine );
+   ref_checkpoint.Write( _newSamples );
+   ref_checkpoint.Write( _firstSampleTimestamp );
+}
+void Smooth_lpfIpp::Restore( CheckpointReader & ref_checkpoint )
+{
+   int numTaps = ref_checkpoint.Read< int >();
+   double normalizedFrequency = ref_checkpoint.Read< double >();
+   Uninitialize();
+   Initialize( numTaps, normalizedFrequency );
+   ref_checkpoint.Read( _delayLine );
+   ref_checkpoint.Read( _newSamples );
+   ref_checkpoint.Read( _firstSampleTimestamp );
+}
 
 #endif
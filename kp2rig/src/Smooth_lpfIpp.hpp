@@ -21,6 +21,8 @@ public:
    virtual int GetSampleShift() const;
    virtual int Apply( std::vector< double > & ref_smoothedSamples,
       bool flush = false );
+   virtual void Save( CheckpointWriter & ref_checkpoint ) const;
+   virtual void Restore( CheckpointReader & ref_checkpoint );
       
 private:
    std::vector< double > _delayLine;
@@ -30,6 +32,7 @@ private:
    unsigned char * _ippInternalBuffer1 = nullptr;
    unsigned char * _ippInternalBuffer2 = nullptr;
    int _numTaps;
+   double _normalizedFrequency;
    int _minNumSamples;
 };
 
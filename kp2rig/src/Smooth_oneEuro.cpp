@@ -0,0 +1,95 @@
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include "Checkpoint.hpp"
+#include "Smooth_oneEuro.hpp"
+
+constexpr double Smooth_oneEuro::DEFAULT_BETA;
+
+// Smoothing factor of an exponential filter with @cutoff (cycles/frame), for a step of @frames
+static double Alpha( double cutoff,
+   double frames )
+{
+   const double tau = 1.0 / (2.0 * M_PI * cutoff);
+   return 1.0 / (1.0 + tau / frames);
+}
+
+void Smooth_oneEuro::Initialize( int numTaps,
+   double normalizedFrequency )
+{
+   (void)numTaps;
+   _minCutoff = normalizedFrequency;
+   _derivativeCutoff = normalizedFrequency;
+   Uninitialize();
+}
+void Smooth_oneEuro::Uninitialize()
+{
+   _lastTimestamp = INT_MIN;
+   _value = 0;
+   _derivative = 0;
+   _newSamples.clear();
+   _firstSampleTimestamp = INT_MIN;
+}
+void Smooth_oneEuro::AddSample( int sampleTimestamp, double value )
+{
+   // Samples back in time are dropped
+   if ( _lastTimestamp != INT_MIN && sampleTimestamp <= _lastTimestamp )
+      return;
+   
+   if ( _lastTimestamp == INT_MIN )
+   {
+      // Nothing to smooth against yet
+      _value = value;
+      _derivative = 0;
+   }
+   else
+   {
+      // Gaps are one long step
+      const double frames = sampleTimestamp - _lastTimestamp;
+      const double derivative = (value - _value) / frames;
+      _derivative += Alpha( _derivativeCutoff, frames ) * (derivative - _derivative);
+      const double cutoff = _minCutoff + _beta * std::abs( _derivative );
+      _value += Alpha( cutoff, frames ) * (value - _value);
+   }
+   _lastTimestamp = sampleTimestamp;
+   
+   if ( _newSamples.empty() )
+      _firstSampleTimestamp = sampleTimestamp;
+   _newSamples.push_back( _value );
+}
+void Smooth_oneEuro::AddSamples( int firstSampleTimestamp,
+   const std::vector< double > & samples )
+{
+   for ( size_t i = 0; i < samples.size(); ++i )
+      AddSample( firstSampleTimestamp + (int)i, samples[ i ] );
+}
+int Smooth_oneEuro::Apply( std::vector< double > & ref_smoothedSamples,
+   bool flush )
+{
+   // Every sample is filtered as it's added, so there's never anything left to flush
+   (void)flush;
+   ref_smoothedSamples.swap( _newSamples );
+   _newSamples.clear();
+   return _firstSampleTimestamp;
+}
+void Smooth_oneEuro::Save( CheckpointWriter & ref_checkpoint ) const
+{
+   ref_checkpoint.Write( _minCutoff );
+   ref_checkpoint.Write( _derivativeCutoff );
+   ref_checkpoint.Write( _beta );
+   ref_checkpoint.Write( _lastTimestamp );
+   ref_checkpoint.Write( _value );
+   ref_checkpoint.Write( _derivative );
+   ref_checkpoint.Write( _newSamples );
+   ref_checkpoint.Write( _firstSampleTimestamp );
+}
+void Smooth_oneEuro::Restore( CheckpointReader & ref_checkpoint )
+{
+   ref_checkpoint.Read( _minCutoff );
+   ref_checkpoint.Read( _derivativeCutoff );
+   ref_checkpoint.Read( _beta );
+   ref_checkpoint.Read( _lastTimestamp );
+   ref_checkpoint.Read( _value );
+   ref_checkpoint.Read( _derivative );
+   ref_checkpoint.Read( _newSamples );
+   ref_checkpoint.Read( _firstSampleTimestamp );
+}
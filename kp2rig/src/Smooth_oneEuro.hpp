@@ -0,0 +1,47 @@
+#ifndef Smooth_oneEuro_hpp
+#define Smooth_oneEuro_hpp
+
+#include <climits>
+#include "Smooth.hpp"
+
+// The 1€ filter (Casiez et al., CHI 2012): a first-order low-pass filter whose cutoff rises with speed,
+// so slow motion is smoothed heavily while fast motion keeps up. It is causal with O(1) state,
+// so each sample is filtered as soon as it is added and nothing is delayed (GetSampleShift() is 0).
+// Timestamps are in frames, so cutoffs are in cycles/frame.
+class Smooth_oneEuro : public Smooth
+{
+public:
+   // How quickly the cutoff rises with speed, in cycles/frame per unit/frame
+   static constexpr double DEFAULT_BETA = 1.0;
+   
+   // @numTaps is ignored, @normalizedFrequency is the cutoff when still, and by default the cutoff of the speed
+   virtual void Initialize( int numTaps,
+      double normalizedFrequency );
+   // Called after Initialize(): @beta is how quickly the cutoff rises with speed, and @derivativeCutoff (cycles/frame)
+   // how quickly the speed it rises with follows the input
+   void Parameters( double beta,
+      double derivativeCutoff ) { _beta = beta; _derivativeCutoff = derivativeCutoff; }
+   virtual void Uninitialize();
+   virtual void AddSample( int sampleTimestamp, double value );
+   virtual void AddSamples( int firstSampleTimestamp,
+      const std::vector< double > & samples );
+   virtual int GetSampleShift() const { return 0; }
+   virtual int Apply( std::vector< double > & ref_smoothedSamples,
+      bool flush = false );
+   virtual void Save( CheckpointWriter & ref_checkpoint ) const;
+   virtual void Restore( CheckpointReader & ref_checkpoint );
+   
+private:
+   double _minCutoff = 0.1;
+   double _derivativeCutoff = 0.1;
+   double _beta = DEFAULT_BETA;
+   int _lastTimestamp = INT_MIN;
+   double _value = 0;
+   double _derivative = 0;
+   
+   // Filtered samples not yet returned by Apply()
+   std::vector< double > _newSamples;
+   int _firstSampleTimestamp = INT_MIN;
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include "WorkerPool.hpp"
+#include "Trace.hpp"
+
+WorkerPool & WorkerPool::Instance()
+{
+   static WorkerPool pool;
+   return pool;
+}
+WorkerPool::~WorkerPool()
+{
+   {
+      std::lock_guard< std::mutex > lock( _mutex );
+      _stop = true;
+   }
+   _wake.notify_all();
+   for ( auto & thread : _threads )
+      thread.join();
+}
+void WorkerPool::Run( size_t numParts,
+   const std::function< void( size_t ) > & task )
+{
+   // A single part runs on the calling thread without tying up the pool, so it can still use the pool itself
+   std::unique_lock< std::mutex > runLock( _runMutex, std::defer_lock );
+   if ( numParts <= 1 || !runLock.try_lock() )
+   {
+      for ( size_t part = 0; part < numParts; ++part )
+         task( part );
+      return;
+   }
+   
+   {
+      std::lock_guard< std::mutex > lock( _mutex );
+      while ( _threads.size() + 1 < numParts )
+         _threads.emplace_back( [this]{ this->WorkForever(); } );
+      _task = &task;
+      _numParts = numParts;
+      _nextPart = 1;
+      _numRemaining = numParts - 1;
+      _errors.assign( numParts, nullptr );
+   }
+   _wake.notify_all();
+   
+   try
+   {
+      task( 0 );
+   }
+   catch ( ... )
+   {
+      _errors[ 0 ] = std::current_exception();
+   }
+   
+   std::unique_lock< std::mutex > lock( _mutex );
+   _done.wait( lock, [this]{ return _numRemaining == 0; } );
+   _task = nullptr;
+   for ( auto & error : _errors )
+   {
+      if ( error )
+         std::rethrow_exception( error );
+   }
+}
+void WorkerPool::WorkForever()
+{
+   Trace::ThreadName( "worker" );
+   std::unique_lock< std::mutex > lock( _mutex );
+   for ( ;; )
+   {
+      _wake.wait( lock, [this]{ return _stop || (_task && _nextPart < _numParts); } );
+      if ( _stop )
+         return;
+      
+      const size_t part = _nextPart++;
+      const std::function< void( size_t ) > & task = *_task;
+      lock.unlock();
+      try
+      {
+         task( part );
+      }
+      catch ( ... )
+      {
+         _errors[ part ] = std::current_exception();
+      }
+      lock.lock();
+      
+      if ( --_numRemaining == 0 )
+         _done.notify_one();
+   }
+}
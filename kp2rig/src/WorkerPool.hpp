@@ -0,0 +1,46 @@
+#ifndef WorkerPool_hpp
+#define WorkerPool_hpp
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+// Worker threads shared by everything in the process that splits its work into parts: RigSolver's blocks of frames,
+// and the characters of a segment written with Animation::PartitionByRig(). Threads are started on first use and
+// kept for the life of the process.
+class WorkerPool
+{
+public:
+   static WorkerPool & Instance();
+   ~WorkerPool();
+   WorkerPool( const WorkerPool & ) = delete;
+   WorkerPool & operator=( const WorkerPool & ) = delete;
+   
+   // Runs @task for every part in [0, numParts) and returns when they're all done. The calling thread runs part 0
+   // and the workers the rest, starting more workers if needed. If another thread is already using the pool,
+   // including a task run by it that calls Run() again, the calling thread runs every part itself.
+   // The first failure is rethrown, same as if run serially.
+   void Run( size_t numParts,
+      const std::function< void( size_t ) > & task );
+   
+private:
+   WorkerPool() = default;
+   void WorkForever();
+   
+   std::mutex _runMutex;
+   std::mutex _mutex;
+   std::condition_variable _wake;
+   std::condition_variable _done;
+   std::vector< std::thread > _threads;
+   const std::function< void( size_t ) > * _task = nullptr;
+   size_t _numParts = 0;
+   size_t _nextPart = 0;
+   size_t _numRemaining = 0;
+   std::vector< std::exception_ptr > _errors;
+   bool _stop = false;
+};
+
+#endif
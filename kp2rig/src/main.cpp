@@ -4,6 +4,7 @@
 #include <algorithm>
 #include <signal.h>
 #include <map>
+#include <thread>
 #include <sys/types.h>
 #include <fstream>
 #include <iostream>
@@ -13,7 +14,10 @@
 #include "Animation.hpp"
 #include "PoseFactory.hpp"
 #include "KpImporterFactory.hpp"
+#include "ImportTransform.hpp"
 #include "RigPose.hpp"
+#include "Metrics.hpp"
+#include "Trace.hpp"
 #include "CLI11.hpp"
 
 #ifdef _WIN32
@@ -27,31 +31,56 @@ struct Args
 {
    std::string inputFolder;
    std::vector< std::string > inputFiles;
+   std::vector< std::string > streamInputs;
    std::string outputDirectory = ".";
    double segmentDuration = 0;
+   double lateness = 1.0;
+   double idleTimeout = 2.0;
+   double retireAfter = 0.0;
+   std::string late = "drop";
+   std::string range;
    double fps = 30.0;
    double unitMeterNorm = 1.;
+   std::string axes;
+   std::string calibration;
    std::string smooth = "lpf_ipp";
+   std::string smoothDomain = "keypoints";
    double maxGap = 0.5;
+   unsigned int threads = 1;
+   size_t boneWarmup = BoneLengthEstimator::DEFAULT_WARMUP_FRAMES;
+   size_t boneFreeze = 0;
+   std::string metricsFile;
+   double metricsInterval = 10.0;
+   std::string traceFile;
+   std::string feed;
+   std::string fsync = "file";
+   std::string checkpoint;
+   std::string resume;
+   bool partitionByRig = false;
    bool useLeftHandCoords = false;
    bool stream = false;
    bool printVersion = false;
 } args;
 
-#ifndef STDIN
-   #define STDIN 0
-#endif
-
 void signalHandler( int signal )
 {
    if (signal == SIGINT)
    {
       quit = true;
-#ifndef _WIN32
-      close( STDIN );
-#endif
    }
 }
+void ParseRange( const std::string & range,
+   int & out_start,
+   int & out_end )
+{
+   std::stringstream ss( range );
+   char separator = 0;
+   if ( !(ss >> out_start >> separator >> out_end) ||
+      separator != ':' ||
+      !ss.eof() ||
+      out_end < out_start )
+      throw std::runtime_error( "Invalid range '" + range + "', expected start:end" );
+}
 void ParseFilesOrDirectory( const std::vector< std::string > & filesOrDirectory )
 {
    // Base everytihng on the first element
@@ -81,9 +110,17 @@ int main( int argc, char *argv[] )
    {
       int contiguousMissingFrames = 0;
       int previousTimestamp = -1;
+      Counter * framesIngested = nullptr;
+      Counter * framesMissing = nullptr;
+      Counter * framesDuplicate = nullptr;
    };
    std::map< std::string, CharacterMetadata > characterMetadata;
    
+   // Per-frame messages are rate-limited, the metrics have the full counts
+   RateLimiter missingFrameLimiter;
+   RateLimiter duplicateFrameLimiter;
+   size_t numSuppressed = 0;
+   
    // Set up our signal handler
    signal( SIGINT, signalHandler );
    
@@ -93,18 +130,40 @@ int main( int argc, char *argv[] )
    app.add_flag( "--version", args.printVersion, "Prints the version string" );
    app.add_flag( "-l,--left", args.useLeftHandCoords, "Output a left-handed coordinate system. Default is right\n");
    auto * streamOption = app.add_flag( "-s,--stream", args.stream, "Read from STDIN instead of files. This is useful for live streaming\n" );
+   auto * inputOption = app.add_option( "--input", args.streamInputs, "Stream from this FIFO or Unix socket instead of STDIN. Repeat to read from several at once, e.g. one per tracker. Implies --stream\n" );
    app.add_option( "--max-gap", args.maxGap, "Maximum gap, in seconds, of missing frames to interpolate. Gaps larger than this will not interpolate but instead copy/paste the previous frame, resulting in a \"freeze\". Default is 0.5\n" );
-   app.add_option( "--smooth", args.smooth, "Specify the smoothing algorithm {none|lpf_ipp}. Defaul is lpf_ipp\n" );
+   app.add_option( "--smooth", args.smooth, "Specify the smoothing algorithm {none|lpf_ipp|one_euro}. one_euro smooths each frame as it arrives, for live output. Defaul is lpf_ipp\n" );
+   app.add_option( "--smooth-domain", args.smoothDomain, "What --smooth filters {keypoints|rotations}: keypoints filters the input and solves each rig from the filtered keypoints, rotations solves each rig once and filters its root location, joint rotations and rolls. Default is keypoints\n" );
    app.add_option( "-o,--outdir", args.outputDirectory, "Set the output directory for the rig file (or rig file segments). Default is the working directory\n" );
    app.add_option( "-r,--rate", args.fps, "Frames-per-second (fps). Default is 30\n" );
    app.add_option( "--segsize", args.segmentDuration, "Segment duration in seconds. Default is 0, meaning output a monolithic file\n" );
+   app.add_option( "--range", args.range, "Only output frames start:end (inclusive), e.g. to split a capture across processes. The frames just before start are read to warm up smoothing and bone lengths. Combine the outputs with rigmerge. Default is every frame\n" );
+   app.add_option( "--lateness", args.lateness, "Seconds a character may lag behind the others before its frames are late. Segments are written once most characters are this far past their end. Default is 1\n" );
+   app.add_option( "--idle-timeout", args.idleTimeout, "Seconds without a frame before a character stops holding segments back. Default is 2\n" );
+   app.add_option( "--retire-after", args.retireAfter, "Seconds without a frame before a character is retired, once all of its frames are written, to release its memory. Measured in wall-clock time, so meant for live input. 0 keeps every character. Default is 0\n" );
+   app.add_option( "--late", args.late, "What to do with frames that arrive after their segment was written {drop|patch}: patch writes them to seg_<start>_patch<n>.json. Default is drop\n" );
+   app.add_option( "--fsync", args.fsync, "When to sync rig files to disk {none|file|full}: file syncs each file before it's renamed into place, full also syncs the directory. Default is file\n" );
+   app.add_option( "--checkpoint", args.checkpoint, "Save the state of every character to this file each time segments are written, so the run can be resumed with --resume. Requires --segsize. Default is no checkpoint\n" );
+   app.add_option( "--resume", args.resume, "Restore a --checkpoint file and carry on writing from the segment after the last one it covers. Frames it covers are skipped, so the input can be replayed from before it. Use the same options as the run that wrote it. Keeps checkpointing to the same file unless --checkpoint is given\n" );
    app.add_option( "-u,--units", args.unitMeterNorm, "\"Normalization\" value used to convert input units to meters; E.g., if your input data uses units of decimeters then you would pass in a value of 0.1. Default is 1.0 (meters)\n" );
+   app.add_option( "--axes", args.axes, "Which input axis, optionally negated, becomes each of x, y and z, e.g. \"x,z,-y\" for z-up input. Axes that mirror the input are rejected; use --left for left-handed input. Applied after --units. Default is x,y,z\n" );
+   app.add_option( "--calibration", args.calibration, "JSON file with a 4x4 transform, in meters, applied to the keypoints after --units and --axes, e.g. a venue calibration. Its top left 3x3 must be a rotation. Default is none\n" );
+   app.add_option( "--threads", args.threads, "Number of threads used to generate rigs, where 0 means one per core. Default is 1\n" );
+   app.add_flag( "--partition-by-rig", args.partitionByRig, "Write one rig file per character, seg_<start>.rig.<id>.json with the id percent-encoded, plus a manifest seg_<start>.manifest.json mapping ids to files. Characters are processed independently, spread across the --threads threads\n" );
+   app.add_option( "--bone-warmup", args.boneWarmup, "Number of frames per rig before bone lengths are estimated. Default is 5\n" );
+   app.add_option( "--bone-freeze", args.boneFreeze, "Number of frames per rig after which bone lengths stop changing, where 0 means never. Otherwise it must be at least --bone-warmup. Default is 0\n" );
+   app.add_option( "--metrics-file", args.metricsFile, "Periodically write metrics to this file, as Prometheus text if it ends in .prom or .txt, otherwise as JSON. Default is no metrics file\n" );
+   app.add_option( "--metrics-interval", args.metricsInterval, "Seconds between metrics file writes, where 0 means only write when finished. Default is 10\n" );
+   app.add_option( "--feed", args.feed, "Also publish a preview of every rig frame as soon as it arrives to this shared-memory feed (e.g. /kp2rig), for rig2c's rig_subscribe(). Previews aren't smoothed by lpf_ipp. Default is no feed\n" );
+   app.add_option( "--trace", args.traceFile, "Record a timeline of the pipeline to this Chrome trace_event JSON file. Requires a build with -DWITH_TRACING=YES\n" );
    
    // The default arguments are files or a directory
    std::vector< std::string > filesOrDirectory;
-   app.add_option_function< std::vector< std::string > >( "files-or-directory", ParseFilesOrDirectory, "Input files or directory" )->excludes( streamOption );
+   app.add_option_function< std::vector< std::string > >( "files-or-directory", ParseFilesOrDirectory, "Input files or directory" )->excludes( streamOption )->excludes( inputOption );
 
    CLI11_PARSE( app, argc, argv );
+   if ( args.streamInputs.size() )
+      args.stream = true;
    
    // If --version then ignore everything else, print the version, and exit
    if ( args.printVersion )
@@ -128,11 +187,87 @@ int main( int argc, char *argv[] )
    animation.OutputDirectory( args.outputDirectory );
    animation.Smooth( SmoothFactory::SmoothType( args.smooth ) );
    animation.MaxMissingFrameGap( args.maxGap );
+   const unsigned int threads = args.threads ? args.threads : std::max( std::thread::hardware_concurrency(), 1u );
+   if ( args.partitionByRig )
+   {
+      // Threads go to characters rather than to each character's frames
+      animation.PartitionByRig( threads );
+      animation.SolverThreads( 1 );
+   }
+   else
+   {
+      animation.SolverThreads( threads );
+   }
+   animation.AllowedLateness( args.lateness );
+   animation.IdleTimeout( args.idleTimeout );
+   animation.Live( args.stream );
+   animation.RetireAfter( args.retireAfter );
+   ImportTransform importTransform;
+   try
+   {
+      importTransform.Scale( args.unitMeterNorm );
+      if ( args.axes.size() )
+         importTransform.Axes( args.axes );
+      if ( args.calibration.size() )
+         importTransform.CalibrationFile( args.calibration );
+      animation.Fsync( SegmentWriter::FsyncPolicy( args.fsync ) );
+      animation.Late( Animation::LatePolicy( args.late ) );
+      animation.SmoothDomain( SmoothFactory::SmoothDomain( args.smoothDomain ) );
+      // Frozen before it's warm, the estimate would never be used
+      if ( args.boneFreeze > 0 && args.boneFreeze < args.boneWarmup )
+         throw std::runtime_error( "--bone-freeze must be 0 or at least --bone-warmup" );
+      animation.BoneLengthFrames( args.boneWarmup, args.boneFreeze );
+      if ( args.range.size() )
+      {
+         int start, end;
+         ParseRange( args.range, start, end );
+         animation.Range( start, end );
+      }
+      if ( args.resume.size() && args.checkpoint.empty() )
+         args.checkpoint = args.resume;
+      if ( args.checkpoint.size() && args.segmentDuration <= 0 )
+         throw std::runtime_error( "--checkpoint and --resume need segments, see --segsize" );
+      if ( args.checkpoint.size() )
+         animation.Checkpoint( args.checkpoint );
+      if ( args.resume.size() )
+         animation.Resume( args.resume );
+   }
+   catch ( std::runtime_error & e )
+   {
+      std::cerr << e.what() << std::endl;
+      return 1;
+   }
+   
+   if ( args.feed.size() )
+   {
+      try
+      {
+         animation.PreviewFeed( args.feed );
+      }
+      catch ( std::runtime_error & e )
+      {
+         std::cerr << e.what() << std::endl;
+      }
+   }
+   
+   if ( args.metricsFile.size() )
+      Metrics::Instance().StartPeriodicWrite( args.metricsFile, args.metricsInterval );
+   if ( args.traceFile.size() )
+   {
+      if ( Trace::Start( args.traceFile ) )
+         Trace::ThreadName( "parse" );
+      else
+         std::cerr << "Ignoring --trace, kp2rig was built without tracing (-DWITH_TRACING=YES)" << std::endl;
+   }
+   Histogram & parseTime = Metrics::Instance().GetTimer( "kp2rig_parse_seconds" );
    
    // Print a message if capturing from stdin
    if ( args.stream )
    {
-      printf( "capturing from STDIN...\n" );
+      if ( args.streamInputs.size() )
+         printf( "capturing from %d inputs...\n", (int)args.streamInputs.size() );
+      else
+         printf( "capturing from STDIN...\n" );
    }
 
    // Until told to quit
@@ -170,23 +305,37 @@ int main( int argc, char *argv[] )
          // Create our importer
          importer = KpImporterFactory::Create( importerType );
          
-         // Set the units
-         importer->UnitMeterNorm( args.unitMeterNorm );
+         // Set the units, axes and calibration
+         importer->Transform( importTransform );
          
-         // Open the file
-         importer->Open( filename );
+         // Open the file, or every stream input
+         if ( args.stream && args.streamInputs.size() )
+         {
+            for ( auto & input : args.streamInputs )
+               importer->Open( input );
+         }
+         else
+         {
+            importer->Open( filename );
+         }
       }
       catch ( std::runtime_error & e )
       {
          std::cerr << e.what() << std::endl;
+         
+         // A stream can't be retried, so give up
+         if ( args.stream )
+            quit = true;
          continue;
       }
 
       // Process all the data
-      while ( !importer->IsParseComplete() )
+      while ( !importer->IsParseComplete() && !quit )
       {
          try
          {
+            ScopedHistogramTimer timer( parseTime );
+            TRACE_SCOPE( "KpImporter::ReadOne" );
             characterPose = importer->ReadOne();
             suppressError = false;
          }
@@ -205,8 +354,26 @@ int main( int argc, char *argv[] )
          
          if ( characterPose )
          {
+            // Forget retired characters and their metrics; one that comes back starts over
+            for ( auto & id : animation.TakeRetiredCharacters() )
+            {
+               const std::string labels = Metrics::Label( "character", id );
+               Metrics::Instance().Remove( "kp2rig_frames_ingested_total", labels );
+               Metrics::Instance().Remove( "kp2rig_frames_missing_total", labels );
+               Metrics::Instance().Remove( "kp2rig_frames_duplicate_total", labels );
+               characterMetadata.erase( id );
+            }
+            
             // Get this character's metadata
             CharacterMetadata & metadata = characterMetadata[characterPose->Name()];
+            if ( !metadata.framesIngested )
+            {
+               std::string labels = Metrics::Label( "character", characterPose->Name() );
+               metadata.framesIngested = &Metrics::Instance().GetCounter( "kp2rig_frames_ingested_total", labels );
+               metadata.framesMissing = &Metrics::Instance().GetCounter( "kp2rig_frames_missing_total", labels );
+               metadata.framesDuplicate = &Metrics::Instance().GetCounter( "kp2rig_frames_duplicate_total", labels );
+            }
+            metadata.framesIngested->Add();
             
             // Set our axis scalars
             characterPose->CoordinateSystem( { 1., 1., args.useLeftHandCoords ? -1. : 1. } );
@@ -219,7 +386,13 @@ int main( int argc, char *argv[] )
             
             if ( metadata.previousTimestamp == characterPose->Timestamp() )
             {
-               printf( "%s: Duplicate frame %d dropped\n", characterPose->Name().c_str(), metadata.previousTimestamp );
+               if ( duplicateFrameLimiter.Allow( numSuppressed ) )
+               {
+                  if ( numSuppressed )
+                     printf( "(%d duplicate frame messages suppressed)\n", (int)numSuppressed );
+                  printf( "%s: Duplicate frame %d dropped\n", characterPose->Name().c_str(), metadata.previousTimestamp );
+               }
+               metadata.framesDuplicate->Add();
                ++totalDuplicateFrames;
             }
             else
@@ -227,14 +400,20 @@ int main( int argc, char *argv[] )
                if ( characterPose->Timestamp() - metadata.previousTimestamp > 1 )
                {
                   metadata.contiguousMissingFrames = characterPose->Timestamp() - (metadata.previousTimestamp + 1);
-                  if ( metadata.contiguousMissingFrames == 1 )
-                     printf( "%s: Missing frame %d\n", characterPose->Name().c_str(), metadata.previousTimestamp + 1 );
-                  else
-                     printf( "%s: Missing %d frames, %d-%d expected\n",
-                        characterPose->Name().c_str(),
-                        metadata.contiguousMissingFrames,
-                        metadata.previousTimestamp + 1,
-                        metadata.previousTimestamp + metadata.contiguousMissingFrames );
+                  if ( missingFrameLimiter.Allow( numSuppressed ) )
+                  {
+                     if ( numSuppressed )
+                        printf( "(%d missing frame messages suppressed)\n", (int)numSuppressed );
+                     if ( metadata.contiguousMissingFrames == 1 )
+                        printf( "%s: Missing frame %d\n", characterPose->Name().c_str(), metadata.previousTimestamp + 1 );
+                     else
+                        printf( "%s: Missing %d frames, %d-%d expected\n",
+                           characterPose->Name().c_str(),
+                           metadata.contiguousMissingFrames,
+                           metadata.previousTimestamp + 1,
+                           metadata.previousTimestamp + metadata.contiguousMissingFrames );
+                  }
+                  metadata.framesMissing->Add( metadata.contiguousMissingFrames );
                         
                   totalMissingFrames += metadata.contiguousMissingFrames;
                }
@@ -254,11 +433,17 @@ int main( int argc, char *argv[] )
             }
          }
       }
+      
+      // A stream is done once all of its inputs have ended
+      if ( args.stream )
+         quit = true;
    }
    
    // Since we're done processing input, make sure all processing is complete
    // before we print our summary and exit
    animation.FlushSegments();
+   Metrics::Instance().StopPeriodicWrite();
+   Trace::Stop();
    
    // For printing-sake, make sure start timestamp isn't greater than end timestamp
    if ( lowestTimestamp > highestTimestamp )
@@ -271,7 +456,7 @@ int main( int argc, char *argv[] )
       printf( "%c", '\n' );
       printf( "------------------------------------------------------\n" );
       printf( "%d characters, bounds %d->%d\n",
-         (int)animation.GetAnimatedRigs().size(),
+         (int)animation.NumCharacters(),
          lowestTimestamp,
          highestTimestamp );
       printf( "%d missing frames, %d duplicate frames\n",
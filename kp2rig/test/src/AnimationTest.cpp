@@ -0,0 +1,356 @@
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <json.hpp>
+#include "Animation.hpp"
+#include "Compression.hpp"
+#include "Metrics.hpp"
+#include "RigMerger.hpp"
+#include "SmoothFactory.hpp"
+#include "Smooth_oneEuro.hpp"
+#include "TestPoses.hpp"
+
+using namespace TestPoses;
+
+#ifdef __linux__
+namespace
+{
+   // Four seconds of one person walking, in one second segments
+   const double FPS = 30;
+   const int NUM_FRAMES = 120;
+   const int SEGMENT_FRAMES = 30;
+
+   // Each test writes to a fresh directory
+   std::string TemporaryDirectory()
+   {
+      char directoryTemplate[] = "/tmp/kp2rigTest_XXXXXX";
+      if ( !mkdtemp( directoryTemplate ) )
+         throw std::runtime_error( "Can't create a temporary directory" );
+      return directoryTemplate;
+   }
+
+   // one_euro is always built in; lpf_ipp, which reads ahead of each segment, needs IPP
+   std::vector< SMOOTH_TYPE > SmoothTypes()
+   {
+      std::vector< SMOOTH_TYPE > types = { SMOOTH_TYPE_ONE_EURO };
+      if ( SmoothFactory::Create( SMOOTH_TYPE_LPF_IPP ) )
+         types.push_back( SMOOTH_TYPE_LPF_IPP );
+      return types;
+   }
+
+   void AddFrames( Animation & ref_animation,
+      int firstTimestamp,
+      int lastTimestamp )
+   {
+      std::map< KEYPOINT_TYPE, int > layout = MpiiLayout();
+      for ( int timestamp = firstTimestamp; timestamp <= lastTimestamp; ++timestamp )
+      {
+         std::unique_ptr< Pose > pose = RawPose( layout, timestamp );
+         ref_animation.AddPose( "player", pose );
+      }
+   }
+}
+
+TEST_CASE( "one_euro_parameters", "[animation]" )
+{
+   // Following a ramp, a higher beta raises the cutoff with the speed and lags less; with none, the cutoff stays put
+   auto Lag = []( double beta )
+   {
+      Smooth_oneEuro filter;
+      filter.Initialize( 0, 1./30. );
+      filter.Parameters( beta, 1./30. );
+      for ( int i = 0; i < 100; ++i )
+         filter.AddSample( i, i * 0.1 );
+      std::vector< double > samples;
+      filter.Apply( samples );
+      return 99 * 0.1 - samples.back();
+   };
+   CHECK( Lag( 0 ) > Lag( Smooth_oneEuro::DEFAULT_BETA ) );
+   CHECK( Lag( Smooth_oneEuro::DEFAULT_BETA ) > Lag( 10 ) );
+   CHECK( Lag( 10 ) > 0 );
+}
+
+TEST_CASE( "smoothed_segments_keep_every_frame", "[animation]" )
+{
+   // No smoothed frames are held back or lost at the boundaries, including those the low-pass filter reads ahead for;
+   // live segments are written as the watermark passes them, the others all at once when flushed
+   for ( SMOOTH_TYPE smoothType : SmoothTypes() )
+   {
+      for ( bool live : { false, true } )
+      {
+         for ( SMOOTH_DOMAIN domain : { SMOOTH_DOMAIN_KEYPOINTS, SMOOTH_DOMAIN_ROTATIONS } )
+         {
+            INFO( SmoothFactory::SmoothType( smoothType ) << (live ? ", live, smoothing " : ", smoothing ") << SmoothFactory::SmoothDomain( domain ) );
+            const uint64_t framesWritten = FramesWritten();
+            const uint64_t solves = Solves();
+            const Histogram & solvesPerFrame = Metrics::Instance().GetHistogram( "kp2rig_solves_per_frame", "", 1e-3 );
+            const uint64_t numSegments = solvesPerFrame.Count();
+            const uint64_t sumSolvesPerFrame = solvesPerFrame.Sum();
+
+            Animation animation( FPS );
+            animation.OutputDirectory( TemporaryDirectory() );
+            animation.SegmentDuration( SEGMENT_FRAMES / FPS );
+            animation.Smooth( smoothType );
+            animation.SmoothDomain( domain );
+            animation.BoneLengthFrames( 5, 0 );
+            animation.Live( live );
+            AddFrames( animation, 0, NUM_FRAMES - 1 );
+            animation.FlushSegments();
+
+            const std::vector< std::string > filenames = animation.SegmentFilenames();
+            CHECK( filenames.size() == NUM_FRAMES / SEGMENT_FRAMES );
+            for ( const std::string & filename : filenames )
+            {
+               INFO( filename );
+               CHECK( FramesInFile( filename )[ "player" ] == (size_t)SEGMENT_FRAMES );
+            }
+            CHECK( FramesWritten() - framesWritten == (uint64_t)NUM_FRAMES );
+            
+            // Without gaps or a live feed, each frame is solved once, after it's filtered or before its rotations are
+            CHECK( Solves() - solves == (uint64_t)NUM_FRAMES );
+            CHECK( solvesPerFrame.Count() - numSegments == filenames.size() );
+
+            // One ratio per segment, in thousandths: each rounds down, and read-ahead solves can land a segment early
+            const uint64_t ratios = solvesPerFrame.Sum() - sumSolvesPerFrame;
+            CHECK( ratios >= 1000 * filenames.size() - filenames.size() );
+            CHECK( ratios <= 1000 * filenames.size() + filenames.size() );
+         }
+      }
+   }
+}
+
+TEST_CASE( "range_pre_roll", "[animation]" )
+{
+   // Frames before the range warm up the filter, and every frame of the range is written, in one file or in segments
+   const int RANGE_START = 40, RANGE_END = 99;
+   for ( SMOOTH_TYPE smoothType : SmoothTypes() )
+   {
+      for ( double segmentDuration : { 0., SEGMENT_FRAMES / FPS } )
+      {
+         INFO( SmoothFactory::SmoothType( smoothType ) << ", segments of " << segmentDuration << "s" );
+         Animation animation( FPS );
+         const std::string directory = TemporaryDirectory();
+         animation.OutputDirectory( directory );
+         animation.SegmentDuration( segmentDuration );
+         animation.Smooth( smoothType );
+         animation.BoneLengthFrames( 5, 0 );
+         animation.Live( false );
+         animation.Range( RANGE_START, RANGE_END );
+         AddFrames( animation, 0, NUM_FRAMES - 1 );
+         animation.FlushSegments();
+
+         const std::vector< std::string > filenames = animation.SegmentFilenames();
+         REQUIRE( filenames.size() );
+         CHECK( filenames.front() == directory + "/seg_" + std::to_string( RANGE_START ) + ".json" );
+         size_t numFrames = 0;
+         for ( const std::string & filename : filenames )
+            numFrames += FramesInFile( filename )[ "player" ];
+         CHECK( numFrames == (size_t)(RANGE_END - RANGE_START + 1) );
+      }
+   }
+}
+
+TEST_CASE( "merged_shards_within_tolerance", "[animation]" )
+{
+   // Each shard's frames are compressed once when written and again when merged, so the merged values are within the
+   // compression tolerance of the shards', and within twice that of what was solved
+   auto write = []( bool hasRange, int start, int end )
+   {
+      Animation animation( FPS );
+      animation.OutputDirectory( TemporaryDirectory() );
+      animation.SegmentDuration( 0 );
+      animation.BoneLengthFrames( 5, 0 );
+      animation.Live( false );
+      if ( hasRange )
+         animation.Range( start, end );
+      AddFrames( animation, 0, NUM_FRAMES - 1 );
+      animation.FlushSegments();
+      REQUIRE( animation.SegmentFilenames().size() == 1 );
+      return animation.SegmentFilenames().front();
+   };
+   const std::string serialFilename = write( false, 0, 0 );
+   const std::vector< std::string > shardFilenames = { write( true, 60, NUM_FRAMES - 1 ), write( true, 0, 59 ) };
+   RigMerger merger;
+   for ( const std::string & filename : shardFilenames )
+      merger.Add( filename );
+   const nlohmann::json merged = nlohmann::json::parse( merger.Merge() );
+   
+   auto read = []( const nlohmann::json & json, const char * key )
+   {
+      const std::string base64 = json.at( "rigs" ).at( 0 ).at( key ).get< std::string >();
+      std::vector< unsigned char > compressed;
+      const size_t size = Compression::DecodeBase64( reinterpret_cast< const unsigned char * >( base64.data() ), base64.size(), compressed );
+      std::vector< double > values;
+      Compression::DecodeZfp( compressed.data(), size, values );
+      return values;
+   };
+   auto readFile = [&]( const std::string & filename, const char * key )
+   {
+      std::ifstream file( filename );
+      nlohmann::json json;
+      file >> json;
+      return read( json, key );
+   };
+   auto maxDifference = []( const std::vector< double > & lhs, const std::vector< double > & rhs )
+   {
+      REQUIRE( lhs.size() == rhs.size() );
+      double difference = 0;
+      for ( size_t i = 0; i < lhs.size(); ++i )
+         difference = std::max( difference, std::abs( lhs[ i ] - rhs[ i ] ) );
+      return difference;
+   };
+   for ( const char * key : { "loc", "boneRot" } )
+   {
+      INFO( key );
+      std::vector< double > shards = readFile( shardFilenames[ 1 ], key );
+      const std::vector< double > secondShard = readFile( shardFilenames[ 0 ], key );
+      shards.insert( std::end( shards ), std::begin( secondShard ), std::end( secondShard ) );
+      const std::vector< double > mergedValues = read( merged, key );
+      CHECK( maxDifference( mergedValues, shards ) <= Compression::ZFP_ACCURACY );
+      CHECK( maxDifference( mergedValues, readFile( serialFilename, key ) ) <= 3 * Compression::ZFP_ACCURACY );
+   }
+}
+
+TEST_CASE( "partitioned_ids_keep_their_own_files", "[animation]" )
+{
+   // These would share a file if their odd characters were replaced, or overwrite the manifest
+   const std::vector< std::string > ids = { "a.b", "a_b", "manifest" };
+   const std::string directory = TemporaryDirectory();
+   Animation animation( FPS );
+   animation.OutputDirectory( directory );
+   animation.SegmentDuration( SEGMENT_FRAMES / FPS );
+   animation.BoneLengthFrames( 5, 0 );
+   animation.Live( false );
+   animation.PartitionByRig( 2 );
+   std::map< KEYPOINT_TYPE, int > layout = MpiiLayout();
+   for ( size_t i = 0; i < ids.size(); ++i )
+   {
+      // Each id has a different number of frames, so the files can be told apart
+      for ( int timestamp = 0; timestamp < SEGMENT_FRAMES - (int)i; ++timestamp )
+      {
+         std::unique_ptr< Pose > pose = RawPose( layout, timestamp );
+         animation.AddPose( ids[ i ], pose );
+      }
+   }
+   animation.FlushSegments();
+   
+   const std::vector< std::string > filenames = animation.SegmentFilenames();
+   REQUIRE( filenames.size() == ids.size() + 1 );
+   CHECK( filenames.back() == directory + "/seg_0.manifest.json" );
+   std::map< std::string, size_t > frames;
+   for ( size_t i = 0; i < ids.size(); ++i )
+   {
+      for ( const auto & rig : FramesInFile( filenames[ i ] ) )
+         frames.insert( rig );
+   }
+   CHECK( frames == std::map< std::string, size_t >( {
+      { "a.b", (size_t)SEGMENT_FRAMES }, { "a_b", (size_t)SEGMENT_FRAMES - 1 }, { "manifest", (size_t)SEGMENT_FRAMES - 2 } } ) );
+}
+
+TEST_CASE( "checkpoint_skipped_after_write_failure", "[animation]" )
+{
+   // Segments go under a regular file, so none of them can be written, whoever runs the test. A checkpoint
+   // would let a resumed run skip past them, so none is written either.
+   const std::string directory = TemporaryDirectory();
+   const std::string notADirectory = directory + "/file";
+   std::ofstream( notADirectory ) << "";
+   const std::string checkpointFilename = directory + "/state.ckpt";
+   const uint64_t writeErrors = Metrics::Instance().GetCounter( "kp2rig_segment_write_errors_total" ).Value();
+   
+   Animation animation( FPS );
+   animation.OutputDirectory( notADirectory + "/segments" );
+   animation.SegmentDuration( SEGMENT_FRAMES / FPS );
+   animation.Checkpoint( checkpointFilename );
+   animation.BoneLengthFrames( 5, 0 );
+   animation.Live( true );
+   AddFrames( animation, 0, NUM_FRAMES - 1 );
+   animation.FlushSegments();
+   
+   CHECK( animation.SegmentFilenames().empty() );
+   CHECK( Metrics::Instance().GetCounter( "kp2rig_segment_write_errors_total" ).Value() - writeErrors == (uint64_t)(NUM_FRAMES / SEGMENT_FRAMES) );
+   CHECK( !std::ifstream( checkpointFilename ).good() );
+}
+
+TEST_CASE( "checkpoint_skipped_after_processing_failure", "[animation]" )
+{
+   // The frames of the second segment can't be solved, so it can't be processed. The checkpoint left on disk is
+   // from after the first, and resuming from it writes the second segment again.
+   const std::string directory = TemporaryDirectory();
+   const std::string checkpointFilename = directory + "/state.ckpt";
+   const std::string secondSegment = directory + "/seg_" + std::to_string( SEGMENT_FRAMES ) + ".json";
+   std::map< KEYPOINT_TYPE, int > layout = MpiiLayout();
+   for ( bool resume : { false, true } )
+   {
+      INFO( (resume ? "Resumed" : "First run") );
+      Animation animation( FPS );
+      animation.OutputDirectory( directory );
+      animation.SegmentDuration( SEGMENT_FRAMES / FPS );
+      animation.Checkpoint( checkpointFilename );
+      animation.BoneLengthFrames( 5, 0 );
+      animation.Live( false );
+      if ( resume )
+         animation.Resume( checkpointFilename );
+      AddFrames( animation, 0, SEGMENT_FRAMES - 1 );
+      animation.FlushSegments();
+      for ( int timestamp = SEGMENT_FRAMES; timestamp < 2 * SEGMENT_FRAMES; ++timestamp )
+      {
+         std::unique_ptr< Pose > pose = resume ? RawPose( layout, timestamp ) : UnsolvablePose( layout, timestamp );
+         animation.AddPose( "player", pose );
+      }
+      animation.FlushSegments();
+      
+      if ( resume )
+      {
+         CHECK( animation.SegmentFilenames() == std::vector< std::string >( { secondSegment } ) );
+         CHECK( FramesInFile( secondSegment )[ "player" ] == (size_t)SEGMENT_FRAMES );
+      }
+      else
+      {
+         CHECK( animation.SegmentFilenames() == std::vector< std::string >( { directory + "/seg_0.json" } ) );
+      }
+   }
+}
+
+TEST_CASE( "retired_characters_release_metrics", "[animation]" )
+{
+   // Once its frames are written, a character that's gone quiet is retired along with its metrics
+   Animation animation( FPS );
+   animation.OutputDirectory( TemporaryDirectory() );
+   animation.SegmentDuration( SEGMENT_FRAMES / FPS );
+   animation.BoneLengthFrames( 5, 0 );
+   animation.Live( false );
+   animation.RetireAfter( 1e-6 );
+   AddFrames( animation, 0, SEGMENT_FRAMES - 1 );
+   const std::string series = "kp2rig_rig_frames{" + Metrics::Label( "character", "player" ) + "}";
+   CHECK( Metrics::Instance().ToPrometheus().find( series ) != std::string::npos );
+   animation.FlushSegments();
+   
+   CHECK( animation.TakeRetiredCharacters() == std::vector< std::string >( { "player" } ) );
+   CHECK( animation.TakeRetiredCharacters().empty() );
+   CHECK( Metrics::Instance().ToPrometheus().find( series ) == std::string::npos );
+}
+
+TEST_CASE( "returning_characters_not_retired", "[animation]" )
+{
+   // A character that comes back before its retirement is taken isn't reported, so the caller keeps what it has for it
+   Animation animation( FPS );
+   animation.OutputDirectory( TemporaryDirectory() );
+   animation.SegmentDuration( SEGMENT_FRAMES / FPS );
+   animation.BoneLengthFrames( 5, 0 );
+   animation.Live( false );
+   animation.RetireAfter( 1e-6 );
+   AddFrames( animation, 0, SEGMENT_FRAMES - 1 );
+   animation.FlushSegments();
+   AddFrames( animation, SEGMENT_FRAMES, 2 * SEGMENT_FRAMES - 1 );
+   
+   CHECK( animation.TakeRetiredCharacters().empty() );
+   CHECK( animation.NumCharacters() == 2 );
+}
+#endif
@@ -0,0 +1,59 @@
+#include <catch2/catch.hpp>
+
+#include "BoneLengthEstimator.hpp"
+
+namespace
+{
+   // The default humanoid with every bone scaled by @scale
+   Rig ScaledRig( double scale )
+   {
+      Rig rig = Rig::DefaultPoseHumanoid();
+      for ( int i = 0; i < rig.numJointsUsed; ++i )
+         rig.GetJoint( Rig::JOINT_TYPE(i) ).length *= scale;
+      return rig;
+   }
+}
+
+TEST_CASE( "p2_quantile_median", "[bones]" )
+{
+   // Exact until the markers are set up, then close to the median of what was added
+   P2Quantile median;
+   CHECK( median.Count() == 0 );
+   CHECK( median.Value() == 0.0 );
+   for ( double value : { 3., 1., 2. } )
+      median.Add( value );
+   CHECK( median.Value() == 2.0 );
+   for ( int i = 0; i < 1000; ++i )
+      median.Add( (i * 37) % 101 );
+   CHECK( median.Count() == 1003 );
+   CHECK( median.Value() == Approx( 50 ).margin( 2 ) );
+}
+
+TEST_CASE( "bone_lengths_need_a_sample", "[bones]" )
+{
+   // With no warm-up there's still no estimate until a rig is added, otherwise every bone would have zero length
+   BoneLengthEstimator estimator( 0, 0 );
+   CHECK( !estimator.IsWarm() );
+   Rig rig = ScaledRig( 1.0 );
+   estimator.Apply( rig );
+   CHECK( rig.pelvis.length == Rig::DefaultPoseHumanoid().pelvis.length );
+
+   estimator.AddSample( ScaledRig( 1.1 ) );
+   CHECK( estimator.IsWarm() );
+   estimator.Apply( rig );
+   CHECK( rig.pelvis.length == Approx( 1.1 * Rig::DefaultPoseHumanoid().pelvis.length ) );
+}
+
+TEST_CASE( "bone_lengths_frozen_before_warm", "[bones]" )
+{
+   // Frozen before it's warm, the estimate is never applied, which is why kp2rig rejects --bone-freeze below --bone-warmup
+   BoneLengthEstimator estimator( 5, 3 );
+   for ( int i = 0; i < 10; ++i )
+      estimator.AddSample( ScaledRig( 1.1 ) );
+   CHECK( estimator.NumSamples() == 3 );
+   CHECK( estimator.IsFrozen() );
+   CHECK( !estimator.IsWarm() );
+   Rig rig = ScaledRig( 1.0 );
+   estimator.Apply( rig );
+   CHECK( rig.pelvis.length == Rig::DefaultPoseHumanoid().pelvis.length );
+}
@@ -0,0 +1,131 @@
+#include <catch2/catch.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <eigen3/Eigen/Geometry>
+#include "ImportTransform.hpp"
+#include "KpImporterFactory.hpp"
+#include "Pose.hpp"
+
+namespace
+{
+   // Decimeters, z-up, and a venue a quarter turn round and off to one side
+   ImportTransform VenueTransform()
+   {
+      ImportTransform transform;
+      transform.Scale( 0.1 );
+      transform.Axes( "x,z,-y" );
+      transform.Calibration( {
+         0, 0, 1, 2.5,
+         0, 1, 0, 0,
+         -1, 0, 0, -4,
+         0, 0, 0, 1 } );
+      return transform;
+   }
+   Eigen::Vector3d ExpectedVenue( const Eigen::Vector3d & input )
+   {
+      const Eigen::Vector3d meters = input * 0.1;
+      const Eigen::Vector3d yUp( meters.x(), meters.z(), -meters.y() );
+      return Eigen::Vector3d( yUp.z() + 2.5, yUp.y(), -yUp.x() - 4 );
+   }
+}
+
+TEST_CASE( "import_transform", "[import]" )
+{
+   ImportTransform transform;
+   CHECK( transform.IsIdentity() );
+   CHECK( transform.Axes() == "x,y,z" );
+   
+   // Axes must use each of x, y and z once
+   CHECK_THROWS_AS( transform.Axes( "x,y" ), std::runtime_error );
+   CHECK_THROWS_AS( transform.Axes( "x,x,z" ), std::runtime_error );
+   CHECK_THROWS_AS( transform.Axes( "x,y,w" ), std::runtime_error );
+   CHECK_THROWS_AS( transform.Axes( "x,y,z," ), std::runtime_error );
+   transform.Axes( "+z,-x,-y" );
+   CHECK( transform.Axes() == "z,-x,-y" );
+   CHECK_THROWS_AS( transform.Calibration( { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 1, 1 } ), std::runtime_error );
+   CHECK_THROWS_AS( transform.Scale( 0 ), std::runtime_error );
+   
+   // Units and flips only multiply, exactly as if each value was multiplied on its own
+   transform.Axes( "-x,y,-z" );
+   transform.Scale( 0.1 );
+   double scaled[] = { 15.071394787257328, 1.3629840029294118, -52.21340364337587, 1, 2, 3 };
+   transform.Apply( scaled, 2 );
+   CHECK( scaled[ 0 ] == 15.071394787257328 * -0.1 );
+   CHECK( scaled[ 1 ] == 1.3629840029294118 * 0.1 );
+   CHECK( scaled[ 2 ] == -52.21340364337587 * -0.1 );
+   CHECK( scaled[ 5 ] == 3 * -0.1 );
+   
+   // Scale, then axes, then calibration
+   transform = VenueTransform();
+   CHECK_FALSE( transform.IsIdentity() );
+   std::vector< double > points;
+   for ( int i = 0; i < 7 * 3; ++i )
+      points.push_back( i * 1.5 - 10 );
+   std::vector< double > transformed = points;
+   transform.Apply( transformed.data(), 7 );
+   for ( size_t i = 0; i < 7; ++i )
+   {
+      const Eigen::Vector3d expected = ExpectedVenue( Eigen::Vector3d( points.data() + i * 3 ) );
+      CHECK( (Eigen::Vector3d( transformed.data() + i * 3 ) - expected).norm() < 1e-12 );
+   }
+}
+
+TEST_CASE( "import_transform_no_mirroring", "[import]" )
+{
+   // Mirrored input would put every left keypoint on the right of the skeleton, so neither the axes nor the
+   // calibration may mirror it; left-handed input is converted by Pose::CoordinateSystem()
+   ImportTransform transform;
+   CHECK_THROWS_AS( transform.Axes( "x,y,-z" ), std::runtime_error );
+   CHECK_THROWS_AS( transform.Axes( "y,x,z" ), std::runtime_error );
+   CHECK_THROWS_AS( transform.Axes( "-x,-y,-z" ), std::runtime_error );
+   CHECK( transform.Axes() == "x,y,z" );
+   transform.Axes( "-y,x,z" );
+   transform.Axes( "z,x,y" );
+   
+   CHECK_THROWS_AS( transform.Calibration( { -1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 } ), std::runtime_error );
+   CHECK_THROWS_AS( transform.Calibration( { 0, 1, 0, 0,  1, 0, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 } ), std::runtime_error );
+   
+   // Nor scale or shear it, which would change the bone lengths
+   CHECK_THROWS_AS( transform.Calibration( { 2, 0, 0, 0,  0, 2, 0, 0,  0, 0, 2, 0,  0, 0, 0, 1 } ), std::runtime_error );
+   CHECK_THROWS_AS( transform.Calibration( { 1, 0.5, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 } ), std::runtime_error );
+   
+   // A rotation written with a few digits is fine
+   const double c = 0.7071068;
+   transform.Calibration( { c, 0, c, 1,  0, 1, 0, 2,  -c, 0, c, 3,  0, 0, 0, 1 } );
+}
+
+TEST_CASE( "import_transform_csv", "[import]" )
+{
+   // One mpii frame of 16 keypoints
+   const char * filename = "import_transform_test.csv";
+   {
+      std::ofstream file( filename );
+      file << "mpii, player, custom, 7:";
+      for ( int i = 0; i < 16 * 3; ++i )
+         file << (i ? ", " : " ") << (i * 0.75 - 12);
+      file << "\n";
+   }
+   
+   std::unique_ptr< KpImporter > importer = KpImporterFactory::Create( KpImporter::IMPORT_TYPE_CSV );
+   importer->Transform( VenueTransform() );
+   CHECK( importer->UnitMeterNorm() == 0.1 );
+   importer->Open( filename );
+   std::unique_ptr< Pose > pose;
+   while ( !pose && !importer->IsParseComplete() )
+      pose = importer->ReadOne();
+   importer->Close();
+   std::remove( filename );
+   
+   REQUIRE( pose );
+   CHECK( pose->Timestamp() == 7 );
+   for ( const auto & keypoint : pose->KeypointLayout() )
+   {
+      const int i = keypoint.second;
+      const Eigen::Vector3d input( i * 3 * 0.75 - 12, (i * 3 + 1) * 0.75 - 12, (i * 3 + 2) * 0.75 - 12 );
+      const std::array< double, 3 > & value = pose->Keypoint( keypoint.first );
+      CHECK( (Eigen::Vector3d( value[ 0 ], value[ 1 ], value[ 2 ] ) - ExpectedVenue( input )).norm() < 1e-12 );
+   }
+}
@@ -0,0 +1,36 @@
+#include <catch2/catch.hpp>
+
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Metrics.hpp"
+
+TEST_CASE( "prometheus_families", "[metrics]" )
+{
+   Metrics & metrics = Metrics::Instance();
+   metrics.GetGauge( "kp2rigTest_gauge", Metrics::Label( "character", "a" ) ).Set( 1 );
+   metrics.GetGauge( "kp2rigTest_gauge", Metrics::Label( "character", "b" ) ).Set( 2 );
+   
+   // Every sample of a family comes after its TYPE line and before the next one
+   std::vector< std::string > lines;
+   std::stringstream text( metrics.ToPrometheus() );
+   for ( std::string line; std::getline( text, line ); )
+   {
+      if ( line.find( "kp2rigTest_gauge" ) != std::string::npos )
+         lines.push_back( line );
+   }
+   CHECK( lines == std::vector< std::string >( {
+      "# TYPE kp2rigTest_gauge gauge",
+      "kp2rigTest_gauge{character=\"a\"} 1",
+      "kp2rigTest_gauge{character=\"b\"} 2",
+      "# TYPE kp2rigTest_gauge_max gauge",
+      "kp2rigTest_gauge_max{character=\"a\"} 1",
+      "kp2rigTest_gauge_max{character=\"b\"} 2" } ) );
+}
+
+TEST_CASE( "prometheus_label_escaping", "[metrics]" )
+{
+   // Character names come from the input, so they can hold anything
+   CHECK( Metrics::Label( "character", "player_5" ) == "character=\"player_5\"" );
+   CHECK( Metrics::Label( "character", "a\"b\\c\nd" ) == "character=\"a\\\"b\\\\c\\nd\"" );
+}
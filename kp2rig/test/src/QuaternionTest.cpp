@@ -0,0 +1,223 @@
+#include <catch2/catch.hpp>
+
+#include <cmath>
+#include <random>
+#include <vector>
+#include <eigen3/Eigen/Geometry>
+#include "QuaternionBatch.hpp"
+
+using namespace QuaternionBatch;
+
+namespace
+{
+   // Not a multiple of any SIMD width, so every kernel also runs its scalar tail
+   const size_t COUNT = 67;
+   const double TOLERANCE = 1e-12;
+
+   Eigen::Quaterniond ToEigen( const QuaternionBuffer & buffer, size_t i )
+   {
+      const std::array< double, 4 > raw = buffer.Get( i );
+      return Eigen::Quaterniond( raw[ 3 ], raw[ 0 ], raw[ 1 ], raw[ 2 ] );
+   }
+   Eigen::Vector3d ToEigen( const VectorBuffer & buffer, size_t i )
+   {
+      const std::array< double, 3 > raw = buffer.Get( i );
+      return Eigen::Vector3d( raw[ 0 ], raw[ 1 ], raw[ 2 ] );
+   }
+   void Set( QuaternionBuffer & out_buffer, size_t i, const Eigen::Quaterniond & q )
+   {
+      out_buffer.Set( i, { q.x(), q.y(), q.z(), q.w() } );
+   }
+
+   void RandomRotations( std::mt19937 & ref_random, QuaternionBuffer & out_buffer )
+   {
+      std::uniform_real_distribution< double > distribution( -1.0, 1.0 );
+      for ( size_t i = 0; i < out_buffer.Size(); ++i )
+         Set( out_buffer, i, Eigen::Quaterniond( distribution( ref_random ), distribution( ref_random ), distribution( ref_random ), distribution( ref_random ) ).normalized() );
+   }
+   void RandomVectors( std::mt19937 & ref_random, VectorBuffer & out_buffer )
+   {
+      std::uniform_real_distribution< double > distribution( -2.0, 2.0 );
+      for ( size_t i = 0; i < out_buffer.Size(); ++i )
+         out_buffer.Set( i, { distribution( ref_random ), distribution( ref_random ), distribution( ref_random ) } );
+   }
+
+   bool Near( const Eigen::Quaterniond & lhs, const Eigen::Quaterniond & rhs )
+   {
+      return (lhs.coeffs() - rhs.coeffs()).cwiseAbs().maxCoeff() <= TOLERANCE;
+   }
+   bool Near( const Eigen::Vector3d & lhs, const Eigen::Vector3d & rhs )
+   {
+      return (lhs - rhs).cwiseAbs().maxCoeff() <= TOLERANCE;
+   }
+
+   std::vector< KERNEL > SupportedKernels()
+   {
+      std::vector< KERNEL > kernels;
+      for ( KERNEL kernel : { KERNEL_SCALAR, KERNEL_AVX2, KERNEL_NEON } )
+      {
+         if ( IsSupported( kernel ) )
+            kernels.push_back( kernel );
+      }
+      return kernels;
+   }
+}
+
+TEST_CASE( "quaternion_batch", "[quaternion]" )
+{
+   std::mt19937 random( 11 );
+   QuaternionBuffer a( COUNT ), b( COUNT ), out( COUNT );
+   VectorBuffer v( COUNT ), w( COUNT ), rotated( COUNT );
+   std::vector< double > ratios( COUNT );
+   RandomRotations( random, a );
+   RandomRotations( random, b );
+   RandomVectors( random, v );
+   RandomVectors( random, w );
+   std::uniform_real_distribution< double > distribution( 0.0, 1.0 );
+   for ( auto & ratio : ratios )
+      ratio = distribution( random );
+   
+   // Packed points, and an affine transform to apply to them
+   std::vector< double > points( COUNT * 3 ), transformed( COUNT * 3 );
+   for ( auto & value : points )
+      value = distribution( random ) * 10.0 - 5.0;
+   Eigen::Affine3d affine = Eigen::Translation3d( 1.5, -2.0, 0.25 ) * ToEigen( a, 0 ) * Eigen::Scaling( 0.1 );
+   std::array< double, 12 > matrix;
+   for ( int row = 0; row < 3; ++row )
+   {
+      for ( int column = 0; column < 4; ++column )
+         matrix[ row * 4 + column ] = affine.matrix()( row, column );
+   }
+
+   // Cases with their own code paths: the same rotation, the same rotation the other way round, and opposite vectors
+   Set( b, 1, ToEigen( a, 1 ) );
+   Set( b, 2, Eigen::Quaterniond( -ToEigen( a, 2 ).coeffs() ) );
+   w.Set( 3, { -v.Get( 3 )[ 0 ] * 3, -v.Get( 3 )[ 1 ] * 3, -v.Get( 3 )[ 2 ] * 3 } );
+   v.Set( 4, { 1, 0, 0 } );
+   w.Set( 4, { -2, 0, 0 } );
+
+   const KERNEL previousKernel = Kernel();
+   for ( KERNEL kernel : SupportedKernels() )
+   {
+      INFO( "Kernel " << KernelName( kernel ) );
+      REQUIRE_NOTHROW( Kernel( kernel ) );
+
+      SECTION( "multiply_" + KernelName( kernel ) )
+      {
+         Multiply( a.View(), b.View(), out.View(), COUNT );
+         for ( size_t i = 0; i < COUNT; ++i )
+            CHECK( Near( ToEigen( out, i ), ToEigen( a, i ) * ToEigen( b, i ) ) );
+      }
+
+      SECTION( "conjugate_" + KernelName( kernel ) )
+      {
+         Conjugate( a.View(), out.View(), COUNT );
+         for ( size_t i = 0; i < COUNT; ++i )
+            CHECK( Near( ToEigen( out, i ), ToEigen( a, i ).conjugate() ) );
+      }
+
+      SECTION( "normalize_" + KernelName( kernel ) )
+      {
+         Multiply( a.View(), b.View(), out.View(), COUNT );
+         for ( size_t i = 0; i < COUNT; ++i )
+            Set( out, i, Eigen::Quaterniond( ToEigen( out, i ).coeffs() * (1.0 + double(i)) ) );
+         Set( out, 5, Eigen::Quaterniond( 0, 0, 0, 0 ) );
+
+         QuaternionBuffer expected( COUNT );
+         for ( size_t i = 0; i < COUNT; ++i )
+            Set( expected, i, i == 5 ? Eigen::Quaterniond( 0, 0, 0, 0 ) : ToEigen( out, i ).normalized() );
+
+         // In place
+         Normalize( out.View(), out.View(), COUNT );
+         for ( size_t i = 0; i < COUNT; ++i )
+            CHECK( Near( ToEigen( out, i ), ToEigen( expected, i ) ) );
+      }
+
+      SECTION( "rotate_" + KernelName( kernel ) )
+      {
+         Rotate( a.View(), v.View(), rotated.View(), COUNT );
+         for ( size_t i = 0; i < COUNT; ++i )
+            CHECK( Near( ToEigen( rotated, i ), ToEigen( a, i )._transformVector( ToEigen( v, i ) ) ) );
+      }
+
+      SECTION( "slerp_" + KernelName( kernel ) )
+      {
+         Slerp( a.View(), b.View(), ratios.data(), out.View(), COUNT );
+         for ( size_t i = 0; i < COUNT; ++i )
+            CHECK( Near( ToEigen( out, i ), ToEigen( a, i ).slerp( ratios[ i ], ToEigen( b, i ) ) ) );
+      }
+
+      SECTION( "nlerp_" + KernelName( kernel ) )
+      {
+         Nlerp( a.View(), b.View(), ratios.data(), out.View(), COUNT );
+         for ( size_t i = 0; i < COUNT; ++i )
+         {
+            const Eigen::Quaterniond from = ToEigen( a, i );
+            const Eigen::Quaterniond to = ToEigen( b, i );
+            const double sign = from.dot( to ) < 0 ? -1.0 : 1.0;
+            const Eigen::Quaterniond expected( ((1.0 - ratios[ i ]) * from.coeffs() + sign * ratios[ i ] * to.coeffs()).normalized() );
+            CHECK( Near( ToEigen( out, i ), expected ) );
+            CHECK( std::abs( ToEigen( out, i ).norm() - 1.0 ) <= TOLERANCE );
+         }
+      }
+
+      SECTION( "transform_points_" + KernelName( kernel ) )
+      {
+         TransformPoints( matrix, points.data(), transformed.data(), COUNT );
+         for ( size_t i = 0; i < COUNT; ++i )
+            CHECK( Near( Eigen::Vector3d( transformed.data() + i * 3 ), affine * Eigen::Vector3d( points.data() + i * 3 ) ) );
+         
+         // In place
+         transformed = points;
+         TransformPoints( matrix, transformed.data(), transformed.data(), COUNT );
+         for ( size_t i = 0; i < COUNT; ++i )
+            CHECK( Near( Eigen::Vector3d( transformed.data() + i * 3 ), affine * Eigen::Vector3d( points.data() + i * 3 ) ) );
+      }
+      
+      SECTION( "scale_points_" + KernelName( kernel ) )
+      {
+         // Exact, and a NaN stays in its own component
+         points[ 7 ] = std::nan( "" );
+         ScalePoints( { 0.1, -1.0, 2.5 }, points.data(), transformed.data(), COUNT );
+         for ( size_t i = 0; i < COUNT * 3; ++i )
+         {
+            if ( i == 7 )
+               CHECK( std::isnan( transformed[ i ] ) );
+            else
+               CHECK( transformed[ i ] == points[ i ] * (i % 3 == 0 ? 0.1 : i % 3 == 1 ? -1.0 : 2.5) );
+         }
+      }
+
+      SECTION( "from_two_vectors_" + KernelName( kernel ) )
+      {
+         FromTwoVectors( v.View(), w.View(), out.View(), COUNT );
+         for ( size_t i = 0; i < COUNT; ++i )
+         {
+            const Eigen::Quaterniond q = ToEigen( out, i );
+            CHECK( std::abs( q.norm() - 1.0 ) <= TOLERANCE );
+            CHECK( Near( q._transformVector( ToEigen( v, i ).normalized() ), ToEigen( w, i ).normalized() ) );
+
+            // Opposite vectors can be turned round any perpendicular axis, so only compare the rest with Eigen
+            if ( i != 3 && i != 4 )
+               CHECK( Near( q, Eigen::Quaterniond::FromTwoVectors( ToEigen( v, i ), ToEigen( w, i ) ) ) );
+         }
+      }
+   }
+   Kernel( previousKernel );
+}
+
+TEST_CASE( "quaternion_batch_kernels", "[quaternion]" )
+{
+   CHECK( IsSupported( KERNEL_SCALAR ) );
+   CHECK( IsSupported( Kernel() ) );
+   for ( KERNEL kernel : { KERNEL_SCALAR, KERNEL_AVX2, KERNEL_NEON } )
+   {
+      if ( !IsSupported( kernel ) )
+         CHECK_THROWS( Kernel( kernel ) );
+   }
+
+   // An empty batch touches nothing
+   QuaternionBuffer empty;
+   CHECK( empty.Size() == 0 );
+   CHECK_NOTHROW( Multiply( empty.View(), empty.View(), empty.View(), 0 ) );
+}
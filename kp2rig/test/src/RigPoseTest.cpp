@@ -0,0 +1,71 @@
+#include <catch2/catch.hpp>
+
+#include <cstring>
+#include <stdexcept>
+#include "RigPose.hpp"
+#include "KpToRigHelper.hpp"
+#include "Utility.hpp"
+
+namespace
+{
+   // A rig with the right leg bent, so the ankle and the pelvis point different ways
+   RigPose BentLeg()
+   {
+      Rig rig;
+      rig.rKnee.quaternion = Utility::QuaternionToRaw( Eigen::Quaterniond( Eigen::AngleAxisd( 0.6, Eigen::Vector3d::UnitX() ) ) );
+      rig.rAnkle.quaternion = Utility::QuaternionToRaw( Eigen::Quaterniond( Eigen::AngleAxisd( -0.4, Eigen::Vector3d::UnitZ() ) ) );
+      RigPose rigPose( 0, rig );
+      RigPose * poses[] = { &rigPose };
+      RigPose::UpdateAbsRotations( poses, 1 );
+      return rigPose;
+   }
+
+   void CheckAbsRotation( const RigPose & rigPose,
+      KEYPOINT_TYPE type )
+   {
+      const SupplimentaryJoint & joint = rigPose.SupplimentaryJoints.At( type );
+      const Eigen::Quaterniond expected = Utility::RawToQuaternion( rigPose.GetRig().GetJoint( joint.parent ).quaternionAbs ) * Utility::RawToQuaternion( joint.quaternion );
+      CHECK( Utility::RawToQuaternion( joint.quaternionAbs ).angularDistance( expected ) < 1e-9 );
+   }
+}
+
+TEST_CASE( "supplimentary_joints", "[rigpose]" )
+{
+   RigPose rigPose = BentLeg();
+   rigPose.KpType( "mpii_27" );
+   const Rig & rig = rigPose.GetRig();
+   
+   SupplimentaryJointList & joints = rigPose.SupplimentaryJoints;
+   joints.Set( RIGHT_HEEL, RIGHT_ANKLE, KpToRigHelper::CreateJoint( rig.rAnkle, { 0, -0.05, -0.08 } ) );
+   joints.Set( RIGHT_BIG_TOE, RIGHT_ANKLE, KpToRigHelper::CreateJoint( rig.rAnkle, { 0.03, -0.05, 0.15 } ) );
+   CHECK( joints.Size() == 2 );
+   CHECK( joints.At( RIGHT_HEEL ).parent == Rig::RANKLE );
+   CHECK( joints.At( RIGHT_BIG_TOE ).type == RIGHT_BIG_TOE );
+   CHECK_FALSE( joints.Has( LEFT_HEEL ) );
+   CHECK_THROWS_AS( joints.At( LEFT_HEEL ), std::out_of_range );
+   
+   // Joints only hang off rig joints
+   CHECK_THROWS_AS( joints.Set( LEFT_HEEL, TOP_HEAD, Joint() ), std::runtime_error );
+   CHECK( joints.Size() == 2 );
+   
+   // Setting a joint again replaces it in place
+   joints.Set( RIGHT_HEEL, RIGHT_ANKLE, KpToRigHelper::CreateJoint( rig.rAnkle, { 0, -0.05, -0.1 } ) );
+   CHECK( joints.Size() == 2 );
+   CHECK( joints.begin()->type == RIGHT_HEEL );
+   
+   // Absolute rotations follow the parent joint, not the pelvis
+   RigPose * poses[] = { &rigPose };
+   RigPose::UpdateAbsRotations( poses, 1 );
+   CheckAbsRotation( rigPose, RIGHT_HEEL );
+   CheckAbsRotation( rigPose, RIGHT_BIG_TOE );
+   
+   // Copies are plain copies, and interpolating keeps every joint
+   RigPose copy;
+   std::memcpy( (void *)&copy, &rigPose, sizeof( RigPose ) );
+   CHECK( copy.KpType() == "mpii_27" );
+   CHECK( copy.SupplimentaryJoints.Size() == 2 );
+   RigPose halfway = rigPose.Interpolate( copy, 0.5 );
+   CHECK( halfway.SupplimentaryJoints.At( RIGHT_HEEL ).length == Approx( rigPose.SupplimentaryJoints.At( RIGHT_HEEL ).length ) );
+   CheckAbsRotation( halfway, RIGHT_HEEL );
+   CheckAbsRotation( halfway, RIGHT_BIG_TOE );
+}
@@ -0,0 +1,79 @@
+#include <catch2/catch.hpp>
+
+#include <set>
+#include <string>
+#include "SegmentFilename.hpp"
+
+TEST_CASE( "segment_filenames", "[segments]" )
+{
+   SegmentFilename segment;
+   
+   REQUIRE( SegmentFilename::Parse( "seg_30.json", segment ) );
+   CHECK( segment.startFrame == 30 );
+   CHECK( segment.patch == 0 );
+   CHECK( segment.contents == SegmentFilename::CONTENTS_ALL );
+   
+   REQUIRE( SegmentFilename::Parse( "seg_-30.json", segment ) );
+   CHECK( segment.startFrame == -30 );
+   
+   REQUIRE( SegmentFilename::Parse( "seg_30.manifest.json", segment ) );
+   CHECK( segment.startFrame == 30 );
+   CHECK( segment.contents == SegmentFilename::CONTENTS_MANIFEST );
+   
+   REQUIRE( SegmentFilename::Parse( "seg_30.rig.player_5.json", segment ) );
+   CHECK( segment.startFrame == 30 );
+   CHECK( segment.contents == SegmentFilename::CONTENTS_RIG );
+   CHECK( segment.rigId == "player_5" );
+   
+   REQUIRE( SegmentFilename::Parse( "seg_30.rig.a%2Eb%25.json", segment ) );
+   CHECK( segment.rigId == "a.b%" );
+   
+   REQUIRE( SegmentFilename::Parse( "seg_30_patch2.json", segment ) );
+   CHECK( segment.startFrame == 30 );
+   CHECK( segment.patch == 2 );
+   CHECK( segment.contents == SegmentFilename::CONTENTS_ALL );
+   
+   REQUIRE( SegmentFilename::Parse( "seg_30_patch2.manifest.json", segment ) );
+   CHECK( segment.patch == 2 );
+   CHECK( segment.contents == SegmentFilename::CONTENTS_MANIFEST );
+   
+   // Temporary files, checkpoints and anything else kp2rig doesn't name this way
+   for ( const char * filename : { "seg_30.json.tmp", "seg_.json", "seg_30x.json", "seg_ 30.json", "seg_+30.json",
+      "seg_30_patch.json", "seg_30_patch0.json", "seg_30..json", "seg_30.a.b.json", "state.ckpt", "seg_30",
+      "seg_30.player_5.json", "seg_30.rig..json", "seg_30.rig.a.b.json", "seg_30.rig.a%2.json", "seg_30.rig.a%2e.json",
+      "seg_30.rig.%41.json" } )
+   {
+      INFO( filename );
+      CHECK( !SegmentFilename::Parse( filename, segment ) );
+   }
+}
+
+TEST_CASE( "segment_filenames_round_trip", "[segments]" )
+{
+   // Ids that would be the same if their odd characters were replaced, and ids named after the manifest, all get
+   // files of their own
+   SegmentFilename segment;
+   segment.startFrame = 30;
+   segment.patch = 2;
+   std::set< std::string > filenames;
+   for ( const char * id : { "a.b", "a_b", "a%2Eb", "manifest", ".manifest", "rig.x", "é", "a/b" } )
+   {
+      INFO( id );
+      segment.contents = SegmentFilename::CONTENTS_RIG;
+      segment.rigId = id;
+      const std::string filename = segment.Filename();
+      CHECK( filenames.insert( filename ).second );
+      CHECK( filename.find( '/' ) == std::string::npos );
+      
+      SegmentFilename parsed;
+      REQUIRE( SegmentFilename::Parse( filename, parsed ) );
+      CHECK( parsed.startFrame == 30 );
+      CHECK( parsed.patch == 2 );
+      CHECK( parsed.contents == SegmentFilename::CONTENTS_RIG );
+      CHECK( parsed.rigId == id );
+   }
+   
+   segment.contents = SegmentFilename::CONTENTS_MANIFEST;
+   CHECK( segment.Filename() == "seg_30_patch2.manifest.json" );
+   CHECK( !filenames.count( segment.Filename() ) );
+}
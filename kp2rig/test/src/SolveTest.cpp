@@ -0,0 +1,221 @@
+#include <catch2/catch.hpp>
+
+#include <array>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "AnimatedRig.hpp"
+#include "KpMpii_16.hpp"
+#include "Metrics.hpp"
+#include "PoseFactory.hpp"
+#include "RigFileWriter.hpp"
+#include "RigSolver.hpp"
+#include "TestPoses.hpp"
+
+using namespace TestPoses;
+
+namespace
+{
+   // A walk across the pitch, with frames 20 to 22 missing so a gap is filled in
+   const int NUM_FRAMES = 60;
+   const int GAP_START = 20;
+   const int GAP_END = 22;
+
+   struct Setup
+   {
+      SMOOTH_TYPE type;
+      SMOOTH_DOMAIN domain;
+   };
+   std::vector< Setup > Setups()
+   {
+      std::vector< Setup > setups = {
+         Setup{ SMOOTH_TYPE_NONE, SMOOTH_DOMAIN_KEYPOINTS },
+         Setup{ SMOOTH_TYPE_ONE_EURO, SMOOTH_DOMAIN_KEYPOINTS },
+         Setup{ SMOOTH_TYPE_ONE_EURO, SMOOTH_DOMAIN_ROTATIONS } };
+      
+      // lpf_ipp needs IPP, which may not be built in
+      if ( SmoothFactory::Create( SMOOTH_TYPE_LPF_IPP ) )
+      {
+         setups.push_back( Setup{ SMOOTH_TYPE_LPF_IPP, SMOOTH_DOMAIN_KEYPOINTS } );
+         setups.push_back( Setup{ SMOOTH_TYPE_LPF_IPP, SMOOTH_DOMAIN_ROTATIONS } );
+      }
+      return setups;
+   }
+
+   
+   // Takes the walk through everything done to write it as one segment: adding each frame, publishing frame 2 live,
+   // filling in the gap, smoothing and writing. Returns the number of frames added.
+   int WriteWalk( AnimatedRig & ref_animatedRig,
+      const Setup & setup,
+      bool invalid )
+   {
+      std::map< KEYPOINT_TYPE, int > layout = MpiiLayout();
+      ref_animatedRig.BoneLengthFrames( 5, 0 );
+      ref_animatedRig.SmoothDomain( setup.domain );
+      ref_animatedRig.SmoothType( setup.type );
+      int numAdded = 0;
+      for ( int timestamp = 0; timestamp < NUM_FRAMES; ++timestamp )
+      {
+         if ( timestamp >= GAP_START && timestamp <= GAP_END )
+            continue;
+         std::unique_ptr< Pose > pose = invalid ? InvalidPose( layout, timestamp ) : RawPose( layout, timestamp );
+         ref_animatedRig.AddPose( pose );
+         ++numAdded;
+      }
+
+      // A preview solves the rig that's written, unless filtering keypoints replaces it
+      ref_animatedRig.PreviewRig( 2 );
+
+      ref_animatedRig.FixMissingFrames( 0, NUM_FRAMES - 1, 5 );
+      int rangeStart = 0, rangeEnd = NUM_FRAMES - 1;
+      ref_animatedRig.SmoothFrames( setup.type, rangeStart, rangeEnd, true );
+
+      RigFileWriter file( 0, NUM_FRAMES - 1, 30 );
+      file.BeginRig( "player", ref_animatedRig.Category(), "player" );
+      CHECK( ref_animatedRig.Write( file, 0, NUM_FRAMES - 1 ) == NUM_FRAMES - 1 );
+      file.EndRig();
+      return numAdded;
+   }
+}
+
+TEST_CASE( "frame_state", "[solve]" )
+{
+   std::map< KEYPOINT_TYPE, int > layout = MpiiLayout();
+   std::unique_ptr< Pose > pose = RawPose( layout, 0 );
+   CHECK( pose->State() == Pose::FRAME_STATE_RAW );
+
+   // Solved once, then the same rig is handed back
+   const uint64_t solves = Solves();
+   pose->GenerateRig();
+   CHECK( pose->State() == Pose::FRAME_STATE_SOLVED );
+   CHECK( pose->ValidateRig() );
+   pose->GenerateRig();
+   CHECK( Solves() == solves + 1 );
+
+   // Later states are kept, and so is the rig
+   PoseTestAccess::State( *pose, Pose::FRAME_STATE_FINAL );
+   pose->GenerateRig();
+   CHECK( Solves() == solves + 1 );
+
+   // New keypoints make the rig out of date
+   pose->Keypoint( pose->Keypoint( PELVIS ), PELVIS );
+   CHECK( pose->State() == Pose::FRAME_STATE_RAW );
+   pose->GenerateRig();
+   CHECK( pose->State() == Pose::FRAME_STATE_SOLVED );
+   CHECK( Solves() == solves + 2 );
+
+   // A pose made from a rig already has one, and copies keep the state
+   std::unique_ptr< Pose > fromRig = PoseFactory::FromRigPose( pose->RigPose(), "mpii", layout );
+   CHECK( fromRig->State() == Pose::FRAME_STATE_SOLVED );
+   std::unique_ptr< Pose > copy( fromRig->Clone() );
+   CHECK( copy->State() == Pose::FRAME_STATE_SOLVED );
+   copy->GenerateRig();
+   CHECK( Solves() == solves + 2 );
+}
+
+TEST_CASE( "changed_final_frames_are_raw", "[solve]" )
+{
+   // A frame ready to write is solved again once anything that can change its keypoints is called
+   std::map< KEYPOINT_TYPE, int > layout = MpiiLayout();
+   for ( bool coordinateSystem : { false, true } )
+   {
+      INFO( (coordinateSystem ? "Coordinate system" : "Keypoint") );
+      std::unique_ptr< Pose > pose = RawPose( layout, 0 );
+      pose->GenerateRig();
+      PoseTestAccess::State( *pose, Pose::FRAME_STATE_FINAL );
+      if ( coordinateSystem )
+         pose->CoordinateSystem( { 1.0, 1.0, -1.0 } );
+      else
+         pose->Keypoint( LEFT_WRIST )[ 1 ] += 0.1;
+      CHECK( pose->State() == Pose::FRAME_STATE_RAW );
+      
+      const uint64_t solves = Solves();
+      pose->GenerateRig();
+      CHECK( Solves() == solves + 1 );
+   }
+}
+
+TEST_CASE( "solve_once_per_frame", "[solve]" )
+{
+   for ( const Setup & setup : Setups() )
+   {
+      INFO( "Smoothing " << SmoothFactory::SmoothType( setup.type ) << " " << SmoothFactory::SmoothDomain( setup.domain ) );
+      const uint64_t solves = Solves();
+      const uint64_t framesWritten = FramesWritten();
+
+      AnimatedRig animatedRig;
+      const int numAdded = WriteWalk( animatedRig, setup, false );
+
+      // Each frame read is solved once, and filled-in frames are made from the rigs either side of the gap, so they
+      // aren't solved at all. Filtering keypoints replaces them, so then every frame written is solved from its
+      // filtered keypoints, on top of the frames solved before filtering: the one published live and either side of
+      // the gap.
+      const bool keypointsFiltered = setup.type == SMOOTH_TYPE_LPF_IPP && setup.domain == SMOOTH_DOMAIN_KEYPOINTS;
+      CHECK( FramesWritten() - framesWritten == (uint64_t)NUM_FRAMES );
+      CHECK( Solves() - solves == (uint64_t)(keypointsFiltered ? NUM_FRAMES + 3 : numAdded) );
+      CHECK( animatedRig.GetFrames().empty() );
+   }
+}
+
+TEST_CASE( "invalid_rigs_throw", "[solve]" )
+{
+   // Rigs are validated as they're solved, before smoothing changes them
+   for ( const Setup & setup : Setups() )
+   {
+      INFO( "Smoothing " << SmoothFactory::SmoothType( setup.type ) << " " << SmoothFactory::SmoothDomain( setup.domain ) );
+      AnimatedRig animatedRig;
+      CHECK_THROWS_WITH( WriteWalk( animatedRig, setup, true ), Catch::Contains( "Rig is invalid" ) );
+   }
+}
+
+TEST_CASE( "block_solve_matches_per_frame", "[solve]" )
+{
+   std::map< KEYPOINT_TYPE, int > layout = MpiiLayout();
+   std::vector< std::unique_ptr< Pose > > expected, block;
+   std::vector< Pose * > blockPoses;
+   for ( int timestamp = 0; timestamp < NUM_FRAMES; ++timestamp )
+   {
+      expected.emplace_back( RawPose( layout, timestamp ) );
+      expected.back()->GenerateRig();
+      block.emplace_back( RawPose( layout, timestamp ) );
+      blockPoses.push_back( block.back().get() );
+   }
+
+   // Solved twice, so the second call reuses the worker threads and scratch buffers of the first
+   for ( unsigned int numThreads : { 1u, 3u, 3u } )
+   {
+      INFO( numThreads << " threads" );
+      for ( auto pose : blockPoses )
+         pose->Keypoint( pose->Keypoint( PELVIS ), PELVIS );
+      const uint64_t solves = Solves();
+      RigSolver::Solve( blockPoses.data(), blockPoses.size(), numThreads );
+      CHECK( Solves() - solves == (uint64_t)NUM_FRAMES );
+
+      for ( int i = 0; i < NUM_FRAMES; ++i )
+      {
+         CHECK( block[ i ]->State() == Pose::FRAME_STATE_SOLVED );
+         CHECK( block[ i ]->RigPose().Timestamp() == i );
+         const Rig & lhs = expected[ i ]->RigPose().GetRig();
+         const Rig & rhs = block[ i ]->RigPose().GetRig();
+         for ( int axis = 0; axis < 3; ++axis )
+            CHECK( rhs.location[ axis ] == Approx( lhs.location[ axis ] ).margin( 1e-9 ) );
+         for ( int j = 0; j < lhs.numJointsUsed; ++j )
+         {
+            const Joint & expectedJoint = lhs.GetJoint( Rig::JOINT_TYPE( j ) );
+            const Joint & joint = rhs.GetJoint( Rig::JOINT_TYPE( j ) );
+            INFO( "Joint " << j );
+            CHECK( joint.length == Approx( expectedJoint.length ).margin( 1e-9 ) );
+            CHECK( joint.roll == Approx( expectedJoint.roll ).margin( 1e-9 ) );
+            for ( int k = 0; k < 4; ++k )
+            {
+               CHECK( joint.quaternion[ k ] == Approx( expectedJoint.quaternion[ k ] ).margin( 1e-9 ) );
+               CHECK( joint.quaternionAbs[ k ] == Approx( expectedJoint.quaternionAbs[ k ] ).margin( 1e-9 ) );
+            }
+            for ( int k = 0; k < 3; ++k )
+               CHECK( joint.offset[ k ] == Approx( expectedJoint.offset[ k ] ).margin( 1e-9 ) );
+         }
+      }
+   }
+}
@@ -0,0 +1,123 @@
+#include "TestPoses.hpp"
+
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+#include <json.hpp>
+#include "Compression.hpp"
+#include "KpMpii_16.hpp"
+#include "Metrics.hpp"
+#include "PoseFactory.hpp"
+
+namespace
+{
+   // A person standing with knees and elbows slightly bent, in meters, in the same order as "mpii" in kpDescriptor.json
+   const std::pair< const char *, std::array< double, 3 > > STANDING[] =
+   {
+      { "rightAnkle",    { -0.10, 0.10, 0.00 } },
+      { "rightKnee",     { -0.10, 0.55, 0.05 } },
+      { "rightHip",      { -0.10, 1.00, 0.00 } },
+      { "leftHip",       {  0.10, 1.00, 0.00 } },
+      { "leftKnee",      {  0.10, 0.55, 0.05 } },
+      { "leftAnkle",     {  0.10, 0.10, 0.00 } },
+      { "pelvis",        {  0.00, 1.00, 0.00 } },
+      { "baseNeck",      {  0.00, 1.50, 0.00 } },
+      { "baseHead",      {  0.00, 1.60, 0.00 } },
+      { "topHead",       {  0.00, 1.80, 0.00 } },
+      { "rightWrist",    { -0.28, 0.98, 0.10 } },
+      { "rightElbow",    { -0.25, 1.20, 0.02 } },
+      { "rightShoulder", { -0.18, 1.45, 0.00 } },
+      { "leftShoulder",  {  0.18, 1.45, 0.00 } },
+      { "leftElbow",     {  0.25, 1.20, 0.02 } },
+      { "leftWrist",     {  0.28, 0.98, 0.10 } }
+   };
+   const int NUM_KEYPOINTS = (int)(sizeof( STANDING ) / sizeof( STANDING[ 0 ] ));
+   
+   // An mpii pose whose rigs never pass validation
+   class InvalidMpiiPose : public KpMpii_16
+   {
+   public:
+      InvalidMpiiPose( const KpMpii_16 & rhs ) : KpMpii_16( rhs ) {}
+      virtual Pose * Clone() const { return new InvalidMpiiPose( *this ); }
+      virtual bool ValidateRig() const { return false; }
+   };
+   
+   // An mpii pose that can't be solved
+   class UnsolvableMpiiPose : public KpMpii_16
+   {
+   public:
+      UnsolvableMpiiPose( const KpMpii_16 & rhs ) : KpMpii_16( rhs ) {}
+      virtual Pose * Clone() const { return new UnsolvableMpiiPose( *this ); }
+   protected:
+      virtual void SolveExtremities() { throw std::runtime_error( "Pose can't be solved" ); }
+   };
+}
+
+std::map< KEYPOINT_TYPE, int > TestPoses::MpiiLayout()
+{
+   std::map< KEYPOINT_TYPE, int > layout;
+   for ( int i = 0; i < NUM_KEYPOINTS; ++i )
+      layout[ StrToKpType( STANDING[ i ].first ) ] = i;
+   return layout;
+}
+std::unique_ptr< Pose > TestPoses::RawPose( std::map< KEYPOINT_TYPE, int > & ref_layout,
+   int timestamp )
+{
+   std::unique_ptr< Pose > pose = PoseFactory::Create( "mpii", ref_layout );
+   pose->Name( "player" );
+   pose->Timestamp( timestamp );
+   for ( int i = 0; i < NUM_KEYPOINTS; ++i )
+   {
+      const std::array< double, 3 > & keypoint = STANDING[ i ].second;
+      pose->Keypoint( {
+         keypoint[ 0 ] + 0.05 * timestamp,
+         keypoint[ 1 ] + 0.02 * std::sin( 0.5 * timestamp ),
+         keypoint[ 2 ] },
+         i );
+   }
+   return pose;
+}
+std::unique_ptr< Pose > TestPoses::InvalidPose( std::map< KEYPOINT_TYPE, int > & ref_layout,
+   int timestamp )
+{
+   std::unique_ptr< Pose > pose = RawPose( ref_layout, timestamp );
+   return std::unique_ptr< Pose >( new InvalidMpiiPose( dynamic_cast< const KpMpii_16 & >( *pose ) ) );
+}
+std::unique_ptr< Pose > TestPoses::UnsolvablePose( std::map< KEYPOINT_TYPE, int > & ref_layout,
+   int timestamp )
+{
+   std::unique_ptr< Pose > pose = RawPose( ref_layout, timestamp );
+   return std::unique_ptr< Pose >( new UnsolvableMpiiPose( dynamic_cast< const KpMpii_16 & >( *pose ) ) );
+}
+uint64_t TestPoses::Solves()
+{
+   return Metrics::Instance().GetCounter( "kp2rig_solves_total" ).Value();
+}
+uint64_t TestPoses::FramesWritten()
+{
+   return Metrics::Instance().GetCounter( "kp2rig_frames_written_total" ).Value();
+}
+std::map< std::string, size_t > TestPoses::FramesInFile( const std::string & filename )
+{
+   std::ifstream file( filename );
+   if ( !file )
+      throw std::runtime_error( "Can't open '" + filename + "'" );
+   nlohmann::json json;
+   file >> json;
+   
+   // Every frame has a root location
+   std::map< std::string, size_t > frames;
+   for ( const auto & rig : json.at( "rigs" ) )
+   {
+      const std::string base64 = rig.value( "loc", "" );
+      std::vector< unsigned char > compressed;
+      const size_t size = Compression::DecodeBase64( reinterpret_cast< const unsigned char * >( base64.data() ), base64.size(), compressed );
+      std::vector< double > locations;
+      if ( size )
+         Compression::DecodeZfp( compressed.data(), size, locations );
+      frames[ rig.at( "id" ).get< std::string >() ] = locations.size() / 3;
+   }
+   return frames;
+}
@@ -0,0 +1,42 @@
+#ifndef TestPoses_hpp
+#define TestPoses_hpp
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include "Pose.hpp"
+
+// What only the pipeline can do to a pose otherwise
+class PoseTestAccess
+{
+public:
+   static void State( Pose & ref_pose,
+      Pose::FRAME_STATE state ) { ref_pose.State( state ); }
+};
+
+// Poses and counters shared by the tests
+namespace TestPoses
+{
+   // The keypoint layout of "mpii" in kpDescriptor.json
+   std::map< KEYPOINT_TYPE, int > MpiiLayout();
+   
+   // A pose with only keypoints, as an importer makes them: a person walking along and bobbing up and down
+   std::unique_ptr< Pose > RawPose( std::map< KEYPOINT_TYPE, int > & ref_layout,
+      int timestamp );
+   
+   // The same pose, but its rigs never pass validation
+   std::unique_ptr< Pose > InvalidPose( std::map< KEYPOINT_TYPE, int > & ref_layout,
+      int timestamp );
+   // The same pose, but solving its rig throws
+   std::unique_ptr< Pose > UnsolvablePose( std::map< KEYPOINT_TYPE, int > & ref_layout,
+      int timestamp );
+   
+   uint64_t Solves();
+   uint64_t FramesWritten();
+   
+   // Number of frames of each rig in the rig file @filename, by id
+   std::map< std::string, size_t > FramesInFile( const std::string & filename );
+}
+
+#endif
@@ -143,9 +143,69 @@ extern "C"{
    API_FUNC_DECLARE( API_TYPE_NAME( RETURN_CODE ) ) API_FUNC_NAME( read )( API_ARG_PREFIX
       API_TYPE_NAME( STRING ) url );
    
+   /* Read only some of the rigs in a JSON file. Same as read(), but callbacks are only made for the rigs in 'rigIds', and
+      only those rigs are decoded. 'url' may also be a manifest written by kp2rig --partition-by-rig, in which case only the
+      files holding those rigs are opened, so the rest cost nothing to skip. read() accepts manifests too, and reads every rig.
+      
+      Requires either OnBoundsDelegate or OnFrameDelegate be set to valid functions.
+   
+   Inputs:
+      url: url of the JSON rig file or manifest
+      rigIds: comma-separated rig ids, e.g. "player_5,player_9". Empty for every rig.
+   
+      Return value: BAD_PATH if any of 'rigIds' isn't in the file (the others are still read), otherwise most recent error code */
+   API_FUNC_DECLARE( API_TYPE_NAME( RETURN_CODE ) ) API_FUNC_NAME( readRigs )( API_ARG_PREFIX
+      API_TYPE_NAME( STRING ) url,
+      API_TYPE_NAME( STRING ) rigIds );
+   
+   /* Subscribe to a live feed of rigs published by kp2rig (see kp2rig --feed). This will create a thread in the background
+      and make a frame callback from that thread for every frame published from now on, as soon as it is published,
+      until stopRead() is called. Data is read straight from shared memory; there are no files involved.
+      The feed is a preview: frames are published before kp2rig can smooth them with lpf_ipp, so they can differ from its rig files.
+      If callbacks can't keep up, frames are skipped, and the OnErrorDelegate is called with FRAMES_DROPPED and the number
+      skipped. POSIX only.
+      
+      Requires OnFrameDelegate be set to a valid function.
+   
+   Inputs:
+      name: name of the feed, as passed to kp2rig --feed
+   
+      Return value: BAD_PATH if the feed doesn't exist, otherwise most recent error code */
+   API_FUNC_DECLARE( API_TYPE_NAME( RETURN_CODE ) ) API_FUNC_NAME( subscribe )( API_ARG_PREFIX
+      API_TYPE_NAME( STRING ) name );
+   
+   /* Follow a directory kp2rig is writing segments to (see kp2rig --outdir and --segsize). This will create threads in the background
+      and, from one of them, make bounds and frame callbacks for each segment once kp2rig has finished writing it, in order,
+      until stopRead() is called. A segment written with --partition-by-rig is read through its manifest, and patches of
+      late frames are delivered as they appear. Following starts with the newest segment already in the directory. Segments are decoded
+      ahead of the callbacks, so delivery continues without a pause from one segment to the next.
+      Partially written files are never read. A segment that can't be read is reported to the OnErrorDelegate and skipped.
+      
+      Requires either OnBoundsDelegate or OnFrameDelegate be set to valid functions.
+   
+   Inputs:
+      directory: the directory to follow
+      lookahead: how many segments may be decoded and waiting for callbacks, at least 1
+   
+      Return value: BAD_PATH if the directory doesn't exist, otherwise most recent error code */
+   API_FUNC_DECLARE( API_TYPE_NAME( RETURN_CODE ) ) API_FUNC_NAME( follow )( API_ARG_PREFIX
+      API_TYPE_NAME( STRING ) directory,
+      API_TYPE_NAME( INT ) lookahead );
+   
    /* Stop processing data, stop making callbacks, and destroy the thread. Blocks until everything is complete.
+      This also ends any subscription, and stops following any directory.
    */
    API_FUNC_DECLARE( API_TYPE_NAME( VOID ) ) API_FUNC_NAME( stopRead )( API_ARG_NONE );
+   
+   /* Gets timing for the most recent read() made on the calling thread. If the calling thread hasn't
+      called read(), this is the most recent read to complete on any thread, including reads from startRead().
+      Useful for finding out where load time goes: parsing, decoding, or your own callbacks.
+      
+      'stats' is a reference to an allocated structure that will be filled if the function exits normally.
+   
+      Return value: most recent error code, NO_MORE_DATA if nothing has been read yet */
+   API_FUNC_DECLARE( API_TYPE_NAME( RETURN_CODE ) ) API_FUNC_NAME( getReadStats )( API_ARG_PREFIX
+      API_TYPE_NAME( READ_STATS_REF ) stats );
 
 #if defined (__cplusplus)
 }
@@ -39,4 +39,14 @@ typedef API_TYPE_NAME( RETURN_CODE ) (*API_FUNC_NAME( readDelegate ))( API_ARG_P
    API_TYPE_NAME( STRING ) url );
 typedef API_TYPE_NAME( RETURN_CODE ) (*API_FUNC_NAME( startReadDelegate ))( API_ARG_PREFIX
    API_TYPE_NAME( STRING ) url );
+typedef API_TYPE_NAME( RETURN_CODE ) (*API_FUNC_NAME( readRigsDelegate ))( API_ARG_PREFIX
+   API_TYPE_NAME( STRING ) url,
+   API_TYPE_NAME( STRING ) rigIds );
+typedef API_TYPE_NAME( RETURN_CODE ) (*API_FUNC_NAME( subscribeDelegate ))( API_ARG_PREFIX
+   API_TYPE_NAME( STRING ) name );
+typedef API_TYPE_NAME( RETURN_CODE ) (*API_FUNC_NAME( followDelegate ))( API_ARG_PREFIX
+   API_TYPE_NAME( STRING ) directory,
+   API_TYPE_NAME( INT ) lookahead );
 typedef API_TYPE_NAME( VOID ) (*API_FUNC_NAME( stopReadDelegate ))( API_ARG_NONE );
+typedef API_TYPE_NAME( RETURN_CODE ) (*API_FUNC_NAME( getReadStatsDelegate ))( API_ARG_PREFIX
+   API_TYPE_NAME( READ_STATS_REF ) stats );
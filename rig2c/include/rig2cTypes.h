@@ -54,14 +54,29 @@ struct API_TYPE_NAME( JOINT )
    API_TYPE_NAME( INT ) index;
 };
 
+/* Timing of a single read, see getReadStats(). Times are in seconds */
+struct API_TYPE_NAME( READ_STATS )
+{
+   API_TYPE_NAME( DOUBLE ) totalTime;        /* The whole read */
+   API_TYPE_NAME( DOUBLE ) firstFrameTime;   /* From the start of the read until the first frame callback */
+   API_TYPE_NAME( DOUBLE ) parseTime;        /* Loading and parsing the JSON file, zero if it was already loaded */
+   API_TYPE_NAME( DOUBLE ) base64Time;       /* Decoding base64 strings */
+   API_TYPE_NAME( DOUBLE ) zfpTime;          /* Decompressing arrays */
+   API_TYPE_NAME( DOUBLE ) callbackTime;     /* Inside bounds and frame callbacks */
+   API_TYPE_NAME( INT ) numRigs;
+   API_TYPE_NAME( INT ) numFrames;           /* Number of frame callbacks made */
+};
+
 #if defined( __ANDROID__ ) && defined(RIG2C_API_JNI)
 
    /* Primitive types */
    typedef jobject API_TYPE_NAME( JOINT_REF );
+   typedef jobject API_TYPE_NAME( READ_STATS_REF );
    
 #else
 
    typedef struct API_TYPE_NAME( JOINT ) * API_TYPE_NAME( JOINT_REF );
+   typedef struct API_TYPE_NAME( READ_STATS ) * API_TYPE_NAME( READ_STATS_REF );
 
 #endif
 
@@ -76,6 +91,7 @@ typedef enum
    API_TYPE_NAME( API_NOT_INITIALIZED ) =    -5,
    API_TYPE_NAME( NO_CALLBACK ) =            -6,
    API_TYPE_NAME( NO_MORE_DATA ) =           -7,
+   API_TYPE_NAME( FRAMES_DROPPED ) =         -8,
    API_TYPE_NAME( UNKNOWN_ERROR ) =          -12345
 } API_TYPE_NAME( RETURN_CODE );
 
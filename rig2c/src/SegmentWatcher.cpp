@@ -0,0 +1,190 @@
+#include "SegmentWatcher.hpp"
+#include <climits>
+#include <stdexcept>
+#include <thread>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "SegmentFilename.hpp"
+#include "Utility.hpp"
+
+#ifdef __linux__
+   #include <poll.h>
+   #include <unistd.h>
+   #include <sys/inotify.h>
+#endif
+
+const int SegmentWatcher::SETTLE_MILLISECONDS;
+const int SegmentWatcher::CLOSE_TIMEOUT_MILLISECONDS;
+
+SegmentWatcher::SegmentWatcher( const std::string & directory )
+   : _directory( Utility::ExpandTilde( directory ) ),
+   _firstStartFrame( INT_MIN ),
+   _lastStartFrame( INT_MIN )
+{
+   if ( !Utility::IsDirectory( _directory ) )
+      throw std::runtime_error( "'" + directory + "' is not a directory" );
+
+#ifdef __linux__
+   // Without inotify we fall back to polling for files that stopped changing
+   _inotify = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+   if ( _inotify >= 0 &&
+      inotify_add_watch( _inotify, _directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO ) < 0 )
+   {
+      close( _inotify );
+      _inotify = -1;
+   }
+#endif
+
+   // Start with the newest segment already here, it was probably written before we started watching,
+   // along with its patches. Anything older is left alone from now on.
+   Scan();
+   if ( _candidates.size() )
+   {
+      _firstStartFrame = std::prev( _candidates.end() )->first.first;
+      _candidates.erase( _candidates.begin(), _candidates.lower_bound( Key( _firstStartFrame, 0 ) ) );
+      for ( auto & candidate : _candidates )
+         candidate.second.preexisting = true;
+   }
+}
+SegmentWatcher::~SegmentWatcher()
+{
+#ifdef __linux__
+   if ( _inotify >= 0 )
+      close( _inotify );
+#endif
+}
+bool SegmentWatcher::Next( std::string & out_filename,
+   int timeoutMilliseconds )
+{
+   const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds( timeoutMilliseconds );
+   while ( true )
+   {
+      // Polling has to look every time. With inotify, only once something was closed or moved here,
+      // or to make sure a file that could have settled really hasn't changed.
+      auto now = std::chrono::steady_clock::now();
+      if ( _inotify < 0 ||
+         _changed ||
+         (_candidates.size() && now >= SettleTime( _candidates.begin()->second )) )
+      {
+         Scan();
+         now = std::chrono::steady_clock::now();
+      }
+
+      // Segments are returned in order, so only the oldest matters
+      if ( _candidates.size() )
+      {
+         auto oldest = _candidates.begin();
+         const Candidate & candidate = oldest->second;
+         if ( candidate.closed ||
+            now >= SettleTime( candidate ) )
+         {
+            out_filename = candidate.filename;
+            if ( oldest->first.second )
+               _returnedPatches.insert( oldest->first );
+            else
+               _lastStartFrame = oldest->first.first;
+            _candidates.erase( oldest );
+            return true;
+         }
+      }
+
+      if ( now >= deadline )
+         return false;
+
+      // Polling wakes up regularly to look again, inotify when the oldest file could have settled
+      auto wake = deadline;
+      if ( _inotify < 0 )
+         wake = std::min( wake, now + std::chrono::milliseconds( 100 ) );
+      else if ( _candidates.size() )
+         wake = std::min( wake, SettleTime( _candidates.begin()->second ) );
+      const int wait = (int)std::chrono::duration_cast< std::chrono::milliseconds >( wake - now ).count();
+      ReadEvents( std::max( wait, 1 ) );
+   }
+}
+void SegmentWatcher::Scan()
+{
+   std::string directory = _directory;
+   std::vector< std::string > filenames = Utility::GetFiles( directory, "" );
+   const auto now = std::chrono::steady_clock::now();
+
+   std::set< Key > found;
+   for ( auto & filename : filenames )
+   {
+      // Partitioned segments are read through their manifest
+      SegmentFilename segment;
+      if ( !SegmentFilename::Parse( filename, segment ) ||
+         segment.contents == SegmentFilename::CONTENTS_RIG ||
+         segment.startFrame < _firstStartFrame )
+         continue;
+
+      // Patches come after the segment they patch, whenever they're written
+      const Key key( segment.startFrame, segment.patch );
+      if ( segment.patch ? _returnedPatches.count( key ) > 0 : segment.startFrame <= _lastStartFrame )
+         continue;
+
+      const std::string path = _directory + "/" + filename;
+      struct stat info;
+      if ( stat( path.c_str(), &info ) != 0 )
+         continue;
+
+      // Note when the file last changed
+      Candidate & candidate = _candidates[ key ];
+      if ( candidate.filename.empty() ||
+         candidate.size != (long long)info.st_size ||
+         candidate.modified != (long long)info.st_mtime )
+      {
+         candidate.filename = path;
+         candidate.size = (long long)info.st_size;
+         candidate.modified = (long long)info.st_mtime;
+         candidate.lastChange = now;
+      }
+      if ( _closedFilenames.count( filename ) )
+         candidate.closed = true;
+      found.insert( key );
+   }
+   _closedFilenames.clear();
+   _changed = false;
+
+   // Forget files that went away before they were finished
+   for ( auto it = _candidates.begin(); it != _candidates.end(); )
+   {
+      if ( found.count( (*it).first ) )
+         ++it;
+      else
+         it = _candidates.erase( it );
+   }
+}
+std::chrono::steady_clock::time_point SegmentWatcher::SettleTime( const Candidate & candidate ) const
+{
+   const bool canClose = _inotify >= 0 && !candidate.preexisting;
+   return candidate.lastChange + std::chrono::milliseconds( canClose ? CLOSE_TIMEOUT_MILLISECONDS : SETTLE_MILLISECONDS );
+}
+void SegmentWatcher::ReadEvents( int timeoutMilliseconds )
+{
+#ifdef __linux__
+   if ( _inotify >= 0 )
+   {
+      pollfd pollInfo = { _inotify, POLLIN, 0 };
+      if ( poll( &pollInfo, 1, timeoutMilliseconds ) <= 0 )
+         return;
+
+      // Remember every file closed after writing, or moved here
+      alignas( inotify_event ) char buffer[ 4096 ];
+      ssize_t length;
+      while ( (length = read( _inotify, buffer, sizeof( buffer ) )) > 0 )
+      {
+         for ( char * p = buffer; p < buffer + length; )
+         {
+            const inotify_event * event = reinterpret_cast< const inotify_event * >( p );
+            if ( event->len )
+               _closedFilenames.insert( event->name );
+            p += sizeof( inotify_event ) + event->len;
+         }
+         _changed = true;
+      }
+      return;
+   }
+#endif
+   std::this_thread::sleep_for( std::chrono::milliseconds( timeoutMilliseconds ) );
+}
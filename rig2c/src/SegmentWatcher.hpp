@@ -0,0 +1,60 @@
+#ifndef SegmentWatcher_hpp
+#define SegmentWatcher_hpp
+
+#include <map>
+#include <set>
+#include <string>
+#include <chrono>
+
+// Finds segments as kp2rig finishes writing them to a directory, in start frame order: seg_<startFrame>.json, or the
+// manifest of a partitioned segment (see SegmentFilename), followed by any patches to it as they are written.
+// A segment is finished once its writer closes it, or, where that can't be watched, once it stops changing.
+// Watching starts with the newest segment already in the directory; older segments are never returned,
+// and neither is anything that starts before the last segment returned, except patches.
+class SegmentWatcher
+{
+public:
+   // Throws if @directory isn't a directory
+   SegmentWatcher( const std::string & directory );
+   ~SegmentWatcher();
+   SegmentWatcher( const SegmentWatcher & ) = delete;
+   SegmentWatcher & operator=( const SegmentWatcher & ) = delete;
+
+   // Waits up to @timeoutMilliseconds for the next finished segment. Returns false if there isn't one yet.
+   bool Next( std::string & out_filename,
+      int timeoutMilliseconds );
+
+   // Files that haven't changed for this long are considered finished when their writer can't be watched
+   static const int SETTLE_MILLISECONDS = 500;
+   // Or when it can, but the file still hasn't been closed after this long, so one missed event can't hold back the rest
+   static const int CLOSE_TIMEOUT_MILLISECONDS = 5000;
+
+private:
+   struct Candidate
+   {
+      std::string filename;
+      long long size = -1;
+      long long modified = -1;
+      std::chrono::steady_clock::time_point lastChange;
+      bool closed = false;
+      bool preexisting = false;
+   };
+
+   // Start frame, then patch number
+   typedef std::pair< int, int > Key;
+
+   void Scan();
+   void ReadEvents( int timeoutMilliseconds );
+   std::chrono::steady_clock::time_point SettleTime( const Candidate & candidate ) const;
+
+   std::string _directory;
+   int _inotify = -1;
+   std::map< Key, Candidate > _candidates;
+   std::set< std::string > _closedFilenames;
+   bool _changed = false;
+   int _firstStartFrame;
+   int _lastStartFrame;
+   std::set< Key > _returnedPatches;
+};
+
+#endif
@@ -1,14 +1,24 @@
 #include "rig2c.h"
+#include <cstdlib>
 #include <fstream>
 #include <thread>
 #include <mutex>
 #include <sstream>
 #include <algorithm>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include <deque>
+#include <set>
+#include <condition_variable>
 #include <string.h>
 #include <json.hpp>
 #include "Compression.hpp"
 #include "Rig.hpp"
 #include "Utility.hpp"
+#include "Trace.hpp"
+#include "RigFeed.hpp"
+#include "SegmentWatcher.hpp"
 #include "config.h"
 
 // Global static variables
@@ -19,8 +29,30 @@ OnFrameDelegate g_frameDelegate = nullptr;
 void * g_platformContext = nullptr;
 bool g_stopReading = false;
 std::thread g_readThread;
+std::thread g_subscribeThread;
+std::atomic< bool > g_stopSubscription( false );
+std::thread g_followDecodeThread;
+std::thread g_followDeliverThread;
+std::atomic< bool > g_stopFollowing( false );
 nlohmann::json g_json;
 std::string g_currentJsonFilename;
+std::mutex g_readStatsMutex;
+API_TYPE_NAME( READ_STATS ) g_readStats;
+bool g_haveReadStats = false;
+thread_local API_TYPE_NAME( READ_STATS ) t_readStats;
+thread_local bool t_haveReadStats = false;
+
+// Adds the time spent in scope to @ref_seconds
+struct ScopedTimer
+{
+   ScopedTimer( double & ref_seconds )
+      : _seconds( ref_seconds ),
+      _start( std::chrono::steady_clock::now() ) {}
+   ~ScopedTimer() { _seconds += std::chrono::duration< double >( std::chrono::steady_clock::now() - _start ).count(); }
+private:
+   double & _seconds;
+   std::chrono::steady_clock::time_point _start;
+};
 
 API_TYPE_NAME( RETURN_CODE ) CheckVersion( std::string version )
 {
@@ -109,6 +141,446 @@ API_TYPE_NAME( RETURN_CODE ) ReadJson( std::string jsonFilename )
    return g_lastError;
 }
 
+// One rig from a rig file, decoded and ready for frame callbacks
+struct DecodedRig
+{
+   std::string rigId;
+   int startFrame = 0;
+   int endFrame = -1;
+   int numLengthsPerFrame = 0;
+   int numRotationsPerFrame = 0;
+   int numOffsetsPerFrame = 0;
+   std::vector< double > positions;
+   std::vector< double > lengths;
+   std::vector< double > rotations;
+   std::vector< double > offsets;
+};
+
+// Fills the name and bounds of @out_rig; the rig's own bounds override the file's
+void RigBounds( const nlohmann::json & rig,
+   const nlohmann::json & header,
+   DecodedRig & out_rig )
+{
+   out_rig.rigId = rig["name"].get<std::string>();
+   out_rig.startFrame = (int)header["startFrame"];
+   out_rig.endFrame = (int)header["endFrame"];
+   if ( rig.find("startFrame") != rig.end() )
+      out_rig.startFrame = (int)rig["startFrame"];
+   if ( rig.find("endFrame") != rig.end() )
+      out_rig.endFrame = (int)rig["endFrame"];
+}
+
+// Decodes the base64, zfp-compressed array @key of @rig
+size_t DecodeArray( const nlohmann::json & rig,
+   const char * key,
+   API_TYPE_NAME( READ_STATS ) & ref_stats,
+   std::vector< unsigned char > & ref_base64Data,
+   std::vector< double > & out_values )
+{
+   const nlohmann::json::string_t & encoded = rig[ key ].get_ref<const nlohmann::json::string_t&>();
+   size_t dataSize = encoded.size();
+   {
+      ScopedTimer timer( ref_stats.base64Time );
+      dataSize = Compression::DecodeBase64( (const unsigned char *)&encoded[0],
+         dataSize,
+         ref_base64Data );
+   }
+   {
+      ScopedTimer timer( ref_stats.zfpTime );
+      Compression::DecodeZfp( &ref_base64Data[0],
+         dataSize,
+         out_values );
+   }
+   return dataSize;
+}
+
+// Decodes the arrays of @rig into @ref_rig, whose bounds are already set.
+// On failure returns the error and sets @out_error.
+API_TYPE_NAME( RETURN_CODE ) DecodeRig( const nlohmann::json & rig,
+   const std::string & jsonFilename,
+   API_TYPE_NAME( READ_STATS ) & ref_stats,
+   DecodedRig & ref_rig,
+   std::string & out_error )
+{
+   std::vector< unsigned char > base64Data;
+   size_t dataSize = 0;
+   
+   // Decode locations
+   DecodeArray( rig, "loc", ref_stats, base64Data, ref_rig.positions );
+
+   // If we have lengths
+   auto arrayIt = rig.find("boneLen");
+   auto lengthIt = rig.find("numLen");
+   if ( arrayIt != rig.end() &&
+      lengthIt != rig.end() &&
+      (ref_rig.numLengthsPerFrame = (*lengthIt).get<int>()) > 0 )
+   {
+      // Grab 'em
+      DecodeArray( rig, "boneLen", ref_stats, base64Data, ref_rig.lengths );
+      
+      // Validate
+      if ( (int)ref_rig.lengths.size() < ref_rig.numLengthsPerFrame )
+      {
+         std::stringstream ss;
+         ss << "Decoded lengths size (" << ref_rig.lengths.size() << ") didn't match numLengthsPerFrame (" << ref_rig.numLengthsPerFrame << ") in "<< jsonFilename;
+         out_error = ss.str();
+         return API_TYPE_NAME( BAD_FILE_DATA );
+      }
+   }
+   
+   // If we have rotations
+   arrayIt = rig.find("boneRot");
+   lengthIt = rig.find("numRot");
+   if ( arrayIt != rig.end() &&
+      lengthIt != rig.end() &&
+      (ref_rig.numRotationsPerFrame = (*lengthIt).get<int>()) > 0 )
+   {
+      // Grab 'em
+      dataSize = DecodeArray( rig, "boneRot", ref_stats, base64Data, ref_rig.rotations );
+      
+      // Validate
+      if ( (int)ref_rig.rotations.size() < (ref_rig.numRotationsPerFrame * 4) )
+      {
+         std::stringstream ss;
+         ss << "Decoded rotations size (" << dataSize << ") didn't match numRotationsPerFrame*4 (" << ref_rig.numRotationsPerFrame*4 << ") in "<< jsonFilename;
+         out_error = ss.str();
+         return API_TYPE_NAME( BAD_FILE_DATA );
+      }
+      
+      // zfp is *approximate*, so sometimes quaternion components are outside the bounds [-1,1]
+      // Take care of that here
+      double * rotationsRaw = (double *)(&ref_rig.rotations[0]);
+      for ( int i = 0; i < (int)ref_rig.rotations.size(); ++i )
+         rotationsRaw[i] = CLIP(rotationsRaw[i]);
+   }
+   
+   // If we have offsets
+   arrayIt = rig.find("boneOff");
+   lengthIt = rig.find("numOff");
+   if ( arrayIt != rig.end() &&
+      lengthIt != rig.end() &&
+       (ref_rig.numOffsetsPerFrame = (*lengthIt).get<int>()) > 0 )
+   {
+      // Grab 'em
+      dataSize = DecodeArray( rig, "boneOff", ref_stats, base64Data, ref_rig.offsets );
+      
+      // Validate
+      if ( (int)ref_rig.offsets.size() < (ref_rig.numOffsetsPerFrame * 3) )
+      {
+         std::stringstream ss;
+         ss << "Decoded offsets data size (" << dataSize << ") didn't match numOffsetsPerFrame*3 (" << ref_rig.numOffsetsPerFrame*3 << ") in "<< jsonFilename;
+         out_error = ss.str();
+         return API_TYPE_NAME( BAD_FILE_DATA );
+      }
+   }
+   
+   return API_TYPE_NAME( NO_ERROR );
+}
+
+// Makes a frame callback for each frame of @rig until @stop is set. Returns the number of callbacks made.
+template< typename StopFlag >
+int DeliverFrames( const DecodedRig & rig,
+   OnFrameDelegate frameDelegate,
+   const StopFlag & stop )
+{
+   if ( !frameDelegate )
+      return 0;
+   
+   const int numFrames = rig.endFrame - rig.startFrame + 1;
+   int counter = 0;
+   while( !stop && counter < numFrames )
+   {
+      frameDelegate( rig.rigId.c_str(),
+         rig.startFrame + counter,
+         &rig.positions[ counter * Rig::LOCATION_DIMENSION ],
+         rig.numRotationsPerFrame ? &rig.rotations[ counter * rig.numRotationsPerFrame * 4 ] : nullptr,
+         rig.numRotationsPerFrame,
+         rig.numLengthsPerFrame ? &rig.lengths[ 0 ] : nullptr,
+         rig.numLengthsPerFrame,
+         rig.numOffsetsPerFrame ? &rig.offsets[ counter * rig.numOffsetsPerFrame * 3 ] : nullptr,
+         rig.numOffsetsPerFrame );
+      ++counter;
+   }
+   return counter;
+}
+
+// Every rig of a segment file, decoded ahead of delivery by follow()
+struct DecodedSegment
+{
+   std::string filename;
+   std::vector< DecodedRig > rigs;
+};
+
+// Reads and decodes every rig of @filename without touching the file loaded by read(), adding the time taken
+// to @ref_stats. @filename may be a manifest, whose rigs are read from the files it names.
+// On failure returns the error and sets @out_error.
+API_TYPE_NAME( RETURN_CODE ) DecodeSegment( const std::string & filename,
+   API_TYPE_NAME( READ_STATS ) & ref_stats,
+   DecodedSegment & out_segment,
+   std::string & out_error )
+{
+   std::ifstream i( filename );
+   if ( !i.good() )
+   {
+      out_error = "Could not open '" + filename + "'";
+      return API_TYPE_NAME( BAD_PATH );
+   }
+   
+   nlohmann::json json;
+   try
+   {
+      {
+         ScopedTimer timer( ref_stats.parseTime );
+         i >> json;
+      }
+      
+      // VERSION CHECK!!!
+      API_TYPE_NAME( RETURN_CODE ) returnValue = CheckVersion( json["version"] );
+      if ( API_TYPE_NAME( NO_ERROR ) != returnValue )
+      {
+         out_error = "Unsupported version in '" + filename + "'";
+         return returnValue;
+      }
+      
+      // Files named by a manifest are relative to it
+      const size_t lastSlash = filename.find_last_of( "/\\" );
+      const std::string directory = lastSlash == std::string::npos ? "" : filename.substr( 0, lastSlash + 1 );
+      
+      out_segment.filename = filename;
+      out_segment.rigs.clear();
+      for ( auto it = json["rigs"].begin(); it != json["rigs"].end(); ++it )
+      {
+         auto fileIt = (*it).find( "file" );
+         if ( fileIt != (*it).end() )
+         {
+            DecodedSegment part;
+            returnValue = DecodeSegment( directory + (*fileIt).get< std::string >(), ref_stats, part, out_error );
+            if ( API_TYPE_NAME( NO_ERROR ) != returnValue )
+               return returnValue;
+            for ( auto & rig : part.rigs )
+               out_segment.rigs.push_back( std::move( rig ) );
+            continue;
+         }
+         
+         out_segment.rigs.emplace_back();
+         DecodedRig & rig = out_segment.rigs.back();
+         RigBounds( *it, json["header"], rig );
+         returnValue = DecodeRig( *it, filename, ref_stats, rig, out_error );
+         if ( API_TYPE_NAME( NO_ERROR ) != returnValue )
+            return returnValue;
+      }
+   }
+   catch ( const std::exception & e )
+   {
+      out_error = "Could not parse '" + filename + "': " + e.what();
+      return API_TYPE_NAME( BAD_FILE_DATA );
+   }
+   
+   return API_TYPE_NAME( NO_ERROR );
+}
+
+// Makes the callbacks for the rigs of @url named in @rigIds, a comma-separated list, or for every rig if it's empty.
+// @url is either a rig file or a manifest, whose rigs name the rig file holding their data instead (see
+// kp2rig --partition-by-rig), in which case only the files of the rigs asked for are opened.
+API_TYPE_NAME( RETURN_CODE ) ReadRigs( API_TYPE_NAME( STRING ) url,
+   const std::string & rigIds )
+{
+   if ( g_lastError == API_TYPE_NAME( API_NOT_INITIALIZED ) )
+      return g_lastError;
+      
+   // We require at least on of these callbacks or what's the point?
+   if ( g_frameDelegate == nullptr && g_boundsDelegate == nullptr )
+   {
+      return API_TYPE_NAME( NO_CALLBACK );
+   }
+   
+   // Reset error
+   g_lastError = API_TYPE_NAME( NO_ERROR );
+   
+   // Get local references
+   // TODO: Not sure we need this
+   bool & stopReading = g_stopReading;
+   API_TYPE_NAME( RETURN_CODE ) & lastError = g_lastError;
+   OnErrorDelegate errorDelegate = g_errorDelegate;
+   OnBoundsDelegate boundsDelegate = g_boundsDelegate;
+   OnFrameDelegate frameDelegate = g_frameDelegate;
+   
+   // Time the whole read, and each step of it
+   TRACE_SCOPE_ARGS( "rig_read", "url", url ? url : "" );
+   API_TYPE_NAME( READ_STATS ) stats = {};
+   auto readStart = std::chrono::steady_clock::now();
+
+   // Try and read the JSON file
+   std::string jsonFilename = Utility::ExpandTilde( std::string( url ? url : "" ) );
+   {
+      TRACE_SCOPE( "rig_read parse" );
+      ScopedTimer timer( stats.parseTime );
+      ReadJson( jsonFilename );
+   }
+   if ( g_lastError != API_TYPE_NAME( NO_ERROR ) )
+      return g_lastError;
+      
+   // VERSION CHECK!!!
+   g_lastError = CheckVersion( g_json["version"] );
+   if ( API_TYPE_NAME( NO_ERROR ) != g_lastError )
+      return g_lastError;
+   
+   // The rigs asked for, if not all of them
+   std::set< std::string > requested;
+   std::set< std::string > found;
+   {
+      std::stringstream ss( rigIds );
+      std::string rigId;
+      while ( getline( ss, rigId, ',' ) )
+      {
+         if ( rigId.size() )
+            requested.insert( rigId );
+      }
+   }
+   
+   auto onBounds = [&]( const DecodedRig & rig )
+   {
+      if ( boundsDelegate )
+      {
+         ScopedTimer timer( stats.callbackTime );
+         boundsDelegate( rig.rigId.c_str(),
+            rig.startFrame,
+            rig.endFrame );
+      }
+      ++stats.numRigs;
+   };
+   auto onFrames = [&]( const DecodedRig & rig )
+   {
+      const int numFrames = rig.endFrame - rig.startFrame + 1;
+      if ( frameDelegate && stats.numFrames == 0 && numFrames > 0 )
+         stats.firstFrameTime = std::chrono::duration< double >( std::chrono::steady_clock::now() - readStart ).count();
+      ScopedTimer timer( stats.callbackTime );
+      stats.numFrames += DeliverFrames( rig, frameDelegate, stopReading );
+   };
+   
+   nlohmann::json::const_iterator it = g_json["rigs"].begin();
+   if ( it == g_json["rigs"].end() )
+   {
+      lastError = API_TYPE_NAME( BAD_FILE_DATA );
+      if ( errorDelegate )
+         errorDelegate( "", lastError, "No rigs defined in JSON file" );
+      return lastError;
+   }
+   
+   // Files named by a manifest are relative to it
+   const size_t lastSlash = jsonFilename.find_last_of( "/\\" );
+   const std::string directory = lastSlash == std::string::npos ? "" : jsonFilename.substr( 0, lastSlash + 1 );
+
+   // For each rig
+   for ( ; it != g_json["rigs"].end(); ++it )
+   {
+      if ( stopReading )
+         break;
+      
+      // Don't decode rigs nobody asked for
+      if ( requested.size() )
+      {
+         auto idIt = (*it).find( "id" );
+         if ( idIt == (*it).end() ||
+            requested.find( (*idIt).get< std::string >() ) == requested.end() )
+            continue;
+         found.insert( (*idIt).get< std::string >() );
+      }
+      
+      // A manifest entry, whose data is in a rig file of its own
+      auto fileIt = (*it).find( "file" );
+      if ( fileIt != (*it).end() )
+      {
+         DecodedSegment segment;
+         std::string error;
+         API_TYPE_NAME( RETURN_CODE ) returnValue = DecodeSegment( directory + (*fileIt).get< std::string >(),
+            stats,
+            segment,
+            error );
+         if ( returnValue != API_TYPE_NAME( NO_ERROR ) )
+         {
+            lastError = returnValue;
+            if ( errorDelegate )
+               errorDelegate( "", lastError, error.c_str() );
+            return lastError;
+         }
+         
+         for ( auto & rig : segment.rigs )
+         {
+            onBounds( rig );
+            onFrames( rig );
+         }
+         continue;
+      }
+      
+      // Get the character name and bounds
+      DecodedRig rig;
+      RigBounds( *it, g_json["header"], rig );
+      
+      // Make the bounds callback
+      onBounds( rig );
+
+      std::string error;
+      API_TYPE_NAME( RETURN_CODE ) returnValue = DecodeRig( *it, jsonFilename, stats, rig, error );
+      if ( returnValue != API_TYPE_NAME( NO_ERROR ) )
+      {
+         lastError = returnValue;
+         if ( errorDelegate )
+            errorDelegate( "", lastError, error.c_str() );
+         return lastError;
+      }
+      
+      // For each frame
+      onFrames( rig );
+   }
+   
+   // Keep the stats for this thread, and as the most recent read overall
+   stats.totalTime = std::chrono::duration< double >( std::chrono::steady_clock::now() - readStart ).count();
+   t_readStats = stats;
+   t_haveReadStats = true;
+   {
+      std::lock_guard< std::mutex > autoLock( g_readStatsMutex );
+      g_readStats = stats;
+      g_haveReadStats = true;
+   }
+   
+   // Everything there was is read, but some of what was asked for wasn't there
+   if ( !stopReading )
+   {
+      for ( auto & rigId : requested )
+      {
+         if ( found.find( rigId ) != found.end() )
+            continue;
+         lastError = API_TYPE_NAME( BAD_PATH );
+         if ( errorDelegate )
+            errorDelegate( rigId.c_str(), lastError, ("No rig '" + rigId + "' in '" + jsonFilename + "'").c_str() );
+      }
+      if ( lastError != API_TYPE_NAME( NO_ERROR ) )
+         return lastError;
+   }
+   
+   return API_TYPE_NAME( NO_ERROR );
+}
+
+// Segments decoded by follow()'s decoder thread, waiting for its delivery thread
+struct FollowQueue
+{
+   std::mutex mutex;
+   std::condition_variable changed;
+   std::deque< std::shared_ptr< DecodedSegment > > segments;
+   size_t lookahead = 1;
+};
+
+void StopFollowing()
+{
+   g_stopFollowing = true;
+   if ( g_followDecodeThread.joinable() )
+      g_followDecodeThread.join();
+   if ( g_followDeliverThread.joinable() )
+      g_followDeliverThread.join();
+   g_stopFollowing = false;
+}
+
 API_TYPE_NAME( RETURN_CODE ) API_CALLING_CONVENTION API_FUNC_NAME( initialize )( API_ARG_PREFIX
    API_TYPE_NAME( VOID_PTR ) platformContext )
 {
@@ -122,12 +594,20 @@ API_TYPE_NAME( RETURN_CODE ) API_CALLING_CONVENTION API_FUNC_NAME( initialize )(
    
    g_platformContext = platformContext;
 
+   // Builds with tracing record a timeline of reads when RIG2C_TRACE names an output file
+#ifdef WITH_TRACING
+   const char * traceFilename = getenv( "RIG2C_TRACE" );
+   if ( traceFilename && !Trace::IsEnabled() )
+      Trace::Start( traceFilename );
+#endif
+
    return g_lastError;
 }
 API_TYPE_NAME( VOID ) API_CALLING_CONVENTION API_FUNC_NAME( uninitialize )( API_ARG_NONE )
 {
    // Call stop as a good measure
    API_FUNC_NAME(stopRead)();
+   Trace::Stop();
    
    g_lastError = API_TYPE_NAME( API_NOT_INITIALIZED );
 }
@@ -161,7 +641,7 @@ API_TYPE_NAME( RETURN_CODE ) API_CALLING_CONVENTION API_FUNC_NAME( getRestPoseHu
    g_lastError = API_TYPE_NAME( NO_ERROR );
    
    // We only need to get the default humanoid pose once
-   static Rig restPose = Rig::RestPoseHumanoid();
+   const Rig & restPose = Rig::RestPoseHumanoid();
    Joint restPoseJoint;
    size_t jointIndex = 0;
    Rig::JOINT_TYPE jointType = Rig::GetJointType( previousName ? std::string( previousName ) : "" );
@@ -337,213 +817,207 @@ API_TYPE_NAME( RETURN_CODE ) API_CALLING_CONVENTION API_FUNC_NAME( startRead )(
 }
 API_TYPE_NAME( RETURN_CODE ) API_CALLING_CONVENTION API_FUNC_NAME( read )( API_ARG_PREFIX
    API_TYPE_NAME( STRING ) url )
+{
+   return ReadRigs( url, "" );
+}
+API_TYPE_NAME( RETURN_CODE ) API_CALLING_CONVENTION API_FUNC_NAME( readRigs )( API_ARG_PREFIX
+   API_TYPE_NAME( STRING ) url,
+   API_TYPE_NAME( STRING ) rigIds )
+{
+   return ReadRigs( url, rigIds ? rigIds : "" );
+}
+API_TYPE_NAME( VOID ) API_CALLING_CONVENTION API_FUNC_NAME( stopRead )( API_ARG_NONE )
+{
+   g_stopReading = false;
+   if ( g_readThread.joinable() )
+      g_readThread.join();
+   
+   g_stopSubscription = true;
+   if ( g_subscribeThread.joinable() )
+      g_subscribeThread.join();
+   g_stopSubscription = false;
+   
+   StopFollowing();
+}
+API_TYPE_NAME( RETURN_CODE ) API_CALLING_CONVENTION API_FUNC_NAME( subscribe )( API_ARG_PREFIX
+   API_TYPE_NAME( STRING ) name )
 {
    if ( g_lastError == API_TYPE_NAME( API_NOT_INITIALIZED ) )
       return g_lastError;
-      
-   // We require at least on of these callbacks or what's the point?
-   if ( g_frameDelegate == nullptr && g_boundsDelegate == nullptr )
-   {
-      return API_TYPE_NAME( NO_CALLBACK );
-   }
    
-   // Reset error
-   g_lastError = API_TYPE_NAME( NO_ERROR );
+   if ( g_frameDelegate == nullptr )
+      return API_TYPE_NAME( NO_CALLBACK );
    
-   // Get local references
-   // TODO: Not sure we need this
-   bool & stopReading = g_stopReading;
-   API_TYPE_NAME( RETURN_CODE ) & lastError = g_lastError;
-   OnErrorDelegate errorDelegate = g_errorDelegate;
-   OnBoundsDelegate boundsDelegate = g_boundsDelegate;
-   OnFrameDelegate frameDelegate = g_frameDelegate;
-
-   // Try and read the JSON file
-   std::string jsonFilename = Utility::ExpandTilde( std::string( url ? url : "" ) );
-   ReadJson( jsonFilename );
-   if ( g_lastError != API_TYPE_NAME( NO_ERROR ) )
-      return g_lastError;
-      
-   // VERSION CHECK!!!
-   g_lastError = CheckVersion( g_json["version"] );
-   if ( API_TYPE_NAME( NO_ERROR ) != g_lastError )
-      return g_lastError;
+   // Only one subscription at a time
+   g_stopSubscription = true;
+   if ( g_subscribeThread.joinable() )
+      g_subscribeThread.join();
+   g_stopSubscription = false;
    
-   nlohmann::json::const_iterator it = g_json["rigs"].begin();
-   if ( it == g_json["rigs"].end() )
+   // Open the feed here so the caller knows right away if it isn't there
+   std::shared_ptr< RigFeed::Subscriber > subscriber;
+   try
    {
-      lastError = API_TYPE_NAME( BAD_FILE_DATA );
-      if ( errorDelegate )
-         errorDelegate( "", lastError, "No rigs defined in JSON file" );
-      return lastError;
+      subscriber = std::make_shared< RigFeed::Subscriber >( name ? name : "" );
    }
-
-   // For each rig
-   for ( ; it != g_json["rigs"].end(); ++it )
+   catch ( std::runtime_error & e )
    {
-      if ( stopReading )
-         break;
-         
-      // Get the character name
-      std::string rigId = (*it)["name"].get<std::string>();
-      
-      // Determine character bounds
-      int startFrame = (int)g_json["header"]["startFrame"];
-      int endFrame = (int)g_json["header"]["endFrame"];
-      if ( (*it).find("startFrame") != (*it).end() )
-         startFrame = (int)(*it)["startFrame"];
-      if ( (*it).find("endFrame") != (*it).end() )
-         endFrame = (int)(*it)["endFrame"];
-      
-      // Make the bounds callback
-      if ( boundsDelegate )
-         boundsDelegate( rigId.c_str(),
-            startFrame,
-            endFrame );
-
-      size_t dataSize = 0;
-      std::vector< unsigned char > base64Data;
-      std::vector< double > positions;
-      std::vector< double > lengths;
-      std::vector< double > rotations;
-      std::vector< double > offsets;
-      
-      int numLengthsPerFrame = 0;
-      int numRotationsPerFrame = 0;
-      int numOffsetsPerFrame = 0;
-      
-      // Decode locations
-      dataSize = (*it)["loc"].get<std::string>().size();
-      dataSize = Compression::DecodeBase64( (const unsigned char *)&(*it)["loc"].get_ref<const nlohmann::json::string_t&>()[0],
-         dataSize,
-         base64Data );
-      Compression::DecodeZfp( &base64Data[0],
-         dataSize,
-         positions );
-
-      // If we have lengths
-      auto arrayIt = (*it).find("boneLen");
-      auto lengthIt = (*it).find("numLen");
-      if ( arrayIt != (*it).end() &&
-         lengthIt != (*it).end() &&
-         (numLengthsPerFrame = (*lengthIt).get<int>()) > 0 )
+      g_lastError = API_TYPE_NAME( BAD_PATH );
+      if ( g_errorDelegate )
+         g_errorDelegate( "", g_lastError, e.what() );
+      return g_lastError;
+   }
+   
+   OnFrameDelegate frameDelegate = g_frameDelegate;
+   OnErrorDelegate errorDelegate = g_errorDelegate;
+   g_subscribeThread = std::thread( [ subscriber, frameDelegate, errorDelegate ]
+   {
+      RigFeed::Frame frame;
+      uint64_t numDropped = 0;
+      while ( !g_stopSubscription )
       {
-         // Grab 'em
-         dataSize = (*it)["boneLen"].get<std::string>().size();
-         dataSize = Compression::DecodeBase64( (const unsigned char *)&(*it)["boneLen"].get_ref<const nlohmann::json::string_t&>()[0],
-            dataSize,
-            base64Data );
-         Compression::DecodeZfp( &base64Data[0],
-            dataSize,
-            lengths );
+         // Deliver everything published since we last looked, then wait a little
+         if ( !subscriber->Next( frame, numDropped ) )
+         {
+            std::this_thread::sleep_for( std::chrono::microseconds( 500 ) );
+            continue;
+         }
          
-         // Validate
-         if ( (int)lengths.size() < numLengthsPerFrame )
+         // We fell behind and the feed wrapped around
+         if ( numDropped && errorDelegate )
          {
-            lastError = API_TYPE_NAME( BAD_FILE_DATA );
-            if ( errorDelegate )
-            {
-               std::stringstream ss;
-               ss << "Decoded lengths size (" << lengths.size() << ") didn't match numLengthsPerFrame (" << numLengthsPerFrame << ") in "<< jsonFilename;
-               errorDelegate( "", lastError, ss.str().c_str() );
-            }
-            return lastError;
+            std::stringstream ss;
+            ss << "Couldn't keep up with the live feed, skipped " << numDropped << " frames";
+            errorDelegate( "", API_TYPE_NAME( FRAMES_DROPPED ), ss.str().c_str() );
          }
+         
+         frameDelegate( frame.rigId,
+            frame.timestamp,
+            frame.location,
+            frame.numRotations ? frame.rotations : nullptr,
+            frame.numRotations,
+            frame.numLengths ? frame.lengths : nullptr,
+            frame.numLengths,
+            frame.numOffsets ? frame.offsets : nullptr,
+            frame.numOffsets );
       }
-      
-      // If we have rotations
-      arrayIt = (*it).find("boneRot");
-      lengthIt = (*it).find("numRot");
-      if ( arrayIt != (*it).end() &&
-         lengthIt != (*it).end() &&
-         (numRotationsPerFrame = (*lengthIt).get<int>()) > 0 )
+   });
+   
+   return API_TYPE_NAME( NO_ERROR );
+}
+API_TYPE_NAME( RETURN_CODE ) API_CALLING_CONVENTION API_FUNC_NAME( follow )( API_ARG_PREFIX
+   API_TYPE_NAME( STRING ) directory,
+   API_TYPE_NAME( INT ) lookahead )
+{
+   if ( g_lastError == API_TYPE_NAME( API_NOT_INITIALIZED ) )
+      return g_lastError;
+   
+   if ( g_frameDelegate == nullptr && g_boundsDelegate == nullptr )
+      return API_TYPE_NAME( NO_CALLBACK );
+   
+   // Only one directory at a time
+   StopFollowing();
+   
+   // Open the directory here so the caller knows right away if it isn't there
+   std::shared_ptr< SegmentWatcher > watcher;
+   try
+   {
+      watcher = std::make_shared< SegmentWatcher >( directory ? directory : "" );
+   }
+   catch ( std::runtime_error & e )
+   {
+      g_lastError = API_TYPE_NAME( BAD_PATH );
+      if ( g_errorDelegate )
+         g_errorDelegate( "", g_lastError, e.what() );
+      return g_lastError;
+   }
+   
+   auto queue = std::make_shared< FollowQueue >();
+   queue->lookahead = (size_t)std::max( 1, (int)lookahead );
+   OnErrorDelegate errorDelegate = g_errorDelegate;
+   OnBoundsDelegate boundsDelegate = g_boundsDelegate;
+   OnFrameDelegate frameDelegate = g_frameDelegate;
+   
+   // Decode segments as they're finished, staying at most lookahead segments ahead of delivery
+   g_followDecodeThread = std::thread( [ watcher, queue, errorDelegate ]
+   {
+      std::string filename;
+      while ( !g_stopFollowing )
       {
-         // Grab 'em
-         dataSize = (*it)["boneRot"].get<std::string>().size();
-         dataSize = Compression::DecodeBase64( (const unsigned char *)&(*it)["boneRot"].get_ref<const nlohmann::json::string_t&>()[0],
-            dataSize,
-            base64Data );
-         Compression::DecodeZfp( &base64Data[0],
-            dataSize,
-            rotations );
+         if ( !watcher->Next( filename, 100 ) )
+            continue;
          
-         // Validate
-         if ( (int)rotations.size() < (numRotationsPerFrame * 4) )
+         auto segment = std::make_shared< DecodedSegment >();
+         std::string error;
+         API_TYPE_NAME( RETURN_CODE ) returnValue;
+         {
+            TRACE_SCOPE_ARGS( "rig_follow decode", "file", filename );
+            API_TYPE_NAME( READ_STATS ) stats = {};
+            returnValue = DecodeSegment( filename, stats, *segment, error );
+         }
+         if ( returnValue != API_TYPE_NAME( NO_ERROR ) )
          {
-            lastError = API_TYPE_NAME( BAD_FILE_DATA );
+            // Skip it, the next segment may be fine
             if ( errorDelegate )
-            {
-               std::stringstream ss;
-               ss << "Decoded rotations size (" << dataSize << ") didn't match numRotationsPerFrame*4 (" << numRotationsPerFrame*4 << ") in "<< jsonFilename;
-               errorDelegate( "", lastError, ss.str().c_str() );
-            }
-            return lastError;
+               errorDelegate( "", returnValue, error.c_str() );
+            continue;
          }
          
-         // zfp is *approximate*, so sometimes quaternion components are outside the bounds [-1,1]
-         // Take care of that here
-         double * rotationsRaw = (double *)(&rotations[0]);
-         for ( int i = 0; i < (int)rotations.size(); ++i )
-            rotationsRaw[i] = CLIP(rotationsRaw[i]);
+         std::unique_lock< std::mutex > lock( queue->mutex );
+         while ( !g_stopFollowing && queue->segments.size() >= queue->lookahead )
+            queue->changed.wait_for( lock, std::chrono::milliseconds( 100 ) );
+         queue->segments.push_back( segment );
+         queue->changed.notify_all();
       }
-      
-      // If we have offsets
-      arrayIt = (*it).find("boneOff");
-      lengthIt = (*it).find("numOff");
-      if ( arrayIt != (*it).end() &&
-         lengthIt != (*it).end() &&
-          (numOffsetsPerFrame = (*lengthIt).get<int>()) > 0 )
+   });
+   
+   // Deliver decoded segments in order
+   g_followDeliverThread = std::thread( [ queue, boundsDelegate, frameDelegate ]
+   {
+      while ( !g_stopFollowing )
       {
-         // Grab 'em
-         dataSize = (*it)["boneOff"].get<std::string>().size();
-         dataSize = Compression::DecodeBase64( (const unsigned char *)&(*it)["boneOff"].get_ref<const nlohmann::json::string_t&>()[0],
-            dataSize,
-            base64Data );
-         Compression::DecodeZfp( &base64Data[0],
-            dataSize,
-            offsets );
-         
-         // Validate
-         if ( (int)offsets.size() < (numOffsetsPerFrame * 3) )
+         std::shared_ptr< DecodedSegment > segment;
          {
-            lastError = API_TYPE_NAME( BAD_FILE_DATA );
-            if ( errorDelegate )
+            std::unique_lock< std::mutex > lock( queue->mutex );
+            if ( queue->segments.empty() )
             {
-               std::stringstream ss;
-               ss << "Decoded offsets data size (" << dataSize << ") didn't match numOffsetsPerFrame*3 (" << numOffsetsPerFrame*3 << ") in "<< jsonFilename;
-               errorDelegate( "", lastError, ss.str().c_str() );
+               queue->changed.wait_for( lock, std::chrono::milliseconds( 100 ) );
+               continue;
             }
-            return lastError;
+            segment = queue->segments.front();
+            queue->segments.pop_front();
+            queue->changed.notify_all();
          }
-      }
-      
-      // For each frame
-      const int numFrames = endFrame - startFrame + 1;
-      int counter = 0;
-      while( !stopReading && counter < numFrames )
-      {
-         if ( frameDelegate )
+         
+         for ( auto & rig : segment->rigs )
          {
-            frameDelegate( rigId.c_str(),
-               startFrame + counter,
-               &positions[ counter * Rig::LOCATION_DIMENSION ],
-               numRotationsPerFrame ? &rotations[ counter * numRotationsPerFrame * 4 ] : nullptr,
-               numRotationsPerFrame,
-               numLengthsPerFrame ? &lengths[ 0 ] : nullptr,
-               numLengthsPerFrame,
-               numOffsetsPerFrame ? &offsets[ counter * numOffsetsPerFrame * 3 ] : nullptr,
-               numOffsetsPerFrame );
+            if ( g_stopFollowing )
+               break;
+            if ( boundsDelegate )
+               boundsDelegate( rig.rigId.c_str(), rig.startFrame, rig.endFrame );
+            DeliverFrames( rig, frameDelegate, g_stopFollowing );
          }
-   
-         ++counter;
       }
-   }
+   });
    
    return API_TYPE_NAME( NO_ERROR );
 }
-API_TYPE_NAME( VOID ) API_CALLING_CONVENTION API_FUNC_NAME( stopRead )( API_ARG_NONE )
+API_TYPE_NAME( RETURN_CODE ) API_CALLING_CONVENTION API_FUNC_NAME( getReadStats )( API_ARG_PREFIX
+   API_TYPE_NAME( READ_STATS_REF ) stats )
 {
-   g_stopReading = false;
-   if ( g_readThread.joinable() )
-      g_readThread.join();
+   if ( g_lastError == API_TYPE_NAME( API_NOT_INITIALIZED ) )
+      return g_lastError;
+   
+   if ( t_haveReadStats )
+   {
+      *stats = t_readStats;
+      return API_TYPE_NAME( NO_ERROR );
+   }
+   
+   std::lock_guard< std::mutex > autoLock( g_readStatsMutex );
+   if ( !g_haveReadStats )
+      return API_TYPE_NAME( NO_MORE_DATA );
+   
+   *stats = g_readStats;
+   return API_TYPE_NAME( NO_ERROR );
 }
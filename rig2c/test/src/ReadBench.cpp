@@ -0,0 +1,240 @@
+#include <catch2/catch.hpp>
+
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <json.hpp>
+#include "rig2cDelegates.h"
+#include "Utility.hpp"
+#include "Compression.hpp"
+#include "ReadBench.hpp"
+
+#ifdef __linux__
+   #include <fcntl.h>
+   #include <unistd.h>
+#endif
+
+double g_benchMinutes = 90;
+int g_benchReaders = 4;
+
+// Frame callback that touches the data, but otherwise does as little as possible
+static thread_local double t_checksum = 0;
+static void OnBenchFrame( const char * rigId,
+   int frameTimestamp,
+   const double * locationXYZ,
+   const double * boneRotations,
+   int numBoneRotations,
+   const double * boneLengths,
+   int numBoneLengths,
+   const double * boneOffsets,
+   int numBoneOffsets )
+{
+   (void)rigId; (void)frameTimestamp; (void)boneLengths; (void)numBoneLengths; (void)boneOffsets; (void)numBoneOffsets;
+   t_checksum += locationXYZ[ 0 ];
+   if ( numBoneRotations )
+      t_checksum += boneRotations[ 0 ];
+}
+
+static std::vector< double > DecodeArray( const std::string & base64 )
+{
+   std::vector< unsigned char > compressed;
+   std::vector< double > returnValue;
+   size_t dataSize = Compression::DecodeBase64( (const unsigned char *)base64.data(), base64.size(), compressed );
+   Compression::DecodeZfp( compressed.data(), dataSize, returnValue );
+   return returnValue;
+}
+static std::string EncodeArray( std::vector< double > & array )
+{
+   std::vector< uint8_t > compressed( array.size() * sizeof(double) + 1024 );
+   size_t compressedSize = compressed.size();
+   Compression::EncodeZfp( array.data(), array.size(), compressed.data(), compressedSize );
+   std::vector< unsigned char > base64;
+   size_t base64Size = Compression::EncodeBase64( compressed.data(), compressedSize, base64 );
+   return std::string( reinterpret_cast< char * >(base64.data()), base64Size );
+}
+
+// Writes a copy of the rig file at @url where every rig's animation is repeated @numRepeats times.
+// Returns the number of bytes written.
+static size_t WriteRepeated( const std::string & url,
+   const std::string & filename,
+   int numRepeats )
+{
+   nlohmann::json json;
+   std::ifstream( url ) >> json;
+   
+   int startFrame = json["header"]["startFrame"];
+   int endFrame = json["header"]["endFrame"];
+   int numFrames = endFrame - startFrame + 1;
+   
+   for ( auto & rig : json["rigs"] )
+   {
+      int rigStart = rig.find( "startFrame" ) != rig.end() ? (int)rig["startFrame"] : startFrame;
+      int rigEnd = rig.find( "endFrame" ) != rig.end() ? (int)rig["endFrame"] : endFrame;
+      
+      // Lengths are one set per rig, everything else is per-frame
+      for ( auto key : { "loc", "boneRot", "boneOff" } )
+      {
+         if ( rig.find( key ) == rig.end() )
+            continue;
+         std::vector< double > array = DecodeArray( rig[ key ] );
+         size_t frameSize = array.size() / (rigEnd - rigStart + 1);
+         array.resize( frameSize * (rigEnd - rigStart + 1) );
+         std::vector< double > repeated;
+         repeated.reserve( array.size() * numRepeats );
+         for ( int i = 0; i < numRepeats; ++i )
+            repeated.insert( repeated.end(), array.begin(), array.end() );
+         rig[ key ] = EncodeArray( repeated );
+      }
+      
+      if ( rig.find( "endFrame" ) != rig.end() )
+         rig["endFrame"] = rigStart + (rigEnd - rigStart + 1) * numRepeats - 1;
+      else
+         rig["endFrame"] = rigStart + numFrames * numRepeats - 1;
+   }
+   json["header"]["endFrame"] = startFrame + numFrames * numRepeats - 1;
+   
+   std::string data = json.dump();
+   std::ofstream( filename, std::ios::binary ) << data;
+   return data.size();
+}
+
+// Removes @filename from the OS file cache, if we can
+static bool DropFromFileCache( const std::string & filename )
+{
+#ifdef __linux__
+   int fd = open( filename.c_str(), O_RDONLY );
+   if ( fd < 0 )
+      return false;
+   fdatasync( fd );
+   bool returnValue = posix_fadvise( fd, 0, 0, POSIX_FADV_DONTNEED ) == 0;
+   close( fd );
+   return returnValue;
+#else
+   (void)filename;
+   return false;
+#endif
+}
+
+static void PrintHeader()
+{
+   printf( "%-10s %9s %-6s %7s %10s %10s %12s %7s %7s %7s %7s\n",
+      "frames", "MB", "cache", "readers", "first ms", "total ms", "frames/s", "parse", "base64", "zfp", "cb" );
+}
+static void PrintStats( const rig_READ_STATS & stats,
+   size_t numBytes,
+   const char * cache,
+   int numReaders,
+   int totalFrames,
+   double wallTime )
+{
+   double total = stats.totalTime > 0 ? stats.totalTime : 1;
+   printf( "%-10d %9.1f %-6s %7d %10.2f %10.2f %12.0f %6.1f%% %6.1f%% %6.1f%% %6.1f%%\n",
+      totalFrames,
+      numBytes / 1e6,
+      cache,
+      numReaders,
+      stats.firstFrameTime * 1e3,
+      wallTime * 1e3,
+      totalFrames / wallTime,
+      100 * stats.parseTime / total,
+      100 * stats.base64Time / total,
+      100 * stats.zfpTime / total,
+      100 * stats.callbackTime / total );
+}
+
+// Hidden by default, run with: rig2cTest --url <file> "[bench]"
+TEST_CASE( "read_benchmark", "[.][bench]" )
+{
+   const std::string jsonFilename = g_url;
+   
+   Utility * utility = Utility::GetInstance();
+   REQUIRE_NOTHROW( utility->LoadLib() );
+   auto initialize = rig_initializeDelegate( utility->GetFunctions()[ "rig_initialize" ] );
+   auto setFrameCallback = rig_setFrameCallbackDelegate( utility->GetFunctions()[ "rig_setFrameCallback" ] );
+   auto read = rig_readDelegate( utility->GetFunctions()[ "rig_read" ] );
+   auto getReadStats = rig_getReadStatsDelegate( utility->GetFunctions()[ "rig_getReadStats" ] );
+   
+   // Work out how many times the segment repeats to make each duration we test
+   nlohmann::json header;
+   {
+      nlohmann::json json;
+      std::ifstream( jsonFilename ) >> json;
+      header = json["header"];
+   }
+   int segmentFrames = (int)header["endFrame"] - (int)header["startFrame"] + 1;
+   double fps = header["fps"];
+   std::vector< int > repeats = { 1 };
+   for ( double minutes : { 1.0, 10.0, 90.0 } )
+   {
+      int numRepeats = (int)std::ceil( std::min( minutes, g_benchMinutes ) * 60 * fps / segmentFrames );
+      if ( numRepeats > repeats.back() )
+         repeats.push_back( numRepeats );
+   }
+   
+   PrintHeader();
+   for ( int numRepeats : repeats )
+   {
+      std::string filename = "rig2cBench.json";
+      size_t numBytes = WriteRepeated( jsonFilename, filename, numRepeats );
+      
+      // Cold: not in the OS file cache, not loaded by rig2c.
+      // Warm: in the OS file cache, not loaded by rig2c.
+      // Loaded: already parsed by rig2c from a previous read.
+      const char * caches[] = { "cold", "warm", "loaded" };
+      for ( auto cache : caches )
+      {
+         if ( cache == caches[ 0 ] && !DropFromFileCache( filename ) )
+            continue;
+         if ( cache != caches[ 2 ] )
+         {
+            REQUIRE( initialize( nullptr ) == rig_NO_ERROR );
+            setFrameCallback( OnBenchFrame );
+         }
+         
+         auto start = std::chrono::steady_clock::now();
+         REQUIRE( read( filename.c_str() ) == rig_NO_ERROR );
+         double wallTime = std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count();
+         
+         rig_READ_STATS stats;
+         REQUIRE( getReadStats( &stats ) == rig_NO_ERROR );
+         PrintStats( stats, numBytes, cache, 1, stats.numFrames, wallTime );
+      }
+      
+      // Concurrent readers of the same, already loaded, file
+      for ( int numReaders = 2; numReaders <= g_benchReaders; numReaders *= 2 )
+      {
+         std::vector< std::thread > readers;
+         std::vector< rig_READ_STATS > stats( numReaders );
+         auto start = std::chrono::steady_clock::now();
+         for ( int i = 0; i < numReaders; ++i )
+         {
+            readers.emplace_back( [&, i]
+            {
+               read( filename.c_str() );
+               getReadStats( &stats[ i ] );
+            });
+         }
+         for ( auto & reader : readers )
+            reader.join();
+         double wallTime = std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count();
+         
+         // Report the slowest reader's breakdown, and the total throughput
+         int totalFrames = 0;
+         size_t slowest = 0;
+         for ( size_t i = 0; i < stats.size(); ++i )
+         {
+            totalFrames += stats[ i ].numFrames;
+            if ( stats[ i ].totalTime > stats[ slowest ].totalTime )
+               slowest = i;
+         }
+         PrintStats( stats[ slowest ], numBytes, "loaded", numReaders, totalFrames, wallTime );
+      }
+      
+      std::remove( filename.c_str() );
+   }
+   
+   utility->CloseLib();
+}
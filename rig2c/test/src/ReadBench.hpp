@@ -0,0 +1,8 @@
+#ifndef ReadBench_hpp
+#define ReadBench_hpp
+
+// Options for the read benchmark (see main.cpp)
+extern double g_benchMinutes;
+extern int g_benchReaders;
+
+#endif /* ReadBench_hpp */
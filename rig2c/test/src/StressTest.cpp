@@ -8,14 +8,22 @@
 #include <functional>
 #include <vector>
 #include <unordered_map>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <json.hpp>
 #include "rig2cDelegates.h"
 #include "Utility.hpp"
 #include "Callbacks.hpp"
+#include "RigFeed.hpp"
 
 #ifdef _WIN32
    #include <direct.h>
    #define getcwd _getcwd
 #else
+   #include <fcntl.h>
+   #include <sys/mman.h>
    #include <unistd.h>
 #endif
 
@@ -175,6 +183,31 @@ TEST_CASE( "basic", "[basic]" )
       utility->CloseLib();
    }
    
+   SECTION( "read_stats" )
+   {
+      const std::string jsonFilename = g_url;
+      Callbacks::numFrameCallbacks = 0;
+      
+      Utility * utility = Utility::GetInstance();
+      
+      REQUIRE_NOTHROW( utility->LoadLib() );
+      
+      // Initialize the lib
+      CHECK( (rig_initializeDelegate(utility->GetFunctions()[ "rig_initialize" ]))( nullptr ) == rig_NO_ERROR );
+      (rig_setFrameCallbackDelegate(utility->GetFunctions()[ "rig_setFrameCallback" ]))( Callbacks::OnFrame );
+      
+      // Stats should match what we received
+      rig_READ_STATS stats;
+      CHECK( (rig_readDelegate(utility->GetFunctions()[ "rig_read" ]))( jsonFilename.c_str() ) == rig_NO_ERROR );
+      CHECK( (rig_getReadStatsDelegate(utility->GetFunctions()[ "rig_getReadStats" ]))( &stats ) == rig_NO_ERROR );
+      CHECK( stats.numFrames == Callbacks::numFrameCallbacks );
+      CHECK( stats.numRigs > 0 );
+      CHECK( stats.totalTime >= stats.parseTime + stats.base64Time + stats.zfpTime );
+      CHECK( stats.firstFrameTime <= stats.totalTime );
+      
+      utility->CloseLib();
+   }
+   
    SECTION( "only_frame_callback" )
    {
       const std::string jsonFilename = g_url;
@@ -199,6 +232,292 @@ TEST_CASE( "basic", "[basic]" )
       
       utility->CloseLib();
    }
+   
+   SECTION( "read_rigs" )
+   {
+      // Split the rig file into one file per rig, with a manifest naming them
+      nlohmann::json json;
+      std::ifstream( g_url ) >> json;
+      REQUIRE( json["rigs"].size() > 1 );
+      nlohmann::json manifest = json;
+      manifest["rigs"] = nlohmann::json::array();
+      std::vector< std::string > filenames;
+      for ( auto & rig : json["rigs"] )
+      {
+         nlohmann::json rigFile = json;
+         rigFile["rigs"] = nlohmann::json::array( { rig } );
+         filenames.push_back( "rig2cTest_" + rig["id"].get< std::string >() + ".json" );
+         std::ofstream( filenames.back() ) << rigFile;
+         manifest["rigs"].push_back( { { "id", rig["id"] }, { "type", rig["type"] }, { "name", rig["name"] }, { "file", filenames.back() } } );
+      }
+      const std::string manifestFilename = "rig2cTest.manifest.json";
+      std::ofstream( manifestFilename ) << manifest;
+      const std::string firstId = json["rigs"][0]["id"];
+      const std::string lastId = json["rigs"].back()["id"];
+      
+      Utility * utility = Utility::GetInstance();
+      
+      REQUIRE_NOTHROW( utility->LoadLib() );
+      
+      rig_readRigsDelegate readRigs = rig_readRigsDelegate(utility->GetFunctions()[ "rig_readRigs" ]);
+      CHECK( (rig_initializeDelegate(utility->GetFunctions()[ "rig_initialize" ]))( nullptr ) == rig_NO_ERROR );
+      
+      static std::set< std::string > rigIds;
+      static int numFrames;
+      (rig_setFrameCallbackDelegate(utility->GetFunctions()[ "rig_setFrameCallback" ]))( []( auto rigId, auto frameTimestamp, auto locationXYZ, auto boneRotations, auto numBoneRotations, auto boneLengths, auto numBoneLengths, auto boneOffsets, auto numBoneOffsets )
+      {
+         Callbacks::OnFrame( rigId, frameTimestamp, locationXYZ, boneRotations, numBoneRotations, boneLengths, numBoneLengths, boneOffsets, numBoneOffsets );
+         rigIds.insert( rigId );
+         ++numFrames;
+      } );
+      
+      // Every rig, from the file and from the manifest
+      rigIds.clear();
+      numFrames = 0;
+      CHECK( (rig_readDelegate(utility->GetFunctions()[ "rig_read" ]))( g_url.c_str() ) == rig_NO_ERROR );
+      const size_t numRigs = rigIds.size();
+      const int allFrames = numFrames;
+      CHECK( numRigs == json["rigs"].size() );
+      
+      rigIds.clear();
+      numFrames = 0;
+      CHECK( (rig_readDelegate(utility->GetFunctions()[ "rig_read" ]))( manifestFilename.c_str() ) == rig_NO_ERROR );
+      CHECK( rigIds.size() == numRigs );
+      CHECK( numFrames == allFrames );
+      
+      // Only the rigs asked for, from either
+      for ( auto & url : { g_url, manifestFilename } )
+      {
+         rigIds.clear();
+         numFrames = 0;
+         CHECK( readRigs( url.c_str(), (firstId + "," + lastId).c_str() ) == rig_NO_ERROR );
+         CHECK( rigIds == std::set< std::string >( { firstId, lastId } ) );
+         CHECK( numFrames < allFrames );
+      }
+      
+      // Only the manifest's file for that rig is opened
+      remove( filenames.back().c_str() );
+      rigIds.clear();
+      CHECK( readRigs( manifestFilename.c_str(), firstId.c_str() ) == rig_NO_ERROR );
+      CHECK( rigIds == std::set< std::string >( { firstId } ) );
+      CHECK( readRigs( manifestFilename.c_str(), lastId.c_str() ) == rig_BAD_PATH );
+      
+      // Rigs that aren't there are an error, the rest are still read
+      rigIds.clear();
+      CHECK( readRigs( g_url.c_str(), (firstId + ",nobody").c_str() ) == rig_BAD_PATH );
+      CHECK( rigIds == std::set< std::string >( { firstId } ) );
+      
+      (rig_uninitializeDelegate(utility->GetFunctions()[ "rig_uninitialize" ]))();
+      utility->CloseLib();
+      
+      for ( auto & filename : filenames )
+         remove( filename.c_str() );
+      remove( manifestFilename.c_str() );
+   }
+   
+#ifndef _WIN32
+   SECTION( "live_feed" )
+   {
+      const std::string feedName = "/rig2cTest_" + std::to_string( getpid() );
+      static std::atomic< int > numFrames( 0 );
+      static std::atomic< int > lastTimestamp( -1 );
+      static std::atomic< int > numDropped( 0 );
+      static std::atomic< bool > slowCallbacks( false );
+      numFrames = 0;
+      numDropped = 0;
+      slowCallbacks = false;
+      
+      Utility * utility = Utility::GetInstance();
+      
+      REQUIRE_NOTHROW( utility->LoadLib() );
+      
+      rig_RETURN_CODE returnValue = rig_NO_ERROR;
+      
+      // Initialize the lib
+      returnValue = (rig_initializeDelegate(utility->GetFunctions()[ "rig_initialize" ]))( nullptr );
+      CHECK( returnValue == rig_NO_ERROR );
+      
+      (rig_setFrameCallbackDelegate(utility->GetFunctions()[ "rig_setFrameCallback" ]))( []( auto rigId, auto frameTimestamp, auto locationXYZ, auto boneRotations, auto numBoneRotations, auto boneLengths, auto numBoneLengths, auto boneOffsets, auto numBoneOffsets )
+      {
+         Callbacks::OnFrame( rigId, frameTimestamp, locationXYZ, boneRotations, numBoneRotations, boneLengths, numBoneLengths, boneOffsets, numBoneOffsets );
+         lastTimestamp = frameTimestamp;
+         ++numFrames;
+         if ( slowCallbacks )
+            std::this_thread::sleep_for( std::chrono::milliseconds( 5 ) );
+      } );
+      
+      // No feed to subscribe to yet
+      returnValue = (rig_subscribeDelegate(utility->GetFunctions()[ "rig_subscribe" ]))( feedName.c_str() );
+      CHECK( returnValue == rig_BAD_PATH );
+      
+      // Frames skipped are reported to the error callback
+      (rig_setErrorCallbackDelegate(utility->GetFunctions()[ "rig_setErrorCallback" ]))( []( auto rigId, auto errorCode, auto description )
+      {
+         (void)rigId;
+         if ( errorCode == rig_FRAMES_DROPPED )
+            numDropped += std::stoi( std::string( description ).substr( std::string( description ).find( "skipped " ) + 8 ) );
+         else
+            Callbacks::OnError( rigId, errorCode, description );
+      } );
+      
+      {
+         RigFeed::Publisher publisher( feedName, 16 );
+         returnValue = (rig_subscribeDelegate(utility->GetFunctions()[ "rig_subscribe" ]))( feedName.c_str() );
+         REQUIRE( returnValue == rig_NO_ERROR );
+         
+         // Publish at a steady rate; every frame should arrive, in order, shortly after
+         const int numPublished = 100;
+         for ( int i = 0; i < numPublished; ++i )
+         {
+            publisher.Publish( "feed_test", i, Rig::DefaultPoseHumanoid() );
+            std::this_thread::sleep_for( std::chrono::milliseconds( 2 ) );
+         }
+         for ( int i = 0; i < 100 && numFrames < numPublished; ++i )
+            std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+         CHECK( numFrames == numPublished );
+         CHECK( lastTimestamp == numPublished - 1 );
+         CHECK( numDropped == 0 );
+         
+         // A burst that callbacks can't keep up with wraps the ring; what's skipped is reported
+         slowCallbacks = true;
+         const int numBurst = 64;
+         for ( int i = 0; i < numBurst; ++i )
+            publisher.Publish( "feed_test", numPublished + i, Rig::DefaultPoseHumanoid() );
+         for ( int i = 0; i < 100 && numFrames + numDropped < numPublished + numBurst; ++i )
+            std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+         
+         (rig_stopReadDelegate(utility->GetFunctions()[ "rig_stopRead" ]))();
+         CHECK( numDropped > 0 );
+         CHECK( numFrames + numDropped == numPublished + numBurst );
+         CHECK( lastTimestamp == numPublished + numBurst - 1 );
+      }
+      
+      (rig_uninitializeDelegate(utility->GetFunctions()[ "rig_uninitialize" ]))();
+      utility->CloseLib();
+      
+      if ( !Callbacks::errorString.empty() )
+         FAIL( Callbacks::errorString );
+   }
+   
+   SECTION( "live_feed_stuck_slot" )
+   {
+      // A slot left mid-write, as by a publisher that died, is given up on rather than read forever
+      const std::string feedName = "/rig2cTest_stuck_" + std::to_string( getpid() );
+      RigFeed::Publisher publisher( feedName, 4 );
+      RigFeed::Subscriber subscriber( feedName );
+      publisher.Publish( "feed_test", 0, Rig::DefaultPoseHumanoid() );
+      
+      int fd = shm_open( feedName.c_str(), O_RDWR, 0 );
+      REQUIRE( fd >= 0 );
+      const size_t size = sizeof( RigFeed::Header ) + 4 * sizeof( RigFeed::Slot );
+      void * memory = mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+      close( fd );
+      REQUIRE( memory != MAP_FAILED );
+      RigFeed::Slot * slots = reinterpret_cast< RigFeed::Slot * >( static_cast< uint8_t * >( memory ) + sizeof( RigFeed::Header ) );
+      
+      RigFeed::Frame frame;
+      uint64_t numDropped = 0;
+      slots[ 0 ].sequence.fetch_add( 1 );
+      CHECK_FALSE( subscriber.Next( frame, numDropped ) );
+      CHECK_FALSE( subscriber.Next( frame, numDropped ) );
+      
+      // Once it's written, it's read
+      slots[ 0 ].sequence.fetch_add( 1 );
+      CHECK( subscriber.Next( frame, numDropped ) );
+      CHECK( frame.index == 0 );
+      CHECK( numDropped == 0 );
+      munmap( memory, size );
+   }
+#endif
+
+#ifdef __linux__
+   SECTION( "follow" )
+   {
+      static std::atomic< int > numFrames( 0 );
+      numFrames = 0;
+      
+      // Segments go to a fresh directory, which starts with one finished segment
+      char directoryTemplate[] = "/tmp/rig2cTest_XXXXXX";
+      REQUIRE( mkdtemp( directoryTemplate ) != nullptr );
+      const std::string directory = directoryTemplate;
+      std::stringstream contents;
+      contents << std::ifstream( g_url ).rdbuf();
+      const std::string segment = contents.str();
+      REQUIRE( segment.size() > 0 );
+      std::ofstream( directory + "/seg_100.json" ) << segment;
+      
+      Utility * utility = Utility::GetInstance();
+      
+      REQUIRE_NOTHROW( utility->LoadLib() );
+      
+      rig_RETURN_CODE returnValue = rig_NO_ERROR;
+      rig_followDelegate follow = rig_followDelegate(utility->GetFunctions()[ "rig_follow" ]);
+      
+      // Initialize the lib
+      returnValue = (rig_initializeDelegate(utility->GetFunctions()[ "rig_initialize" ]))( nullptr );
+      CHECK( returnValue == rig_NO_ERROR );
+      
+      (rig_setFrameCallbackDelegate(utility->GetFunctions()[ "rig_setFrameCallback" ]))( []( auto rigId, auto frameTimestamp, auto locationXYZ, auto boneRotations, auto numBoneRotations, auto boneLengths, auto numBoneLengths, auto boneOffsets, auto numBoneOffsets )
+      {
+         Callbacks::OnFrame( rigId, frameTimestamp, locationXYZ, boneRotations, numBoneRotations, boneLengths, numBoneLengths, boneOffsets, numBoneOffsets );
+         ++numFrames;
+      } );
+      
+      // No directory to follow
+      returnValue = follow( (directory + "/missing").c_str(), 2 );
+      CHECK( returnValue == rig_BAD_PATH );
+      
+      (rig_setErrorCallbackDelegate(utility->GetFunctions()[ "rig_setErrorCallback" ]))( Callbacks::OnError );
+      returnValue = follow( directory.c_str(), 2 );
+      REQUIRE( returnValue == rig_NO_ERROR );
+      
+      // The existing segment arrives once it has settled
+      for ( int i = 0; i < 500 && numFrames == 0; ++i )
+         std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+      std::this_thread::sleep_for( std::chrono::milliseconds( 200 ) );
+      const int framesPerSegment = numFrames;
+      CHECK( framesPerSegment > 0 );
+      
+      // A segment still being written is left alone, however long it takes
+      {
+         std::ofstream file( directory + "/seg_200.json" );
+         file << segment.substr( 0, segment.size() / 2 );
+         file.flush();
+         std::this_thread::sleep_for( std::chrono::milliseconds( 1000 ) );
+         CHECK( numFrames == framesPerSegment );
+         file << segment.substr( segment.size() / 2 );
+      }
+      for ( int i = 0; i < 500 && numFrames < framesPerSegment * 2; ++i )
+         std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+      CHECK( numFrames == framesPerSegment * 2 );
+      
+      // A patch to it is played when it appears, and a partitioned segment through its manifest, not its parts
+      std::ofstream( directory + "/seg_200_patch1.json" ) << segment;
+      for ( int i = 0; i < 500 && numFrames < framesPerSegment * 3; ++i )
+         std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+      CHECK( numFrames == framesPerSegment * 3 );
+      nlohmann::json manifest = nlohmann::json::parse( segment );
+      manifest[ "rigs" ] = nlohmann::json::array( { { { "id", "everyone" }, { "file", "seg_300.everyone.json" } } } );
+      std::ofstream( directory + "/seg_300.everyone.json" ) << segment;
+      std::ofstream( directory + "/seg_300.manifest.json" ) << manifest.dump();
+      for ( int i = 0; i < 500 && numFrames < framesPerSegment * 4; ++i )
+         std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+      std::this_thread::sleep_for( std::chrono::milliseconds( 200 ) );
+      
+      (rig_stopReadDelegate(utility->GetFunctions()[ "rig_stopRead" ]))();
+      CHECK( numFrames == framesPerSegment * 4 );
+      
+      (rig_uninitializeDelegate(utility->GetFunctions()[ "rig_uninitialize" ]))();
+      utility->CloseLib();
+      
+      for ( const char * filename : { "seg_100.json", "seg_200.json", "seg_200_patch1.json", "seg_300.everyone.json", "seg_300.manifest.json" } )
+         remove( (directory + "/" + filename).c_str() );
+      remove( directory.c_str() );
+      
+      if ( !Callbacks::errorString.empty() )
+         FAIL( Callbacks::errorString );
+   }
+#endif
 }
 
 TEST_CASE( "stress", "[stress]" )
@@ -2,6 +2,7 @@
 #include <catch2/catch.hpp>
 
 #include "Utility.hpp"
+#include "ReadBench.hpp"
 
 using namespace Catch::clara;
 
@@ -12,7 +13,13 @@ int main( int argc, char* argv[] )
    auto cli = session.cli()
       | Opt( g_url, "url")
          ["-u"]["--url"]
-         ("**REQUIRED** URL to json file on local disk" );
+         ("**REQUIRED** URL to json file on local disk" )
+      | Opt( g_benchMinutes, "minutes" )
+         ["--bench-minutes"]
+         ("Longest match, in minutes, the [bench] test reads. Default is 90" )
+      | Opt( g_benchReaders, "readers" )
+         ["--bench-readers"]
+         ("Most concurrent readers the [bench] test uses. Default is 4" );
 
    session.cli( cli );
 
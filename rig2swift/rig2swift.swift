@@ -8,6 +8,7 @@ public enum ReturnCode: Int {
    API_NOT_INITIALIZED =    -5,
    NO_CALLBACK =            -6,
    NO_MORE_DATA =           -7,
+   FRAMES_DROPPED =         -8,
    UNKNOWN_ERROR =          -12345
 }
 